@@ -0,0 +1,830 @@
+// Throughput of the processing stages on synthetic frames.
+//
+//   processing_bench [stage...] [--iterations N]
+//
+// Runs every stage when none is named. Each stage checks its SIMD kernels
+// against the scalar reference before timing them and exits with 1 on a
+// mismatch, so the benchmark doubles as a smoke test of the dispatch.
+
+#include "hardware/webcam/region_of_interest.h"
+#include "hardware/webcam/synthetic_source.h"
+#include "processing/background_model.h"
+#include "processing/blob_extractor.h"
+#include "processing/color_convert.h"
+#include "processing/frame_cache.h"
+#include "processing/motion_detector.h"
+#include "processing/optical_flow.h"
+#include "processing/resampler.h"
+#include "processing/trace_report.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+int iterations = 200;
+
+const char* kernelName(SimdKernel kernel) {
+    switch (kernel) {
+    case SimdKernel::Scalar:
+        return "scalar";
+    case SimdKernel::Sse2:
+        return "sse2";
+    case SimdKernel::Avx2:
+        return "avx2";
+    case SimdKernel::Avx512:
+        return "avx512";
+    default:
+        return "auto";
+    }
+}
+
+/**
+ * @brief Median wall time of one call to `work`, in milliseconds.
+ * @param runs Timed calls, `iterations` if 0.
+ */
+double measure(const std::function<void()>& work, int runs = 0) {
+    work(); // Warm caches and lazily built tables
+    std::vector<double> times(static_cast<std::size_t>(runs > 0 ? runs : iterations));
+    for (double& time : times) {
+        auto start = std::chrono::steady_clock::now();
+        work();
+        time = std::chrono::duration<double, std::milli>(
+                   std::chrono::steady_clock::now() - start)
+                   .count();
+    }
+    std::nth_element(times.begin(), times.begin() + times.size() / 2,
+                     times.end());
+    return times[times.size() / 2];
+}
+
+std::vector<uint8_t> renderFrame(const MediaFormat& format, uint64_t sequence) {
+    std::vector<uint8_t> data(rawFrameSize(format));
+    SyntheticSource::render(format, sequence, 0, data.data());
+    return data;
+}
+
+bool benchConvert() {
+    const SimdKernel kernels[] = {SimdKernel::Scalar, SimdKernel::Sse2,
+                                  SimdKernel::Avx2, SimdKernel::Avx512};
+    const uint32_t subtypes[]  = {FOURCC_YUY2, FOURCC_UYVY, FOURCC_NV12,
+                                  FOURCC_I420, FOURCC_IYUV, FOURCC_YV12};
+    const std::pair<PixelOutput, const char*> outputs[] = {
+        {PixelOutput::Rgba, "rgba"}, {PixelOutput::Bgra, "bgra"}, {PixelOutput::Gray, "gray"}};
+    const ColorMatrix matrices[] = {ColorMatrix::Bt601, ColorMatrix::Bt709};
+    const ColorRange  ranges[]   = {ColorRange::Limited, ColorRange::Full};
+    // Widths that leave every tail length of the 16, 32 and 64 pixel loops,
+    // odd ones included
+    const uint32_t sizes[][2] = {{1920, 1080}, {1918, 4}, {94, 6}, {71, 5}, {33, 3}, {2, 2}};
+
+    std::printf("convert: every subtype, output, matrix and range against scalar\n");
+    std::mt19937 random(7);
+    for (const auto& size : sizes) {
+        const MediaFormat probe{FOURCC_YUY2, size[0], size[1], 30, 1};
+        for (uint32_t subtype : subtypes) {
+            MediaFormat format = probe;
+            format.subtype     = subtype;
+            // Random bytes reach the clamps that the test pattern does not
+            std::vector<uint8_t> source(rawFrameSize(format));
+            for (uint8_t& byte : source) {
+                byte = static_cast<uint8_t>(random());
+            }
+            for (const auto& output : outputs) {
+                // Padded rows, so a kernel writing past the width mismatches
+                const std::size_t stride = format.width * bytesPerPixel(output.first) + 24;
+                std::vector<uint8_t> reference(stride * format.height);
+                std::vector<uint8_t> result(reference.size());
+                for (ColorMatrix matrix : matrices) {
+                    for (ColorRange range : ranges) {
+                        ColorSettings settings{matrix, range, SimdKernel::Scalar};
+                        std::fill(reference.begin(), reference.end(), 0xA5);
+                        convertImage(subtype, source.data(), format.width, format.height,
+                                     reference.data(), stride, output.first, settings);
+                        for (SimdKernel kernel : kernels) {
+                            if (!isColorKernelAvailable(kernel)) {
+                                continue;
+                            }
+                            settings.kernel = kernel;
+                            std::fill(result.begin(), result.end(), 0xA5);
+                            convertImage(subtype, source.data(), format.width,
+                                         format.height, result.data(), stride,
+                                         output.first, settings);
+                            if (result != reference) {
+                                std::printf("  %4ux%-4u %ls %s %s %s %-7s  MISMATCH\n",
+                                            format.width, format.height,
+                                            fourccToString(subtype).c_str(),
+                                            output.second,
+                                            matrix == ColorMatrix::Bt709 ? "bt709" : "bt601",
+                                            range == ColorRange::Full ? "full" : "limited",
+                                            kernelName(kernel));
+                                return false;
+                            }
+                        }
+                    }
+                }
+                if (format.width * format.height < 1920 * 1080) {
+                    continue;
+                }
+
+                // Timed on the full frame with the default settings
+                for (SimdKernel kernel : kernels) {
+                    if (!isColorKernelAvailable(kernel)) {
+                        continue;
+                    }
+                    ColorSettings settings;
+                    settings.kernel = kernel;
+                    double ms       = measure([&] {
+                        convertImage(subtype, source.data(), format.width, format.height,
+                                     result.data(), stride, output.first, settings);
+                    });
+                    std::printf("  %4ux%-4u %ls %-4s %-7s %8.3f ms  %8.1f Mpx/s\n",
+                                format.width, format.height,
+                                fourccToString(subtype).c_str(), output.second,
+                                kernelName(kernel), ms,
+                                static_cast<double>(format.width) * format.height /
+                                    ms / 1000.0);
+                }
+            }
+        }
+    }
+    std::printf("  every kernel matches at %zu sizes\n", std::size(sizes));
+    return true;
+}
+
+bool benchMotion() {
+    const SimdKernel kernels[] = {SimdKernel::Scalar, SimdKernel::Sse2,
+                                  SimdKernel::Avx2, SimdKernel::Avx512};
+    const MediaFormat formats[] = {{FOURCC_NV12, 1280, 720, 30, 1},
+                                   {FOURCC_NV12, 1920, 1080, 30, 1},
+                                   {FOURCC_NV12, 3840, 2160, 30, 1}};
+
+    std::printf("motion: luma tiles, 16x16, threshold 12\n");
+    for (const MediaFormat& format : formats) {
+        // Consecutive frames: the background drifts by one level, the square
+        // moves by a few pixels
+        std::vector<uint8_t> previous = renderFrame(format, 0);
+        std::vector<uint8_t> current  = renderFrame(format, 1);
+
+        MotionOptions options;
+        MotionMap     reference, map;
+        options.kernel = SimdKernel::Scalar;
+        detectMotion(previous.data(), current.data(), format.width,
+                     format.width, format.height, options, reference);
+
+        for (SimdKernel kernel : kernels) {
+            if (!isMotionKernelAvailable(kernel)) {
+                continue;
+            }
+            options.kernel = kernel;
+            double ms      = measure([&] {
+                detectMotion(previous.data(), current.data(), format.width,
+                             format.width, format.height, options, map);
+            });
+            const bool match = map.energy == reference.energy &&
+                               map.changed == reference.changed &&
+                               map.active == reference.active;
+            const double pixels = static_cast<double>(format.width) * format.height;
+            std::printf("  %4ux%-4u %-7s %8.3f ms  %8.1f Mpx/s  %zu active%s\n",
+                        format.width, format.height, kernelName(kernel), ms,
+                        pixels / ms / 1000.0, map.active_tiles,
+                        match ? "" : "  MISMATCH");
+            if (!match) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+bool benchBackground() {
+    const SimdKernel kernels[] = {SimdKernel::Scalar, SimdKernel::Sse2,
+                                  SimdKernel::Avx2, SimdKernel::Avx512};
+    const MediaFormat format{FOURCC_NV12, 1920, 1080, 30, 1};
+    const BackgroundMode modes[] = {BackgroundMode::RunningAverage,
+                                    BackgroundMode::Mixture};
+
+    // A short clip replayed in a loop; every kernel sees the same frames
+    std::vector<Frame> clip;
+    for (uint64_t i = 0; i < 8; ++i) {
+        Frame frame;
+        frame.format = format;
+        frame.buffer = FrameBufferRef::allocate(rawFrameSize(format));
+        SyntheticSource::render(format, i, 0, frame.buffer.data());
+        clip.push_back(frame);
+    }
+
+    auto single = std::make_shared<ThreadPool>(1);
+    auto all    = std::make_shared<ThreadPool>();
+    std::printf("background: 1920x1080, 1 and %zu threads\n", all->size());
+    for (BackgroundMode mode : modes) {
+        std::vector<uint8_t> reference;
+        for (SimdKernel kernel : kernels) {
+            if (!isBackgroundKernelAvailable(kernel)) {
+                continue;
+            }
+            BackgroundOptions options;
+            options.mode   = mode;
+            options.kernel = kernel;
+
+            // Masks after one pass over the clip must match the scalar ones
+            BackgroundModel check(options, single);
+            Frame           mask;
+            for (const Frame& frame : clip) {
+                check.apply(frame, mask);
+            }
+            std::vector<uint8_t> result(mask.buffer.data(),
+                                        mask.buffer.data() + mask.buffer.size());
+            if (reference.empty()) {
+                reference = result;
+            }
+            const bool match = result == reference;
+
+            double ms[2];
+            int    index = 0;
+            for (const auto& workers : {single, all}) {
+                BackgroundModel model(options, workers);
+                std::size_t     next = 0;
+                ms[index++]          = measure([&] {
+                    model.apply(clip[next++ % clip.size()], mask);
+                });
+            }
+            std::printf("  %-15s %-7s %8.3f ms  %8.3f ms%s\n",
+                        mode == BackgroundMode::Mixture ? "mixture"
+                                                        : "running average",
+                        kernelName(kernel), ms[0], ms[1],
+                        match ? "" : "  MISMATCH");
+            if (!match) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Value noise on three scales, sampled at `(x - dx, y - dy)`, so
+ * calling it with a shift renders the same texture moved by exactly that.
+ */
+std::vector<uint8_t> renderTexture(uint32_t width, uint32_t height, double dx,
+                                   double dy) {
+    const int    scales[] = {3, 9, 27};
+    std::mt19937 random(42);
+
+    std::vector<float> sum(static_cast<std::size_t>(width) * height, 0.0f);
+    for (int scale : scales) {
+        const uint32_t     grid_width  = width / scale + 4;
+        const uint32_t     grid_height = height / scale + 4;
+        std::vector<float> grid(static_cast<std::size_t>(grid_width) * grid_height);
+        for (float& value : grid) {
+            value = static_cast<float>(random() % 256);
+        }
+        auto smooth = [](double t) { return t * t * (3 - 2 * t); };
+        for (uint32_t y = 0; y < height; ++y) {
+            const double fy = std::clamp((y - dy) / scale + 1, 0.0, grid_height - 2.0);
+            const auto   gy = static_cast<std::size_t>(fy);
+            const double b  = smooth(fy - gy);
+            for (uint32_t x = 0; x < width; ++x) {
+                const double fx = std::clamp((x - dx) / scale + 1, 0.0, grid_width - 2.0);
+                const auto   gx = static_cast<std::size_t>(fx);
+                const double a  = smooth(fx - gx);
+                const float* g  = grid.data() + gy * grid_width + gx;
+                sum[y * width + x] += static_cast<float>(
+                    (1 - a) * (1 - b) * g[0] + a * (1 - b) * g[1] +
+                    (1 - a) * b * g[grid_width] + a * b * g[grid_width + 1]);
+            }
+        }
+    }
+    std::vector<uint8_t> plane(sum.size());
+    for (std::size_t i = 0; i < plane.size(); ++i) {
+        plane[i] = static_cast<uint8_t>(sum[i] / std::size(scales));
+    }
+    return plane;
+}
+
+bool benchFlow() {
+    const SimdKernel kernels[] = {SimdKernel::Scalar, SimdKernel::Sse2,
+                                  SimdKernel::Avx2, SimdKernel::Avx512};
+    const uint32_t sizes[][2]  = {{1280, 720}, {1920, 1080}};
+    const std::size_t counts[] = {500, 2000, 10000};
+    const double shift_x = 5.25, shift_y = -3.5;
+    const int    runs    = std::max(1, iterations / 20); // Calls take milliseconds
+
+    auto single = std::make_shared<ThreadPool>(1);
+    auto all    = std::make_shared<ThreadPool>();
+    std::printf("flow: pyramidal LK, 21x21 window, 4 levels, 1 and %zu threads\n",
+                all->size());
+    for (const auto& size : sizes) {
+        const uint32_t width = size[0], height = size[1];
+        std::vector<uint8_t> previous = renderTexture(width, height, 0, 0);
+        std::vector<uint8_t> current  = renderTexture(width, height, shift_x, shift_y);
+
+        FlowOptions  options;
+        ImagePyramid from, to;
+        for (SimdKernel kernel : kernels) {
+            if (!isFlowKernelAvailable(kernel)) {
+                continue;
+            }
+            ImagePyramid pyramid;
+            double       ms = measure([&] {
+                pyramid.build(current.data(), width, width, height,
+                              options.levels, true, kernel, single.get());
+            });
+            std::printf("  %4ux%-4u %-7s pyramid %8.3f ms\n", width, height,
+                        kernelName(kernel), ms);
+        }
+        from.build(previous.data(), width, width, height, options.levels, true);
+        to.build(current.data(), width, width, height, options.levels, true);
+
+        for (std::size_t count : counts) {
+            // Evenly spread over the frame, away from the edges
+            std::vector<FlowPoint> points;
+            const auto columns = static_cast<std::size_t>(
+                std::ceil(std::sqrt(count * double(width) / height)));
+            const std::size_t rows = (count + columns - 1) / columns;
+            for (std::size_t i = 0; i < count; ++i) {
+                FlowPoint point;
+                point.x = static_cast<float>(16 + (width - 32.0) * (i % columns + 0.5) / columns);
+                point.y = static_cast<float>(16 + (height - 32.0) * (i / columns + 0.5) / rows);
+                points.push_back(point);
+            }
+
+            std::vector<FlowPoint> reference, tracked;
+            options.kernel = SimdKernel::Scalar;
+            computeFlow(from, to, points, reference, options);
+            for (SimdKernel kernel : kernels) {
+                if (!isFlowKernelAvailable(kernel)) {
+                    continue;
+                }
+                options.kernel = kernel;
+                double ms[2];
+                int    index = 0;
+                for (const auto& workers : {single, all}) {
+                    ms[index++] = measure([&] {
+                        computeFlow(from, to, points, tracked, options, workers.get());
+                    }, runs);
+                }
+
+                bool        match = true;
+                std::size_t found = 0, accurate = 0;
+                for (std::size_t i = 0; i < count; ++i) {
+                    const FlowPoint& a = tracked[i];
+                    const FlowPoint& b = reference[i];
+                    match = match && a.x == b.x && a.y == b.y && a.found == b.found &&
+                            a.error == b.error;
+                    found += a.found;
+                    accurate += a.found &&
+                                std::hypot(a.x - points[i].x - shift_x,
+                                           a.y - points[i].y - shift_y) < 0.1;
+                }
+                std::printf("  %4ux%-4u %5zu pts %-7s %8.3f ms  %8.3f ms  "
+                            "%7.0f kpts/s  %zu found, %zu within 0.1 px%s\n",
+                            width, height, count, kernelName(kernel), ms[0], ms[1],
+                            count / ms[1], found, accurate, match ? "" : "  MISMATCH");
+                if (!match) {
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+bool benchCache() {
+    const MediaFormat format{FOURCC_YUY2, 1920, 1080, 30, 1};
+    const char* names[] = {"gray", "half", "quarter", "rgba"};
+
+    // Three stages and a preview read the same packed frames; the luma is
+    // extracted once per frame and shared
+    auto                   workers = std::make_shared<ThreadPool>();
+    MotionDetector         motion;
+    BackgroundModel        background({}, workers);
+    OpticalFlowTracker     flow({}, workers);
+    MotionMap              map;
+    Frame                  mask, product;
+    std::vector<FlowPoint> points, tracked;
+    for (uint32_t y = 64; y < format.height - 64; y += 64) {
+        for (uint32_t x = 64; x < format.width - 64; x += 64) {
+            points.push_back({static_cast<float>(x), static_cast<float>(y)});
+        }
+    }
+
+    resetFrameProductStats();
+    const uint64_t frames = static_cast<uint64_t>(std::max(1, iterations / 10));
+    for (uint64_t i = 0; i < frames; ++i) {
+        Frame frame;
+        frame.format = format;
+        frame.buffer = FrameBufferRef::allocate(rawFrameSize(format));
+        SyntheticSource::render(format, i, 0, frame.buffer.data());
+
+        motion.process(frame, map);
+        background.apply(frame, mask, &map);
+        flow.track(frame, points, tracked);
+        frameProduct(frame, FrameProduct::Quarter, product);
+        frameProduct(frame, FrameProduct::Rgba, product);
+    }
+
+    std::printf("cache: 1920x1080 YUY2, motion, background, flow and preview, "
+                "%llu frames\n",
+                static_cast<unsigned long long>(frames));
+    for (std::size_t i = 0; i < FRAME_PRODUCTS; ++i) {
+        const FrameProductStats stats = getFrameProductStats(FrameProduct(i));
+        std::printf("  %-7s %6llu hits  %6llu misses  %8.3f ms per compute\n",
+                    names[i], static_cast<unsigned long long>(stats.hits),
+                    static_cast<unsigned long long>(stats.misses),
+                    stats.misses ? stats.compute_ns / 1e6 / stats.misses : 0.0);
+    }
+    return true;
+}
+
+bool benchBlobs() {
+    const uint32_t width = 3840, height = 2160;
+    const std::size_t threads[] = {1, 2, 4, 8};
+    const int         runs      = std::max(1, iterations / 10);
+
+    // Sparse: a few hundred discs over an empty frame; dense: salt noise with
+    // every other pixel set, which is nearly all runs and tiny blobs
+    std::mt19937         rng(7);
+    std::vector<uint8_t> sparse(static_cast<std::size_t>(width) * height);
+    for (int i = 0; i < 300; ++i) {
+        const int cx = static_cast<int>(rng() % width);
+        const int cy = static_cast<int>(rng() % height);
+        const int r  = 4 + static_cast<int>(rng() % 40);
+        for (int y = std::max(0, cy - r); y < std::min<int>(height, cy + r); ++y) {
+            for (int x = std::max(0, cx - r); x < std::min<int>(width, cx + r); ++x) {
+                if ((x - cx) * (x - cx) + (y - cy) * (y - cy) <= r * r) {
+                    sparse[static_cast<std::size_t>(y) * width + x] = 255;
+                }
+            }
+        }
+    }
+    std::vector<uint8_t> dense(sparse.size());
+    for (uint8_t& pixel : dense) {
+        pixel = rng() % 2 ? 255 : 0;
+    }
+
+    std::printf("blobs: 3840x2160 masks, 8-connected, by worker count\n");
+    const std::pair<const char*, const std::vector<uint8_t>*> masks[] = {
+        {"sparse", &sparse}, {"dense", &dense}};
+    for (const auto& mask : masks) {
+        std::vector<Blob> reference, blobs;
+        double            base = 0;
+        for (std::size_t count : threads) {
+            BlobExtractor extractor({}, std::make_shared<ThreadPool>(count));
+            double        ms = measure([&] {
+                extractor.extract(mask.second->data(), width, width, height, blobs);
+            }, runs);
+            if (count == 1) {
+                reference = blobs;
+                base      = ms;
+            }
+            // Labels do not depend on the band split, compare whole blobs
+            bool match = blobs.size() == reference.size();
+            for (std::size_t i = 0; match && i < blobs.size(); ++i) {
+                match = std::memcmp(&blobs[i], &reference[i], sizeof(Blob)) == 0;
+            }
+            const BlobStats stats = extractor.getStats();
+            std::printf("  %-6s %zu threads %8.3f ms  x%4.2f  %8zu runs  %7zu blobs%s\n",
+                        mask.first, count, ms, base / ms, stats.runs, stats.blobs,
+                        match ? "" : "  MISMATCH");
+            if (!match) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+bool benchTrace() {
+    const MediaFormat format{FOURCC_NV12, 1920, 1080, 60, 1};
+    const std::size_t cameras = 4;
+    const int         seconds = std::max(1, iterations / 100);
+
+    // Four cameras' worth of frames per tick; each one is dequeued, converted
+    // for display, run through motion detection and presented
+    std::vector<Frame> clip;
+    for (uint64_t i = 0; i < 8; ++i) {
+        Frame frame;
+        frame.format = format;
+        frame.buffer = FrameBufferRef::allocate(rawFrameSize(format));
+        SyntheticSource::render(format, i, 0, frame.buffer.data());
+        clip.push_back(frame);
+    }
+    std::vector<MotionDetector> motion(cameras);
+    std::vector<uint8_t>        rgba(static_cast<std::size_t>(format.width) * format.height * 4);
+    TraceReport                 report;
+    MotionMap                   map;
+
+    auto run = [&](int frames) {
+        for (int i = 0; i < frames; ++i) {
+            for (std::size_t camera = 0; camera < cameras; ++camera) {
+                Frame frame    = clip[(i + camera) % clip.size()];
+                frame.capture  = hostTime100ns();
+                frame.arrival  = frame.capture;
+                frame.trace_id = nextTraceId();
+                recordTraceSpan(frame.trace_id, TraceStage::Capture, frame.capture,
+                                frame.arrival);
+                recordTraceSpan(frame.trace_id, TraceStage::Queue, frame.arrival,
+                                hostTime100ns());
+                convertFrame(frame, rgba.data(), format.width * 4, PixelOutput::Rgba);
+                motion[camera].process(frame, map);
+                TraceScope present(frame, TraceStage::Present);
+            }
+            if (i % 60 == 59) {
+                report.collect();
+            }
+        }
+    };
+
+    // Alternate short runs so drift in clock speed hits both sides alike
+    const int frames = 60 * seconds;
+    double    off = 0, on = 0;
+    for (int round = 0; round < 4; ++round) {
+        stopFrameTrace();
+        off += measure([&] { run(frames / 4); }, 1);
+        startFrameTrace();
+        on += measure([&] { run(frames / 4); }, 1);
+    }
+    stopFrameTrace();
+    report.collect();
+
+    // Cost of a span on its own, clock reads included
+    Frame probe;
+    probe.trace_id = nextTraceId();
+    startFrameTrace();
+    const int spans = 100000;
+    double    span_ms = measure([&] {
+        for (int i = 0; i < spans; ++i) {
+            TraceScope scope(probe, TraceStage::Process, "probe");
+        }
+        std::vector<TraceEvent> events;
+        collectTraceEvents(events);
+    }, 5);
+    stopFrameTrace();
+
+    uint64_t recorded = 0;
+    for (const auto& stage : report.getStages()) {
+        recorded += stage.second.count();
+    }
+    const LatencyHistogram& total       = report.getEndToEnd();
+    const double            span_ns     = span_ms * 1e6 / spans;
+    const double            spans_per_s = static_cast<double>(recorded) /
+                                          std::max<uint64_t>(1, total.count()) *
+                                          cameras * format.fps_numerator;
+    std::printf("trace: %zu x 1920x1080 NV12, convert + motion, %d frames per camera, "
+                "%s\n",
+                cameras, frames * 2, FRAME_TRACE_ENABLED ? "compiled in" : "compiled out");
+    std::printf("  off %8.3f ms  on %8.3f ms  %+6.2f %%\n", off, on,
+                (on - off) / off * 100.0);
+    std::printf("  %6.1f ns per span, %4.0f spans/s at 60 fps = %6.4f %% of one core\n",
+                span_ns, spans_per_s, spans_per_s * span_ns / 1e7);
+    for (const auto& stage : report.getStages()) {
+        std::printf("  %-8s %7llu spans  p50 %6llu us  p99 %6llu us  max %6llu us\n",
+                    stage.first.c_str(),
+                    static_cast<unsigned long long>(stage.second.count()),
+                    static_cast<unsigned long long>(stage.second.percentile(50)),
+                    static_cast<unsigned long long>(stage.second.percentile(99)),
+                    static_cast<unsigned long long>(stage.second.max()));
+    }
+    std::printf("  %-8s %7llu frames p50 %6llu us  p99 %6llu us  max %6llu us\n", "total",
+                static_cast<unsigned long long>(total.count()),
+                static_cast<unsigned long long>(total.percentile(50)),
+                static_cast<unsigned long long>(total.percentile(99)),
+                static_cast<unsigned long long>(total.max()));
+    return true;
+}
+
+bool benchResample() {
+    const SimdKernel kernels[] = {SimdKernel::Scalar, SimdKernel::Sse2,
+                                  SimdKernel::Avx2, SimdKernel::Avx512};
+    const std::pair<ResampleFilter, const char*> filters[] = {
+        {ResampleFilter::Box, "box"},
+        {ResampleFilter::Bilinear, "bilinear"},
+        {ResampleFilter::Lanczos3, "lanczos3"}};
+    struct Ratio {
+        uint32_t src_width, src_height, dst_width, dst_height;
+    };
+    const Ratio ratios[] = {{3840, 2160, 640, 360},
+                            {1920, 1080, 426, 240},
+                            {1920, 1080, 960, 540},
+                            {640, 360, 1280, 720}};
+    const int runs = std::max(1, iterations / 10);
+
+    auto single = std::make_shared<ThreadPool>(1);
+    auto all    = std::make_shared<ThreadPool>();
+    std::printf("resample: RGBA and gray, 1 and %zu threads\n", all->size());
+    for (const Ratio& ratio : ratios) {
+        // Gray is a texture, RGBA three shifted copies of it and opaque alpha
+        const std::size_t    pixels = static_cast<std::size_t>(ratio.src_width) *
+                                   ratio.src_height;
+        std::vector<uint8_t> gray = renderTexture(ratio.src_width, ratio.src_height, 0, 0);
+        std::vector<uint8_t> rgba(pixels * 4, 255);
+        for (std::size_t i = 0; i < pixels; ++i) {
+            rgba[i * 4]     = gray[i];
+            rgba[i * 4 + 1] = gray[(i + 7 * ratio.src_width + 3) % pixels];
+            rgba[i * 4 + 2] = gray[(i + 13 * ratio.src_width + 11) % pixels];
+        }
+
+        for (uint32_t channels : {4u, 1u}) {
+            const std::vector<uint8_t>& source = channels == 4 ? rgba : gray;
+            const std::size_t dst_stride = static_cast<std::size_t>(ratio.dst_width) * channels;
+            for (const auto& filter : filters) {
+                std::vector<uint8_t> reference, result(dst_stride * ratio.dst_height);
+                for (SimdKernel kernel : kernels) {
+                    if (!isResampleKernelAvailable(kernel)) {
+                        continue;
+                    }
+                    ResampleOptions options;
+                    options.filter = filter.first;
+                    options.kernel = kernel;
+
+                    double ms[2];
+                    int    index = 0;
+                    for (const auto& workers : {single, all}) {
+                        Resampler resampler(options, workers);
+                        ms[index++] = measure([&] {
+                            resampler.resample(source.data(), ratio.src_width * channels,
+                                               ratio.src_width, ratio.src_height,
+                                               channels, result.data(), dst_stride,
+                                               ratio.dst_width, ratio.dst_height);
+                        }, runs);
+                    }
+                    if (reference.empty()) {
+                        reference = result;
+                    }
+                    const bool match = result == reference;
+                    std::printf("  %4ux%-4u -> %4ux%-4u %-4s %-8s %-7s %8.3f ms  "
+                                "%8.3f ms  %8.1f Mpx/s%s\n",
+                                ratio.src_width, ratio.src_height, ratio.dst_width,
+                                ratio.dst_height, channels == 4 ? "rgba" : "gray",
+                                filter.second, kernelName(kernel), ms[0], ms[1],
+                                pixels / ms[1] / 1000.0, match ? "" : "  MISMATCH");
+                    if (!match) {
+                        return false;
+                    }
+                }
+            }
+        }
+    }
+    return true;
+}
+
+bool benchRoi() {
+    const MediaFormat format{FOURCC_YUY2, 1920, 1080, 30, 1};
+    const double      coverages[] = {1.0, 0.5, 0.1};
+    const int         runs        = std::max(1, iterations / 10);
+    const std::size_t pixels = static_cast<std::size_t>(format.width) * format.height;
+
+    std::vector<Frame> clip;
+    for (uint64_t i = 0; i < 8; ++i) {
+        Frame frame;
+        frame.format = format;
+        frame.buffer = FrameBufferRef::allocate(rawFrameSize(format));
+        SyntheticSource::render(format, i, 0, frame.buffer.data());
+        clip.push_back(frame);
+    }
+
+    // Whole frames first, the reference for the covered parts
+    std::vector<uint8_t> reference(pixels * 4), rgba(pixels * 4);
+    convertFrame(clip[1], reference.data(), format.width * 4, PixelOutput::Rgba);
+    std::vector<std::vector<uint8_t>> lumas(clip.size(), std::vector<uint8_t>(pixels));
+    for (std::size_t i = 0; i < clip.size(); ++i) {
+        convertImage(format.subtype, clip[i].buffer.data(), format.width,
+                     format.height, lumas[i].data(), format.width, PixelOutput::Gray);
+    }
+    MotionOptions motion_options;
+    MotionMap     reference_map, map;
+    detectMotion(lumas[0].data(), lumas[1].data(), format.width, format.width,
+                 format.height, motion_options, reference_map);
+
+    // One worker, so the times are CPU time
+    auto workers = std::make_shared<ThreadPool>(1);
+    std::printf("roi: 1920x1080 YUY2, centred rectangles, 1 thread\n");
+    double full[4] = {};
+    for (std::size_t c = 0; c <= std::size(coverages); ++c) {
+        RoiRef roi;
+        if (c > 0) {
+            // Sides scaled by the square root give the area
+            const float side   = static_cast<float>(std::sqrt(coverages[c - 1]));
+            auto        region = std::make_shared<RegionOfInterest>();
+            region->addRectangle(0.5f - side / 2, 0.5f - side / 2, 0.5f + side / 2,
+                                 0.5f + side / 2);
+            roi = region;
+        }
+        auto mask = roi ? roi->getMask(format.width, format.height) : nullptr;
+
+        std::vector<Frame> frames = clip;
+        for (Frame& frame : frames) {
+            frame.roi = roi;
+        }
+
+        // Converted pixels inside the region and motion of covered tiles
+        // must match the whole frame, everything else is left alone
+        std::fill(rgba.begin(), rgba.end(), 0);
+        convertFrame(frames[1], rgba.data(), format.width * 4, PixelOutput::Rgba);
+        detectMotion(lumas[0].data(), lumas[1].data(), format.width, format.width,
+                     format.height, motion_options, map, mask.get());
+        bool match = true;
+        for (uint32_t y = 0; match && y < format.height; ++y) {
+            for (uint32_t x = 0; match && x < format.width; ++x) {
+                const std::size_t offset = (static_cast<std::size_t>(y) * format.width + x) * 4;
+                const bool        inside =
+                    !mask || mask->tile(x / mask->tile_size, y / mask->tile_size) !=
+                                 RoiCoverage::Outside;
+                match = inside ? std::memcmp(&rgba[offset], &reference[offset], 4) == 0
+                               : rgba[offset + 3] == 0;
+            }
+        }
+        for (std::size_t t = 0; match && t < map.energy.size(); ++t) {
+            const bool inside = !mask || mask->tiles[t] != RoiCoverage::Outside;
+            match = map.energy[t] == (inside ? reference_map.energy[t] : 0);
+        }
+
+        BackgroundModel   model({}, workers);
+        BlobExtractor     extractor({}, workers);
+        Frame             foreground;
+        std::vector<Blob> blobs;
+        std::size_t       next = 0;
+        double            ms[4];
+        // Frames rotate so the planes are not already cached
+        ms[0] = measure([&] {
+            convertFrame(frames[next++ % frames.size()], rgba.data(),
+                         format.width * 4, PixelOutput::Rgba);
+        }, runs);
+        ms[1] = measure([&] {
+            const std::size_t i = next++ % lumas.size();
+            detectMotion(lumas[i].data(), lumas[(i + 1) % lumas.size()].data(),
+                         format.width, format.width, format.height,
+                         motion_options, map, mask.get());
+        }, runs);
+        ms[2] = measure([&] {
+            model.apply(frames[next++ % frames.size()], foreground);
+        }, runs);
+        ms[3] = measure([&] { extractor.extract(foreground, blobs); }, runs);
+
+        if (c == 1) {
+            std::copy(ms, ms + 4, full);
+        }
+        const double area = mask ? mask->coverage() : 1.0;
+        std::printf("  %-5s %5.1f%%  convert %7.3f ms  motion %7.3f ms  "
+                    "background %7.3f ms  blobs %7.3f ms%s\n",
+                    roi ? "roi" : "none", area * 100.0, ms[0], ms[1], ms[2],
+                    ms[3], match ? "" : "  MISMATCH");
+        if (c > 1) {
+            std::printf("  %-5s %6s  x%-13.2f  x%-13.2f  x%-17.2f  x%.2f of the "
+                        "full region\n",
+                        "", "", ms[0] / full[0], ms[1] / full[1],
+                        ms[2] / full[2], ms[3] / full[3]);
+        }
+        if (!match) {
+            return false;
+        }
+    }
+    return true;
+}
+
+struct Stage {
+    const char* name;
+    bool (*run)();
+};
+
+const Stage STAGES[] = {
+    {"convert", benchConvert},
+    {"motion", benchMotion},
+    {"background", benchBackground},
+    {"flow", benchFlow},
+    {"cache", benchCache},
+    {"blobs", benchBlobs},
+    {"trace", benchTrace},
+    {"resample", benchResample},
+    {"roi", benchRoi},
+};
+
+} // namespace
+
+int main(int argc, char** argv) {
+    std::vector<std::string> selected;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--iterations") == 0 && i + 1 < argc) {
+            iterations = std::max(1, std::atoi(argv[++i]));
+        } else {
+            selected.emplace_back(argv[i]);
+        }
+    }
+
+    bool ok = true;
+    for (const Stage& stage : STAGES) {
+        if (selected.empty() ||
+            std::find(selected.begin(), selected.end(), stage.name) !=
+                selected.end()) {
+            ok = stage.run() && ok;
+        }
+    }
+    return ok ? 0 : 1;
+}
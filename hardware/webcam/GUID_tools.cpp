@@ -1,7 +1,119 @@
 #include "GUID_tools.h"
 
-bool GuidComparer::operator()(const GUID& lhs, const GUID& rhs) const {
-    return memcmp(&lhs, &rhs, sizeof(GUID)) < 0;
+#include "pixel_format.h"
+#include <cstring>
+
+namespace {
+
+constexpr uint16_t BASE_DATA2    = 0x0000;
+constexpr uint16_t BASE_DATA3    = 0x0010;
+constexpr uint8_t  BASE_DATA4[8] = {0x80, 0x00, 0x00, 0xAA, 0x00, 0x38, 0x9B, 0x71};
+
+/**
+ * @brief Name of a base derived GUID from its `Data1`, for the codes the
+ * pixel format registry does not describe.
+ */
+constexpr const wchar_t* baseGuidName(uint32_t code) {
+    if (const PixelFormatTraits* traits = findPixelFormat(code)) {
+        return traits->name;
+    }
+    switch (code) {
+    // Major types
+    case makeFourCC('a', 'u', 'd', 's'):
+        return L"Audio";
+    case makeFourCC('v', 'i', 'd', 's'):
+        return L"Video";
+    // Video subtypes
+    case makeFourCC('A', 'I', '4', '4'):
+        return L"AI44";
+    case makeFourCC('A', 'Y', 'U', 'V'):
+        return L"AYUV";
+    case makeFourCC('d', 'v', '2', '5'):
+        return L"DV25";
+    case makeFourCC('d', 'v', '5', '0'):
+        return L"DV50";
+    case makeFourCC('d', 'v', 'h', '1'):
+        return L"DVH1";
+    case makeFourCC('d', 'v', 's', 'd'):
+        return L"DVSD";
+    case makeFourCC('d', 'v', 's', 'l'):
+        return L"DVSL";
+    case makeFourCC('H', '2', '6', '4'):
+        return L"H264";
+    case makeFourCC('N', 'V', '1', '1'):
+        return L"NV11";
+    case makeFourCC('v', '2', '1', '0'):
+        return L"v210";
+    case makeFourCC('v', '4', '1', '0'):
+        return L"v410";
+    case makeFourCC('W', 'M', 'V', '1'):
+        return L"WMV1";
+    case makeFourCC('W', 'M', 'V', '2'):
+        return L"WMV2";
+    case makeFourCC('W', 'M', 'V', '3'):
+        return L"WMV3";
+    case makeFourCC('W', 'V', 'C', '1'):
+        return L"WVC1";
+    // D3DFORMAT based RGB subtypes
+    case 20:
+        return L"RGB24";
+    case 21:
+        return L"ARGB32";
+    case 22:
+        return L"RGB32";
+    case 23:
+        return L"RGB565";
+    case 24:
+        return L"RGB555";
+    case 41:
+        return L"RGB8";
+    // Wave format tags
+    case 0x0001:
+        return L"PCM";
+    case 0x0003:
+        return L"Float";
+    case 0x0008:
+        return L"DTS";
+    case 0x0009:
+        return L"DRM";
+    case 0x0050:
+        return L"MPEG";
+    case 0x0055:
+        return L"MP3";
+    case 0x0092:
+        return L"Dolby AC3 SPDIF";
+    case 0x0161:
+        return L"WMAudioV8";
+    case 0x0162:
+        return L"WMAudioV9";
+    case 0x0163:
+        return L"WMAudio Lossless";
+    case 0x0164:
+        return L"WMASPDIF";
+    default:
+        return nullptr;
+    }
+}
+
+struct NamedGuid {
+    const GUID*    guid;
+    const wchar_t* name;
+};
+
+// Major types that are not derived from the base GUID
+const NamedGuid OTHER_GUIDS[] = {
+    {&MFMediaType_HTML, L"HTML"},
+    {&MFMediaType_Binary, L"Binary"},
+    {&MFMediaType_FileTransfer, L"File Transfer"},
+    {&MFMediaType_Image, L"Image"},
+    {&MFMediaType_Stream, L"Stream"},
+};
+
+} // namespace
+
+bool isFourCCGuid(const GUID& guid) {
+    return guid.Data2 == BASE_DATA2 && guid.Data3 == BASE_DATA3 &&
+           std::memcmp(guid.Data4, BASE_DATA4, sizeof(BASE_DATA4)) == 0;
 }
 
 // Additional function to convert GUID to string
@@ -11,60 +123,29 @@ std::wstring guidToString(const GUID& guid) {
     return std::wstring(buf);
 }
 
+const wchar_t* guidName(const GUID& guid) {
+    if (isFourCCGuid(guid)) {
+        return baseGuidName(guid.Data1);
+    }
+    for (const NamedGuid& entry : OTHER_GUIDS) {
+        if (IsEqualGUID(*entry.guid, guid)) {
+            return entry.name;
+        }
+    }
+    return nullptr;
+}
+
 // Mapping function to convert Media Foundation GUIDs to readable strings
 std::wstring getGuidName(const GUID& guid) {
-    static const std::map<GUID, std::wstring, GuidComparer> guidMap = {
-        {MFMediaType_Audio, L"Audio"},
-        {MFMediaType_Video, L"Video"},
-        {MFMediaType_HTML, L"HTML"},
-        {MFMediaType_Binary, L"Binary"},
-        {MFMediaType_FileTransfer, L"File Transfer"},
-        {MFMediaType_Image, L"Image"},
-        {MFMediaType_Stream, L"Stream"},
-        {MFVideoFormat_AI44, L"AI44"},
-        {MFVideoFormat_ARGB32, L"ARGB32"},
-        {MFVideoFormat_AYUV, L"AYUV"},
-        {MFVideoFormat_DV25, L"DV25"},
-        {MFVideoFormat_DV50, L"DV50"},
-        {MFVideoFormat_DVH1, L"DVH1"},
-        {MFVideoFormat_DVSD, L"DVSD"},
-        {MFVideoFormat_DVSL, L"DVSL"},
-        {MFVideoFormat_H264, L"H264"},
-        {MFVideoFormat_I420, L"I420"},
-        {MFVideoFormat_IYUV, L"IYUV"},
-        {MFVideoFormat_NV11, L"NV11"},
-        {MFVideoFormat_NV12, L"NV12"},
-        {MFVideoFormat_RGB24, L"RGB24"},
-        {MFVideoFormat_RGB32, L"RGB32"},
-        {MFVideoFormat_RGB555, L"RGB555"},
-        {MFVideoFormat_RGB565, L"RGB565"},
-        {MFVideoFormat_RGB8, L"RGB8"},
-        {MFVideoFormat_UYVY, L"UYVY"},
-        {MFVideoFormat_v210, L"v210"},
-        {MFVideoFormat_v410, L"v410"},
-        {MFVideoFormat_WMV1, L"WMV1"},
-        {MFVideoFormat_WMV2, L"WMV2"},
-        {MFVideoFormat_WMV3, L"WMV3"},
-        {MFVideoFormat_WVC1, L"WVC1"},
-        {MFVideoFormat_YUY2, L"YUY2"},
-        {MFVideoFormat_YV12, L"YV12"},
-        {MFAudioFormat_PCM, L"PCM"},
-        {MFAudioFormat_Float, L"Float"},
-        {MFAudioFormat_DTS, L"DTS"},
-        {MFAudioFormat_Dolby_AC3_SPDIF, L"Dolby AC3 SPDIF"},
-        {MFAudioFormat_DRM, L"DRM"},
-        {MFAudioFormat_WMAudioV8, L"WMAudioV8"},
-        {MFAudioFormat_WMAudioV9, L"WMAudioV9"},
-        {MFAudioFormat_WMAudio_Lossless, L"WMAudio Lossless"},
-        {MFAudioFormat_WMASPDIF, L"WMASPDIF"},
-        {MFAudioFormat_MP3, L"MP3"},
-        {MFAudioFormat_MPEG, L"MPEG"},
-        {MFVideoFormat_MJPG, L"MJPG"}};
+    wchar_t buf[39];
+    StringFromGUID2(guid, buf, 39);
 
-    auto it = guidMap.find(guid);
-    if (it != guidMap.end()) {
-        return L"Type: " + it->second + L" GUID: " + guidToString(guid);
+    std::wstring result;
+    result.reserve(64);
+    if (const wchar_t* name = guidName(guid)) {
+        result.append(L"Type: ").append(name).append(L" GUID: ").append(buf);
     } else {
-        return L"Unknown Type (" + guidToString(guid) + L")";
+        result.append(L"Unknown Type (").append(buf).append(L")");
     }
-}
\ No newline at end of file
+    return result;
+}
@@ -1,18 +1,27 @@
 #ifndef GUID_TOOLS_H
 #define GUID_TOOLS_H
 
-#include <iostream>
-#include <map>
 #include <mfapi.h>
+#include <string>
 
-struct GuidComparer {
-    bool operator()(const GUID& lhs, const GUID& rhs) const;
-};
+/**
+ * @brief Whether `guid` is derived from the `XXXXXXXX-0000-0010-8000-00AA00389B71`
+ * base: `Data1` then holds a FourCC for most video subtypes, a `D3DFORMAT`
+ * for the RGB ones and a wave format tag for audio subtypes.
+ */
+bool isFourCCGuid(const GUID& guid);
 
 // Additional function to convert GUID to string
 std::wstring guidToString(const GUID& guid);
 
+/**
+ * @brief Readable name of a Media Foundation major type or subtype, e.g.
+ * `NV12`. Pixel formats come from the `PIXEL_FORMATS` registry.
+ * @return nullptr for unknown GUIDs. Does not allocate.
+ */
+const wchar_t* guidName(const GUID& guid);
+
 // Mapping function to convert Media Foundation GUIDs to readable strings
 std::wstring getGuidName(const GUID& guid);
 
-#endif // GUID_TOOLS_H
\ No newline at end of file
+#endif // GUID_TOOLS_H
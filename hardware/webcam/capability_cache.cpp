@@ -0,0 +1,225 @@
+#include "capability_cache.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+namespace {
+
+constexpr uint64_t FNV_OFFSET = 1469598103934665603ull;
+constexpr uint64_t FNV_PRIME  = 1099511628211ull;
+
+uint64_t checksum(const uint8_t* data, std::size_t size) {
+    uint64_t hash = FNV_OFFSET;
+    for (std::size_t i = 0; i < size; ++i) {
+        hash = (hash ^ data[i]) * FNV_PRIME;
+    }
+    return hash;
+}
+
+void writeBytes(std::vector<uint8_t>& out, const void* data, std::size_t size) {
+    const auto* bytes = static_cast<const uint8_t*>(data);
+    out.insert(out.end(), bytes, bytes + size);
+}
+
+void writeString(std::vector<uint8_t>& out, const std::wstring& value) {
+    const auto length = static_cast<uint32_t>(value.size());
+    writeBytes(out, &length, sizeof(length));
+    for (wchar_t c : value) {
+        const auto unit = static_cast<uint16_t>(c);
+        writeBytes(out, &unit, sizeof(unit));
+    }
+}
+
+/**
+ * @brief Bounds-checked reads of the serialized entries.
+ */
+class Reader {
+  private:
+    const uint8_t* data_;
+    std::size_t    size_;
+    std::size_t    offset_{};
+
+  public:
+    Reader(const uint8_t* data, std::size_t size) : data_(data), size_(size) {}
+
+    bool read(void* out, std::size_t size) {
+        if (size > this->size_ - this->offset_) {
+            return false;
+        }
+        std::memcpy(out, this->data_ + this->offset_, size);
+        this->offset_ += size;
+        return true;
+    }
+
+    bool readString(std::wstring& value) {
+        uint32_t length = 0;
+        if (!this->read(&length, sizeof(length)) ||
+            length > (this->size_ - this->offset_) / sizeof(uint16_t)) {
+            return false;
+        }
+        value.resize(length);
+        for (wchar_t& c : value) {
+            uint16_t unit = 0;
+            if (!this->read(&unit, sizeof(unit))) {
+                return false;
+            }
+            c = static_cast<wchar_t>(unit);
+        }
+        return true;
+    }
+
+    bool done() const { return this->offset_ == this->size_; }
+};
+
+} // namespace
+
+CapabilityCache::CapabilityCache(std::filesystem::path path)
+    : path_(std::move(path)) {}
+
+std::filesystem::path CapabilityCache::defaultPath() {
+    std::filesystem::path base;
+#ifdef _WIN32
+    if (const char* local = std::getenv("LOCALAPPDATA")) {
+        base = local;
+    }
+#else
+    if (const char* cache = std::getenv("XDG_CACHE_HOME")) {
+        base = cache;
+    } else if (const char* home = std::getenv("HOME")) {
+        base = std::filesystem::path(home) / ".cache";
+    }
+#endif
+    if (base.empty()) {
+        std::error_code error;
+        base = std::filesystem::temp_directory_path(error);
+    }
+    return base / "imGUI_tests" / "capabilities.bin";
+}
+
+int16_t CapabilityCache::load() {
+    std::ifstream file(this->path_, std::ios::binary);
+    if (!file) {
+        std::error_code error;
+        return std::filesystem::exists(this->path_, error) ? -500 : 204;
+    }
+    std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)),
+                              std::istreambuf_iterator<char>());
+    if (file.bad()) {
+        return -500;
+    }
+
+    std::vector<CachedDevice> devices;
+    CapabilityCacheHeader     header{};
+    bool valid = data.size() >= sizeof(header);
+    if (valid) {
+        std::memcpy(&header, data.data(), sizeof(header));
+        valid = std::memcmp(header.magic, CAPABILITY_CACHE_MAGIC,
+                            sizeof(header.magic)) == 0 &&
+                header.version == CAPABILITY_CACHE_VERSION &&
+                header.checksum == checksum(data.data() + sizeof(header),
+                                            data.size() - sizeof(header));
+    }
+    Reader reader(valid ? data.data() + sizeof(header) : data.data(),
+                  valid ? data.size() - sizeof(header) : 0);
+    for (uint32_t i = 0; valid && i < header.device_count; ++i) {
+        CachedDevice device;
+        uint32_t     count = 0;
+        valid = reader.readString(device.identity.id) &&
+                reader.readString(device.identity.driver_version) &&
+                reader.readString(device.name) && reader.read(&count, sizeof(count));
+        for (uint32_t k = 0; valid && k < count; ++k) {
+            MediaFormat format;
+            valid = reader.read(&format, sizeof(format));
+            device.formats.push_back(format);
+        }
+        devices.push_back(std::move(device));
+    }
+    valid = valid && reader.done();
+
+    std::lock_guard<std::mutex> lock(this->mutex_);
+    // A corrupt file is rewritten by the next save
+    this->devices_ = valid ? std::move(devices) : std::vector<CachedDevice>();
+    this->dirty_   = !valid;
+    return valid ? 0 : -400;
+}
+
+int16_t CapabilityCache::save() {
+    std::vector<uint8_t> data(sizeof(CapabilityCacheHeader));
+    CapabilityCacheHeader header{};
+    {
+        std::lock_guard<std::mutex> lock(this->mutex_);
+        if (!this->dirty_) {
+            return 304;
+        }
+        for (const CachedDevice& device : this->devices_) {
+            writeString(data, device.identity.id);
+            writeString(data, device.identity.driver_version);
+            writeString(data, device.name);
+            const auto count = static_cast<uint32_t>(device.formats.size());
+            writeBytes(data, &count, sizeof(count));
+            writeBytes(data, device.formats.data(), count * sizeof(MediaFormat));
+        }
+        header.device_count = static_cast<uint32_t>(this->devices_.size());
+        this->dirty_        = false;
+    }
+    std::memcpy(header.magic, CAPABILITY_CACHE_MAGIC, sizeof(header.magic));
+    header.version  = CAPABILITY_CACHE_VERSION;
+    header.checksum = checksum(data.data() + sizeof(header), data.size() - sizeof(header));
+    std::memcpy(data.data(), &header, sizeof(header));
+
+    std::error_code error;
+    std::filesystem::create_directories(this->path_.parent_path(), error);
+    std::filesystem::path temporary = this->path_;
+    temporary += ".tmp";
+    {
+        std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+        file.write(reinterpret_cast<const char*>(data.data()),
+                   static_cast<std::streamsize>(data.size()));
+        if (!file) {
+            std::lock_guard<std::mutex> lock(this->mutex_);
+            this->dirty_ = true;
+            return -500;
+        }
+    }
+    std::filesystem::rename(temporary, this->path_, error);
+    if (error) {
+        std::filesystem::remove(temporary, error);
+        std::lock_guard<std::mutex> lock(this->mutex_);
+        this->dirty_ = true;
+        return -500;
+    }
+    return 0;
+}
+
+bool CapabilityCache::find(const DeviceIdentity& identity,
+                           CachedDevice&         device) const {
+    std::lock_guard<std::mutex> lock(this->mutex_);
+    for (const CachedDevice& entry : this->devices_) {
+        if (entry.identity == identity) {
+            device = entry;
+            return true;
+        }
+    }
+    return false;
+}
+
+void CapabilityCache::store(const CachedDevice& device) {
+    std::lock_guard<std::mutex> lock(this->mutex_);
+    // One entry per device, a driver update replaces the old one
+    for (CachedDevice& entry : this->devices_) {
+        if (entry.identity.id == device.identity.id) {
+            entry        = device;
+            this->dirty_ = true;
+            return;
+        }
+    }
+    this->devices_.push_back(device);
+    this->dirty_ = true;
+}
+
+std::size_t CapabilityCache::size() const {
+    std::lock_guard<std::mutex> lock(this->mutex_);
+    return this->devices_.size();
+}
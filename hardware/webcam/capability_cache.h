@@ -0,0 +1,116 @@
+#ifndef CAPABILITY_CACHE_H
+#define CAPABILITY_CACHE_H
+
+// On-disk layout of the capability cache.
+//
+//   [CapabilityCacheHeader]
+//   per device:
+//     [uint32 length][uint16 * length]   identity.id
+//     [uint32 length][uint16 * length]   identity.driver_version
+//     [uint32 length][uint16 * length]   name
+//     [uint32 count][MediaFormat * count]
+//
+// All fields are little-endian, strings are UTF-16 code units. `checksum` is
+// the FNV-1a hash of everything after the header; a file that does not match
+// it, or has another magic or version, is ignored and rewritten.
+
+#include "frame.h"
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <vector>
+
+constexpr char     CAPABILITY_CACHE_MAGIC[8] = {'W', 'C', 'C', 'A', 'P', 'S', 0, 0};
+constexpr uint32_t CAPABILITY_CACHE_VERSION  = 1;
+
+struct CapabilityCacheHeader {
+    char     magic[8];
+    uint32_t version;
+    uint32_t device_count;
+    uint64_t checksum;
+};
+
+static_assert(sizeof(CapabilityCacheHeader) == 24, "unexpected header padding");
+static_assert(sizeof(MediaFormat) == 20, "unexpected media format padding");
+
+/**
+ * @brief What a cache entry is valid for: the device interface path, which
+ * includes the USB vendor and product ids and the port, and the version of
+ * the driver bound to it.
+ */
+struct DeviceIdentity {
+    std::wstring id{};
+    std::wstring driver_version{};
+
+    bool operator==(const DeviceIdentity& other) const {
+        return this->id == other.id &&
+               this->driver_version == other.driver_version;
+    }
+};
+
+/**
+ * @brief Everything the capture source learns by probing a device.
+ */
+struct CachedDevice {
+    DeviceIdentity           identity{};
+    std::wstring             name{};
+    std::vector<MediaFormat> formats{};
+};
+
+/**
+ * @brief Media types of devices probed before, kept in a small file so the
+ * next start does not have to activate every camera to enumerate them.
+ *
+ * Entries are replaced when a device is probed again; devices that are
+ * unplugged keep their entries. All methods are thread safe.
+ */
+class CapabilityCache {
+  private:
+    std::filesystem::path     path_;
+    mutable std::mutex        mutex_{};
+    std::vector<CachedDevice> devices_{};
+    bool                      dirty_{false};
+
+  public:
+    explicit CapabilityCache(std::filesystem::path path);
+
+    /**
+     * @brief `imGUI_tests/capabilities.bin` in the user's local cache
+     * directory: `%LOCALAPPDATA%` on Windows, `$XDG_CACHE_HOME` or
+     * `~/.cache` elsewhere.
+     */
+    static std::filesystem::path defaultPath();
+
+    const std::filesystem::path& getPath() const { return this->path_; }
+
+    /**
+     * @brief Replace the entries with those of the file.
+     * @return 0 on success, 204 if there is no file, -400 if it is corrupt
+     * or of another version (the cache is then empty), -500 if it cannot be
+     * read.
+     */
+    int16_t load();
+
+    /**
+     * @brief Write the entries if they changed since `load` or `save`. The
+     * file is replaced atomically, through a temporary file.
+     * @return 0 on success, 304 if nothing changed, -500 on a write error.
+     */
+    int16_t save();
+
+    /**
+     * @brief Entry of the device with `identity`.
+     * @return false if there is none, e.g. for a new device or after a
+     * driver update.
+     */
+    bool find(const DeviceIdentity& identity, CachedDevice& device) const;
+
+    /**
+     * @brief Add or replace the entry of `device.identity`.
+     */
+    void store(const CachedDevice& device);
+
+    std::size_t size() const;
+};
+
+#endif // CAPABILITY_CACHE_H
@@ -0,0 +1,134 @@
+#include "capture_session.h"
+
+#include "frame_trace.h"
+
+namespace {
+
+// Blocks held outside the ring: the frame being read and a few consumers
+constexpr std::size_t POOL_EXTRA_BUFFERS = 4;
+
+void traceDequeue(const Frame& frame) {
+    if constexpr (FRAME_TRACE_ENABLED) {
+        if (isFrameTraceRecording()) {
+            recordTraceSpan(frame.trace_id, TraceStage::Queue, frame.arrival,
+                            hostTime100ns());
+        }
+    }
+}
+
+} // namespace
+
+CaptureSession::CaptureSession(std::shared_ptr<CaptureSource> source,
+                               const MediaFormat&             format,
+                               const CaptureOptions&          options)
+    : source_(std::move(source)),
+      ring_(options.ring_capacity, options.ring_policy) {
+    this->pool_blocks_ = this->ring_.capacity() + POOL_EXTRA_BUFFERS;
+    this->pool_        = FramePool::create(frameBufferSize(format),
+                                           this->pool_blocks_, this->pool_blocks_);
+}
+
+CaptureSession::~CaptureSession() { this->stop(); }
+
+void CaptureSession::start() {
+    if (this->running_.exchange(true)) {
+        return;
+    }
+    this->source_->setFramePool(this->pool_);
+    this->thread_ = std::thread(&CaptureSession::run, this);
+}
+
+void CaptureSession::stop() {
+    this->running_.store(false);
+    // Wakes a producer blocked on a full ring and any waiting consumer
+    this->ring_.close();
+    if (this->thread_.joinable()) {
+        this->thread_.join();
+        this->source_->setFramePool(nullptr);
+    }
+}
+
+void CaptureSession::setTap(FrameTap tap, std::size_t held) {
+    std::shared_ptr<const FrameTap> installed;
+    if (tap) {
+        installed = std::make_shared<const FrameTap>(std::move(tap));
+    } else {
+        held = 0;
+    }
+    this->pool_->setMaxFree(this->pool_blocks_ + held);
+    std::atomic_store(&this->tap_, std::move(installed));
+}
+
+void CaptureSession::setRegionOfInterest(RoiRef roi) {
+    std::atomic_store(&this->roi_, std::move(roi));
+}
+
+void CaptureSession::run() {
+    if constexpr (FRAME_TRACE_ENABLED) {
+        setTraceThreadName("capture");
+    }
+    Frame frame;
+    while (this->running_.load(std::memory_order_relaxed)) {
+        int16_t result = this->source_->readFrame(frame);
+        if (result == 0) {
+            frame.arrival = hostTime100ns();
+            frame.roi     = std::atomic_load(&this->roi_);
+            if constexpr (FRAME_TRACE_ENABLED) {
+                frame.trace_id = nextTraceId();
+                if (frame.capture != 0) {
+                    recordTraceSpan(frame.trace_id, TraceStage::Capture,
+                                    frame.capture, frame.arrival);
+                }
+            }
+            this->captured_.fetch_add(1, std::memory_order_relaxed);
+            if (auto tap = std::atomic_load(&this->tap_)) {
+                (*tap)(frame);
+            }
+            if (!this->ring_.push(std::move(frame))) {
+                break;
+            }
+            frame = Frame();
+        } else if (result == 204) {
+            this->empty_reads_.fetch_add(1, std::memory_order_relaxed);
+        } else if (result == -410) {
+            break;
+        } else {
+            this->errors_.fetch_add(1, std::memory_order_relaxed);
+            // Do not spin on a device that keeps failing
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+    }
+    // Lets consumers drain what is left and then see the end of the stream
+    this->ring_.close();
+}
+
+int16_t CaptureSession::tryGetLatest(Frame& frame) {
+    if (this->ring_.tryPopLatest(frame)) {
+        traceDequeue(frame);
+        return 0;
+    }
+    return this->ring_.isClosed() ? -410 : 204;
+}
+
+int16_t CaptureSession::waitNext(Frame&                    frame,
+                                 std::chrono::milliseconds timeout) {
+    if (this->ring_.waitPop(frame, timeout)) {
+        traceDequeue(frame);
+        return 0;
+    }
+    return this->ring_.isClosed() ? -410 : 204;
+}
+
+CaptureStats CaptureSession::getStats() const {
+    CaptureStats stats;
+    stats.captured    = this->captured_.load(std::memory_order_relaxed);
+    stats.dropped     = this->ring_.dropped();
+    stats.empty_reads = this->empty_reads_.load(std::memory_order_relaxed);
+    stats.errors      = this->errors_.load(std::memory_order_relaxed);
+    stats.queued      = this->ring_.size();
+    return stats;
+}
+
+FramePoolStats CaptureSession::getPoolStats() const {
+    return this->pool_->getStats();
+}
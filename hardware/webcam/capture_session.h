@@ -0,0 +1,114 @@
+#ifndef CAPTURE_SESSION_H
+#define CAPTURE_SESSION_H
+
+#include "capture_source.h"
+#include "frame_ring.h"
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <thread>
+
+/**
+ * @brief Ring settings for an active webcam.
+ */
+struct CaptureOptions {
+    std::size_t ring_capacity{4};
+    RingPolicy  ring_policy{RingPolicy::OverwriteOldest};
+};
+
+/**
+ * @brief Counters of one capture session.
+ */
+struct CaptureStats {
+    uint64_t captured{};    // Frames read from the source
+    uint64_t dropped{};     // Frames overwritten before anyone consumed them
+    uint64_t empty_reads{}; // Source calls that returned no sample
+    uint64_t errors{};      // Source calls that failed
+    uint64_t queued{};      // Frames waiting to be consumed, approximate
+};
+
+/**
+ * @brief Called on the capture thread with every frame before it is queued.
+ * Must not block.
+ */
+using FrameTap = std::function<void(const Frame&)>;
+
+/**
+ * @brief Capture thread feeding a `FrameRing` from an open source.
+ *
+ * The thread owns all `readFrame` calls on the source, so a slow device only
+ * ever blocks this thread. It stops on `stop`, at the end of the stream or
+ * when the ring is closed.
+ *
+ * Frames are read into buffers of a per-session `FramePool` with enough
+ * blocks for a full ring plus the frames consumers and the source hold, so
+ * the steady state does not allocate.
+ */
+class CaptureSession {
+  private:
+    std::shared_ptr<CaptureSource> source_;
+    FrameRing<Frame>               ring_;
+    std::shared_ptr<FramePool>     pool_;
+    std::thread                    thread_{};
+    std::shared_ptr<const FrameTap> tap_{}; // Accessed with std::atomic_*
+    RoiRef                          roi_{}; // Accessed with std::atomic_*
+
+    std::size_t           pool_blocks_{}; // Blocks kept without a tap
+
+    std::atomic<bool>     running_{false};
+    std::atomic<uint64_t> captured_{};
+    std::atomic<uint64_t> empty_reads_{};
+    std::atomic<uint64_t> errors_{};
+
+    void run();
+
+  public:
+    /**
+     * @param format Media type the source was opened with, sizes the pool.
+     */
+    CaptureSession(std::shared_ptr<CaptureSource> source,
+                   const MediaFormat& format, const CaptureOptions& options);
+    CaptureSession(const CaptureSession&) = delete;
+    ~CaptureSession();
+
+    CaptureSession& operator=(const CaptureSession&) = delete;
+
+    void start();
+    void stop();
+
+    /**
+     * @brief Install or, with an empty function, remove the frame tap. Safe
+     * while the session runs; the capture thread may still call the previous
+     * tap once after this returns.
+     * @param held Frames the tap may keep after it returns, e.g. the queue of
+     * a recorder. The pool keeps that many more blocks for reuse; they are
+     * allocated the first time the tap falls that far behind, so the pool
+     * misses while its backlog first grows and not afterwards.
+     */
+    void setTap(FrameTap tap, std::size_t held = 0);
+
+    /**
+     * @brief Region stamped on every frame read from now on, null for the
+     * whole frame. Safe while the session runs.
+     */
+    void setRegionOfInterest(RoiRef roi);
+
+    /**
+     * @brief Newest queued frame; older queued frames are discarded.
+     * @return 0 on success, 204 if nothing new arrived, -410 once the stream
+     * ended and the ring is drained.
+     */
+    int16_t tryGetLatest(Frame& frame);
+
+    /**
+     * @brief Oldest queued frame, waiting up to `timeout` for one.
+     * @return 0 on success, 204 on timeout, -410 once the stream ended and the
+     * ring is drained.
+     */
+    int16_t waitNext(Frame& frame, std::chrono::milliseconds timeout);
+
+    CaptureStats   getStats() const;
+    FramePoolStats getPoolStats() const;
+};
+
+#endif // CAPTURE_SESSION_H
@@ -0,0 +1,51 @@
+#include "capture_source.h"
+
+#include <thread>
+
+FrameBufferRef CaptureSource::acquireBuffer(std::size_t size) {
+    if (this->frame_pool_) {
+        return this->frame_pool_->acquire(size);
+    }
+    return FrameBufferRef::allocate(size);
+}
+
+void CaptureSource::setFramePool(std::shared_ptr<FramePool> pool) {
+    this->frame_pool_ = std::move(pool);
+}
+
+FramePacer::FramePacer(SourcePacing pacing, const MediaFormat& format)
+    : pacing_(pacing), next_deadline_(std::chrono::steady_clock::now()) {
+    uint32_t numerator   = format.fps_numerator ? format.fps_numerator : 30;
+    uint32_t denominator = format.fps_denominator ? format.fps_denominator : 1;
+
+    this->period_100ns_num_ = 10'000'000LL * denominator;
+    this->period_100ns_den_ = numerator;
+    this->period_ = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+        std::chrono::duration<double>(static_cast<double>(denominator) /
+                                      numerator));
+}
+
+void FramePacer::wait() {
+    if (this->pacing_ == SourcePacing::Unthrottled) {
+        return;
+    }
+    auto now = std::chrono::steady_clock::now();
+    if (this->next_deadline_ > now) {
+        std::this_thread::sleep_until(this->next_deadline_);
+    } else if (now - this->next_deadline_ > this->period_ * 4) {
+        // The consumer fell far behind, do not try to catch up with a burst
+        this->next_deadline_ = now;
+    }
+}
+
+uint64_t FramePacer::sequence() const { return this->sequence_; }
+
+int64_t FramePacer::timestamp() const {
+    return static_cast<int64_t>(this->sequence_) * this->period_100ns_num_ /
+           this->period_100ns_den_;
+}
+
+void FramePacer::advance() {
+    ++this->sequence_;
+    this->next_deadline_ += this->period_;
+}
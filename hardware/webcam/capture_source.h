@@ -0,0 +1,99 @@
+#ifndef CAPTURE_SOURCE_H
+#define CAPTURE_SOURCE_H
+
+#include "frame.h"
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * @brief How non-hardware sources deliver frames.
+ */
+enum class SourcePacing {
+    Native,     // Sleep so frames arrive at the media type's frame rate
+    Unthrottled // Return the next frame as soon as it is requested
+};
+
+/**
+ * @brief Backend a `Webcam` reads its frames from.
+ *
+ * The media types are enumerated once, when the source is constructed, and
+ * stay valid for its lifetime. `open` selects one of them by index.
+ */
+class CaptureSource {
+  private:
+    std::shared_ptr<FramePool> frame_pool_{};
+
+  protected:
+    /**
+     * @brief Buffer for the next frame, from the frame pool when one is set.
+     */
+    FrameBufferRef acquireBuffer(std::size_t size);
+
+  public:
+    virtual ~CaptureSource() = default;
+
+    /**
+     * @brief Pool `readFrame` takes its buffers from. Must not change while a
+     * frame is being read.
+     */
+    void setFramePool(std::shared_ptr<FramePool> pool);
+
+    virtual std::wstring                    getName() const         = 0;
+    virtual const std::vector<MediaFormat>& getMediaFormats() const = 0;
+    virtual bool                            isOpen() const          = 0;
+
+    /**
+     * @brief Start streaming the media type at `index`.
+     * @return 0 on success, 304 if already open, < 0 on error.
+     */
+    virtual int16_t open(std::size_t index) = 0;
+
+    /**
+     * @brief Stop streaming.
+     * @return 0 on success, 304 if not open.
+     */
+    virtual int16_t close() = 0;
+
+    /**
+     * @brief Read the next frame, blocking until the source produces one.
+     * @param frame Receives the frame in a buffer from `acquireBuffer`.
+     * @return 0 on success, 204 if the source delivered no sample this call,
+     * -410 at the end of the stream, < 0 on error.
+     */
+    virtual int16_t readFrame(Frame& frame) = 0;
+};
+
+/**
+ * @brief Timestamp and deadline bookkeeping shared by file and synthetic
+ * sources.
+ */
+class FramePacer {
+  private:
+    SourcePacing                          pacing_{SourcePacing::Native};
+    std::chrono::steady_clock::duration   period_{};
+    std::chrono::steady_clock::time_point next_deadline_{};
+    int64_t                               period_100ns_num_{};
+    int64_t                               period_100ns_den_{1};
+    uint64_t                              sequence_{};
+
+  public:
+    FramePacer() = default;
+    FramePacer(SourcePacing pacing, const MediaFormat& format);
+
+    /**
+     * @brief Wait until the next frame is due (no-op when unthrottled).
+     */
+    void wait();
+
+    /**
+     * @brief Index of the next frame and its presentation time in 100 ns.
+     */
+    uint64_t sequence() const;
+    int64_t  timestamp() const;
+
+    void advance();
+};
+
+#endif // CAPTURE_SOURCE_H
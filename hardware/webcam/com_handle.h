@@ -0,0 +1,81 @@
+#ifndef COM_HANDLE_H
+#define COM_HANDLE_H
+
+#include <utility>
+
+/**
+ * @brief Owning, move-only reference to a COM object.
+ *
+ * Holds one reference and releases it on destruction. Moving transfers the
+ * reference without touching the count; a second reference is only taken
+ * where it is asked for, with `share` or `copy`. Works with any type that
+ * has `AddRef` and `Release`.
+ */
+template <typename T> class ComHandle {
+  private:
+    T* object_{nullptr};
+
+  public:
+    ComHandle() = default;
+
+    /**
+     * @brief Take over a reference the caller owns, e.g. one returned
+     * through an out parameter.
+     */
+    explicit ComHandle(T* object) : object_(object) {}
+
+    /**
+     * @brief Take a new reference to an object the caller does not own.
+     */
+    static ComHandle share(T* object) {
+        if (object) {
+            object->AddRef();
+        }
+        return ComHandle(object);
+    }
+
+    ComHandle(ComHandle&& other) noexcept : object_(other.object_) {
+        other.object_ = nullptr;
+    }
+    ComHandle(const ComHandle&) = delete;
+    ~ComHandle() { this->reset(); }
+
+    ComHandle& operator=(ComHandle&& other) noexcept {
+        if (this != &other) {
+            this->reset();
+            this->object_ = std::exchange(other.object_, nullptr);
+        }
+        return *this;
+    }
+    ComHandle& operator=(const ComHandle&) = delete;
+
+    T*       get() const { return this->object_; }
+    T*       operator->() const { return this->object_; }
+    explicit operator bool() const { return this->object_ != nullptr; }
+
+    /**
+     * @brief A second handle to the same object, with its own reference.
+     */
+    ComHandle copy() const { return share(this->object_); }
+
+    /**
+     * @brief Release the object and return the slot for an out parameter.
+     */
+    T** put() {
+        this->reset();
+        return &this->object_;
+    }
+
+    /**
+     * @brief Give up ownership; the caller releases the returned reference.
+     */
+    T* detach() { return std::exchange(this->object_, nullptr); }
+
+    void reset() {
+        if (this->object_) {
+            std::exchange(this->object_, nullptr)->Release();
+        }
+    }
+};
+
+#endif // COM_HANDLE_H
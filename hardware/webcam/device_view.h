@@ -0,0 +1,76 @@
+#ifndef DEVICE_VIEW_H
+#define DEVICE_VIEW_H
+
+#include "webcam.h"
+#include <iterator>
+#include <mutex>
+#include <string_view>
+
+/**
+ * @brief The device list of a `WebcamManager`, locked while the view exists.
+ *
+ * Iterating it neither copies webcams nor allocates. Other `WebcamManager`
+ * calls from the same thread must wait until the view is gone, they would
+ * block on the lock.
+ */
+class DeviceView {
+  private:
+    using Devices = std::vector<std::shared_ptr<Webcam>>;
+
+    std::unique_lock<std::mutex> lock_;
+    const Devices*               devices_;
+
+  public:
+    class Iterator {
+      private:
+        Devices::const_iterator position_;
+
+      public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type        = Webcam;
+        using difference_type   = std::ptrdiff_t;
+        using pointer           = const Webcam*;
+        using reference         = const Webcam&;
+
+        explicit Iterator(Devices::const_iterator position)
+            : position_(position) {}
+
+        const Webcam& operator*() const { return **this->position_; }
+        const Webcam* operator->() const { return this->position_->get(); }
+        Iterator&     operator++() {
+            ++this->position_;
+            return *this;
+        }
+        bool operator==(const Iterator& other) const {
+            return this->position_ == other.position_;
+        }
+        bool operator!=(const Iterator& other) const { return !(*this == other); }
+    };
+
+    DeviceView(std::mutex& mutex, const Devices& devices)
+        : lock_(mutex), devices_(&devices) {}
+
+    Iterator      begin() const { return Iterator(this->devices_->begin()); }
+    Iterator      end() const { return Iterator(this->devices_->end()); }
+    std::size_t   size() const { return this->devices_->size(); }
+    bool          empty() const { return this->devices_->empty(); }
+    const Webcam& operator[](std::size_t index) const {
+        return *(*this->devices_)[index];
+    }
+
+    /**
+     * @brief Index of the first device named `name`, without allocating.
+     * @return 0 on success, -404 if there is none.
+     */
+    int16_t find(std::wstring_view name, std::size_t& index) const {
+        for (std::size_t i = 0; i < this->devices_->size(); ++i) {
+            if ((*this->devices_)[i]->getName() == name) {
+                index = i;
+                return 0;
+            }
+        }
+        return -404;
+    }
+};
+
+#endif // DEVICE_VIEW_H
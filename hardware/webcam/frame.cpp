@@ -0,0 +1,33 @@
+#include "frame.h"
+
+#include "pixel_format.h"
+#include <chrono>
+
+std::size_t rawFrameSize(const MediaFormat& format) {
+    const PixelFormatTraits* traits = findPixelFormat(format.subtype);
+    return traits ? pixelFrameSize(*traits, format.width, format.height) : 0;
+}
+
+std::size_t frameBufferSize(const MediaFormat& format) {
+    std::size_t size = rawFrameSize(format);
+    if (size == 0) {
+        size = static_cast<std::size_t>(format.width) * format.height * 2;
+    }
+    return size;
+}
+
+std::wstring fourccToString(uint32_t fourcc) {
+    std::wstring result;
+    for (int shift = 0; shift < 32; shift += 8) {
+        wchar_t c = static_cast<wchar_t>((fourcc >> shift) & 0xFF);
+        result.push_back(c >= 0x20 && c < 0x7F ? c : L'?');
+    }
+    return result;
+}
+
+int64_t hostTime100ns() {
+    using Ticks = std::chrono::duration<int64_t, std::ratio<1, 10000000>>;
+    return std::chrono::duration_cast<Ticks>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
@@ -0,0 +1,109 @@
+#ifndef FRAME_H
+#define FRAME_H
+
+#include "frame_pool.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+class RegionOfInterest;
+
+/**
+ * @brief Shared, immutable region of interest, see `region_of_interest.h`.
+ */
+using RoiRef = std::shared_ptr<const RegionOfInterest>;
+
+/**
+ * @brief Build a little-endian FourCC code, the same value Media Foundation
+ * stores in `Data1` of its `MFVideoFormat_*` subtype GUIDs.
+ */
+constexpr uint32_t makeFourCC(char a, char b, char c, char d) {
+    return static_cast<uint32_t>(static_cast<uint8_t>(a)) |
+           (static_cast<uint32_t>(static_cast<uint8_t>(b)) << 8) |
+           (static_cast<uint32_t>(static_cast<uint8_t>(c)) << 16) |
+           (static_cast<uint32_t>(static_cast<uint8_t>(d)) << 24);
+}
+
+constexpr uint32_t FOURCC_MJPG = makeFourCC('M', 'J', 'P', 'G');
+constexpr uint32_t FOURCC_YUY2 = makeFourCC('Y', 'U', 'Y', '2');
+constexpr uint32_t FOURCC_UYVY = makeFourCC('U', 'Y', 'V', 'Y');
+constexpr uint32_t FOURCC_NV12 = makeFourCC('N', 'V', '1', '2');
+constexpr uint32_t FOURCC_I420 = makeFourCC('I', '4', '2', '0');
+constexpr uint32_t FOURCC_IYUV = makeFourCC('I', 'Y', 'U', 'V');
+constexpr uint32_t FOURCC_YV12 = makeFourCC('Y', 'V', '1', '2');
+
+// Decoded and converted frames produced by the processing stages
+constexpr uint32_t FOURCC_RGBA = makeFourCC('R', 'G', 'B', 'A');
+constexpr uint32_t FOURCC_BGRA = makeFourCC('B', 'G', 'R', 'A');
+constexpr uint32_t FOURCC_Y800 = makeFourCC('Y', '8', '0', '0');
+
+/**
+ * @brief Backend independent description of one native media type.
+ */
+struct MediaFormat {
+    uint32_t subtype{};         // FourCC of the pixel format
+    uint32_t width{};           // Frame width in pixels
+    uint32_t height{};          // Frame height in pixels
+    uint32_t fps_numerator{};   // Frame rate numerator
+    uint32_t fps_denominator{}; // Frame rate denominator
+
+    bool operator==(const MediaFormat& other) const {
+        return this->subtype == other.subtype && this->width == other.width &&
+               this->height == other.height &&
+               this->fps_numerator == other.fps_numerator &&
+               this->fps_denominator == other.fps_denominator;
+    }
+    bool operator!=(const MediaFormat& other) const { return !(*this == other); }
+};
+
+/**
+ * @brief One captured frame.
+ *
+ * `timestamp` is the presentation time reported by the source in 100 ns
+ * units, the unit Media Foundation uses for sample times. Each source counts
+ * from its own origin; `arrival` is on the host's steady clock, also in
+ * 100 ns, and relates frames of different sources. `capture` is when the
+ * driver captured the frame on the same clock, if the source reports it.
+ * `roi` is the region of the camera's view the stages process, see
+ * `region_of_interest.h`; frames derived from this one keep it. Copying a
+ * frame shares its buffer.
+ */
+struct Frame {
+    FrameBufferRef buffer{};
+    MediaFormat    format{};
+    int64_t        timestamp{};
+    uint64_t       sequence{}; // Index of the frame since `open`
+    int64_t        arrival{};  // When the capture thread received the frame,
+                               // 0 for frames that did not come through one
+    int64_t        capture{};  // Driver capture time, 0 if unknown
+    uint64_t       trace_id{}; // Frame in `frame_trace.h` spans, 0 if untraced
+    RoiRef         roi{};      // Null for the whole frame
+};
+
+/**
+ * @brief Host steady clock in 100 ns units, the clock of `Frame::arrival`.
+ */
+int64_t hostTime100ns();
+
+/**
+ * @brief Size in bytes of one uncompressed frame.
+ *
+ * @return 0 for compressed or unknown subtypes.
+ */
+std::size_t rawFrameSize(const MediaFormat& format);
+
+/**
+ * @brief Pool block size for frames of `format`.
+ *
+ * The exact size for uncompressed subtypes. Compressed frames get the size of
+ * the equivalent YUY2 frame, which MJPEG frames from cameras stay below.
+ */
+std::size_t frameBufferSize(const MediaFormat& format);
+
+/**
+ * @brief Printable name of a FourCC subtype, e.g. `YUY2`.
+ */
+std::wstring fourccToString(uint32_t fourcc);
+
+#endif // FRAME_H
@@ -0,0 +1,252 @@
+#include "frame_pool.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <new>
+
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+namespace {
+
+std::size_t roundUp(std::size_t size) {
+    return (size + FRAME_BUFFER_ALIGNMENT - 1) & ~(FRAME_BUFFER_ALIGNMENT - 1);
+}
+
+uint8_t* alignedAlloc(std::size_t size) {
+#ifdef _WIN32
+    void* memory = _aligned_malloc(size, FRAME_BUFFER_ALIGNMENT);
+#else
+    void* memory = std::aligned_alloc(FRAME_BUFFER_ALIGNMENT, size);
+#endif
+    if (!memory) {
+        throw std::bad_alloc();
+    }
+    return static_cast<uint8_t*>(memory);
+}
+
+void alignedFree(uint8_t* memory) {
+#ifdef _WIN32
+    _aligned_free(memory);
+#else
+    std::free(memory);
+#endif
+}
+
+} // namespace
+
+FrameBuffer::FrameBuffer(std::size_t capacity)
+    : data_(alignedAlloc(roundUp(capacity ? capacity : 1))),
+      capacity_(roundUp(capacity ? capacity : 1)) {}
+
+FrameBuffer::FrameBuffer(uint8_t* data, std::size_t size,
+                         std::shared_ptr<const void> owner)
+    : data_(data), capacity_(size), size_(size), owner_(std::move(owner)),
+      owns_data_(false) {}
+
+FrameBuffer::~FrameBuffer() {
+    if (this->owns_data_) {
+        alignedFree(this->data_);
+    }
+}
+
+FrameBufferRef::FrameBufferRef(const FrameBufferRef& other)
+    : buffer_(other.buffer_) {
+    this->addRef();
+}
+
+FrameBufferRef::FrameBufferRef(FrameBufferRef&& other) noexcept
+    : buffer_(other.buffer_) {
+    other.buffer_ = nullptr;
+}
+
+FrameBufferRef::~FrameBufferRef() { this->release(); }
+
+FrameBufferRef& FrameBufferRef::operator=(const FrameBufferRef& other) {
+    if (this->buffer_ != other.buffer_) {
+        this->release();
+        this->buffer_ = other.buffer_;
+        this->addRef();
+    }
+    return *this;
+}
+
+FrameBufferRef& FrameBufferRef::operator=(FrameBufferRef&& other) noexcept {
+    if (this != &other) {
+        this->release();
+        this->buffer_ = other.buffer_;
+        other.buffer_ = nullptr;
+    }
+    return *this;
+}
+
+FrameBufferRef FrameBufferRef::allocate(std::size_t capacity) {
+    FrameBufferRef ref;
+    ref.buffer_ = new FrameBuffer(capacity);
+    ref.buffer_->refs_.store(1, std::memory_order_relaxed);
+    ref.buffer_->size_ = capacity;
+    return ref;
+}
+
+FrameBufferRef FrameBufferRef::wrap(uint8_t* data, std::size_t size,
+                                    std::shared_ptr<const void> owner) {
+    FrameBufferRef ref;
+    ref.buffer_ = new FrameBuffer(data, size, std::move(owner));
+    ref.buffer_->refs_.store(1, std::memory_order_relaxed);
+    return ref;
+}
+
+void FrameBufferRef::addRef() {
+    if (this->buffer_) {
+        this->buffer_->refs_.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void FrameBufferRef::release() {
+    FrameBuffer* buffer = this->buffer_;
+    this->buffer_       = nullptr;
+    if (!buffer ||
+        buffer->refs_.fetch_sub(1, std::memory_order_acq_rel) != 1) {
+        return;
+    }
+    // May release other blocks, so not while holding any lock
+    buffer->attachment_.reset();
+    if (buffer->pool_) {
+        // The block may hold the last reference to its pool
+        std::shared_ptr<FramePool> pool = std::move(buffer->pool_);
+        pool->recycle(buffer);
+    } else {
+        delete buffer;
+    }
+}
+
+void FrameBufferRef::setSize(std::size_t size) {
+    if (this->buffer_) {
+        this->buffer_->size_ =
+            size < this->buffer_->capacity_ ? size : this->buffer_->capacity_;
+    }
+}
+
+uint32_t FrameBufferRef::useCount() const {
+    return this->buffer_ ? this->buffer_->refs_.load(std::memory_order_relaxed)
+                         : 0;
+}
+
+std::shared_ptr<void> FrameBufferRef::attachment(
+    const std::function<std::shared_ptr<void>()>& make) const {
+    if (!this->buffer_) {
+        return nullptr;
+    }
+    std::lock_guard<std::mutex> lock(this->buffer_->attachment_mutex_);
+    if (!this->buffer_->attachment_) {
+        this->buffer_->attachment_ = make();
+    }
+    return this->buffer_->attachment_;
+}
+
+void FrameBufferRef::reset() { this->release(); }
+
+FramePool::FramePool(std::size_t buffer_size, std::size_t max_free)
+    : buffer_size_(buffer_size), max_free_(max_free) {
+    this->free_.reserve(max_free);
+}
+
+FramePool::~FramePool() {
+    for (auto buffer : this->free_) {
+        delete buffer;
+    }
+}
+
+std::shared_ptr<FramePool> FramePool::create(std::size_t buffer_size,
+                                             std::size_t preallocate,
+                                             std::size_t max_free) {
+    std::shared_ptr<FramePool> pool(
+        new FramePool(buffer_size, std::max(max_free, preallocate)));
+    for (std::size_t i = 0; i < preallocate; ++i) {
+        pool->free_.push_back(new FrameBuffer(buffer_size));
+    }
+    return pool;
+}
+
+FrameBufferRef FramePool::acquire(std::size_t size) {
+    FrameBuffer* buffer = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(this->mutex_);
+        while (!this->free_.empty() && !buffer) {
+            buffer = this->free_.back();
+            this->free_.pop_back();
+            if (buffer->capacity_ < size) {
+                delete buffer; // Left over from before the size grew
+                buffer = nullptr;
+            }
+        }
+        if (size > this->buffer_size_) {
+            this->buffer_size_ = size;
+        }
+        if (!buffer) {
+            buffer = new FrameBuffer(this->buffer_size_);
+            this->misses_.fetch_add(1, std::memory_order_relaxed);
+        } else {
+            this->hits_.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    std::size_t outstanding =
+        this->outstanding_.fetch_add(1, std::memory_order_relaxed) + 1;
+    std::size_t high_water = this->high_water_.load(std::memory_order_relaxed);
+    while (outstanding > high_water &&
+           !this->high_water_.compare_exchange_weak(
+               high_water, outstanding, std::memory_order_relaxed)) {
+    }
+
+    buffer->refs_.store(1, std::memory_order_relaxed);
+    buffer->size_ = size;
+    buffer->pool_ = this->shared_from_this();
+
+    FrameBufferRef ref;
+    ref.buffer_ = buffer;
+    return ref;
+}
+
+void FramePool::recycle(FrameBuffer* buffer) {
+    this->outstanding_.fetch_sub(1, std::memory_order_relaxed);
+    {
+        std::lock_guard<std::mutex> lock(this->mutex_);
+        if (this->free_.size() < this->max_free_ &&
+            buffer->capacity_ >= this->buffer_size_) {
+            this->free_.push_back(buffer);
+            return;
+        }
+    }
+    delete buffer;
+}
+
+void FramePool::setMaxFree(std::size_t max_free) {
+    std::vector<FrameBuffer*> extra;
+    {
+        std::lock_guard<std::mutex> lock(this->mutex_);
+        this->max_free_ = max_free;
+        while (this->free_.size() > max_free) {
+            extra.push_back(this->free_.back());
+            this->free_.pop_back();
+        }
+        this->free_.reserve(max_free);
+    }
+    for (auto buffer : extra) {
+        delete buffer;
+    }
+}
+
+FramePoolStats FramePool::getStats() const {
+    FramePoolStats stats;
+    stats.hits        = this->hits_.load(std::memory_order_relaxed);
+    stats.misses      = this->misses_.load(std::memory_order_relaxed);
+    stats.outstanding = this->outstanding_.load(std::memory_order_relaxed);
+    stats.high_water  = this->high_water_.load(std::memory_order_relaxed);
+    {
+        std::lock_guard<std::mutex> lock(this->mutex_);
+        stats.buffer_size = this->buffer_size_;
+    }
+    return stats;
+}
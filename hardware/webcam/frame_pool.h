@@ -0,0 +1,186 @@
+#ifndef FRAME_POOL_H
+#define FRAME_POOL_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+class FramePool;
+
+constexpr std::size_t FRAME_BUFFER_ALIGNMENT = 64;
+
+/**
+ * @brief Reference counted, 64-byte aligned block of frame memory.
+ *
+ * Blocks are only handled through `FrameBufferRef`. When the last reference
+ * goes away the block returns to the pool it came from, or is freed if it was
+ * allocated without one. Wrapped blocks point at memory owned by someone
+ * else and only release their `owner`. An attachment, if any, is destroyed
+ * at the same time.
+ */
+class FrameBuffer {
+  private:
+    uint8_t*                    data_{nullptr};
+    std::size_t                 capacity_{};
+    std::size_t                 size_{};
+    std::atomic<uint32_t>       refs_{0};
+    std::shared_ptr<FramePool>  pool_{};  // Set while the block is handed out
+    std::shared_ptr<const void> owner_{}; // Keeps wrapped memory alive
+    bool                        owns_data_{true};
+
+    std::mutex            attachment_mutex_{};
+    std::shared_ptr<void> attachment_{}; // Lives until the block is released
+
+    explicit FrameBuffer(std::size_t capacity);
+    FrameBuffer(uint8_t* data, std::size_t size,
+                std::shared_ptr<const void> owner);
+    ~FrameBuffer();
+
+    friend class FramePool;
+    friend class FrameBufferRef;
+
+  public:
+    FrameBuffer(const FrameBuffer&)            = delete;
+    FrameBuffer& operator=(const FrameBuffer&) = delete;
+};
+
+/**
+ * @brief Owning handle to a `FrameBuffer`, copies share the block.
+ */
+class FrameBufferRef {
+  private:
+    FrameBuffer* buffer_{nullptr};
+
+    void addRef();
+    void release();
+
+    friend class FramePool;
+
+  public:
+    FrameBufferRef() = default;
+    FrameBufferRef(const FrameBufferRef& other);
+    FrameBufferRef(FrameBufferRef&& other) noexcept;
+    ~FrameBufferRef();
+
+    FrameBufferRef& operator=(const FrameBufferRef& other);
+    FrameBufferRef& operator=(FrameBufferRef&& other) noexcept;
+
+    /**
+     * @brief Allocate a block that does not belong to any pool.
+     */
+    static FrameBufferRef allocate(std::size_t capacity);
+
+    /**
+     * @brief Wrap `size` bytes at `data` without copying them. `owner` is
+     * held until the last handle goes away and must keep `data` valid.
+     */
+    static FrameBufferRef wrap(uint8_t* data, std::size_t size,
+                               std::shared_ptr<const void> owner);
+
+    explicit operator bool() const { return this->buffer_ != nullptr; }
+
+    uint8_t*       data() { return this->buffer_ ? this->buffer_->data_ : nullptr; }
+    const uint8_t* data() const {
+        return this->buffer_ ? this->buffer_->data_ : nullptr;
+    }
+    std::size_t size() const { return this->buffer_ ? this->buffer_->size_ : 0; }
+    std::size_t capacity() const {
+        return this->buffer_ ? this->buffer_->capacity_ : 0;
+    }
+
+    /**
+     * @brief Set the number of valid bytes, at most `capacity()`.
+     */
+    void setSize(std::size_t size);
+
+    /**
+     * @brief Number of handles sharing the block.
+     */
+    uint32_t useCount() const;
+
+    /**
+     * @brief Object attached to the block, created by `make` on the first
+     * call; concurrent first calls create it once.
+     *
+     * The attachment is destroyed when the last handle goes away, before the
+     * block is recycled, so it must not hold a handle to the block itself.
+     * Null for an empty handle.
+     */
+    std::shared_ptr<void>
+    attachment(const std::function<std::shared_ptr<void>()>& make) const;
+
+    void reset();
+};
+
+/**
+ * @brief Pool statistics, all counters are cumulative except `outstanding`.
+ */
+struct FramePoolStats {
+    uint64_t    hits{};        // Acquires served from the free list
+    uint64_t    misses{};      // Acquires that had to allocate
+    std::size_t outstanding{}; // Blocks currently handed out
+    std::size_t high_water{};  // Largest `outstanding` seen
+    std::size_t buffer_size{}; // Capacity new blocks are allocated with
+};
+
+/**
+ * @brief Recycles frame buffers of one capture session.
+ *
+ * Created through `create` because handed out blocks keep the pool alive.
+ * After warm-up, when `outstanding` stays below the number of pooled blocks,
+ * `acquire` never allocates.
+ */
+class FramePool : public std::enable_shared_from_this<FramePool> {
+  private:
+    mutable std::mutex        mutex_{};
+    std::vector<FrameBuffer*> free_{};
+    std::size_t               buffer_size_{};
+    std::size_t               max_free_{};
+
+    std::atomic<uint64_t>    hits_{};
+    std::atomic<uint64_t>    misses_{};
+    std::atomic<std::size_t> outstanding_{};
+    std::atomic<std::size_t> high_water_{};
+
+    FramePool(std::size_t buffer_size, std::size_t max_free);
+
+    void recycle(FrameBuffer* buffer);
+
+    friend class FrameBufferRef;
+
+  public:
+    ~FramePool();
+
+    FramePool(const FramePool&)            = delete;
+    FramePool& operator=(const FramePool&) = delete;
+
+    /**
+     * @param buffer_size Capacity of every block.
+     * @param preallocate Blocks allocated up front.
+     * @param max_free Blocks kept for reuse, extra ones are freed on release.
+     */
+    static std::shared_ptr<FramePool> create(std::size_t buffer_size,
+                                             std::size_t preallocate,
+                                             std::size_t max_free);
+
+    /**
+     * @brief Hand out a block able to hold `size` bytes, with `size()` set to
+     * `size`.
+     */
+    FrameBufferRef acquire(std::size_t size);
+
+    /**
+     * @brief Change how many released blocks are kept for reuse. Blocks are
+     * not allocated up front, a larger limit takes effect as consumers hold
+     * more of them; a smaller one frees the extra free blocks now.
+     */
+    void setMaxFree(std::size_t max_free);
+
+    FramePoolStats getStats() const;
+};
+
+#endif // FRAME_POOL_H
@@ -0,0 +1,257 @@
+#ifndef FRAME_RING_H
+#define FRAME_RING_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+/**
+ * @brief What `FrameRing::push` does when the ring is full.
+ */
+enum class RingPolicy {
+    OverwriteOldest, // Drop the oldest queued frame, never block the producer
+    Block            // Wait until the consumer frees a slot
+};
+
+/**
+ * @brief Bounded single-producer/single-consumer ring.
+ *
+ * Slots carry a sequence number (Vyukov's bounded queue) so the producer can
+ * also pop the oldest element when it overwrites, without locking against the
+ * consumer. The fast paths are lock-free; the mutex and condition variables
+ * are only touched when a side actually has to sleep.
+ */
+template <typename T> class FrameRing {
+  private:
+    struct Slot {
+        std::atomic<std::size_t> sequence{};
+        T                        value{};
+    };
+
+    // Keep producer and consumer indices on separate cache lines
+    struct alignas(64) Index {
+        std::atomic<std::size_t> value{};
+    };
+
+    std::unique_ptr<Slot[]> slots_;
+    std::size_t             mask_;
+    RingPolicy              policy_;
+
+    Index head_{}; // Next slot to pop, advanced by CAS
+    Index tail_{}; // Next slot to push, producer only
+
+    std::atomic<uint32_t>   waiting_consumers_{};
+    std::atomic<uint32_t>   waiting_producers_{};
+    std::atomic<bool>       closed_{false};
+    std::atomic<uint64_t>   dropped_{};
+    std::mutex              wait_mutex_{};
+    std::condition_variable not_empty_{};
+    std::condition_variable not_full_{};
+
+    bool tryPushSlot(T& value) {
+        std::size_t pos  = this->tail_.value.load(std::memory_order_relaxed);
+        Slot&       slot = this->slots_[pos & this->mask_];
+        std::size_t seq  = slot.sequence.load(std::memory_order_acquire);
+        if (seq != pos) {
+            return false; // Still holds an element or is being read
+        }
+        slot.value = std::move(value);
+        slot.sequence.store(pos + 1, std::memory_order_release);
+        this->tail_.value.store(pos + 1, std::memory_order_relaxed);
+        return true;
+    }
+
+    template <typename Clock, typename Duration>
+    bool waitFor(std::condition_variable&                  condition,
+                 std::atomic<uint32_t>&                    waiting,
+                 const std::chrono::time_point<Clock, Duration>& deadline,
+                 bool want_data) {
+        waiting.fetch_add(1, std::memory_order_seq_cst);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        std::unique_lock<std::mutex> lock(this->wait_mutex_);
+        bool ready = condition.wait_until(lock, deadline, [&] {
+            return this->closed_.load(std::memory_order_acquire) ||
+                   (want_data ? !this->empty() : !this->full());
+        });
+        waiting.fetch_sub(1, std::memory_order_relaxed);
+        return ready;
+    }
+
+    void wake(std::condition_variable& condition,
+              std::atomic<uint32_t>&   waiting) {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (waiting.load(std::memory_order_relaxed)) {
+            // Taking the lock orders us after a waiter's predicate check
+            { std::lock_guard<std::mutex> lock(this->wait_mutex_); }
+            condition.notify_all();
+        }
+    }
+
+  public:
+    /**
+     * @param capacity Rounded up to a power of two, at least 2.
+     */
+    explicit FrameRing(std::size_t capacity = 4,
+                       RingPolicy  policy   = RingPolicy::OverwriteOldest)
+        : policy_(policy) {
+        std::size_t size = 2;
+        while (size < capacity) {
+            size <<= 1;
+        }
+        this->slots_.reset(new Slot[size]);
+        this->mask_ = size - 1;
+        for (std::size_t i = 0; i < size; ++i) {
+            this->slots_[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    FrameRing(const FrameRing&)            = delete;
+    FrameRing& operator=(const FrameRing&) = delete;
+
+    std::size_t capacity() const { return this->mask_ + 1; }
+    RingPolicy  policy() const { return this->policy_; }
+
+    /**
+     * @brief Frames discarded by `OverwriteOldest` since construction.
+     */
+    uint64_t dropped() const {
+        return this->dropped_.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Elements queued, approximate while either side is running.
+     */
+    std::size_t size() const {
+        std::size_t head = this->head_.value.load(std::memory_order_acquire);
+        std::size_t tail = this->tail_.value.load(std::memory_order_acquire);
+        return tail > head ? std::min(tail - head, this->capacity()) : 0;
+    }
+
+    bool empty() const {
+        std::size_t pos = this->head_.value.load(std::memory_order_acquire);
+        return this->slots_[pos & this->mask_].sequence.load(
+                   std::memory_order_acquire) != pos + 1;
+    }
+
+    bool full() const {
+        std::size_t pos = this->tail_.value.load(std::memory_order_relaxed);
+        return this->slots_[pos & this->mask_].sequence.load(
+                   std::memory_order_acquire) != pos;
+    }
+
+    /**
+     * @brief Pop the oldest element without blocking.
+     */
+    bool tryPop(T& out) {
+        std::size_t pos = this->head_.value.load(std::memory_order_relaxed);
+        while (true) {
+            Slot&          slot = this->slots_[pos & this->mask_];
+            std::size_t    seq  = slot.sequence.load(std::memory_order_acquire);
+            std::ptrdiff_t diff = static_cast<std::ptrdiff_t>(seq - (pos + 1));
+            if (diff == 0) {
+                if (this->head_.value.compare_exchange_weak(
+                        pos, pos + 1, std::memory_order_relaxed)) {
+                    out = std::move(slot.value);
+                    slot.sequence.store(pos + this->mask_ + 1,
+                                        std::memory_order_release);
+                    if (this->policy_ == RingPolicy::Block) {
+                        this->wake(this->not_full_, this->waiting_producers_);
+                    }
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = this->head_.value.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    /**
+     * @brief Pop everything queued and keep only the newest element.
+     * @return false if the ring was empty.
+     */
+    bool tryPopLatest(T& out) {
+        if (!this->tryPop(out)) {
+            return false;
+        }
+        while (this->tryPop(out)) {
+        }
+        return true;
+    }
+
+    /**
+     * @brief Pop the oldest element, sleeping up to `timeout` for one.
+     * @return false on timeout or if the ring was closed and drained.
+     */
+    template <typename Rep, typename Period>
+    bool waitPop(T& out, const std::chrono::duration<Rep, Period>& timeout) {
+        if (this->tryPop(out)) {
+            return true;
+        }
+        auto deadline = std::chrono::steady_clock::now() + timeout;
+        while (!this->closed_.load(std::memory_order_acquire)) {
+            if (!this->waitFor(this->not_empty_, this->waiting_consumers_,
+                               deadline, true)) {
+                break;
+            }
+            if (this->tryPop(out)) {
+                return true;
+            }
+        }
+        return this->tryPop(out);
+    }
+
+    /**
+     * @brief Push an element, applying the ring's full policy.
+     * @return false if the ring was closed before the element was queued.
+     */
+    bool push(T value) {
+        while (!this->closed_.load(std::memory_order_acquire)) {
+            if (this->tryPushSlot(value)) {
+                this->wake(this->not_empty_, this->waiting_consumers_);
+                return true;
+            }
+
+            if (this->policy_ == RingPolicy::OverwriteOldest) {
+                T oldest;
+                if (this->tryPop(oldest)) {
+                    this->dropped_.fetch_add(1, std::memory_order_relaxed);
+                } else {
+                    // The consumer holds the oldest slot for a moment
+                    std::this_thread::yield();
+                }
+                continue;
+            }
+
+            this->waitFor(this->not_full_, this->waiting_producers_,
+                          std::chrono::steady_clock::now() +
+                              std::chrono::milliseconds(100),
+                          false);
+        }
+        return false;
+    }
+
+    /**
+     * @brief Wake every waiter and refuse further pushes. Queued elements can
+     * still be popped.
+     */
+    void close() {
+        this->closed_.store(true, std::memory_order_release);
+        std::lock_guard<std::mutex> lock(this->wait_mutex_);
+        this->not_empty_.notify_all();
+        this->not_full_.notify_all();
+    }
+
+    bool isClosed() const {
+        return this->closed_.load(std::memory_order_acquire);
+    }
+};
+
+#endif // FRAME_RING_H
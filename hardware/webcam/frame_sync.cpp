@@ -0,0 +1,292 @@
+#include "frame_sync.h"
+
+#include <algorithm>
+#include <limits>
+
+namespace {
+
+constexpr std::size_t NONE = std::numeric_limits<std::size_t>::max();
+
+// How long to sleep on one camera while no camera has a frame
+constexpr std::chrono::milliseconds POLL_INTERVAL(1);
+
+std::chrono::steady_clock::duration fromHostTime(int64_t value) {
+    return std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+        std::chrono::duration<int64_t, std::ratio<1, 10000000>>(value));
+}
+
+} // namespace
+
+SyncGroup::SyncGroup(std::vector<std::shared_ptr<Webcam>> cameras,
+                     const SyncOptions&                   options)
+    : options_(options) {
+    this->options_.offset_window = std::max<std::size_t>(1, options.offset_window);
+    this->options_.max_pending   = std::max<std::size_t>(1, options.max_pending);
+    this->members_.reserve(cameras.size());
+    for (auto& camera : cameras) {
+        this->members_.push_back(Member{std::move(camera)});
+    }
+    this->stats_.members.resize(this->members_.size());
+    this->offset_sums_.resize(this->members_.size());
+    this->chosen_.resize(this->members_.size());
+}
+
+int64_t SyncGroup::aligned(const Member& member, const Frame& frame) const {
+    return frame.timestamp + member.offset;
+}
+
+void SyncGroup::drop(std::size_t index) {
+    Member& member = this->members_[index];
+    member.last    = std::move(member.pending.front());
+    member.pending.pop_front();
+    std::lock_guard<std::mutex> lock(this->stats_mutex_);
+    ++this->stats_.members[index].dropped;
+}
+
+void SyncGroup::receive(std::size_t index, Frame&& frame) {
+    Member& member = this->members_[index];
+
+    // Transport delays only ever add to the difference, so its minimum is
+    // the offset plus the camera's smallest latency
+    const int64_t difference = frame.arrival - frame.timestamp;
+    if (member.window_count == 0 || difference < member.window_min) {
+        member.window_min = difference;
+    }
+    member.offset = member.has_previous
+                        ? std::min(member.previous_min, member.window_min)
+                        : member.window_min;
+    if (++member.window_count == this->options_.offset_window) {
+        member.previous_min = member.window_min;
+        member.has_previous = true;
+        member.window_count = 0;
+    }
+
+    if (member.pending.size() == this->options_.max_pending) {
+        this->drop(index);
+    }
+    member.pending.push_back(std::move(frame));
+
+    std::lock_guard<std::mutex> lock(this->stats_mutex_);
+    SyncMemberStats& stats = this->stats_.members[index];
+    ++stats.received;
+    stats.clock_offset = member.offset;
+}
+
+int16_t SyncGroup::pull(std::size_t index, std::chrono::milliseconds timeout) {
+    Member& member = this->members_[index];
+    if (member.ended) {
+        return -410;
+    }
+    Frame   frame;
+    int16_t result = member.camera->waitNext(frame, timeout);
+    if (result == 0) {
+        this->receive(index, std::move(frame));
+    } else if (result < 0) {
+        // Deactivated or at the end of its stream, nothing more will come
+        member.ended = true;
+    }
+    return result;
+}
+
+int16_t SyncGroup::match(Frameset& set, std::size_t& waiting_for,
+                         std::chrono::steady_clock::time_point& until) {
+    const int64_t tolerance = this->options_.tolerance;
+    const auto    now       = std::chrono::steady_clock::now();
+
+    // Dropping the frames too old for a set can leave a camera whose oldest
+    // frame is beyond the others' tolerance, the set then moves to that frame
+    int64_t target = std::numeric_limits<int64_t>::min();
+    for (bool moved = true; moved;) {
+        moved = false;
+        for (const Member& member : this->members_) {
+            if (!member.pending.empty() &&
+                this->aligned(member, member.pending.front()) > target) {
+                target = this->aligned(member, member.pending.front());
+                moved  = true;
+            }
+        }
+        for (std::size_t i = 0; moved && i < this->members_.size(); ++i) {
+            const Member& member = this->members_[i];
+            // Too old for this set, and later sets are newer still
+            while (!member.pending.empty() &&
+                   this->aligned(member, member.pending.front()) < target - tolerance) {
+                this->drop(i);
+            }
+        }
+    }
+
+    std::size_t missing = 0;
+    for (std::size_t i = 0; i < this->members_.size(); ++i) {
+        Member& member = this->members_[i];
+        if (member.pending.empty()) {
+            if (member.ended) {
+                return -410;
+            }
+            this->chosen_[i] = NONE;
+            if (missing++ == 0) {
+                waiting_for = i;
+            }
+            continue;
+        }
+        // The front is within tolerance, a later frame may be closer
+        std::size_t best = 0;
+        for (std::size_t k = 1; k < member.pending.size(); ++k) {
+            const int64_t time = this->aligned(member, member.pending[k]);
+            if (time > target + tolerance) {
+                break;
+            }
+            if (std::abs(time - target) <
+                std::abs(this->aligned(member, member.pending[best]) - target)) {
+                best = k;
+            }
+        }
+        this->chosen_[i] = best;
+    }
+
+    if (missing == 0) {
+        this->waiting_ = false;
+        this->deliver(set, target);
+        return 0;
+    }
+    if (missing == this->members_.size()) {
+        this->waiting_ = false;
+        until          = std::min(until, now + POLL_INTERVAL);
+        return 204;
+    }
+
+    // Give the missing cameras `tolerance` to deliver, counted from when this
+    // set could first have been delivered without them
+    if (!this->waiting_ || this->wait_target_ != target) {
+        this->waiting_     = true;
+        this->wait_target_ = target;
+        this->ready_since_ = now;
+    }
+    const auto deadline = this->ready_since_ + fromHostTime(tolerance);
+    if (now < deadline) {
+        until = std::min(until, deadline);
+        return 204;
+    }
+    this->waiting_ = false;
+
+    bool repeatable = this->options_.policy == SyncPolicy::Duplicate;
+    for (std::size_t i = 0; i < this->members_.size(); ++i) {
+        if (this->chosen_[i] == NONE && !this->members_[i].last.buffer) {
+            repeatable = false; // Nothing delivered yet that could be repeated
+        }
+    }
+    if (repeatable) {
+        this->deliver(set, target);
+        return 0;
+    }
+
+    for (std::size_t i = 0; i < this->members_.size(); ++i) {
+        for (std::size_t k = 0; this->chosen_[i] != NONE && k <= this->chosen_[i]; ++k) {
+            this->drop(i);
+        }
+    }
+    {
+        std::lock_guard<std::mutex> lock(this->stats_mutex_);
+        ++this->stats_.discarded;
+    }
+    waiting_for = NONE; // Try the next set right away
+    return 204;
+}
+
+void SyncGroup::deliver(Frameset& set, int64_t timestamp) {
+    set.frames.resize(this->members_.size());
+    set.timestamp = timestamp;
+    set.sequence  = this->sequence_++;
+
+    int64_t earliest = std::numeric_limits<int64_t>::max();
+    int64_t latest   = std::numeric_limits<int64_t>::min();
+    std::lock_guard<std::mutex> lock(this->stats_mutex_);
+    for (std::size_t i = 0; i < this->members_.size(); ++i) {
+        Member&          member = this->members_[i];
+        SyncedFrame&     out    = set.frames[i];
+        SyncMemberStats& stats  = this->stats_.members[i];
+        if (this->chosen_[i] == NONE) {
+            out.frame    = member.last;
+            out.aligned  = this->aligned(member, member.last);
+            out.repeated = true;
+            ++stats.repeated;
+            continue;
+        }
+        stats.dropped += this->chosen_[i];
+        member.pending.erase(member.pending.begin(),
+                             member.pending.begin() +
+                                 static_cast<std::ptrdiff_t>(this->chosen_[i]));
+        member.last = std::move(member.pending.front());
+        member.pending.pop_front();
+
+        out.frame    = member.last;
+        out.aligned  = this->aligned(member, member.last);
+        out.repeated = false;
+        earliest     = std::min(earliest, out.aligned);
+        latest       = std::max(latest, out.aligned);
+        ++stats.used;
+        this->offset_sums_[i] += out.aligned - timestamp;
+    }
+
+    set.skew = latest - earliest;
+    ++this->stats_.framesets;
+    this->skew_sum_       += set.skew;
+    this->stats_.max_skew  = std::max(this->stats_.max_skew, set.skew);
+}
+
+int16_t SyncGroup::waitFrameset(Frameset& set, std::chrono::milliseconds timeout) {
+    if (this->members_.empty()) {
+        return -409;
+    }
+    const auto deadline = std::chrono::steady_clock::now() + timeout;
+    for (;;) {
+        // Bounded, a camera delivering faster than this loop cannot keep it
+        for (std::size_t i = 0; i < this->members_.size(); ++i) {
+            for (std::size_t k = 0; k < this->options_.max_pending &&
+                                    this->pull(i, std::chrono::milliseconds(0)) == 0;
+                 ++k) {
+            }
+        }
+
+        std::size_t waiting_for = NONE;
+        auto        until       = deadline;
+        int16_t     result      = this->match(set, waiting_for, until);
+        if (result != 204) {
+            return result;
+        }
+        const auto now = std::chrono::steady_clock::now();
+        if (now >= deadline) {
+            return 204;
+        }
+        if (waiting_for != NONE && now < until) {
+            this->pull(waiting_for,
+                       std::chrono::ceil<std::chrono::milliseconds>(until - now));
+        }
+    }
+}
+
+void SyncGroup::reset() {
+    for (Member& member : this->members_) {
+        member.pending.clear();
+        member.last         = Frame();
+        member.window_count = 0;
+        member.has_previous = false;
+        member.offset       = 0;
+    }
+    this->waiting_ = false;
+}
+
+SyncStats SyncGroup::getStats() const {
+    std::lock_guard<std::mutex> lock(this->stats_mutex_);
+    SyncStats stats = this->stats_;
+    if (stats.framesets > 0) {
+        stats.mean_skew = this->skew_sum_ / static_cast<int64_t>(stats.framesets);
+    }
+    for (std::size_t i = 0; i < stats.members.size(); ++i) {
+        SyncMemberStats& member = stats.members[i];
+        if (member.used > 0) {
+            member.mean_offset =
+                this->offset_sums_[i] / static_cast<int64_t>(member.used);
+        }
+    }
+    return stats;
+}
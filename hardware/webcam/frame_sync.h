@@ -0,0 +1,157 @@
+#ifndef FRAME_SYNC_H
+#define FRAME_SYNC_H
+
+#include "webcam.h"
+#include <chrono>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+/**
+ * @brief What a `SyncGroup` does when a camera has no frame for a frameset,
+ * typically because it runs at a lower rate than the others.
+ */
+enum class SyncPolicy {
+    Drop,     // Discard the frameset; sets come at the slowest camera's rate
+    Duplicate // Repeat that camera's previous frame; sets come at the fastest
+              // camera's rate
+};
+
+struct SyncOptions {
+    int64_t     tolerance{100000};  // Largest distance of a frame from its
+                                    // frameset's time, 100 ns
+    SyncPolicy  policy{SyncPolicy::Drop};
+    std::size_t offset_window{120}; // Frames per clock offset window
+    std::size_t max_pending{8};     // Frames buffered per camera
+};
+
+/**
+ * @brief One camera's frame in a frameset.
+ */
+struct SyncedFrame {
+    Frame   frame{};
+    int64_t aligned{};  // `frame.timestamp` on the host clock, 100 ns
+    bool    repeated{}; // Reused from an earlier frameset
+};
+
+/**
+ * @brief Frames of all cameras of a group taken at about the same time, in
+ * the order the cameras were given to the group.
+ */
+struct Frameset {
+    std::vector<SyncedFrame> frames{};
+    int64_t                  timestamp{}; // Host clock, 100 ns
+    int64_t                  skew{};      // Spread of the frames that are not
+                                          // repeated, 100 ns
+    uint64_t                 sequence{};  // Index of the set since creation
+};
+
+/**
+ * @brief Counters of one camera of a group.
+ */
+struct SyncMemberStats {
+    uint64_t received{};     // Frames taken from the camera
+    uint64_t used{};         // Frames delivered in a frameset
+    uint64_t dropped{};      // Frames that matched no frameset
+    uint64_t repeated{};     // Framesets that repeated an earlier frame
+    int64_t  clock_offset{}; // Host time minus camera time, 100 ns
+    int64_t  mean_offset{};  // Mean aligned time minus frameset time, 100 ns
+};
+
+/**
+ * @brief Counters of a group, cumulative.
+ */
+struct SyncStats {
+    uint64_t                     framesets{}; // Delivered
+    uint64_t                     discarded{}; // Incomplete sets dropped
+    int64_t                      mean_skew{}; // 100 ns
+    int64_t                      max_skew{};  // 100 ns
+    std::vector<SyncMemberStats> members{};
+};
+
+/**
+ * @brief Matches the frames of several active webcams into framesets.
+ *
+ * Camera timestamps are mapped onto the host clock with a per-camera offset,
+ * the smallest difference between arrival and presentation time over the
+ * last one or two `offset_window`s, so transport jitter does not move it and
+ * clock drift is followed. Different cameras differ by their smallest
+ * latency, which the offset cannot see.
+ *
+ * A frameset's time is the newest of the oldest buffered frames of the
+ * cameras. Every camera contributes its buffered frame closest to it within
+ * `tolerance`; older frames can no longer match and are dropped. When only
+ * some cameras have a frame, the group waits for the others at most
+ * `tolerance` of wall time before it applies the policy, so a slow or
+ * stalled camera does not hold back the rest.
+ *
+ * The group shares the webcams with their owner, e.g. `WebcamManager`; a
+ * camera deactivated there ends the group's stream. One thread calls
+ * `waitFrameset`; `getStats` may be called from any thread.
+ */
+class SyncGroup {
+  private:
+    struct Member {
+        std::shared_ptr<Webcam> camera;
+        std::deque<Frame>       pending{};
+        Frame                   last{}; // Newest frame delivered or dropped
+        bool                    ended{false};
+
+        int64_t     window_min{}; // Smallest arrival - timestamp this window
+        int64_t     previous_min{};
+        std::size_t window_count{};
+        bool        has_previous{false};
+        int64_t     offset{};
+    };
+
+    SyncOptions                           options_;
+    std::vector<Member>                   members_{};
+    std::vector<std::size_t>              chosen_{}; // Pending frame per camera
+    std::chrono::steady_clock::time_point ready_since_{};
+    int64_t                               wait_target_{};
+    bool                                  waiting_{false};
+    uint64_t                              sequence_{};
+
+    mutable std::mutex   stats_mutex_{};
+    SyncStats            stats_{};
+    int64_t              skew_sum_{};
+    std::vector<int64_t> offset_sums_{}; // Of `mean_offset`
+
+    int64_t aligned(const Member& member, const Frame& frame) const;
+    void    drop(std::size_t index);
+    void    receive(std::size_t index, Frame&& frame);
+    int16_t pull(std::size_t index, std::chrono::milliseconds timeout);
+    int16_t match(Frameset& set, std::size_t& waiting_for,
+                  std::chrono::steady_clock::time_point& until);
+    void    deliver(Frameset& set, int64_t timestamp);
+
+  public:
+    /**
+     * @param cameras Active webcams, at least one.
+     */
+    SyncGroup(std::vector<std::shared_ptr<Webcam>> cameras,
+              const SyncOptions&                   options = {});
+
+    SyncGroup(const SyncGroup&)            = delete;
+    SyncGroup& operator=(const SyncGroup&) = delete;
+
+    /**
+     * @brief Next frameset, waiting up to `timeout` for one.
+     * @return 0 on success, 204 on timeout, -410 once a camera's stream ended
+     * or it was deactivated and its buffered frames are used up, -409 for a
+     * group without cameras.
+     */
+    int16_t waitFrameset(Frameset& set, std::chrono::milliseconds timeout);
+
+    /**
+     * @brief Forget buffered frames, repeated frames and clock offsets.
+     * Statistics are kept.
+     */
+    void reset();
+
+    std::size_t        size() const { return this->members_.size(); }
+    const SyncOptions& getOptions() const { return this->options_; }
+    SyncStats          getStats() const;
+};
+
+#endif // FRAME_SYNC_H
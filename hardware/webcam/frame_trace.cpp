@@ -0,0 +1,157 @@
+#include "frame_trace.h"
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+
+namespace {
+
+// Spans a thread can hold between two collections. At 4 cameras, 60 fps and
+// a dozen spans per frame that is several seconds.
+constexpr std::size_t TRACE_BUFFER_EVENTS = 8192;
+
+/**
+ * @brief Single producer, single consumer ring of one thread's spans.
+ */
+struct TraceBuffer {
+    std::vector<TraceEvent> events{std::vector<TraceEvent>(TRACE_BUFFER_EVENTS)};
+    std::atomic<uint64_t>   head{};  // Written by the owning thread
+    std::atomic<uint64_t>   tail{};  // Written by the collector
+    std::atomic<uint64_t>   dropped{};
+    std::atomic<bool>       retired{false};
+    uint32_t                index{};
+};
+
+struct TraceRegistry {
+    std::mutex                                mutex{};
+    std::vector<std::shared_ptr<TraceBuffer>> buffers{};
+    std::vector<TraceThread>                  threads{};
+};
+
+TraceRegistry& registry() {
+    static TraceRegistry instance;
+    return instance;
+}
+
+std::atomic<bool>     recording{false};
+std::atomic<uint64_t> last_trace_id{0};
+
+/**
+ * @brief The calling thread's buffer, registered on first use and retired
+ * when the thread exits; the collector drops it once drained.
+ */
+struct ThreadSlot {
+    std::shared_ptr<TraceBuffer> buffer{};
+
+    ~ThreadSlot() {
+        if (this->buffer) {
+            this->buffer->retired.store(true, std::memory_order_release);
+        }
+    }
+};
+
+thread_local ThreadSlot thread_slot;
+
+TraceBuffer& threadBuffer() {
+    if (!thread_slot.buffer) {
+        auto           buffer = std::make_shared<TraceBuffer>();
+        TraceRegistry& shared = registry();
+        std::lock_guard<std::mutex> lock(shared.mutex);
+        buffer->index = static_cast<uint32_t>(shared.threads.size());
+        shared.threads.push_back(
+            {buffer->index, "thread " + std::to_string(buffer->index), 0});
+        shared.buffers.push_back(buffer);
+        thread_slot.buffer = std::move(buffer);
+    }
+    return *thread_slot.buffer;
+}
+
+} // namespace
+
+const char* traceStageName(TraceStage stage) {
+    switch (stage) {
+    case TraceStage::Capture:
+        return "Capture";
+    case TraceStage::Queue:
+        return "Queue";
+    case TraceStage::Decode:
+        return "Decode";
+    case TraceStage::Convert:
+        return "Convert";
+    case TraceStage::Process:
+        return "Process";
+    default:
+        return "Present";
+    }
+}
+
+const char* traceEventName(const TraceEvent& event) {
+    return event.label ? event.label : traceStageName(event.stage);
+}
+
+void startFrameTrace() { recording.store(true, std::memory_order_relaxed); }
+
+void stopFrameTrace() { recording.store(false, std::memory_order_relaxed); }
+
+bool isFrameTraceRecording() {
+    return recording.load(std::memory_order_relaxed);
+}
+
+uint64_t nextTraceId() {
+    return last_trace_id.fetch_add(1, std::memory_order_relaxed) + 1;
+}
+
+void recordTraceSpan(uint64_t frame, TraceStage stage, int64_t begin,
+                     int64_t end, const char* label) {
+    if (!FRAME_TRACE_ENABLED || frame == 0 || !isFrameTraceRecording()) {
+        return;
+    }
+    TraceBuffer&   buffer = threadBuffer();
+    const uint64_t head   = buffer.head.load(std::memory_order_relaxed);
+    if (head - buffer.tail.load(std::memory_order_acquire) == TRACE_BUFFER_EVENTS) {
+        buffer.dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    TraceEvent& event = buffer.events[head % TRACE_BUFFER_EVENTS];
+    event.frame       = frame;
+    event.begin       = begin;
+    event.end         = end;
+    event.label       = label;
+    event.thread      = buffer.index;
+    event.stage       = stage;
+    buffer.head.store(head + 1, std::memory_order_release);
+}
+
+void setTraceThreadName(const std::string& name) {
+    TraceBuffer&   buffer = threadBuffer();
+    TraceRegistry& shared = registry();
+    std::lock_guard<std::mutex> lock(shared.mutex);
+    shared.threads[buffer.index].name = name;
+}
+
+std::size_t collectTraceEvents(std::vector<TraceEvent>& events) {
+    TraceRegistry& shared = registry();
+    std::lock_guard<std::mutex> lock(shared.mutex);
+    const std::size_t before = events.size();
+    for (auto it = shared.buffers.begin(); it != shared.buffers.end();) {
+        TraceBuffer& buffer = **it;
+        // Read `retired` first: a retired thread has no spans after `head`
+        const bool     retired = buffer.retired.load(std::memory_order_acquire);
+        const uint64_t head    = buffer.head.load(std::memory_order_acquire);
+        uint64_t       tail    = buffer.tail.load(std::memory_order_relaxed);
+        for (; tail != head; ++tail) {
+            events.push_back(buffer.events[tail % TRACE_BUFFER_EVENTS]);
+        }
+        buffer.tail.store(tail, std::memory_order_release);
+        shared.threads[buffer.index].dropped =
+            buffer.dropped.load(std::memory_order_relaxed);
+        it = retired ? shared.buffers.erase(it) : it + 1;
+    }
+    return events.size() - before;
+}
+
+std::vector<TraceThread> getTraceThreads() {
+    TraceRegistry& shared = registry();
+    std::lock_guard<std::mutex> lock(shared.mutex);
+    return shared.threads;
+}
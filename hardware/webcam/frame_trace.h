@@ -0,0 +1,154 @@
+#ifndef FRAME_TRACE_H
+#define FRAME_TRACE_H
+
+// Per-frame latency tracing.
+//
+// Every frame a `CaptureSession` reads gets a `trace_id`, and the stages that
+// handle it record spans of host time under that id: when the driver captured
+// it, how long it waited in the ring, decode, conversion, each processing
+// stage and presentation. Spans go to a lock-free buffer of the recording
+// thread and are drained by `collectTraceEvents`; `processing/trace_report.h`
+// turns them into latency histograms and Chrome trace JSON.
+//
+// Building without `WEBCAM_FRAME_TRACE` (the `WEBCAM_ENABLE_TRACE` CMake
+// option) compiles the recording calls out. With it, spans are only recorded
+// between `startFrameTrace` and `stopFrameTrace`.
+
+#include "frame.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#ifdef WEBCAM_FRAME_TRACE
+constexpr bool FRAME_TRACE_ENABLED = true;
+#else
+constexpr bool FRAME_TRACE_ENABLED = false;
+#endif
+
+/**
+ * @brief Part of a frame's path from the driver to the screen.
+ */
+enum class TraceStage : uint8_t {
+    Capture, // Driver capture time until the capture thread received it
+    Queue,   // Waiting in the capture ring until a consumer took it
+    Decode,  // MJPEG decode on a worker
+    Convert, // YUV to RGB or gray
+    Process, // A processing stage, named by the span's label
+    Present  // Drawing or uploading the result
+};
+
+constexpr std::size_t TRACE_STAGES = 6;
+
+/**
+ * @brief One recorded span, times on the `hostTime100ns` clock.
+ */
+struct TraceEvent {
+    uint64_t    frame{};  // `Frame::trace_id`
+    int64_t     begin{};
+    int64_t     end{};
+    const char* label{};  // Static string naming a Process span, or nullptr
+    uint32_t    thread{}; // Index of the recording thread, see `getTraceThreads`
+    TraceStage  stage{TraceStage::Capture};
+};
+
+/**
+ * @brief A thread that recorded spans.
+ */
+struct TraceThread {
+    uint32_t    index{};
+    std::string name{};
+    uint64_t    dropped{}; // Spans lost because its buffer was full
+};
+
+/**
+ * @brief `Capture`, `Queue`, ... for stage.
+ */
+const char* traceStageName(TraceStage stage);
+
+/**
+ * @brief Name of a span: its label if it has one, the stage's otherwise.
+ */
+const char* traceEventName(const TraceEvent& event);
+
+/**
+ * @brief Start recording spans on all threads.
+ */
+void startFrameTrace();
+
+/**
+ * @brief Stop recording. Spans already recorded stay until collected.
+ */
+void stopFrameTrace();
+
+bool isFrameTraceRecording();
+
+/**
+ * @brief Next unused trace id, never 0.
+ */
+uint64_t nextTraceId();
+
+/**
+ * @brief Record a span of `frame` on the calling thread's buffer. Does
+ * nothing when not recording or when `frame` is 0. Does not allocate after
+ * the thread's first span.
+ *
+ * @param label Static string, e.g. the name of a processing stage.
+ */
+void recordTraceSpan(uint64_t frame, TraceStage stage, int64_t begin,
+                     int64_t end, const char* label = nullptr);
+
+/**
+ * @brief Name the calling thread in exported traces.
+ */
+void setTraceThreadName(const std::string& name);
+
+/**
+ * @brief Move the spans recorded so far on all threads into `events`.
+ * @return Number of spans appended.
+ */
+std::size_t collectTraceEvents(std::vector<TraceEvent>& events);
+
+/**
+ * @brief Every thread that recorded a span since the process started.
+ */
+std::vector<TraceThread> getTraceThreads();
+
+/**
+ * @brief Records the span from its construction to its destruction.
+ *
+ * Costs one check of the recording flag when tracing is off and nothing when
+ * it is compiled out.
+ */
+class TraceScope {
+  private:
+    uint64_t    frame_{};
+    int64_t     begin_{};
+    const char* label_{};
+    TraceStage  stage_;
+
+  public:
+    TraceScope(const Frame& frame, TraceStage stage,
+               const char* label = nullptr)
+        : label_(label), stage_(stage) {
+        if constexpr (FRAME_TRACE_ENABLED) {
+            if (frame.trace_id != 0 && isFrameTraceRecording()) {
+                this->frame_ = frame.trace_id;
+                this->begin_ = hostTime100ns();
+            }
+        }
+    }
+    TraceScope(const TraceScope&) = delete;
+    ~TraceScope() {
+        if constexpr (FRAME_TRACE_ENABLED) {
+            if (this->frame_ != 0) {
+                recordTraceSpan(this->frame_, this->stage_, this->begin_,
+                                hostTime100ns(), this->label_);
+            }
+        }
+    }
+
+    TraceScope& operator=(const TraceScope&) = delete;
+};
+
+#endif // FRAME_TRACE_H
@@ -0,0 +1,131 @@
+#include "media_catalog.h"
+
+#include <algorithm>
+
+namespace {
+
+constexpr uint64_t MJPEG_BITS_PER_PIXEL = 3;
+
+// 29.97 fps media types satisfy a 30 fps minimum
+constexpr double FPS_SLACK = 0.999;
+
+} // namespace
+
+MediaCatalog::MediaCatalog(const std::vector<MediaFormat>& formats) {
+    const std::size_t count = formats.size();
+    this->subtype_.reserve(count);
+    this->width_.reserve(count);
+    this->height_.reserve(count);
+    this->fps_numerator_.reserve(count);
+    this->fps_denominator_.reserve(count);
+    this->fps_.reserve(count);
+    this->bandwidth_.reserve(count);
+    for (const MediaFormat& format : formats) {
+        this->subtype_.push_back(format.subtype);
+        this->width_.push_back(format.width);
+        this->height_.push_back(format.height);
+        this->fps_numerator_.push_back(format.fps_numerator);
+        this->fps_denominator_.push_back(format.fps_denominator);
+        this->fps_.push_back(format.fps_denominator
+                                 ? static_cast<double>(format.fps_numerator) /
+                                       format.fps_denominator
+                                 : 0.0);
+        this->bandwidth_.push_back(estimateBandwidth(format));
+    }
+}
+
+uint64_t MediaCatalog::estimateBandwidth(const MediaFormat& format) {
+    if (format.fps_denominator == 0) {
+        return 0;
+    }
+    uint64_t frame = rawFrameSize(format);
+    if (frame == 0) {
+        // Compressed or unknown, budget like MJPEG
+        frame = static_cast<uint64_t>(format.width) * format.height *
+                MJPEG_BITS_PER_PIXEL / 8;
+    }
+    return frame * format.fps_numerator / format.fps_denominator;
+}
+
+MediaFormat MediaCatalog::format(std::size_t index) const {
+    return {this->subtype_[index], this->width_[index], this->height_[index],
+            this->fps_numerator_[index], this->fps_denominator_[index]};
+}
+
+bool MediaCatalog::matches(std::size_t index, const FormatQuery& query) const {
+    return this->fps_[index] >= query.min_fps * FPS_SLACK &&
+           this->width_[index] >= query.min_width &&
+           this->height_[index] >= query.min_height &&
+           (query.max_width == 0 || this->width_[index] <= query.max_width) &&
+           (query.max_height == 0 || this->height_[index] <= query.max_height) &&
+           (query.max_bandwidth == 0 ||
+            this->bandwidth_[index] <= query.max_bandwidth) &&
+           (query.required_subtype == 0 ||
+            this->subtype_[index] == query.required_subtype);
+}
+
+bool MediaCatalog::isBetter(std::size_t a, std::size_t b,
+                            const FormatQuery& query) const {
+    if (query.preferred_subtype != 0) {
+        const bool preferred_a = this->subtype_[a] == query.preferred_subtype;
+        const bool preferred_b = this->subtype_[b] == query.preferred_subtype;
+        if (preferred_a != preferred_b) {
+            return preferred_a;
+        }
+    }
+    const uint64_t pixels_a = static_cast<uint64_t>(this->width_[a]) * this->height_[a];
+    const uint64_t pixels_b = static_cast<uint64_t>(this->width_[b]) * this->height_[b];
+    switch (query.goal) {
+    case FormatGoal::MinBandwidth:
+        if (this->bandwidth_[a] != this->bandwidth_[b]) {
+            return this->bandwidth_[a] < this->bandwidth_[b];
+        }
+        if (pixels_a != pixels_b) {
+            return pixels_a > pixels_b;
+        }
+        return this->fps_[a] > this->fps_[b];
+    case FormatGoal::MaxResolution:
+        if (pixels_a != pixels_b) {
+            return pixels_a > pixels_b;
+        }
+        if (this->fps_[a] != this->fps_[b]) {
+            return this->fps_[a] > this->fps_[b];
+        }
+        return this->bandwidth_[a] < this->bandwidth_[b];
+    case FormatGoal::MaxFrameRate:
+        if (this->fps_[a] != this->fps_[b]) {
+            return this->fps_[a] > this->fps_[b];
+        }
+        if (pixels_a != pixels_b) {
+            return pixels_a > pixels_b;
+        }
+        return this->bandwidth_[a] < this->bandwidth_[b];
+    }
+    return false;
+}
+
+int16_t MediaCatalog::findBest(const FormatQuery& query, std::size_t& index) const {
+    bool found = false;
+    for (std::size_t i = 0; i < this->size(); ++i) {
+        if (this->matches(i, query) && (!found || this->isBetter(i, index, query))) {
+            index = i;
+            found = true;
+        }
+    }
+    return found ? 0 : -404;
+}
+
+std::vector<std::size_t> MediaCatalog::rank(const FormatQuery& query) const {
+    std::vector<std::size_t> indices;
+    for (std::size_t i = 0; i < this->size(); ++i) {
+        if (this->matches(i, query)) {
+            indices.push_back(i);
+        }
+    }
+    // Equal media types keep the source's order
+    std::stable_sort(indices.begin(), indices.end(),
+                     [&](std::size_t a, std::size_t b) {
+                         return this->isBetter(a, b, query);
+                     });
+    return indices;
+}
@@ -0,0 +1,101 @@
+#ifndef MEDIA_CATALOG_H
+#define MEDIA_CATALOG_H
+
+#include "frame.h"
+#include <cstdint>
+#include <vector>
+
+/**
+ * @brief What `MediaCatalog::findBest` optimizes among the media types that
+ * satisfy a query.
+ */
+enum class FormatGoal {
+    MinBandwidth,  // Least data over the bus
+    MaxResolution, // Most pixels, then the highest frame rate
+    MaxFrameRate   // Highest frame rate, then the most pixels
+};
+
+/**
+ * @brief Constraints and preferences for picking a media type.
+ *
+ * Zero leaves a limit open. Frame rates within 0.1% of `min_fps` satisfy
+ * it, so 29.97 fps counts as 30. The preferred subtype is chosen over the
+ * others whenever a media type of it satisfies the constraints.
+ */
+struct FormatQuery {
+    double     min_fps{0};
+    uint32_t   min_width{0};
+    uint32_t   min_height{0};
+    uint32_t   max_width{0};
+    uint32_t   max_height{0};
+    uint64_t   max_bandwidth{0};     // Bytes per second
+    uint32_t   required_subtype{0};  // FourCC, only this subtype qualifies
+    uint32_t   preferred_subtype{0}; // FourCC
+    FormatGoal goal{FormatGoal::MinBandwidth};
+};
+
+/**
+ * @brief Media types of a source, decoded once into one array per field.
+ *
+ * Indices match the source's `getMediaFormats()`. Queries scan the arrays
+ * they need without touching the source or the device again, so listing
+ * and selecting formats for the UI is cheap, and catalogs can be built from
+ * any list of formats.
+ */
+class MediaCatalog {
+  private:
+    std::vector<uint32_t> subtype_{};
+    std::vector<uint32_t> width_{};
+    std::vector<uint32_t> height_{};
+    std::vector<uint32_t> fps_numerator_{};
+    std::vector<uint32_t> fps_denominator_{};
+    std::vector<double>   fps_{};
+    std::vector<uint64_t> bandwidth_{};
+
+    // Whether `a` ranks before `b`, both satisfying `query`
+    bool isBetter(std::size_t a, std::size_t b, const FormatQuery& query) const;
+
+  public:
+    MediaCatalog() = default;
+    explicit MediaCatalog(const std::vector<MediaFormat>& formats);
+
+    /**
+     * @brief Estimated bytes per second of `format`.
+     *
+     * Exact for uncompressed subtypes. MJPEG is assumed to take 3 bits per
+     * pixel, a fifth of YUY2, which is typical of webcam encoders.
+     */
+    static uint64_t estimateBandwidth(const MediaFormat& format);
+
+    std::size_t size() const { return this->subtype_.size(); }
+    bool        empty() const { return this->subtype_.empty(); }
+
+    uint32_t subtype(std::size_t index) const { return this->subtype_[index]; }
+    uint32_t width(std::size_t index) const { return this->width_[index]; }
+    uint32_t height(std::size_t index) const { return this->height_[index]; }
+    double   fps(std::size_t index) const { return this->fps_[index]; }
+    uint64_t bandwidth(std::size_t index) const {
+        return this->bandwidth_[index];
+    }
+    MediaFormat format(std::size_t index) const;
+
+    /**
+     * @brief Whether the media type at `index` satisfies the constraints of
+     * `query`; the preference and goal are ignored.
+     */
+    bool matches(std::size_t index, const FormatQuery& query) const;
+
+    /**
+     * @brief Best media type for `query`.
+     * @param index Receives its index.
+     * @return 0 on success, -404 if no media type satisfies the constraints.
+     */
+    int16_t findBest(const FormatQuery& query, std::size_t& index) const;
+
+    /**
+     * @brief Indices of the media types satisfying `query`, best first.
+     */
+    std::vector<std::size_t> rank(const FormatQuery& query) const;
+};
+
+#endif // MEDIA_CATALOG_H
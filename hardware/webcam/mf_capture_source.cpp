@@ -0,0 +1,371 @@
+#include "mf_capture_source.h"
+
+#include <algorithm>
+#include "pixel_format.h"
+#include <cstring>
+#include <iostream>
+#include <locale.h>
+
+// Defines the DEVPKEY_ property keys, in this translation unit only
+#include <initguid.h>
+
+#include <cfgmgr32.h>
+#include <devpkey.h>
+
+void error(HRESULT hr, const std::wstring& message) {
+    if (FAILED(hr)) {
+        LPWSTR lpMsgBuf;
+        DWORD  bufLen = FormatMessageW(
+            FORMAT_MESSAGE_ALLOCATE_BUFFER | FORMAT_MESSAGE_FROM_SYSTEM |
+                FORMAT_MESSAGE_IGNORE_INSERTS,
+            NULL, hr,
+            MAKELANGID(LANG_ENGLISH, SUBLANG_ENGLISH_US), // English language
+            (LPWSTR)&lpMsgBuf, 0, NULL);
+
+        if (bufLen) {
+            LPCWSTR      lpMsgStr = (LPCWSTR)lpMsgBuf;
+            std::wstring result(lpMsgStr, lpMsgStr + bufLen);
+
+            std::wcerr << message << L" Error: " << hr << L": " << result
+                       << std::endl;
+
+            LocalFree(lpMsgBuf);
+        }
+    }
+}
+
+namespace {
+
+/**
+ * @brief Native media types of the first video stream, largest resolution
+ * first and MJPEG before other subtypes of the same size; otherwise the
+ * device's order.
+ */
+void enumerateMediaTypes(IMFSourceReader* reader, std::vector<MediaFormat>& formats,
+                         std::vector<ComHandle<IMFMediaType>>& media_types) {
+    // Decode every media type once, the sort compares the plain values
+    std::vector<std::pair<MediaFormat, ComHandle<IMFMediaType>>> types;
+    uint32_t                index = 0;
+    ComHandle<IMFMediaType> media_type;
+    while (SUCCEEDED(reader->GetNativeMediaType(
+        (DWORD)MF_SOURCE_READER_FIRST_VIDEO_STREAM, index, media_type.put()))) {
+        MediaFormat format{};
+        GUID        subtype = {};
+        media_type->GetGUID(MF_MT_SUBTYPE, &subtype);
+        MFGetAttributeSize(media_type.get(), MF_MT_FRAME_SIZE, &format.width,
+                           &format.height);
+        MFGetAttributeRatio(media_type.get(), MF_MT_FRAME_RATE,
+                            &format.fps_numerator, &format.fps_denominator);
+        // Video subtypes are FourCC based, Data1 holds the code
+        format.subtype = subtype.Data1;
+        types.emplace_back(format, std::move(media_type));
+        ++index;
+    }
+
+    std::stable_sort(types.begin(), types.end(), [](const auto& a, const auto& b) {
+        const uint64_t pixels_a = static_cast<uint64_t>(a.first.width) * a.first.height;
+        const uint64_t pixels_b = static_cast<uint64_t>(b.first.width) * b.first.height;
+        if (pixels_a != pixels_b) {
+            return pixels_a > pixels_b;
+        }
+        return pixelDecoder(a.first.subtype) == PixelDecoder::Mjpeg &&
+               pixelDecoder(b.first.subtype) != PixelDecoder::Mjpeg;
+    });
+
+    formats.clear();
+    media_types.clear();
+    for (auto& type : types) {
+        formats.push_back(type.first);
+        media_types.push_back(std::move(type.second));
+    }
+}
+
+/**
+ * @brief Activate `device`, enumerate its media types and shut it down again.
+ */
+HRESULT probeDevice(IMFActivate* device, IMFAttributes* config,
+                    std::vector<MediaFormat>&             formats,
+                    std::vector<ComHandle<IMFMediaType>>& media_types) {
+    ComHandle<IMFMediaSource>  source;
+    ComHandle<IMFSourceReader> reader;
+
+    HRESULT hr = device->ActivateObject(IID_PPV_ARGS(source.put()));
+    if (SUCCEEDED(hr)) {
+        hr = MFCreateSourceReaderFromMediaSource(source.get(), config, reader.put());
+    }
+    if (SUCCEEDED(hr)) {
+        enumerateMediaTypes(reader.get(), formats, media_types);
+    }
+
+    reader.reset();
+    if (source) {
+        source->Shutdown();
+    }
+    device->ShutdownObject();
+    return hr;
+}
+
+std::wstring interfaceProperty(const wchar_t* link, const DEVPROPKEY& key) {
+    DEVPROPTYPE type = 0;
+    ULONG       size = 0;
+    if (CM_Get_Device_Interface_PropertyW(link, &key, &type, nullptr, &size, 0) !=
+            CR_BUFFER_SMALL ||
+        type != DEVPROP_TYPE_STRING) {
+        return {};
+    }
+    std::wstring value(size / sizeof(wchar_t), L'\0');
+    if (CM_Get_Device_Interface_PropertyW(link, &key, &type,
+                                          reinterpret_cast<PBYTE>(value.data()),
+                                          &size, 0) != CR_SUCCESS) {
+        return {};
+    }
+    value.resize(wcsnlen(value.c_str(), value.size()));
+    return value;
+}
+
+std::wstring nodeProperty(DEVINST node, const DEVPROPKEY& key) {
+    DEVPROPTYPE type = 0;
+    ULONG       size = 0;
+    if (CM_Get_DevNode_PropertyW(node, &key, &type, nullptr, &size, 0) !=
+            CR_BUFFER_SMALL ||
+        type != DEVPROP_TYPE_STRING) {
+        return {};
+    }
+    std::wstring value(size / sizeof(wchar_t), L'\0');
+    if (CM_Get_DevNode_PropertyW(node, &key, &type,
+                                 reinterpret_cast<PBYTE>(value.data()), &size,
+                                 0) != CR_SUCCESS) {
+        return {};
+    }
+    value.resize(wcsnlen(value.c_str(), value.size()));
+    return value;
+}
+
+} // namespace
+
+MfCaptureSource::MfCaptureSource(IMFActivate* device, IMFAttributes* config)
+    : device_(ComHandle<IMFActivate>::share(device)),
+      config_(ComHandle<IMFAttributes>::share(config)) {
+    LPWSTR name = nullptr;
+    this->device_->GetAllocatedString(MF_DEVSOURCE_ATTRIBUTE_FRIENDLY_NAME,
+                                      &name, NULL);
+    this->name_ = name;
+    CoTaskMemFree(name);
+    this->identity_ = identify(this->device_.get());
+
+    HRESULT hr = probeDevice(this->device_.get(), this->config_.get(),
+                             this->type_formats_, this->media_types_);
+    this->media_formats_ = this->type_formats_;
+
+    error(hr, L"unable to initialize webcam");
+}
+
+MfCaptureSource::MfCaptureSource(IMFActivate* device, IMFAttributes* config,
+                                 const CachedDevice& cached)
+    : device_(ComHandle<IMFActivate>::share(device)),
+      config_(ComHandle<IMFAttributes>::share(config)),
+      media_formats_(cached.formats), name_(cached.name),
+      identity_(cached.identity) {}
+
+MfCaptureSource::~MfCaptureSource() {
+    // The handles release themselves, the objects also need shutting down
+    this->source_reader_.reset();
+    if (this->active_device_) {
+        this->active_device_->Shutdown();
+    }
+    if (this->device_) {
+        this->device_->ShutdownObject();
+    }
+}
+
+IMFActivate* MfCaptureSource::getDevice() const {
+    return this->device_.copy().detach();
+}
+
+DeviceIdentity MfCaptureSource::identify(IMFActivate* device) {
+    DeviceIdentity identity;
+    LPWSTR         link = nullptr;
+    if (FAILED(device->GetAllocatedString(
+            MF_DEVSOURCE_ATTRIBUTE_SOURCE_TYPE_VIDCAP_SYMBOLIC_LINK, &link,
+            NULL))) {
+        return identity;
+    }
+    identity.id = link;
+
+    // The interface belongs to the device node the driver is bound to
+    const std::wstring instance = interfaceProperty(link, DEVPKEY_Device_InstanceId);
+    CoTaskMemFree(link);
+    DEVINST node = 0;
+    if (!instance.empty() &&
+        CM_Locate_DevNodeW(&node, const_cast<DEVINSTID_W>(instance.c_str()),
+                           CM_LOCATE_DEVNODE_NORMAL) == CR_SUCCESS) {
+        identity.driver_version = nodeProperty(node, DEVPKEY_Device_DriverVersion);
+    }
+    return identity;
+}
+
+const DeviceIdentity& MfCaptureSource::getIdentity() const {
+    return this->identity_;
+}
+
+CachedDevice MfCaptureSource::describe() const {
+    return {this->identity_, this->name_, this->media_formats_};
+}
+
+int16_t MfCaptureSource::probe(std::vector<MediaFormat>& formats) {
+    std::lock_guard<std::mutex> lock(this->mutex_);
+    if (this->source_reader_) {
+        return 304;
+    }
+    std::vector<ComHandle<IMFMediaType>> media_types;
+    HRESULT hr = probeDevice(this->device_.get(), this->config_.get(), formats,
+                             media_types);
+    if (FAILED(hr)) {
+        error(hr, L"unable to probe webcam " + this->name_);
+        return -500;
+    }
+    return 0;
+}
+
+std::wstring MfCaptureSource::getName() const { return this->name_; }
+
+const std::vector<MediaFormat>& MfCaptureSource::getMediaFormats() const {
+    return this->media_formats_;
+}
+
+bool MfCaptureSource::isOpen() const {
+    return static_cast<bool>(this->source_reader_);
+}
+
+int16_t MfCaptureSource::open(std::size_t index) {
+    std::lock_guard<std::mutex> lock(this->mutex_);
+    if (this->source_reader_) {
+        return 304;
+    }
+    if (index >= this->media_formats_.size()) {
+        return -400;
+    }
+
+    HRESULT hr = S_OK;
+
+    if (this->device_ && !this->active_device_) {
+        hr = this->device_->ActivateObject(
+            IID_PPV_ARGS(this->active_device_.put()));
+    }
+
+    if (SUCCEEDED(hr)) {
+        hr = MFCreateSourceReaderFromMediaSource(this->active_device_.get(),
+                                                 this->config_.get(),
+                                                 this->source_reader_.put());
+    }
+
+    // Sources created from the cache enumerate on the first open
+    if (SUCCEEDED(hr) && this->media_types_.empty()) {
+        enumerateMediaTypes(this->source_reader_.get(), this->type_formats_,
+                            this->media_types_);
+    }
+
+    // The device may have changed since the formats were cached
+    const auto type = std::find(this->type_formats_.begin(),
+                                this->type_formats_.end(),
+                                this->media_formats_[index]);
+    if (SUCCEEDED(hr) && type == this->type_formats_.end()) {
+        hr = MF_E_INVALIDMEDIATYPE;
+    }
+
+    if (SUCCEEDED(hr)) {
+        hr = this->source_reader_->SetCurrentMediaType(
+            (DWORD)MF_SOURCE_READER_FIRST_VIDEO_STREAM, NULL,
+            this->media_types_[type - this->type_formats_.begin()].get());
+    }
+
+    if (FAILED(hr)) {
+        this->source_reader_.reset();
+        if (this->active_device_) {
+            this->active_device_->Shutdown();
+            this->active_device_.reset();
+        }
+        error(hr, L"unable to activate webcam " + this->name_);
+        return -500;
+    }
+
+    this->chosen_media_type_index_ = index;
+    this->sequence_                = 0;
+    return 0;
+}
+
+int16_t MfCaptureSource::close() {
+    std::lock_guard<std::mutex> lock(this->mutex_);
+    if (!this->source_reader_) {
+        return 304;
+    }
+    this->source_reader_.reset();
+    if (this->active_device_) {
+        this->active_device_->Shutdown();
+        this->active_device_.reset();
+    }
+    this->device_->ShutdownObject();
+    return 0;
+}
+
+int16_t MfCaptureSource::readFrame(Frame& frame) {
+    if (!this->source_reader_) {
+        return -409;
+    }
+
+    DWORD                streamIndex, flags;
+    LONGLONG             timestamp;
+    ComHandle<IMFSample> sample;
+
+    HRESULT hr = this->source_reader_->ReadSample(
+        MF_SOURCE_READER_FIRST_VIDEO_STREAM, 0, &streamIndex, &flags,
+        &timestamp, sample.put());
+    if (FAILED(hr)) {
+        error(hr, L"ReadSample failed");
+        return -500;
+    }
+    if (flags & MF_SOURCE_READERF_ENDOFSTREAM) {
+        return -410;
+    }
+    if (!sample) {
+        // Stream tick, the device had a gap and delivered no data
+        return 204;
+    }
+
+    ComHandle<IMFMediaBuffer> buffer;
+    DWORD                     maxLength = 0, currentLength = 0;
+    BYTE*                     rawBuffer = nullptr;
+    DWORD                     count     = 0;
+
+    // Cameras deliver one buffer per sample, only fall back to the merging
+    // copy of ConvertToContiguousBuffer for multi-buffer samples
+    hr = sample->GetBufferCount(&count);
+    if (SUCCEEDED(hr)) {
+        hr = count == 1 ? sample->GetBufferByIndex(0, buffer.put())
+                        : sample->ConvertToContiguousBuffer(buffer.put());
+    }
+    if (SUCCEEDED(hr)) {
+        hr = buffer->Lock(&rawBuffer, &maxLength, &currentLength);
+        if (SUCCEEDED(hr)) {
+            frame.buffer = this->acquireBuffer(currentLength);
+            memcpy(frame.buffer.data(), rawBuffer, currentLength);
+            buffer->Unlock();
+        }
+    }
+
+    if (FAILED(hr)) {
+        error(hr, L"Unable to read sample buffer");
+        return -500;
+    }
+
+    // QPC time of the capture in 100 ns, the clock steady_clock and so
+    // hostTime100ns read on Windows. Only reported by Windows 10 and later.
+    UINT64 device_time = 0;
+    hr = sample->GetUINT64(MFSampleExtension_DeviceReferenceSystemTime, &device_time);
+
+    frame.format    = this->media_formats_[this->chosen_media_type_index_];
+    frame.timestamp = timestamp;
+    frame.capture   = SUCCEEDED(hr) ? static_cast<int64_t>(device_time) : 0;
+    frame.sequence  = this->sequence_++;
+    return 0;
+}
@@ -0,0 +1,84 @@
+#ifndef MF_CAPTURE_SOURCE_H
+#define MF_CAPTURE_SOURCE_H
+
+#include "GUID_tools.h"
+#include "capability_cache.h"
+#include "capture_source.h"
+#include "com_handle.h"
+#include <comdef.h>
+#include <mfapi.h>
+#include <mferror.h>
+#include <mfidl.h>
+#include <mfreadwrite.h>
+#include <mutex>
+#include <windows.h>
+
+void error(HRESULT hr, const std::wstring& message = L"");
+
+/**
+ * @brief Media Foundation capture device, read through `IMFSourceReader`.
+ *
+ * The device is activated once in the constructor to enumerate its native
+ * media types and shut down again until `open` is called. Constructed from a
+ * capability cache entry it is not activated at all; `open` then enumerates
+ * the media types and picks the one equal to the cached format.
+ */
+class MfCaptureSource : public CaptureSource {
+  private:
+    ComHandle<IMFActivate>               device_{};
+    ComHandle<IMFMediaSource>            active_device_{};
+    ComHandle<IMFSourceReader>           source_reader_{};
+    ComHandle<IMFAttributes>             config_{};
+    std::vector<ComHandle<IMFMediaType>> media_types_{};
+    std::vector<MediaFormat>             type_formats_{};  // Decoded media_types_
+    std::vector<MediaFormat>             media_formats_{}; // Probed or cached
+    std::mutex                           mutex_{};         // Device activation
+
+    std::size_t    chosen_media_type_index_{};
+    uint64_t       sequence_{};
+    std::wstring   name_{};
+    DeviceIdentity identity_{};
+
+  public:
+    MfCaptureSource(IMFActivate* device, IMFAttributes* config = nullptr);
+    MfCaptureSource(IMFActivate* device, IMFAttributes* config,
+                    const CachedDevice& cached);
+    MfCaptureSource(const MfCaptureSource&) = delete;
+    ~MfCaptureSource() override;
+
+    MfCaptureSource& operator=(const MfCaptureSource&) = delete;
+
+    IMFActivate* getDevice() const;
+
+    /**
+     * @brief Cache key of `device`, read from its attributes and the
+     * configuration manager without activating it.
+     * @return An empty id if the device has no symbolic link.
+     */
+    static DeviceIdentity identify(IMFActivate* device);
+
+    const DeviceIdentity& getIdentity() const;
+
+    /**
+     * @brief Cache entry for the media types this source was created with.
+     */
+    CachedDevice describe() const;
+
+    /**
+     * @brief Activate the device, enumerate its media types and shut it down
+     * again, e.g. to check a cache entry. Blocks `open` while it runs.
+     * @return 0 on success, 304 if the source is open, -500 if the device
+     * cannot be activated.
+     */
+    int16_t probe(std::vector<MediaFormat>& formats);
+
+    std::wstring                    getName() const override;
+    const std::vector<MediaFormat>& getMediaFormats() const override;
+    bool                            isOpen() const override;
+
+    int16_t open(std::size_t index) override;
+    int16_t close() override;
+    int16_t readFrame(Frame& frame) override;
+};
+
+#endif // MF_CAPTURE_SOURCE_H
@@ -0,0 +1,176 @@
+#ifndef PIXEL_FORMAT_H
+#define PIXEL_FORMAT_H
+
+#include "frame.h"
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @brief How the bytes of a frame are split into planes.
+ */
+enum class PlaneLayout : uint8_t {
+    Packed,     // All components interleaved in one plane (YUY2, RGBA)
+    SemiPlanar, // Luma plane followed by one interleaved chroma plane (NV12)
+    Planar,     // One plane per component (I420, YV12)
+    Compressed  // Variable-size bitstream (MJPG)
+};
+
+/**
+ * @brief YUV to RGB conversion path that reads the format, see
+ * `convertImage`.
+ */
+enum class PixelConversion : uint8_t { None, Packed422, SemiPlanar420, Planar420 };
+
+/**
+ * @brief Decoder that turns the format into raw pixels.
+ */
+enum class PixelDecoder : uint8_t { None, Mjpeg };
+
+/**
+ * @brief One plane of a raw frame.
+ *
+ * The plane has `ceil(width / 2^shift_x)` samples of `bytes` bytes per row
+ * and `ceil(height / 2^shift_y)` rows.
+ */
+struct PlaneTraits {
+    uint8_t bytes{};
+    uint8_t shift_x{};
+    uint8_t shift_y{};
+};
+
+/**
+ * @brief Compile-time description of a pixel format.
+ */
+struct PixelFormatTraits {
+    uint32_t        fourcc{};
+    const wchar_t*  name{};
+    PlaneLayout     layout{PlaneLayout::Packed};
+    uint8_t         planes{};          // 0 for compressed formats
+    PlaneTraits     plane[3]{};
+    uint8_t         bits_per_pixel{};  // Average over the frame, 12 for 4:2:0
+    uint8_t         chroma_shift_x{};  // log2 of the horizontal chroma subsampling
+    uint8_t         chroma_shift_y{};  // log2 of the vertical chroma subsampling
+    uint8_t         row_alignment{1};  // Rows are padded to a multiple of this,
+                                       // 4 keeps 4:2:2 macropixels whole
+    bool            luma_plane{};      // Plane 0 is 8-bit luma, usable as gray
+    bool            chroma_first{};    // Packed422 byte order is U Y V Y
+    bool            swap_chroma{};     // Planar420 stores V before U
+    PixelConversion conversion{PixelConversion::None};
+    PixelDecoder    decoder{PixelDecoder::None};
+};
+
+// clang-format off
+inline constexpr PixelFormatTraits PIXEL_FORMATS[] = {
+    // fourcc, name, layout, planes, plane, bits_per_pixel, chroma_shift_x/y,
+    // row_alignment, luma_plane, chroma_first, swap_chroma, conversion, decoder
+    {FOURCC_YUY2, L"YUY2", PlaneLayout::Packed,     1, {{2, 0, 0}},                       16, 1, 0, 4, false, false, false, PixelConversion::Packed422,     PixelDecoder::None},
+    {FOURCC_UYVY, L"UYVY", PlaneLayout::Packed,     1, {{2, 0, 0}},                       16, 1, 0, 4, false, true,  false, PixelConversion::Packed422,     PixelDecoder::None},
+    {FOURCC_NV12, L"NV12", PlaneLayout::SemiPlanar, 2, {{1, 0, 0}, {2, 1, 1}},            12, 1, 1, 1, true,  false, false, PixelConversion::SemiPlanar420, PixelDecoder::None},
+    {FOURCC_I420, L"I420", PlaneLayout::Planar,     3, {{1, 0, 0}, {1, 1, 1}, {1, 1, 1}}, 12, 1, 1, 1, true,  false, false, PixelConversion::Planar420,     PixelDecoder::None},
+    {FOURCC_IYUV, L"IYUV", PlaneLayout::Planar,     3, {{1, 0, 0}, {1, 1, 1}, {1, 1, 1}}, 12, 1, 1, 1, true,  false, false, PixelConversion::Planar420,     PixelDecoder::None},
+    {FOURCC_YV12, L"YV12", PlaneLayout::Planar,     3, {{1, 0, 0}, {1, 1, 1}, {1, 1, 1}}, 12, 1, 1, 1, true,  false, true,  PixelConversion::Planar420,     PixelDecoder::None},
+    {FOURCC_Y800, L"Y800", PlaneLayout::Packed,     1, {{1, 0, 0}},                        8, 0, 0, 1, true,  false, false, PixelConversion::None,          PixelDecoder::None},
+    {FOURCC_RGBA, L"RGBA", PlaneLayout::Packed,     1, {{4, 0, 0}},                       32, 0, 0, 1, false, false, false, PixelConversion::None,          PixelDecoder::None},
+    {FOURCC_BGRA, L"BGRA", PlaneLayout::Packed,     1, {{4, 0, 0}},                       32, 0, 0, 1, false, false, false, PixelConversion::None,          PixelDecoder::None},
+    {FOURCC_MJPG, L"MJPG", PlaneLayout::Compressed, 0, {},                                 0, 0, 0, 1, false, false, false, PixelConversion::None,          PixelDecoder::Mjpeg},
+};
+// clang-format on
+
+/**
+ * @brief Traits of `fourcc` in constant time, without allocating.
+ * @return nullptr for formats the pipeline does not know.
+ */
+constexpr const PixelFormatTraits* findPixelFormat(uint32_t fourcc) {
+    switch (fourcc) {
+    case FOURCC_YUY2:
+        return &PIXEL_FORMATS[0];
+    case FOURCC_UYVY:
+        return &PIXEL_FORMATS[1];
+    case FOURCC_NV12:
+        return &PIXEL_FORMATS[2];
+    case FOURCC_I420:
+        return &PIXEL_FORMATS[3];
+    case FOURCC_IYUV:
+        return &PIXEL_FORMATS[4];
+    case FOURCC_YV12:
+        return &PIXEL_FORMATS[5];
+    case FOURCC_Y800:
+        return &PIXEL_FORMATS[6];
+    case FOURCC_RGBA:
+        return &PIXEL_FORMATS[7];
+    case FOURCC_BGRA:
+        return &PIXEL_FORMATS[8];
+    case FOURCC_MJPG:
+        return &PIXEL_FORMATS[9];
+    default:
+        return nullptr;
+    }
+}
+
+/**
+ * @brief Decoder for frames of `fourcc`, `PixelDecoder::None` for raw and
+ * unknown formats.
+ */
+constexpr PixelDecoder pixelDecoder(uint32_t fourcc) {
+    const PixelFormatTraits* traits = findPixelFormat(fourcc);
+    return traits ? traits->decoder : PixelDecoder::None;
+}
+
+/**
+ * @brief Bytes per row of plane `index` of a `width` pixels wide frame.
+ */
+constexpr std::size_t planeStride(const PixelFormatTraits& traits,
+                                  std::size_t index, uint32_t width) {
+    const PlaneTraits& plane   = traits.plane[index];
+    const std::size_t  samples = (static_cast<std::size_t>(width) +
+                                  (1u << plane.shift_x) - 1) >> plane.shift_x;
+    const std::size_t  bytes   = samples * plane.bytes;
+    return (bytes + traits.row_alignment - 1) / traits.row_alignment *
+           traits.row_alignment;
+}
+
+/**
+ * @brief Rows of plane `index` of a `height` pixels high frame.
+ */
+constexpr std::size_t planeRows(const PixelFormatTraits& traits,
+                                std::size_t index, uint32_t height) {
+    const uint8_t shift = traits.plane[index].shift_y;
+    return (static_cast<std::size_t>(height) + (1u << shift) - 1) >> shift;
+}
+
+/**
+ * @brief Offset of plane `index` from the start of a frame whose planes
+ * follow each other without gaps.
+ */
+constexpr std::size_t planeOffset(const PixelFormatTraits& traits,
+                                  std::size_t index, uint32_t width,
+                                  uint32_t height) {
+    std::size_t offset = 0;
+    for (std::size_t i = 0; i < index; ++i) {
+        offset += planeStride(traits, i, width) * planeRows(traits, i, height);
+    }
+    return offset;
+}
+
+/**
+ * @brief Size in bytes of a raw frame, 0 for compressed formats.
+ */
+constexpr std::size_t pixelFrameSize(const PixelFormatTraits& traits,
+                                     uint32_t width, uint32_t height) {
+    return planeOffset(traits, traits.planes, width, height);
+}
+
+static_assert(
+    [] {
+        for (const PixelFormatTraits& traits : PIXEL_FORMATS) {
+            if (findPixelFormat(traits.fourcc) != &traits) {
+                return false;
+            }
+        }
+        return true;
+    }(),
+    "findPixelFormat does not cover PIXEL_FORMATS");
+static_assert(pixelFrameSize(*findPixelFormat(FOURCC_NV12), 5, 3) == 15 + 2 * 3 * 2,
+              "unexpected 4:2:0 frame size");
+
+#endif // PIXEL_FORMAT_H
@@ -0,0 +1,458 @@
+#include "recorder.h"
+
+#include "pixel_format.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+std::size_t alignUp(std::size_t value, std::size_t alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+uint8_t* allocateBlock(std::size_t size) {
+#ifdef _WIN32
+    return static_cast<uint8_t*>(_aligned_malloc(size, RECORDING_ALIGNMENT));
+#else
+    return static_cast<uint8_t*>(std::aligned_alloc(RECORDING_ALIGNMENT, size));
+#endif
+}
+
+void freeBlock(uint8_t* block) {
+#ifdef _WIN32
+    _aligned_free(block);
+#else
+    std::free(block);
+#endif
+}
+
+bool isCropped(const RecorderCrop& crop) {
+    return crop.width != 0 || crop.height != 0;
+}
+
+/**
+ * @brief Whether `crop` lies inside `format` on its chroma grid.
+ */
+bool isValidCrop(const RecorderCrop& crop, const MediaFormat& format) {
+    const PixelFormatTraits* traits = findPixelFormat(format.subtype);
+    if (!traits || traits->planes == 0 || crop.width == 0 || crop.height == 0 ||
+        crop.left >= format.width || crop.top >= format.height ||
+        crop.width > format.width - crop.left ||
+        crop.height > format.height - crop.top) {
+        return false;
+    }
+    const uint32_t x_step = 1u << traits->chroma_shift_x;
+    const uint32_t y_step = 1u << traits->chroma_shift_y;
+    return crop.left % x_step == 0 && crop.top % y_step == 0 &&
+           (crop.width % x_step == 0 || crop.left + crop.width == format.width) &&
+           (crop.height % y_step == 0 || crop.top + crop.height == format.height);
+}
+
+} // namespace
+
+/**
+ * @brief Positional writes on a native file handle, optionally unbuffered.
+ */
+struct Recorder::File {
+#ifdef _WIN32
+    HANDLE handle{INVALID_HANDLE_VALUE};
+#else
+    int fd{-1};
+#endif
+    bool direct{false};
+
+    ~File() { this->close(); }
+
+    bool open(const std::filesystem::path& path, bool want_direct) {
+#ifdef _WIN32
+        for (bool unbuffered : {want_direct, false}) {
+            DWORD flags  = FILE_ATTRIBUTE_NORMAL;
+            if (unbuffered) {
+                flags |= FILE_FLAG_NO_BUFFERING;
+            }
+            this->handle = CreateFileW(path.c_str(), GENERIC_WRITE,
+                                       FILE_SHARE_READ, nullptr, CREATE_ALWAYS,
+                                       flags, nullptr);
+            if (this->handle != INVALID_HANDLE_VALUE) {
+                this->direct = unbuffered;
+                return true;
+            }
+        }
+        return false;
+#else
+        int flags = O_WRONLY | O_CREAT | O_TRUNC;
+#ifdef O_DIRECT
+        if (want_direct) {
+            this->fd = ::open(path.c_str(), flags | O_DIRECT, 0644);
+            if (this->fd >= 0) {
+                this->direct = true;
+                return true;
+            }
+        }
+#endif
+        this->fd = ::open(path.c_str(), flags, 0644);
+#ifdef F_NOCACHE
+        if (this->fd >= 0 && want_direct) {
+            fcntl(this->fd, F_NOCACHE, 1);
+        }
+#endif
+        return this->fd >= 0;
+#endif
+    }
+
+    bool writeAt(const uint8_t* data, std::size_t size, uint64_t offset) {
+#ifdef _WIN32
+        while (size > 0) {
+            OVERLAPPED position{};
+            position.Offset     = static_cast<DWORD>(offset);
+            position.OffsetHigh = static_cast<DWORD>(offset >> 32);
+            DWORD chunk = static_cast<DWORD>(std::min<std::size_t>(size, 1u << 30));
+            DWORD written = 0;
+            if (!WriteFile(this->handle, data, chunk, &written, &position) ||
+                written == 0) {
+                return false;
+            }
+            data += written, size -= written, offset += written;
+        }
+        return true;
+#else
+        bool retried = false;
+        while (size > 0) {
+            ssize_t written = pwrite(this->fd, data, size,
+                                     static_cast<off_t>(offset));
+            if (written < 0 && errno == EINTR) {
+                continue;
+            }
+#ifdef O_DIRECT
+            if (written < 0 && errno == EINVAL && this->direct && !retried) {
+                // Opened fine but the filesystem rejects unbuffered writes
+                int flags = fcntl(this->fd, F_GETFL);
+                fcntl(this->fd, F_SETFL, flags & ~O_DIRECT);
+                this->direct = false;
+                retried      = true;
+                continue;
+            }
+#endif
+            if (written <= 0) {
+                return false;
+            }
+            data += written, size -= static_cast<std::size_t>(written);
+            offset += static_cast<uint64_t>(written);
+        }
+        return true;
+#endif
+    }
+
+    bool truncate(uint64_t size) {
+#ifdef _WIN32
+        FILE_END_OF_FILE_INFO info{};
+        info.EndOfFile.QuadPart = static_cast<LONGLONG>(size);
+        return SetFileInformationByHandle(this->handle, FileEndOfFileInfo,
+                                          &info, sizeof(info));
+#else
+        return ftruncate(this->fd, static_cast<off_t>(size)) == 0;
+#endif
+    }
+
+    bool sync() {
+#ifdef _WIN32
+        return FlushFileBuffers(this->handle);
+#elif defined(__APPLE__)
+        return fsync(this->fd) == 0;
+#else
+        return fdatasync(this->fd) == 0;
+#endif
+    }
+
+    void close() {
+#ifdef _WIN32
+        if (this->handle != INVALID_HANDLE_VALUE) {
+            CloseHandle(this->handle);
+            this->handle = INVALID_HANDLE_VALUE;
+        }
+#else
+        if (this->fd >= 0) {
+            ::close(this->fd);
+            this->fd = -1;
+        }
+#endif
+    }
+};
+
+Recorder::Recorder(const std::filesystem::path& path, const MediaFormat& format,
+                   const RecorderOptions& options)
+    : path_(path), format_(format), options_(options),
+      queue_(options.queue_capacity, RingPolicy::OverwriteOldest) {}
+
+Recorder::~Recorder() { this->close(); }
+
+int16_t Recorder::open() {
+    if (this->open_) {
+        return 304;
+    }
+    if (this->queue_.isClosed()) {
+        return -409;
+    }
+    if (this->options_.write_size == 0 ||
+        this->options_.write_size % RECORDING_ALIGNMENT != 0 ||
+        this->options_.queue_capacity == 0) {
+        return -400;
+    }
+    const RecorderCrop& crop    = this->options_.crop;
+    const bool          cropped = isCropped(crop);
+    if (cropped && !isValidCrop(crop, this->format_)) {
+        return -400;
+    }
+
+    this->file_ = std::make_unique<File>();
+    if (!this->file_->open(this->path_, this->options_.direct_io)) {
+        this->file_.reset();
+        return -500;
+    }
+    this->block_ = allocateBlock(this->options_.write_size);
+    if (!this->block_) {
+        this->file_.reset();
+        return -500;
+    }
+
+    std::memcpy(this->header_.magic, RECORDING_MAGIC, sizeof(RECORDING_MAGIC));
+    this->header_.version         = RECORDING_VERSION;
+    this->header_.header_size     = RECORDING_ALIGNMENT;
+    this->header_.subtype         = this->format_.subtype;
+    this->header_.width           = cropped ? crop.width : this->format_.width;
+    this->header_.height          = cropped ? crop.height : this->format_.height;
+    this->header_.fps_numerator   = this->format_.fps_numerator;
+    this->header_.fps_denominator = this->format_.fps_denominator;
+
+    // Placeholder until `finish` writes the final header
+    this->stage(&this->header_, sizeof(this->header_));
+    this->stageZeros(RECORDING_ALIGNMENT - sizeof(this->header_));
+
+    this->open_   = true;
+    this->thread_ = std::thread(&Recorder::run, this);
+    return 0;
+}
+
+int16_t Recorder::append(const Frame& frame) {
+    if (!this->open_.load(std::memory_order_acquire)) {
+        return -409;
+    }
+    if (this->failed_.load(std::memory_order_relaxed)) {
+        return -500;
+    }
+    if (frame.format.subtype != this->format_.subtype ||
+        frame.format.width != this->format_.width ||
+        frame.format.height != this->format_.height || !frame.buffer ||
+        // A short sample would be read past its end; 0 for compressed ones
+        frame.buffer.size() < rawFrameSize(this->format_)) {
+        return -400;
+    }
+    // OverwriteOldest never waits, a full queue drops its oldest frame
+    return this->queue_.push(frame) ? 0 : -409;
+}
+
+int16_t Recorder::close() {
+    if (!this->open_.exchange(false)) {
+        return 304;
+    }
+    this->queue_.close();
+    this->thread_.join();
+
+    freeBlock(this->block_);
+    this->block_ = nullptr;
+    this->file_.reset();
+    return this->failed_ ? -500 : 0;
+}
+
+bool Recorder::isOpen() const { return this->open_; }
+
+RecorderStats Recorder::getStats() const {
+    RecorderStats stats;
+    stats.frames_written = this->frames_written_.load(std::memory_order_relaxed);
+    stats.bytes_written  = this->bytes_written_.load(std::memory_order_relaxed);
+    stats.dropped        = this->queue_.dropped();
+    stats.writes         = this->writes_.load(std::memory_order_relaxed);
+    stats.syncs          = this->syncs_.load(std::memory_order_relaxed);
+    stats.errors         = this->errors_.load(std::memory_order_relaxed);
+    return stats;
+}
+
+void Recorder::run() {
+    using clock = std::chrono::steady_clock;
+
+    const auto interval  = this->options_.sync_interval;
+    const auto poll      = interval.count() > 0
+                               ? std::min(interval, std::chrono::milliseconds(100))
+                               : std::chrono::milliseconds(100);
+    auto       next_sync = clock::now() + interval;
+
+    Frame frame;
+    for (;;) {
+        if (this->queue_.waitPop(frame, poll)) {
+            this->writeFrame(frame);
+            frame = Frame();
+        } else if (this->queue_.isClosed()) {
+            break; // Closed and drained
+        }
+
+        if (interval.count() > 0 && clock::now() >= next_sync) {
+            if (this->unsynced_) {
+                this->sync();
+            }
+            next_sync = clock::now() + interval;
+        }
+    }
+    this->finish();
+}
+
+void Recorder::writeFrame(const Frame& frame) {
+    if (this->failed_) {
+        return;
+    }
+
+    const RecorderCrop& crop    = this->options_.crop;
+    const bool          cropped = isCropped(crop);
+
+    RecordingFrameHeader record{};
+    record.magic     = RECORDING_FRAME_MAGIC;
+    record.size      = static_cast<uint32_t>(
+        cropped ? pixelFrameSize(*findPixelFormat(this->format_.subtype),
+                                 crop.width, crop.height)
+                : frame.buffer.size());
+    record.timestamp = frame.timestamp;
+    record.sequence  = frame.sequence;
+
+    const uint64_t record_offset = this->block_offset_ + this->block_fill_;
+    this->stage(&record, sizeof(record));
+    if (cropped) {
+        this->stageCrop(frame);
+    } else {
+        this->stage(frame.buffer.data(), frame.buffer.size());
+    }
+    this->stageZeros(alignUp(record.size, RECORDING_RECORD_ALIGNMENT) -
+                     record.size);
+
+    if (this->index_.empty()) {
+        this->header_.first_timestamp = frame.timestamp;
+    }
+    this->header_.last_timestamp = frame.timestamp;
+    this->index_.push_back({frame.timestamp, record_offset + sizeof(record),
+                            record.size, 0});
+
+    this->frames_written_.fetch_add(1, std::memory_order_relaxed);
+    this->bytes_written_.store(this->block_offset_ + this->block_fill_,
+                               std::memory_order_relaxed);
+}
+
+void Recorder::stageCrop(const Frame& frame) {
+    const PixelFormatTraits& traits = *findPixelFormat(this->format_.subtype);
+    const RecorderCrop&      crop   = this->options_.crop;
+    const uint32_t           width  = this->format_.width;
+    const uint32_t           height = this->format_.height;
+
+    for (std::size_t p = 0; p < traits.planes; ++p) {
+        const PlaneTraits& plane  = traits.plane[p];
+        const std::size_t  stride = planeStride(traits, p, width);
+        const std::size_t  bytes  = planeStride(traits, p, crop.width);
+        const uint8_t*     row    = frame.buffer.data() +
+                             planeOffset(traits, p, width, height) +
+                             (crop.top >> plane.shift_y) * stride +
+                             (crop.left >> plane.shift_x) * plane.bytes;
+        for (std::size_t r = planeRows(traits, p, crop.height); r > 0; --r) {
+            this->stage(row, bytes);
+            row += stride;
+        }
+    }
+}
+
+void Recorder::stage(const void* data, std::size_t size) {
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    while (size > 0) {
+        std::size_t chunk =
+            std::min(size, this->options_.write_size - this->block_fill_);
+        std::memcpy(this->block_ + this->block_fill_, bytes, chunk);
+        this->block_fill_ += chunk;
+        this->unsynced_ = true;
+        bytes += chunk, size -= chunk;
+
+        if (this->block_fill_ == this->options_.write_size) {
+            this->writeBlock(this->block_fill_);
+            this->block_offset_ += this->block_fill_;
+            this->block_fill_ = 0;
+        }
+    }
+}
+
+void Recorder::stageZeros(std::size_t size) {
+    static const uint8_t zeros[RECORDING_RECORD_ALIGNMENT] = {};
+    while (size > 0) {
+        std::size_t chunk = std::min(size, sizeof(zeros));
+        this->stage(zeros, chunk);
+        size -= chunk;
+    }
+}
+
+bool Recorder::writeBlock(std::size_t length) {
+    if (this->failed_) {
+        return false;
+    }
+    // Unbuffered writes go in whole sectors; the tail is rewritten once the
+    // block fills up and the file is truncated to size at the end
+    if (length > this->block_fill_) {
+        std::memset(this->block_ + this->block_fill_, 0,
+                    length - this->block_fill_);
+    }
+    this->writes_.fetch_add(1, std::memory_order_relaxed);
+    if (!this->file_->writeAt(this->block_, length, this->block_offset_)) {
+        this->errors_.fetch_add(1, std::memory_order_relaxed);
+        this->failed_ = true;
+        return false;
+    }
+    return true;
+}
+
+void Recorder::sync() {
+    if (this->block_fill_ > 0) {
+        this->writeBlock(alignUp(this->block_fill_, RECORDING_ALIGNMENT));
+    }
+    if (!this->failed_ && !this->file_->sync()) {
+        this->errors_.fetch_add(1, std::memory_order_relaxed);
+    }
+    this->syncs_.fetch_add(1, std::memory_order_relaxed);
+    this->unsynced_ = false;
+}
+
+void Recorder::finish() {
+    this->header_.frame_count  = this->index_.size();
+    this->header_.index_offset = this->block_offset_ + this->block_fill_;
+    this->stage(this->index_.data(),
+                this->index_.size() * sizeof(RecordingIndexEntry));
+
+    const uint64_t size = this->block_offset_ + this->block_fill_;
+    if (this->block_fill_ > 0) {
+        this->writeBlock(alignUp(this->block_fill_, RECORDING_ALIGNMENT));
+    }
+
+    // The final header replaces the placeholder in the first sector
+    std::memset(this->block_, 0, RECORDING_ALIGNMENT);
+    std::memcpy(this->block_, &this->header_, sizeof(this->header_));
+    if (!this->failed_ &&
+        (!this->file_->writeAt(this->block_, RECORDING_ALIGNMENT, 0) ||
+         !this->file_->truncate(size) || !this->file_->sync())) {
+        this->errors_.fetch_add(1, std::memory_order_relaxed);
+        this->failed_ = true;
+    }
+    this->writes_.fetch_add(1, std::memory_order_relaxed);
+    this->syncs_.fetch_add(1, std::memory_order_relaxed);
+    this->bytes_written_.store(size, std::memory_order_relaxed);
+    this->file_->close();
+}
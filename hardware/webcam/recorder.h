@@ -0,0 +1,135 @@
+#ifndef RECORDER_H
+#define RECORDER_H
+
+#include "frame_ring.h"
+#include "recording.h"
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <memory>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief Part of each frame a recorder writes, in pixels.
+ *
+ * Edges must fall on the chroma grid of the format (even for 4:2:2 and
+ * 4:2:0) unless they are the frame's edges.
+ */
+struct RecorderCrop {
+    uint32_t left{};
+    uint32_t top{};
+    uint32_t width{}; // 0 to write whole frames
+    uint32_t height{};
+};
+
+struct RecorderOptions {
+    std::size_t queue_capacity{64};             // Frames between capture and disk
+    std::size_t write_size{4 * 1024 * 1024};    // Bytes per coalesced write
+    bool        direct_io{true};                // Bypass the page cache
+    std::chrono::milliseconds sync_interval{1000}; // 0 to only sync on close
+    RecorderCrop crop{};                        // Raw formats only
+};
+
+/**
+ * @brief Counters of one recording.
+ */
+struct RecorderStats {
+    uint64_t frames_written{};
+    uint64_t bytes_written{}; // Logical file size so far
+    uint64_t dropped{};       // Frames lost because the writer fell behind
+    uint64_t writes{};        // Write calls issued to the OS
+    uint64_t syncs{};
+    uint64_t errors{};
+};
+
+/**
+ * @brief Appends frames to a single recording file on a writer thread.
+ *
+ * `append` only queues a reference to the frame, so the capture thread never
+ * waits on the disk; when the writer falls behind by more than
+ * `queue_capacity` frames the oldest queued one is dropped and counted. The
+ * writer copies frames into one aligned block and writes it once it holds
+ * `write_size` bytes. With `direct_io` the file is opened with O_DIRECT on
+ * Linux and FILE_FLAG_NO_BUFFERING on Windows so long recordings do not
+ * evict the page cache; filesystems that refuse it get buffered writes.
+ * Every `sync_interval` the data written so far is flushed to the device.
+ * With a `crop` only that rectangle of each frame is copied, plane by plane,
+ * and the recording has the size of the crop.
+ *
+ * The layout is described in `recording.h`.
+ */
+class Recorder {
+  private:
+    struct File;
+
+    std::filesystem::path path_;
+    MediaFormat           format_;
+    RecorderOptions       options_;
+
+    FrameRing<Frame>      queue_;
+    std::thread           thread_{};
+    std::unique_ptr<File> file_;
+
+    uint8_t*    block_{nullptr}; // Staging block of `write_size` bytes
+    std::size_t block_fill_{};   // Valid bytes in the block
+    uint64_t    block_offset_{}; // File offset of the block
+    bool        unsynced_{};     // Bytes staged since the last sync
+
+    std::vector<RecordingIndexEntry> index_{};
+    RecordingHeader                  header_{};
+
+    std::atomic<uint64_t> frames_written_{};
+    std::atomic<uint64_t> bytes_written_{};
+    std::atomic<uint64_t> writes_{};
+    std::atomic<uint64_t> syncs_{};
+    std::atomic<uint64_t> errors_{};
+    std::atomic<bool>     open_{false};
+    std::atomic<bool>     failed_{false};
+
+    void run();
+    void writeFrame(const Frame& frame);
+    void stageCrop(const Frame& frame);
+    void stage(const void* data, std::size_t size);
+    void stageZeros(std::size_t size);
+    bool writeBlock(std::size_t length);
+    void sync();
+    void finish();
+
+  public:
+    Recorder(const std::filesystem::path& path, const MediaFormat& format,
+             const RecorderOptions& options = {});
+    Recorder(const Recorder&) = delete;
+    ~Recorder();
+
+    Recorder& operator=(const Recorder&) = delete;
+
+    /**
+     * @brief Create the file and start the writer thread. A recorder writes
+     * one file and cannot be reopened after `close`.
+     * @return 0 on success, 304 if already open, -400 for invalid options or
+     * a crop the media type cannot be cut to, -409 if it was closed before, -500 if the file cannot be created.
+     */
+    int16_t open();
+
+    /**
+     * @brief Queue a frame for writing. Never blocks.
+     * @return 0 on success, -400 if the frame does not match the recording's
+     * media type or a raw frame is shorter than its media type, -409 if the
+     * recorder is not open, -500 after a write error.
+     */
+    int16_t append(const Frame& frame);
+
+    /**
+     * @brief Write what is queued, the index and the final header, then close
+     * the file.
+     * @return 0 on success, 304 if not open, -500 if any write failed.
+     */
+    int16_t close();
+
+    bool                         isOpen() const;
+    const std::filesystem::path& getPath() const { return this->path_; }
+    RecorderStats                getStats() const;
+};
+
+#endif // RECORDER_H
@@ -0,0 +1,58 @@
+#ifndef RECORDING_H
+#define RECORDING_H
+
+// On-disk layout of a recording, shared by the recorder and the readers.
+//
+//   [RecordingHeader, padded to RECORDING_ALIGNMENT]
+//   [RecordingFrameHeader][payload][padding to 8 bytes]   once per frame
+//   [RecordingIndexEntry] * frame_count
+//
+// All fields are little-endian. `frame_count` and `index_offset` in the header
+// are filled in when the recording is closed; a recording that was never
+// closed can still be read by walking the frame records.
+
+#include "frame.h"
+#include <cstddef>
+#include <cstdint>
+
+constexpr char        RECORDING_MAGIC[8]    = {'W', 'C', 'R', 'E', 'C', 'O', 'R', 'D'};
+constexpr uint32_t    RECORDING_VERSION     = 1;
+constexpr std::size_t RECORDING_ALIGNMENT   = 4096; // Header size, write unit
+constexpr std::size_t RECORDING_RECORD_ALIGNMENT = 8;
+constexpr uint32_t    RECORDING_FRAME_MAGIC = makeFourCC('F', 'R', 'A', 'M');
+
+struct RecordingHeader {
+    char     magic[8];
+    uint32_t version;
+    uint32_t header_size; // Offset of the first frame record
+    uint32_t subtype;
+    uint32_t width;
+    uint32_t height;
+    uint32_t fps_numerator;
+    uint32_t fps_denominator;
+    uint32_t reserved;
+    uint64_t frame_count;  // 0 until the recording is closed
+    uint64_t index_offset; // 0 until the recording is closed
+    int64_t  first_timestamp;
+    int64_t  last_timestamp;
+};
+
+struct RecordingFrameHeader {
+    uint32_t magic; // RECORDING_FRAME_MAGIC
+    uint32_t size;  // Payload bytes, without padding
+    int64_t  timestamp;
+    uint64_t sequence;
+};
+
+struct RecordingIndexEntry {
+    int64_t  timestamp;
+    uint64_t offset; // Of the payload, the frame header is right before it
+    uint32_t size;
+    uint32_t reserved;
+};
+
+static_assert(sizeof(RecordingHeader) == 72, "unexpected header padding");
+static_assert(sizeof(RecordingFrameHeader) == 24, "unexpected frame header padding");
+static_assert(sizeof(RecordingIndexEntry) == 24, "unexpected index padding");
+
+#endif // RECORDING_H
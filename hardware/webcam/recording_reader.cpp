@@ -0,0 +1,284 @@
+#include "recording_reader.h"
+
+#include <algorithm>
+#include <cstring>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/**
+ * @brief Private, copy-on-write mapping of a whole file.
+ */
+struct RecordingReader::Mapping {
+    uint8_t*    data{nullptr};
+    std::size_t size{};
+#ifdef _WIN32
+    HANDLE file{INVALID_HANDLE_VALUE};
+    HANDLE mapping{nullptr};
+#endif
+
+    Mapping() = default;
+    Mapping(const Mapping&)            = delete;
+    Mapping& operator=(const Mapping&) = delete;
+
+    ~Mapping() {
+#ifdef _WIN32
+        if (this->data) {
+            UnmapViewOfFile(this->data);
+        }
+        if (this->mapping) {
+            CloseHandle(this->mapping);
+        }
+        if (this->file != INVALID_HANDLE_VALUE) {
+            CloseHandle(this->file);
+        }
+#else
+        if (this->data) {
+            munmap(this->data, this->size);
+        }
+#endif
+    }
+
+    bool map(const std::filesystem::path& path) {
+#ifdef _WIN32
+        this->file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ,
+                                 nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL,
+                                 nullptr);
+        LARGE_INTEGER size;
+        if (this->file == INVALID_HANDLE_VALUE ||
+            !GetFileSizeEx(this->file, &size) || size.QuadPart == 0) {
+            return false;
+        }
+        this->size    = static_cast<std::size_t>(size.QuadPart);
+        this->mapping = CreateFileMappingW(this->file, nullptr, PAGE_WRITECOPY,
+                                           0, 0, nullptr);
+        if (!this->mapping) {
+            return false;
+        }
+        this->data = static_cast<uint8_t*>(
+            MapViewOfFile(this->mapping, FILE_MAP_COPY, 0, 0, 0));
+        return this->data != nullptr;
+#else
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            return false;
+        }
+        struct stat info;
+        if (fstat(fd, &info) != 0 || info.st_size == 0) {
+            ::close(fd);
+            return false;
+        }
+        this->size = static_cast<std::size_t>(info.st_size);
+        void* data = mmap(nullptr, this->size, PROT_READ | PROT_WRITE,
+                          MAP_PRIVATE, fd, 0);
+        ::close(fd); // The mapping keeps the file referenced
+        if (data == MAP_FAILED) {
+            return false;
+        }
+        this->data = static_cast<uint8_t*>(data);
+        return true;
+#endif
+    }
+
+    void advise(std::size_t offset, std::size_t length) const {
+        if (offset >= this->size) {
+            return;
+        }
+        length = std::min(length, this->size - offset);
+#ifdef _WIN32
+        WIN32_MEMORY_RANGE_ENTRY range{this->data + offset, length};
+        PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+#else
+        // madvise wants a page aligned start
+        const std::size_t page  = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+        const std::size_t start = offset / page * page;
+        madvise(this->data + start, length + (offset - start), MADV_WILLNEED);
+#endif
+    }
+};
+
+FrameView RecordingReader::Iterator::operator*() const {
+    FrameView view;
+    this->reader_->frameAt(this->index_, view);
+    return view;
+}
+
+RecordingReader::~RecordingReader() { this->close(); }
+
+int16_t RecordingReader::open(const std::filesystem::path& path) {
+    this->close();
+
+    auto mapping = std::make_shared<Mapping>();
+    if (!mapping->map(path)) {
+        return -404;
+    }
+
+    RecordingHeader header;
+    if (mapping->size < sizeof(header)) {
+        return -400;
+    }
+    std::memcpy(&header, mapping->data, sizeof(header));
+    if (std::memcmp(header.magic, RECORDING_MAGIC, sizeof(header.magic)) != 0 ||
+        header.version != RECORDING_VERSION ||
+        header.header_size > mapping->size) {
+        return -400;
+    }
+
+    this->mapping_ = std::move(mapping);
+    this->format_  = {header.subtype, header.width, header.height,
+                      header.fps_numerator, header.fps_denominator};
+
+    const uint64_t index_bytes = header.frame_count * sizeof(RecordingIndexEntry);
+    if (header.index_offset != 0 && header.index_offset % 8 == 0 &&
+        header.index_offset <= this->mapping_->size &&
+        index_bytes <= this->mapping_->size - header.index_offset) {
+        this->index_ = reinterpret_cast<const RecordingIndexEntry*>(
+            this->mapping_->data + header.index_offset);
+        this->count_ = static_cast<std::size_t>(header.frame_count);
+    } else {
+        this->rebuildIndex(header.header_size);
+    }
+    return 0;
+}
+
+void RecordingReader::rebuildIndex(uint64_t first_record) {
+    const uint8_t* data = this->mapping_->data;
+    const uint64_t size = this->mapping_->size;
+
+    uint64_t offset = first_record;
+    while (offset + sizeof(RecordingFrameHeader) <= size) {
+        RecordingFrameHeader record;
+        std::memcpy(&record, data + offset, sizeof(record));
+        const uint64_t payload = offset + sizeof(record);
+        if (record.magic != RECORDING_FRAME_MAGIC || record.size > size - payload) {
+            break; // Padding or a frame cut off by the crash
+        }
+        this->rebuilt_.push_back({record.timestamp, payload, record.size, 0});
+        offset = payload + (record.size + RECORDING_RECORD_ALIGNMENT - 1) /
+                               RECORDING_RECORD_ALIGNMENT *
+                               RECORDING_RECORD_ALIGNMENT;
+    }
+    this->index_ = this->rebuilt_.data();
+    this->count_ = this->rebuilt_.size();
+}
+
+void RecordingReader::close() {
+    this->mapping_.reset();
+    this->format_ = {};
+    this->index_  = nullptr;
+    this->rebuilt_.clear();
+    this->count_ = 0;
+}
+
+bool RecordingReader::isOpen() const { return this->mapping_ != nullptr; }
+
+int64_t RecordingReader::getFirstTimestamp() const {
+    return this->count_ ? this->index_[0].timestamp : 0;
+}
+
+int64_t RecordingReader::getLastTimestamp() const {
+    return this->count_ ? this->index_[this->count_ - 1].timestamp : 0;
+}
+
+int16_t RecordingReader::frameAt(std::size_t index, FrameView& view) const {
+    if (index >= this->count_) {
+        return -404;
+    }
+    const RecordingIndexEntry& entry = this->index_[index];
+    if (entry.offset < sizeof(RecordingFrameHeader) ||
+        entry.offset > this->mapping_->size ||
+        entry.size > this->mapping_->size - entry.offset) {
+        return -400;
+    }
+
+    RecordingFrameHeader record;
+    std::memcpy(&record,
+                this->mapping_->data + entry.offset - sizeof(RecordingFrameHeader),
+                sizeof(record));
+
+    view.data      = this->mapping_->data + entry.offset;
+    view.size      = entry.size;
+    view.timestamp = entry.timestamp;
+    view.sequence  = record.sequence;
+    view.index     = index;
+    return 0;
+}
+
+int16_t RecordingReader::frameAt(std::size_t index, Frame& frame) const {
+    FrameView view;
+    int16_t   result = this->frameAt(index, view);
+    if (result != 0) {
+        return result;
+    }
+    frame.buffer    = FrameBufferRef::wrap(const_cast<uint8_t*>(view.data),
+                                           view.size, this->mapping_);
+    frame.format    = this->format_;
+    frame.timestamp = view.timestamp;
+    frame.sequence  = view.sequence;
+    return 0;
+}
+
+std::size_t RecordingReader::indexAt(int64_t timestamp) const {
+    const RecordingIndexEntry* end   = this->index_ + this->count_;
+    const RecordingIndexEntry* after = std::upper_bound(
+        this->index_, end, timestamp,
+        [](int64_t value, const RecordingIndexEntry& entry) {
+            return value < entry.timestamp;
+        });
+    return after == this->index_ ? 0
+                                 : static_cast<std::size_t>(after - this->index_) - 1;
+}
+
+RecordingReader::Range RecordingReader::frames(std::size_t begin,
+                                               std::size_t end,
+                                               std::size_t stride) const {
+    end = std::min(end, this->count_);
+    begin = std::min(begin, end);
+    stride = std::max<std::size_t>(stride, 1);
+    return {Iterator(this, begin, end, stride), Iterator(this, end, end, stride)};
+}
+
+void RecordingReader::setAccessPattern(AccessPattern pattern) {
+#ifndef _WIN32
+    if (!this->mapping_) {
+        return;
+    }
+    int advice = MADV_NORMAL;
+    if (pattern == AccessPattern::Sequential) {
+        advice = MADV_SEQUENTIAL;
+    } else if (pattern == AccessPattern::Random) {
+        advice = MADV_RANDOM;
+    }
+    madvise(this->mapping_->data, this->mapping_->size, advice);
+#else
+    (void)pattern; // Windows has no per-mapping hint, `prefetch` still works
+#endif
+}
+
+void RecordingReader::prefetch(std::size_t index, std::size_t count,
+                               std::size_t stride) const {
+    if (!this->mapping_ || index >= this->count_ || count == 0) {
+        return;
+    }
+    stride = std::max<std::size_t>(stride, 1);
+    const std::size_t last =
+        std::min(this->count_ - 1, index + (count - 1) * stride);
+
+    if (stride == 1) {
+        // One contiguous range from the first frame header to the last payload
+        const RecordingIndexEntry& first = this->index_[index];
+        const RecordingIndexEntry& end   = this->index_[last];
+        const std::size_t begin = first.offset - sizeof(RecordingFrameHeader);
+        this->mapping_->advise(begin, end.offset + end.size - begin);
+        return;
+    }
+    for (std::size_t i = index; i <= last; i += stride) {
+        this->mapping_->advise(this->index_[i].offset, this->index_[i].size);
+    }
+}
@@ -0,0 +1,155 @@
+#ifndef RECORDING_READER_H
+#define RECORDING_READER_H
+
+#include "recording.h"
+#include <filesystem>
+#include <iterator>
+#include <memory>
+#include <vector>
+
+/**
+ * @brief Non-owning view of one recorded frame inside the mapping.
+ */
+struct FrameView {
+    const uint8_t* data{nullptr};
+    std::size_t    size{};
+    int64_t        timestamp{};
+    uint64_t       sequence{};
+    std::size_t    index{}; // Position in the recording
+};
+
+/**
+ * @brief Paging hint for the whole mapping.
+ */
+enum class AccessPattern { Normal, Sequential, Random };
+
+/**
+ * @brief Random access to a recording through a memory mapping.
+ *
+ * Opening reads the header and points at the index at the end of the file,
+ * so it costs the same for any length of recording. Recordings that were
+ * never closed have no index; their frame records are walked once instead.
+ *
+ * Views point straight into the mapping. The mapping is copy-on-write, so
+ * frames handed out through `frameAt(index, Frame&)` can be modified by
+ * consumers without touching the file.
+ */
+class RecordingReader {
+  private:
+    struct Mapping;
+
+    std::shared_ptr<Mapping>         mapping_{};
+    MediaFormat                      format_{};
+    const RecordingIndexEntry*       index_{nullptr}; // Into the mapping or
+    std::vector<RecordingIndexEntry> rebuilt_{};      // the rebuilt index
+    std::size_t                      count_{};
+
+    void rebuildIndex(uint64_t first_record);
+
+  public:
+    /**
+     * @brief Walks a `Range`. Advancing past its last frame stops at the end
+     * of the range, so iterators compare equal exactly when they point at
+     * the same frame.
+     */
+    class Iterator {
+      private:
+        const RecordingReader* reader_{nullptr};
+        std::size_t            index_{};
+        std::size_t            end_{};
+        std::size_t            stride_{1};
+
+      public:
+        using iterator_category = std::input_iterator_tag;
+        using value_type        = FrameView;
+        using difference_type   = std::ptrdiff_t;
+        using pointer           = const FrameView*;
+        using reference         = FrameView;
+
+        Iterator() = default;
+        Iterator(const RecordingReader* reader, std::size_t index,
+                 std::size_t end, std::size_t stride)
+            : reader_(reader), index_(index), end_(end), stride_(stride) {}
+
+        FrameView operator*() const;
+        Iterator& operator++() {
+            this->index_ = this->end_ - this->index_ > this->stride_
+                               ? this->index_ + this->stride_
+                               : this->end_;
+            return *this;
+        }
+        bool operator==(const Iterator& other) const {
+            return this->reader_ == other.reader_ && this->index_ == other.index_;
+        }
+        bool operator!=(const Iterator& other) const {
+            return !(*this == other);
+        }
+    };
+
+    /**
+     * @brief Frames `begin`, `begin + stride`, ... before `end`, for use in a
+     * range-based for loop.
+     */
+    struct Range {
+        Iterator first;
+        Iterator last;
+
+        Iterator begin() const { return this->first; }
+        Iterator end() const { return this->last; }
+    };
+
+    RecordingReader() = default;
+    RecordingReader(const RecordingReader&) = delete;
+    ~RecordingReader();
+
+    RecordingReader& operator=(const RecordingReader&) = delete;
+
+    /**
+     * @return 0 on success, -404 if the file cannot be opened, -400 if it is
+     * not a recording.
+     */
+    int16_t open(const std::filesystem::path& path);
+    void    close();
+    bool    isOpen() const;
+
+    const MediaFormat& getFormat() const { return this->format_; }
+    std::size_t        getFrameCount() const { return this->count_; }
+    int64_t            getFirstTimestamp() const;
+    int64_t            getLastTimestamp() const;
+
+    /**
+     * @return 0 on success, -404 if `index` is out of range, -400 if the index
+     * points outside the file.
+     */
+    int16_t frameAt(std::size_t index, FrameView& view) const;
+
+    /**
+     * @brief The frame as an owning `Frame` sharing the mapping, no copy.
+     * @return See `frameAt`.
+     */
+    int16_t frameAt(std::size_t index, Frame& frame) const;
+
+    /**
+     * @brief Index of the frame on screen at `timestamp`: the last one that
+     * started at or before it, or the first frame for earlier times.
+     */
+    std::size_t indexAt(int64_t timestamp) const;
+
+    int16_t frameAtTime(int64_t timestamp, FrameView& view) const {
+        return this->frameAt(this->indexAt(timestamp), view);
+    }
+
+    Range frames(std::size_t begin = 0, std::size_t end = SIZE_MAX,
+                 std::size_t stride = 1) const;
+
+    void setAccessPattern(AccessPattern pattern);
+
+    /**
+     * @brief Ask the OS to start reading `count` frames from `index` on,
+     * every `stride`-th one, in the background.
+     */
+    void prefetch(std::size_t index, std::size_t count,
+                  std::size_t stride = 1) const;
+};
+
+#endif // RECORDING_READER_H
@@ -0,0 +1,117 @@
+#include "recording_source.h"
+
+namespace {
+
+// Frames asked from the OS ahead of playback
+constexpr std::size_t READAHEAD_FRAMES = 32;
+
+} // namespace
+
+RecordingSource::RecordingSource(const std::filesystem::path& path,
+                                 SourcePacing pacing, bool loop)
+    : path_(path), pacing_(pacing), loop_(loop) {
+    if (this->reader_.open(path) == 0) {
+        this->media_formats_.push_back(this->reader_.getFormat());
+    }
+}
+
+std::wstring RecordingSource::getName() const {
+    return this->path_.filename().wstring();
+}
+
+const std::vector<MediaFormat>& RecordingSource::getMediaFormats() const {
+    return this->media_formats_;
+}
+
+bool RecordingSource::isOpen() const { return this->open_; }
+
+int16_t RecordingSource::open(std::size_t index) {
+    if (this->open_) {
+        return 304;
+    }
+    if (index >= this->media_formats_.size()) {
+        return -400;
+    }
+
+    this->reader_.setAccessPattern(AccessPattern::Sequential);
+    this->pacer_            = FramePacer(this->pacing_, this->media_formats_[0]);
+    this->position_         = 0;
+    this->prefetched_from_  = 0;
+    this->prefetched_until_ = 0;
+    this->loop_offset_      = 0;
+    this->open_             = true;
+    return 0;
+}
+
+int16_t RecordingSource::close() {
+    if (!this->open_) {
+        return 304;
+    }
+    this->reader_.setAccessPattern(AccessPattern::Normal);
+    this->open_ = false;
+    return 0;
+}
+
+int16_t RecordingSource::readFrame(Frame& frame) {
+    if (!this->open_) {
+        return -409;
+    }
+
+    const std::size_t count    = this->reader_.getFrameCount();
+    const std::size_t stride   = this->stride_.load();
+    std::size_t       position = this->position_.load();
+    if (position >= count) {
+        if (!this->loop_ || count == 0) {
+            return -410;
+        }
+        // Keep timestamps increasing across loops
+        const MediaFormat& format = this->media_formats_[0];
+        int64_t period = format.fps_numerator
+                             ? 10000000LL * format.fps_denominator /
+                                   format.fps_numerator
+                             : 0;
+        this->loop_offset_ += this->reader_.getLastTimestamp() -
+                              this->reader_.getFirstTimestamp() + period;
+        this->position_.compare_exchange_strong(position, 0);
+        position = this->position_.load();
+    }
+
+    if (position < this->prefetched_from_ ||
+        position + READAHEAD_FRAMES / 2 * stride >= this->prefetched_until_) {
+        this->reader_.prefetch(position, READAHEAD_FRAMES, stride);
+        this->prefetched_from_  = position;
+        this->prefetched_until_ = position + READAHEAD_FRAMES * stride;
+    }
+
+    this->pacer_.wait();
+    int16_t result = this->reader_.frameAt(position, frame);
+    if (result != 0) {
+        return result;
+    }
+    frame.timestamp += this->loop_offset_;
+    frame.sequence = this->pacer_.sequence();
+    this->pacer_.advance();
+
+    // Leaves a concurrent `seek` in place
+    this->position_.compare_exchange_strong(position, position + stride);
+    return 0;
+}
+
+int16_t RecordingSource::seek(std::size_t index) {
+    if (index >= this->reader_.getFrameCount()) {
+        return -404;
+    }
+    this->position_ = index;
+    return 0;
+}
+
+int16_t RecordingSource::seekTime(int64_t timestamp) {
+    if (this->reader_.getFrameCount() == 0) {
+        return -404;
+    }
+    return this->seek(this->reader_.indexAt(timestamp));
+}
+
+void RecordingSource::setStride(std::size_t stride) {
+    this->stride_ = stride ? stride : 1;
+}
@@ -0,0 +1,69 @@
+#ifndef RECORDING_SOURCE_H
+#define RECORDING_SOURCE_H
+
+#include "capture_source.h"
+#include "recording_reader.h"
+#include <atomic>
+
+/**
+ * @brief Plays back a recording written by `Recorder`.
+ *
+ * Frames share the reader's mapping instead of being copied, and keep the
+ * timestamps they were recorded with. Unthrottled playback is bounded by how
+ * fast the consumer takes frames, which makes offline analysis of a
+ * recording much faster than real time. `seek` and `setStride` may be called
+ * from any thread while the source is open.
+ */
+class RecordingSource : public CaptureSource {
+  private:
+    std::filesystem::path    path_{};
+    RecordingReader          reader_{};
+    std::vector<MediaFormat> media_formats_{};
+    SourcePacing             pacing_{SourcePacing::Native};
+    bool                     loop_{false};
+
+    FramePacer               pacer_{};
+    std::atomic<std::size_t> position_{};
+    std::atomic<std::size_t> stride_{1};
+    std::size_t              prefetched_from_{};
+    std::size_t              prefetched_until_{};
+    int64_t                  loop_offset_{}; // Added to timestamps after a loop
+    bool                     open_{false};
+
+  public:
+    /**
+     * @brief Maps the recording right away so its media type is known before
+     * `open`. A file that is not a recording advertises no media types.
+     */
+    explicit RecordingSource(const std::filesystem::path& path,
+                             SourcePacing pacing = SourcePacing::Native,
+                             bool         loop   = false);
+
+    std::wstring                    getName() const override;
+    const std::vector<MediaFormat>& getMediaFormats() const override;
+    bool                            isOpen() const override;
+
+    int16_t open(std::size_t index) override;
+    int16_t close() override;
+    int16_t readFrame(Frame& frame) override;
+
+    const RecordingReader& getReader() const { return this->reader_; }
+
+    /**
+     * @brief Continue playback from the frame at `index`.
+     * @return 0 on success, -404 if `index` is past the end.
+     */
+    int16_t seek(std::size_t index);
+
+    /**
+     * @brief Continue playback from the frame on screen at `timestamp`.
+     */
+    int16_t seekTime(int64_t timestamp);
+
+    /**
+     * @brief Deliver every `stride`-th frame, 1 for all of them.
+     */
+    void setStride(std::size_t stride);
+};
+
+#endif // RECORDING_SOURCE_H
@@ -0,0 +1,186 @@
+#include "region_of_interest.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+constexpr std::size_t MAX_CACHED_MASKS = 8; // Frame sizes and grids per region
+
+/**
+ * @brief First pixel whose centre is at or right of `edge`, a fraction of
+ * `size`.
+ */
+uint32_t firstPixel(double edge, uint32_t size) {
+    const double pixel = std::ceil(edge * size - 0.5);
+    return static_cast<uint32_t>(std::clamp<double>(pixel, 0.0, size));
+}
+
+/**
+ * @brief Append the pixels of row `y` inside `shape` to `spans`, unsorted.
+ *
+ * Edges are half-open in y, so a vertex on the scanline is counted once and
+ * the spans of a row come in pairs of crossings.
+ */
+void rasterizeRow(const std::vector<RoiPoint>& shape, uint32_t width,
+                  double y, std::vector<double>& crossings,
+                  std::vector<RoiSpan>& spans) {
+    crossings.clear();
+    for (std::size_t i = 0, j = shape.size() - 1; i < shape.size(); j = i++) {
+        const RoiPoint& a = shape[j];
+        const RoiPoint& b = shape[i];
+        if ((a.y <= y) != (b.y <= y)) {
+            crossings.push_back(a.x + (y - a.y) / (b.y - a.y) * (b.x - a.x));
+        }
+    }
+    std::sort(crossings.begin(), crossings.end());
+    for (std::size_t i = 0; i + 1 < crossings.size(); i += 2) {
+        const uint32_t begin = firstPixel(crossings[i], width);
+        const uint32_t end   = firstPixel(crossings[i + 1], width);
+        if (begin < end) {
+            spans.push_back({begin, end});
+        }
+    }
+}
+
+std::shared_ptr<const RoiMask>
+rasterize(const std::vector<std::vector<RoiPoint>>& shapes, uint32_t width,
+          uint32_t height, uint32_t tile_size) {
+    auto mask       = std::make_shared<RoiMask>();
+    mask->width     = width;
+    mask->height    = height;
+    mask->tile_size = tile_size;
+    mask->tiles_x   = (width + tile_size - 1) / tile_size;
+    mask->tiles_y   = (height + tile_size - 1) / tile_size;
+    mask->row_start.reserve(static_cast<std::size_t>(height) + 1);
+
+    // Spans of every row, the union of all shapes
+    std::vector<double>  crossings;
+    std::vector<RoiSpan> row;
+    uint32_t             left = width, right = 0, top = height, bottom = 0;
+    for (uint32_t y = 0; y < height; ++y) {
+        mask->row_start.push_back(static_cast<uint32_t>(mask->spans.size()));
+        const double centre = (y + 0.5) / height;
+        row.clear();
+        for (const std::vector<RoiPoint>& shape : shapes) {
+            rasterizeRow(shape, width, centre, crossings, row);
+        }
+        std::sort(row.begin(), row.end(), [](const RoiSpan& a, const RoiSpan& b) {
+            return a.begin < b.begin;
+        });
+        const std::size_t first = mask->spans.size();
+        for (const RoiSpan& span : row) {
+            if (mask->spans.size() > first && span.begin <= mask->spans.back().end) {
+                mask->spans.back().end = std::max(mask->spans.back().end, span.end);
+            } else {
+                mask->spans.push_back(span);
+            }
+        }
+        for (std::size_t i = first; i < mask->spans.size(); ++i) {
+            mask->pixels += mask->spans[i].end - mask->spans[i].begin;
+        }
+        if (mask->spans.size() > first) {
+            left   = std::min(left, mask->spans[first].begin);
+            right  = std::max(right, mask->spans.back().end);
+            top    = std::min(top, y);
+            bottom = y + 1;
+        }
+    }
+    mask->row_start.push_back(static_cast<uint32_t>(mask->spans.size()));
+    if (mask->pixels > 0) {
+        mask->left = left, mask->top = top;
+        mask->right = right, mask->bottom = bottom;
+    }
+
+    // Pixels inside each tile decide its coverage
+    std::vector<uint32_t> inside(static_cast<std::size_t>(mask->tiles_x) * mask->tiles_y);
+    for (uint32_t y = 0; y < height; ++y) {
+        uint32_t* counts = inside.data() + static_cast<std::size_t>(y / tile_size) * mask->tiles_x;
+        for (uint32_t i = mask->row_start[y]; i < mask->row_start[y + 1]; ++i) {
+            const RoiSpan& span = mask->spans[i];
+            for (uint32_t tx = span.begin / tile_size; tx * tile_size < span.end; ++tx) {
+                const uint32_t begin = std::max(span.begin, tx * tile_size);
+                const uint32_t end   = std::min(span.end, (tx + 1) * tile_size);
+                counts[tx] += end - begin;
+            }
+        }
+    }
+    mask->tiles.resize(inside.size());
+    mask->tile_row_start.reserve(static_cast<std::size_t>(mask->tiles_y) + 1);
+    for (uint32_t ty = 0; ty < mask->tiles_y; ++ty) {
+        mask->tile_row_start.push_back(static_cast<uint32_t>(mask->tile_runs.size()));
+        const uint32_t rows = std::min(height - ty * tile_size, tile_size);
+        bool           open = false;
+        for (uint32_t tx = 0; tx < mask->tiles_x; ++tx) {
+            const std::size_t tile    = static_cast<std::size_t>(ty) * mask->tiles_x + tx;
+            const uint32_t    columns = std::min(width - tx * tile_size, tile_size);
+            RoiCoverage       coverage = RoiCoverage::Partial;
+            if (inside[tile] == 0) {
+                coverage = RoiCoverage::Outside;
+            } else if (inside[tile] == columns * rows) {
+                coverage = RoiCoverage::Inside;
+            }
+            mask->tiles[tile] = coverage;
+
+            if (coverage == RoiCoverage::Outside) {
+                open = false;
+                continue;
+            }
+            ++mask->covered_tiles;
+            if (open) {
+                mask->tile_runs.back().end = tx + 1;
+            } else {
+                mask->tile_runs.push_back({tx, tx + 1});
+                open = true;
+            }
+        }
+    }
+    mask->tile_row_start.push_back(static_cast<uint32_t>(mask->tile_runs.size()));
+    return mask;
+}
+
+} // namespace
+
+RegionOfInterest::RegionOfInterest(const RegionOfInterest& other)
+    : shapes_(other.shapes_) {}
+
+int16_t RegionOfInterest::addRectangle(float left, float top, float right,
+                                       float bottom) {
+    if (!(left < right) || !(top < bottom)) {
+        return -400;
+    }
+    return this->addPolygon(
+        {{left, top}, {right, top}, {right, bottom}, {left, bottom}});
+}
+
+int16_t RegionOfInterest::addPolygon(const std::vector<RoiPoint>& points) {
+    if (points.size() < 3) {
+        return -400;
+    }
+    std::lock_guard<std::mutex> lock(this->mutex_);
+    this->shapes_.push_back(points);
+    this->masks_.clear();
+    return 0;
+}
+
+std::shared_ptr<const RoiMask> RegionOfInterest::getMask(uint32_t width,
+                                                         uint32_t height,
+                                                         uint32_t tile_size) const {
+    if (width == 0 || height == 0 || tile_size == 0) {
+        return nullptr;
+    }
+    std::lock_guard<std::mutex> lock(this->mutex_);
+    for (const std::shared_ptr<const RoiMask>& mask : this->masks_) {
+        if (mask->width == width && mask->height == height &&
+            mask->tile_size == tile_size) {
+            return mask;
+        }
+    }
+
+    auto mask = rasterize(this->shapes_, width, height, tile_size);
+    if (this->masks_.size() == MAX_CACHED_MASKS) {
+        this->masks_.erase(this->masks_.begin());
+    }
+    this->masks_.push_back(mask);
+    return mask;
+}
@@ -0,0 +1,129 @@
+#ifndef REGION_OF_INTEREST_H
+#define REGION_OF_INTEREST_H
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+constexpr uint32_t ROI_TILE_SIZE = 16; // Default tile edge of `RoiMask`
+
+/**
+ * @brief Point of an ROI shape, as a fraction of the frame's width and
+ * height, so one region fits every media type of a camera.
+ */
+struct RoiPoint {
+    float x{};
+    float y{};
+};
+
+/**
+ * @brief How much of a tile a region covers.
+ */
+enum class RoiCoverage : uint8_t {
+    Outside, // No pixel of the tile is in the region
+    Partial, // Some are, see the row spans
+    Inside   // All are
+};
+
+/**
+ * @brief Pixels `[begin, end)` of one row.
+ */
+struct RoiSpan {
+    uint32_t begin{};
+    uint32_t end{};
+};
+
+/**
+ * @brief A region rasterized for one frame size.
+ *
+ * Pixels are in the region when their centre is. Each row lists the spans of
+ * pixels inside, sorted and disjoint, and each row of tiles lists the runs of
+ * consecutive tiles that are not `Outside`, so stages visit only the tiles
+ * they need and clip partial ones with the spans.
+ */
+struct RoiMask {
+    uint32_t width{};
+    uint32_t height{};
+    uint32_t tile_size{};
+    uint32_t tiles_x{};
+    uint32_t tiles_y{};
+
+    std::vector<RoiCoverage> tiles{};          // Row-major, `tiles_x * tiles_y`
+    std::vector<RoiSpan>     tile_runs{};      // Tile columns, not pixels
+    std::vector<uint32_t>    tile_row_start{}; // First run of each tile row,
+                                               // and the end
+    std::vector<RoiSpan>     spans{};
+    std::vector<uint32_t>    row_start{};      // First span of each row, and
+                                               // the end
+
+    uint32_t left{}; // Bounding box of the pixels inside, exclusive right
+    uint32_t top{};  // and bottom, all 0 for an empty region
+    uint32_t right{};
+    uint32_t bottom{};
+    uint64_t pixels{};        // Pixels inside
+    uint64_t covered_tiles{}; // Tiles that are not `Outside`
+
+    /**
+     * @brief Fraction of the frame's pixels inside the region.
+     */
+    double coverage() const {
+        const double total = static_cast<double>(this->width) * this->height;
+        return total > 0 ? static_cast<double>(this->pixels) / total : 0.0;
+    }
+
+    RoiCoverage tile(uint32_t tx, uint32_t ty) const {
+        return this->tiles[static_cast<std::size_t>(ty) * this->tiles_x + tx];
+    }
+};
+
+/**
+ * @brief Parts of a camera's view that the processing stages look at: the
+ * union of rectangles and polygons.
+ *
+ * Attached to a `Webcam` and shared by every frame it captures, see
+ * `Frame::roi`. Stages ask for the mask of their frame size and tile grid;
+ * masks are rasterized on the first request and cached, so the steady state
+ * costs a lookup. Shapes must be added before the region is shared, masks
+ * may be requested from any thread.
+ */
+class RegionOfInterest {
+  private:
+    std::vector<std::vector<RoiPoint>> shapes_{}; // Closed polygons
+
+    mutable std::mutex                                 mutex_{};
+    mutable std::vector<std::shared_ptr<const RoiMask>> masks_{};
+
+  public:
+    RegionOfInterest() = default;
+    RegionOfInterest(const RegionOfInterest& other);
+
+    RegionOfInterest& operator=(const RegionOfInterest&) = delete;
+
+    /**
+     * @brief Add the rectangle from `left`, `top` to `right`, `bottom`, right
+     * and bottom exclusive.
+     * @return 0 on success, -400 if it is empty.
+     */
+    int16_t addRectangle(float left, float top, float right, float bottom);
+
+    /**
+     * @brief Add a polygon, closed from the last point back to the first.
+     * Self-intersecting polygons use the even-odd rule.
+     * @return 0 on success, -400 for fewer than three points.
+     */
+    int16_t addPolygon(const std::vector<RoiPoint>& points);
+
+    bool empty() const { return this->shapes_.empty(); }
+
+    /**
+     * @brief The region rasterized for `width` x `height` frames and tiles of
+     * `tile_size` pixels.
+     * @return null for an empty frame size or tile size.
+     */
+    std::shared_ptr<const RoiMask>
+    getMask(uint32_t width, uint32_t height,
+            uint32_t tile_size = ROI_TILE_SIZE) const;
+};
+
+#endif // REGION_OF_INTEREST_H
@@ -0,0 +1,221 @@
+#include "replay_source.h"
+
+#include "pixel_format.h"
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+constexpr std::size_t READ_CHUNK = 256 * 1024;
+
+std::size_t findEoi(const uint8_t* data, std::size_t size, std::size_t from) {
+    for (std::size_t i = from; i + 1 < size; ++i) {
+        if (data[i] == 0xFF && data[i + 1] == 0xD9) {
+            return i + 2;
+        }
+    }
+    return 0;
+}
+
+} // namespace
+
+std::size_t findJpegEnd(const uint8_t* data, std::size_t size) {
+    if (size < 4 || data[0] != 0xFF || data[1] != 0xD8) {
+        return 0;
+    }
+
+    std::size_t i = 2;
+    while (true) {
+        if (i + 1 >= size) {
+            return 0;
+        }
+        if (data[i] != 0xFF) {
+            // Not a well formed segment list, fall back to the first EOI
+            return findEoi(data, size, i);
+        }
+        while (i < size && data[i] == 0xFF) {
+            ++i; // Fill bytes
+        }
+        if (i >= size) {
+            return 0;
+        }
+        uint8_t marker = data[i++];
+        if (marker == 0xD9) {
+            return i;
+        }
+        if (marker == 0x01 || (marker >= 0xD0 && marker <= 0xD7)) {
+            continue; // Standalone markers carry no length
+        }
+        if (i + 2 > size) {
+            return 0;
+        }
+        std::size_t length = (static_cast<std::size_t>(data[i]) << 8) | data[i + 1];
+        if (length < 2) {
+            return findEoi(data, size, i);
+        }
+        i += length;
+        if (marker != 0xDA) {
+            continue;
+        }
+        // Entropy coded data runs until the next marker that is neither a
+        // stuffed 0xFF00 nor a restart marker
+        while (true) {
+            if (i + 1 >= size) {
+                return 0;
+            }
+            uint8_t next = data[i + 1];
+            if (data[i] == 0xFF && next != 0x00 &&
+                !(next >= 0xD0 && next <= 0xD7)) {
+                break;
+            }
+            ++i;
+        }
+    }
+}
+
+ReplaySource::ReplaySource(const std::filesystem::path& path,
+                           const MediaFormat& format, SourcePacing pacing,
+                           bool loop)
+    : path_(path), media_formats_{format}, pacing_(pacing), loop_(loop) {}
+
+std::wstring ReplaySource::getName() const {
+    return this->path_.filename().wstring();
+}
+
+const std::vector<MediaFormat>& ReplaySource::getMediaFormats() const {
+    return this->media_formats_;
+}
+
+bool ReplaySource::isOpen() const { return this->open_; }
+
+int16_t ReplaySource::open(std::size_t index) {
+    if (this->open_) {
+        return 304;
+    }
+    const MediaFormat& format = this->media_formats_.front();
+    if (index != 0 ||
+        (pixelDecoder(format.subtype) != PixelDecoder::Mjpeg &&
+         rawFrameSize(format) == 0)) {
+        return -400;
+    }
+
+    this->file_.open(this->path_, std::ios::in | std::ios::binary);
+    if (!this->file_) {
+        return -404;
+    }
+    this->pending_.clear();
+    this->pending_pos_         = 0;
+    this->frames_since_rewind_ = 0;
+    this->pacer_               = FramePacer(this->pacing_, format);
+    this->open_                = true;
+    return 0;
+}
+
+int16_t ReplaySource::close() {
+    if (!this->open_) {
+        return 304;
+    }
+    this->file_.close();
+    this->pending_.clear();
+    this->pending_.shrink_to_fit();
+    this->open_ = false;
+    return 0;
+}
+
+int16_t ReplaySource::readFrame(Frame& frame) {
+    if (!this->open_) {
+        return -409;
+    }
+
+    this->pacer_.wait();
+    const bool jpeg = pixelDecoder(this->media_formats_.front().subtype) ==
+                      PixelDecoder::Mjpeg;
+    int16_t result = jpeg ? this->readJpeg(frame) : this->readRaw(frame);
+    if (result != 0) {
+        return result;
+    }
+
+    frame.format    = this->media_formats_.front();
+    frame.timestamp = this->pacer_.timestamp();
+    frame.sequence  = this->pacer_.sequence();
+    this->pacer_.advance();
+    ++this->frames_since_rewind_;
+    return 0;
+}
+
+bool ReplaySource::rewind() {
+    // A file without a single complete frame would otherwise loop forever
+    if (!this->loop_ || this->frames_since_rewind_ == 0) {
+        return false;
+    }
+    this->file_.clear();
+    this->file_.seekg(0);
+    this->pending_.clear();
+    this->pending_pos_         = 0;
+    this->frames_since_rewind_ = 0;
+    return true;
+}
+
+int16_t ReplaySource::readRaw(Frame& frame) {
+    const std::size_t size = rawFrameSize(this->media_formats_.front());
+    frame.buffer           = this->acquireBuffer(size);
+
+    while (true) {
+        this->file_.read(reinterpret_cast<char*>(frame.buffer.data()), size);
+        if (static_cast<std::size_t>(this->file_.gcount()) == size) {
+            return 0;
+        }
+        if (!this->rewind()) {
+            return -410;
+        }
+    }
+}
+
+int16_t ReplaySource::readJpeg(Frame& frame) {
+    while (true) {
+        const uint8_t*    begin = this->pending_.data() + this->pending_pos_;
+        const std::size_t avail = this->pending_.size() - this->pending_pos_;
+
+        std::size_t soi = avail;
+        for (std::size_t i = 0; i + 1 < avail; ++i) {
+            if (begin[i] == 0xFF && begin[i + 1] == 0xD8) {
+                soi = i;
+                break;
+            }
+        }
+
+        if (soi != avail) {
+            std::size_t end = findJpegEnd(begin + soi, avail - soi);
+            if (end) {
+                frame.buffer = this->acquireBuffer(end);
+                std::memcpy(frame.buffer.data(), begin + soi, end);
+                this->pending_pos_ += soi + end;
+                return 0;
+            }
+            this->pending_pos_ += soi; // Drop bytes before the SOI
+        } else if (avail > 1) {
+            // Keep the last byte, it may be the first half of an SOI
+            this->pending_pos_ = this->pending_.size() - 1;
+        }
+
+        if (!this->fillPending() && !this->rewind()) {
+            return -410;
+        }
+    }
+}
+
+bool ReplaySource::fillPending() {
+    this->pending_.erase(this->pending_.begin(),
+                         this->pending_.begin() + this->pending_pos_);
+    this->pending_pos_ = 0;
+
+    // Grow geometrically so a large image is not rescanned many times
+    const std::size_t old_size = this->pending_.size();
+    const std::size_t chunk    = std::max(READ_CHUNK, old_size);
+    this->pending_.resize(old_size + chunk);
+    this->file_.read(reinterpret_cast<char*>(this->pending_.data() + old_size),
+                     chunk);
+    const std::size_t read = static_cast<std::size_t>(this->file_.gcount());
+    this->pending_.resize(old_size + read);
+    return read > 0;
+}
@@ -0,0 +1,57 @@
+#ifndef REPLAY_SOURCE_H
+#define REPLAY_SOURCE_H
+
+#include "capture_source.h"
+#include <filesystem>
+#include <fstream>
+
+/**
+ * @brief Replays a recorded elementary stream from disk.
+ *
+ * Raw YUY2/UYVY/NV12/I420/YV12 files are read as back-to-back frames of
+ * `rawFrameSize(format)` bytes. MJPEG files are a concatenation of JPEG images
+ * (what most capture tools write as `.mjpeg`) and are split on their markers.
+ * Timestamps are derived from the frame rate in `format`.
+ */
+class ReplaySource : public CaptureSource {
+  private:
+    std::filesystem::path    path_{};
+    std::vector<MediaFormat> media_formats_{};
+    SourcePacing             pacing_{SourcePacing::Native};
+    bool                     loop_{false};
+
+    std::ifstream        file_{};
+    FramePacer           pacer_{};
+    std::vector<uint8_t> pending_{}; // Buffered MJPEG bytes not yet returned
+    std::size_t          pending_pos_{};
+    std::size_t          frames_since_rewind_{};
+    bool                 open_{false};
+
+    bool    rewind();
+    int16_t readRaw(Frame& frame);
+    int16_t readJpeg(Frame& frame);
+    bool    fillPending();
+
+  public:
+    ReplaySource(const std::filesystem::path& path, const MediaFormat& format,
+                 SourcePacing pacing = SourcePacing::Native, bool loop = false);
+
+    std::wstring                    getName() const override;
+    const std::vector<MediaFormat>& getMediaFormats() const override;
+    bool                            isOpen() const override;
+
+    int16_t open(std::size_t index) override;
+    int16_t close() override;
+    int16_t readFrame(Frame& frame) override;
+};
+
+/**
+ * @brief Find the end of the JPEG image starting at `data`.
+ *
+ * Walks the marker segments so embedded thumbnails do not end the image early.
+ * @return Offset one past the EOI marker, or 0 if `data` does not hold a
+ * complete image.
+ */
+std::size_t findJpegEnd(const uint8_t* data, std::size_t size);
+
+#endif // REPLAY_SOURCE_H
@@ -0,0 +1,198 @@
+#include "synthetic_source.h"
+
+#include "pixel_format.h"
+#include <algorithm>
+
+namespace {
+
+struct Pattern {
+    uint32_t width{};
+    uint32_t height{};
+    uint32_t shift{};
+    uint32_t box_x{};
+    uint32_t box_y{};
+    uint32_t box_size{};
+
+    Pattern(const MediaFormat& format, uint64_t sequence, uint32_t seed)
+        : width(format.width), height(format.height) {
+        this->shift    = static_cast<uint32_t>(sequence + seed);
+        this->box_size = std::max<uint32_t>(std::min(width, height) / 8, 1);
+
+        // Triangle waves so the square bounces between the borders
+        uint32_t range_x = width > box_size ? width - box_size : 1;
+        uint32_t range_y = height > box_size ? height - box_size : 1;
+        uint64_t step_x  = (sequence * 7 + seed) % (2 * range_x);
+        uint64_t step_y  = (sequence * 5 + seed) % (2 * range_y);
+        this->box_x =
+            static_cast<uint32_t>(step_x < range_x ? step_x : 2 * range_x - step_x);
+        this->box_y =
+            static_cast<uint32_t>(step_y < range_y ? step_y : 2 * range_y - step_y);
+    }
+
+    uint8_t luma(uint32_t x, uint32_t y) const {
+        if (x - box_x < box_size && y - box_y < box_size) {
+            return 235;
+        }
+        return static_cast<uint8_t>(16 + (x + y + shift) % 220);
+    }
+
+    // Chroma coordinates are in units of the subsampled plane
+    uint8_t cb(uint32_t cx, uint32_t chroma_width) const {
+        return static_cast<uint8_t>(64 + cx * 128 / std::max(chroma_width, 1u));
+    }
+
+    uint8_t cr(uint32_t cy, uint32_t chroma_height) const {
+        return static_cast<uint8_t>(192 -
+                                    cy * 128 / std::max(chroma_height, 1u));
+    }
+};
+
+void renderPacked(const Pattern& p, const PixelFormatTraits& traits,
+                  uint8_t* data) {
+    const bool        yuyv         = !traits.chroma_first;
+    const uint32_t    chroma_width = (p.width + 1) / 2;
+    const std::size_t stride       = planeStride(traits, 0, p.width);
+    for (uint32_t y = 0; y < p.height; ++y) {
+        uint8_t* row = data + y * stride;
+        for (uint32_t x = 0; x < p.width; x += 2) {
+            uint8_t  y0 = p.luma(x, y);
+            uint8_t  y1 = x + 1 < p.width ? p.luma(x + 1, y) : y0;
+            uint8_t  u  = p.cb(x / 2, chroma_width);
+            uint8_t  v  = p.cr(y, p.height);
+            uint8_t* px = row + x * 2;
+            if (yuyv) {
+                px[0] = y0, px[1] = u, px[2] = y1, px[3] = v;
+            } else {
+                px[0] = u, px[1] = y0, px[2] = v, px[3] = y1;
+            }
+        }
+    }
+}
+
+void renderPlanar(const Pattern& p, const PixelFormatTraits& traits,
+                  uint8_t* data) {
+    const uint32_t chroma_width  = (p.width + 1) / 2;
+    const uint32_t chroma_height = (p.height + 1) / 2;
+
+    uint8_t* luma = data;
+    for (uint32_t y = 0; y < p.height; ++y) {
+        uint8_t* row = luma + static_cast<std::size_t>(y) * p.width;
+        for (uint32_t x = 0; x < p.width; ++x) {
+            row[x] = p.luma(x, y);
+        }
+    }
+
+    uint8_t* chroma = luma + static_cast<std::size_t>(p.width) * p.height;
+    if (traits.conversion == PixelConversion::SemiPlanar420) {
+        for (uint32_t cy = 0; cy < chroma_height; ++cy) {
+            uint8_t* row = chroma + static_cast<std::size_t>(cy) * chroma_width * 2;
+            for (uint32_t cx = 0; cx < chroma_width; ++cx) {
+                row[cx * 2]     = p.cb(cx, chroma_width);
+                row[cx * 2 + 1] = p.cr(cy, chroma_height);
+            }
+        }
+        return;
+    }
+
+    const std::size_t plane_size =
+        static_cast<std::size_t>(chroma_width) * chroma_height;
+    uint8_t* u_plane = chroma;
+    uint8_t* v_plane = chroma + plane_size;
+    if (traits.swap_chroma) {
+        std::swap(u_plane, v_plane);
+    }
+    for (uint32_t cy = 0; cy < chroma_height; ++cy) {
+        std::size_t offset = static_cast<std::size_t>(cy) * chroma_width;
+        for (uint32_t cx = 0; cx < chroma_width; ++cx) {
+            u_plane[offset + cx] = p.cb(cx, chroma_width);
+            v_plane[offset + cx] = p.cr(cy, chroma_height);
+        }
+    }
+}
+
+} // namespace
+
+SyntheticSource::SyntheticSource(std::vector<MediaFormat> formats,
+                                 SourcePacing pacing, uint32_t seed)
+    : media_formats_(std::move(formats)), pacing_(pacing), seed_(seed) {
+    if (this->media_formats_.empty()) {
+        this->media_formats_ = defaultFormats();
+    }
+}
+
+std::vector<MediaFormat> SyntheticSource::defaultFormats() {
+    return {
+        {FOURCC_YUY2, 1920, 1080, 30, 1}, {FOURCC_NV12, 1920, 1080, 30, 1},
+        {FOURCC_YUY2, 1280, 720, 60, 1},  {FOURCC_NV12, 1280, 720, 60, 1},
+        {FOURCC_I420, 640, 480, 30, 1},
+    };
+}
+
+std::wstring SyntheticSource::getName() const {
+    return L"Synthetic " + std::to_wstring(this->seed_);
+}
+
+const std::vector<MediaFormat>& SyntheticSource::getMediaFormats() const {
+    return this->media_formats_;
+}
+
+bool SyntheticSource::isOpen() const { return this->open_; }
+
+int16_t SyntheticSource::open(std::size_t index) {
+    if (this->open_) {
+        return 304;
+    }
+    if (index >= this->media_formats_.size() ||
+        rawFrameSize(this->media_formats_[index]) == 0) {
+        return -400;
+    }
+    this->format_index_ = index;
+    this->pacer_        = FramePacer(this->pacing_, this->media_formats_[index]);
+    this->open_         = true;
+    return 0;
+}
+
+int16_t SyntheticSource::close() {
+    if (!this->open_) {
+        return 304;
+    }
+    this->open_ = false;
+    return 0;
+}
+
+int16_t SyntheticSource::readFrame(Frame& frame) {
+    if (!this->open_) {
+        return -409;
+    }
+    const MediaFormat& format = this->media_formats_[this->format_index_];
+
+    this->pacer_.wait();
+    frame.capture = hostTime100ns();
+    frame.buffer  = this->acquireBuffer(rawFrameSize(format));
+    render(format, this->pacer_.sequence(), this->seed_, frame.buffer.data());
+    frame.format    = format;
+    frame.timestamp = this->pacer_.timestamp();
+    frame.sequence  = this->pacer_.sequence();
+    this->pacer_.advance();
+    return 0;
+}
+
+void SyntheticSource::render(const MediaFormat& format, uint64_t sequence,
+                             uint32_t seed, uint8_t* data) {
+    const PixelFormatTraits* traits = findPixelFormat(format.subtype);
+    if (!traits) {
+        return;
+    }
+    Pattern pattern(format, sequence, seed);
+    switch (traits->conversion) {
+    case PixelConversion::Packed422:
+        renderPacked(pattern, *traits, data);
+        break;
+    case PixelConversion::SemiPlanar420:
+    case PixelConversion::Planar420:
+        renderPlanar(pattern, *traits, data);
+        break;
+    default:
+        break;
+    }
+}
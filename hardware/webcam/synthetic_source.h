@@ -0,0 +1,53 @@
+#ifndef SYNTHETIC_SOURCE_H
+#define SYNTHETIC_SOURCE_H
+
+#include "capture_source.h"
+
+/**
+ * @brief Deterministic test pattern generator.
+ *
+ * Every frame is a pure function of the seed and the frame index: a diagonal
+ * luma gradient scrolling one pixel per frame, a bright square bouncing across
+ * the image and a chroma ramp. Supports the uncompressed YUV subtypes
+ * (YUY2, UYVY, NV12, I420, IYUV, YV12).
+ */
+class SyntheticSource : public CaptureSource {
+  private:
+    std::vector<MediaFormat> media_formats_{};
+    SourcePacing             pacing_{SourcePacing::Native};
+    uint32_t                 seed_{};
+    FramePacer               pacer_{};
+    std::size_t              format_index_{};
+    bool                     open_{false};
+
+  public:
+    /**
+     * @param formats Media types the source advertises. An empty list selects
+     * `defaultFormats()`.
+     * @param pacing Deliver at the media type's rate or as fast as possible.
+     * @param seed Offsets the pattern so several sources differ.
+     */
+    explicit SyntheticSource(std::vector<MediaFormat> formats = {},
+                             SourcePacing pacing = SourcePacing::Native,
+                             uint32_t     seed   = 0);
+
+    static std::vector<MediaFormat> defaultFormats();
+
+    std::wstring                    getName() const override;
+    const std::vector<MediaFormat>& getMediaFormats() const override;
+    bool                            isOpen() const override;
+
+    int16_t open(std::size_t index) override;
+    int16_t close() override;
+    int16_t readFrame(Frame& frame) override;
+
+    /**
+     * @brief Render frame number `sequence` of `format` into `data`.
+     *
+     * `data` must hold `rawFrameSize(format)` bytes.
+     */
+    static void render(const MediaFormat& format, uint64_t sequence,
+                       uint32_t seed, uint8_t* data);
+};
+
+#endif // SYNTHETIC_SOURCE_H
@@ -1,336 +1,150 @@
 #include "webcam.h"
 
-#include <locale.h>
-
-void error(HRESULT hr, const std::wstring& message) {
-    if (FAILED(hr)) {
-        LPWSTR lpMsgBuf;
-        DWORD  bufLen = FormatMessageW(
-            FORMAT_MESSAGE_ALLOCATE_BUFFER | FORMAT_MESSAGE_FROM_SYSTEM |
-                FORMAT_MESSAGE_IGNORE_INSERTS,
-            NULL, hr,
-            MAKELANGID(LANG_ENGLISH, SUBLANG_ENGLISH_US), // English language
-            (LPWSTR)&lpMsgBuf, 0, NULL);
-
-        if (bufLen) {
-            LPCWSTR      lpMsgStr = (LPCWSTR)lpMsgBuf;
-            std::wstring result(lpMsgStr, lpMsgStr + bufLen);
-
-            std::wcerr << message << L" Error: " << hr << L": " << result
-                       << std::endl;
-
-            LocalFree(lpMsgBuf);
-        }
-    }
+#include "pixel_format.h"
+#include <filesystem>
+
+namespace {
+
+void printFormat(const MediaCatalog& catalog, std::size_t index) {
+    const MediaFormat format = catalog.format(index);
+    std::wcout << L"Sub Type: " << fourccToString(format.subtype) << "\n"
+               << L"Resolution: " << format.width << L"x" << format.height
+               << "\n"
+               << L"Frame Rate: " << format.fps_numerator << L"/"
+               << format.fps_denominator << "\n"
+               << L"Bandwidth: " << catalog.bandwidth(index) / 1000
+               << L" kB/s" << std::endl;
 }
 
-Webcam::Webcam(IMFActivate* device, IMFAttributes* config)
-    : device_(device), active_device_(nullptr), source_reader_(nullptr),
-      active_(false), media_types_(), config_(config) {
-    HRESULT hr = S_OK;
-    if (this->device_) {
-        this->device_->AddRef();
-    }
-    if (this->config_) {
-        this->config_->AddRef();
-    }
-    LPWSTR name = nullptr;
-    this->device_->GetAllocatedString(MF_DEVSOURCE_ATTRIBUTE_FRIENDLY_NAME,
-                                      &name, NULL);
-    this->name_ = name;
-    CoTaskMemFree(name);
-
-    hr = this->device_->ActivateObject(IID_PPV_ARGS(&this->active_device_));
-
-    if (SUCCEEDED(hr)) {
-        this->active_device_->AddRef();
-        hr = MFCreateSourceReaderFromMediaSource(
-            this->active_device_, this->config_, &this->source_reader_);
-    }
+/**
+ * @brief Bounding box of `roi` in `format` frames, widened to the chroma
+ * grid, or an empty crop if the format cannot be cut or the whole frame is
+ * needed anyway.
+ */
+RecorderCrop recordingCrop(const RegionOfInterest& roi, const MediaFormat& format) {
+    const PixelFormatTraits* traits = findPixelFormat(format.subtype);
+    auto mask = roi.getMask(format.width, format.height);
+    if (!traits || traits->planes == 0 || !mask || mask->pixels == 0) {
+        return {};
+    }
+    const uint32_t x_step = 1u << traits->chroma_shift_x;
+    const uint32_t y_step = 1u << traits->chroma_shift_y;
+    const uint32_t left   = mask->left / x_step * x_step;
+    const uint32_t top    = mask->top / y_step * y_step;
+    const uint32_t right  = std::min(format.width, (mask->right + x_step - 1) / x_step * x_step);
+    const uint32_t bottom = std::min(format.height, (mask->bottom + y_step - 1) / y_step * y_step);
+    if (right - left == format.width && bottom - top == format.height) {
+        return {};
+    }
+    return {left, top, right - left, bottom - top};
+}
 
-    if (SUCCEEDED(hr)) {
-        this->source_reader_->AddRef();
-        uint32_t      index      = 0;
-        IMFMediaType* media_type = nullptr;
-        while (SUCCEEDED(source_reader_->GetNativeMediaType(
-            (DWORD)MF_SOURCE_READER_FIRST_VIDEO_STREAM, index, &media_type))) {
-            this->media_types_.push_back(media_type);
-            media_type->AddRef();
-            media_type = nullptr;
-            ++index;
-        }
-        std::sort(
-            this->media_types_.begin(), this->media_types_.end(),
-            [](IMFMediaType* a, IMFMediaType* b) {
-                UINT32 widthA, heightA, widthB, heightB;
-                MFGetAttributeSize(a, MF_MT_FRAME_SIZE, &widthA, &heightA);
-                MFGetAttributeSize(b, MF_MT_FRAME_SIZE, &widthB, &heightB);
-
-                GUID encodingA;
-                a->GetGUID(MF_MT_SUBTYPE, &encodingA);
-                GUID encodingB;
-                b->GetGUID(MF_MT_SUBTYPE, &encodingB);
-
-                // If resolutions are not the same, sort by resolution
-                if (widthA * heightA != widthB * heightB) {
-                    return (widthA * heightA) > (widthB * heightB);
-                }
-
-                // If resolutions are the same, MJPEG should come first
-                if (encodingA == MFVideoFormat_MJPG &&
-                    encodingB != MFVideoFormat_MJPG) {
-                    return true;
-                } else if (encodingB == MFVideoFormat_MJPG &&
-                           encodingA != MFVideoFormat_MJPG) {
-                    return false;
-                }
-
-                // If resolutions and encodings are the same, it doesn't matter
-                // which comes first
-                return false;
-            });
-    }
+} // namespace
 
-    if (this->active_device_) {
-        this->active_device_->Shutdown();
-        this->active_device_->Release();
-        this->active_device_ = nullptr;
-    }
-    if (this->source_reader_) {
-        this->source_reader_->Release();
-        this->source_reader_ = nullptr;
+Webcam::Webcam(std::shared_ptr<CaptureSource> source)
+    : source_(std::move(source)) {
+    if (this->source_) {
+        this->name_    = this->source_->getName();
+        this->catalog_ = std::make_unique<const MediaCatalog>(
+            this->source_->getMediaFormats());
     }
-    this->device_->ShutdownObject();
+}
+
+#ifdef _WIN32
+Webcam::Webcam(IMFActivate* device, IMFAttributes* config)
+    : Webcam(std::make_shared<MfCaptureSource>(device, config)) {}
 
-    error(hr, L"unable to initialize webcam");
+IMFActivate* Webcam::getDevice() const {
+    auto* source = dynamic_cast<MfCaptureSource*>(this->source_.get());
+    return source ? source->getDevice() : nullptr;
 }
+#endif
 
-Webcam::Webcam(const Webcam& other)
-    : device_(other.device_), active_device_(other.active_device_),
-      source_reader_(other.source_reader_), config_(other.config_),
-      media_types_(other.media_types_),
-      chosen_media_type_index_(other.chosen_media_type_index_),
-      active_(other.active_), name_(other.name_) {
+bool Webcam::isActive() const {
+    return this->source_ && this->source_->isOpen();
+}
 
-    if (this->device_) {
-        this->device_->AddRef();
-    }
-    if (this->config_) {
-        this->config_->AddRef();
-    }
-    if (this->active_device_) {
-        this->active_device_->AddRef();
-    }
-    if (this->source_reader_) {
-        this->source_reader_->AddRef();
-    }
-    for (auto& media_type : this->media_types_) {
-        media_type->AddRef();
-    }
+const std::wstring& Webcam::getName() const { return this->name_; }
+
+CaptureSource* Webcam::getSource() const { return this->source_.get(); }
+
+void Webcam::setMediaTypeIndex(uint16_t index) {
+    this->chosen_media_type_index_ = index;
 }
 
-Webcam::~Webcam() {
-    this->active_ = false;
-    if (this->source_reader_) {
-        this->source_reader_->Release();
-        this->source_reader_ = nullptr;
-    }
-    if (this->active_device_) {
-        this->active_device_->Shutdown();
-        this->active_device_->Release();
-        this->active_device_ = nullptr;
-    }
-    if (this->config_) {
-        this->config_->Release();
-        this->config_ = nullptr;
-    }
-    if (this->device_) {
-        this->device_->ShutdownObject();
-        this->device_->Release();
-        this->device_ = nullptr;
-    }
-    for (auto media_type : this->media_types_) {
-        media_type->Release();
-        media_type = nullptr;
-    }
-    media_types_.clear();
+void Webcam::setCaptureOptions(const CaptureOptions& options) {
+    this->capture_options_ = options;
 }
 
-Webcam& Webcam::operator=(const Webcam& other) {
-    if (this != &other) {
-        // Release old resources
-        if (this->device_) {
-            this->device_->Release();
-        }
-        if (this->config_) {
-            this->config_->Release();
-        }
-        if (this->active_device_) {
-            this->active_device_->Release();
-        }
-        if (this->source_reader_) {
-            this->source_reader_->Release();
-        }
-        for (auto& media_type : this->media_types_) {
-            if (media_type) {
-                media_type->Release();
-            }
-        }
-
-        // Copy new resources
-        this->device_        = other.device_;
-        this->active_device_ = other.active_device_;
-        this->source_reader_ = other.source_reader_;
-        this->config_        = other.config_;
-        this->media_types_   = other.media_types_; // Still assumes shallow copy
-        this->chosen_media_type_index_ = other.chosen_media_type_index_;
-        this->active_                  = other.active_;
-        this->name_                    = other.name_;
-
-        // Add reference to new resources
-        if (this->device_) {
-            this->device_->AddRef();
-        }
-        if (this->config_) {
-            this->config_->AddRef();
-        }
-        if (this->active_device_) {
-            this->active_device_->AddRef();
-        }
-        if (this->source_reader_) {
-            this->source_reader_->AddRef();
-        }
-        for (auto& media_type : this->media_types_) {
-            media_type->AddRef();
-        }
+void Webcam::setRegionOfInterest(RoiRef roi) {
+    this->roi_ = std::move(roi);
+    if (this->session_) {
+        this->session_->setRegionOfInterest(this->roi_);
     }
-    return *this;
 }
 
-bool Webcam::isActive() const { return this->active_; }
-
-IMFActivate* Webcam::getDevice() const {
-    this->device_->AddRef();
-    return this->device_;
+const std::vector<MediaFormat>& Webcam::getMediaFormats() const {
+    static const std::vector<MediaFormat> empty;
+    return this->source_ ? this->source_->getMediaFormats() : empty;
 }
 
-std::wstring Webcam::getName() const { return this->name_; }
+const MediaCatalog& Webcam::getMediaCatalog() const {
+    static const MediaCatalog empty;
+    return this->catalog_ ? *this->catalog_ : empty;
+}
 
-void Webcam::setMediaTypeIndex(uint16_t index) {
-    this->chosen_media_type_index_ = index;
+int16_t Webcam::selectMediaType(const FormatQuery& query) {
+    std::size_t index  = 0;
+    int16_t     result = this->getMediaCatalog().findBest(query, index);
+    if (result == 0) {
+        this->setMediaTypeIndex(static_cast<uint16_t>(index));
+    }
+    return result;
 }
 
 void Webcam::listMediaTypes() {
-    GUID   majorType = {};
-    GUID   subType   = {};
-    UINT32 width = 0, height = 0;
-    UINT32 numerator = 0, denominator = 0;
-
-    for (auto media_type : this->media_types_) {
-        media_type->GetGUID(MF_MT_MAJOR_TYPE, &majorType);
-        media_type->GetGUID(MF_MT_SUBTYPE, &subType);
-        MFGetAttributeSize(media_type, MF_MT_FRAME_SIZE, &width, &height);
-        MFGetAttributeRatio(media_type, MF_MT_FRAME_RATE, &numerator,
-                            &denominator);
-
-        std::wcout << L"Major Type: " << getGuidName(majorType) << "\n"
-                   << L"Sub Type: " << getGuidName(subType) << "\n"
-                   << L"Resolution: " << width << L"x" << height << "\n"
-                   << L"Frame Rate: " << numerator << L"/" << denominator
-                   << std::endl;
+    const MediaCatalog& catalog = this->getMediaCatalog();
+    for (std::size_t i = 0; i < catalog.size(); ++i) {
+        printFormat(catalog, i);
     }
 }
 
 void Webcam::printMediaType(uint64_t index) {
-    if (index > this->media_types_.size()) {
+    if (index >= this->getMediaCatalog().size()) {
         return;
     }
-
-    GUID   majorType = {};
-    GUID   subType   = {};
-    UINT32 width = 0, height = 0;
-    UINT32 numerator = 0, denominator = 0;
-
-    IMFMediaType* media_type = this->media_types_[index];
-
-    media_type->GetGUID(MF_MT_MAJOR_TYPE, &majorType);
-    media_type->GetGUID(MF_MT_SUBTYPE, &subType);
-    MFGetAttributeSize(media_type, MF_MT_FRAME_SIZE, &width, &height);
-    MFGetAttributeRatio(media_type, MF_MT_FRAME_RATE, &numerator, &denominator);
-
-    std::wcout << L"Major Type: " << getGuidName(majorType) << "\n"
-               << L"Sub Type: " << getGuidName(subType) << "\n"
-               << L"Resolution: " << width << L"x" << height << "\n"
-               << L"Frame Rate: " << numerator << L"/" << denominator
-               << std::endl;
+    printFormat(this->getMediaCatalog(), index);
 }
 
 void Webcam::printSelectedMediaType() {
-    GUID   majorType = {};
-    GUID   subType   = {};
-    UINT32 width = 0, height = 0;
-    UINT32 numerator = 0, denominator = 0;
-
-    IMFMediaType* media_type =
-        this->media_types_[this->chosen_media_type_index_];
-
-    media_type->GetGUID(MF_MT_MAJOR_TYPE, &majorType);
-    media_type->GetGUID(MF_MT_SUBTYPE, &subType);
-    MFGetAttributeSize(media_type, MF_MT_FRAME_SIZE, &width, &height);
-    MFGetAttributeRatio(media_type, MF_MT_FRAME_RATE, &numerator, &denominator);
-
-    std::wcout << L"Major Type: " << getGuidName(majorType) << "\n"
-               << L"Sub Type: " << getGuidName(subType) << "\n"
-               << L"Resolution: " << width << L"x" << height << "\n"
-               << L"Frame Rate: " << numerator << L"/" << denominator
-               << std::endl;
+    this->printMediaType(this->chosen_media_type_index_);
 }
 
 int16_t Webcam::activate() {
-
-    if (this->active_) {
-        return 304;
+    if (!this->source_) {
+        return -409;
     }
-
-    HRESULT hr = S_OK;
-
-    if (this->device_ && !this->active_device_) {
-        hr = this->device_->ActivateObject(IID_PPV_ARGS(&this->active_device_));
-    }
-
-    if (SUCCEEDED(hr)) {
-        this->active_device_->AddRef();
-        hr = MFCreateSourceReaderFromMediaSource(
-            this->active_device_, this->config_, &this->source_reader_);
+    if (this->source_->isOpen()) {
+        return 304;
     }
 
-    if (SUCCEEDED(hr)) {
-        this->source_reader_->AddRef();
-        hr = this->source_reader_->SetCurrentMediaType(
-            (DWORD)MF_SOURCE_READER_FIRST_VIDEO_STREAM, NULL,
-            this->media_types_[this->chosen_media_type_index_]);
-        this->active_ = true;
+    int16_t result = this->source_->open(this->chosen_media_type_index_);
+    if (result != 0) {
+        return result;
     }
 
-    if (FAILED(hr)) {
-        if (this->active_device_) {
-            this->active_device_->Shutdown();
-            this->active_device_ = nullptr;
-        }
-        if (this->source_reader_) {
-            this->source_reader_->Release();
-            this->source_reader_ = nullptr;
-        }
-        error(hr, L"unable to activate webcam " + this->name_);
-    } else {
-        std::wcout << L"Activation succesfull " + this->name_ << std::endl;
-    }
+    this->session_ = std::make_unique<CaptureSession>(
+        this->source_, this->getMediaFormats()[this->chosen_media_type_index_],
+        this->capture_options_);
+    this->session_->setRegionOfInterest(this->roi_);
+    this->session_->start();
 
+    std::wcout << L"Activation succesfull " + this->name_ << std::endl;
     return 0;
 }
 
 int16_t Webcam::activate(uint16_t index) {
-    if (index >= this->media_types_.size()) {
+    if (index >= this->getMediaFormats().size()) {
         return -1; // TODO: temporary error code
     }
     setMediaTypeIndex(index);
@@ -338,101 +152,120 @@ int16_t Webcam::activate(uint16_t index) {
 }
 
 int16_t Webcam::deactivate() {
-    if (!this->active_) {
+    if (!this->isActive()) {
         return 304;
     }
-    this->active_ = false;
-    if (this->active_device_) {
-        this->active_device_->Shutdown();
-        this->active_device_->Release();
-        this->active_device_ = nullptr;
-    }
-    if (this->source_reader_) {
-        this->source_reader_->Release();
-        this->source_reader_ = nullptr;
+    // Stop reading before the source goes away under the capture thread
+    if (this->session_) {
+        this->session_->stop();
     }
-    this->device_->ShutdownObject();
+    this->stopRecording();
+    this->source_->close();
 
     std::wcout << L"Deactivation succesfull " + this->name_ << std::endl;
 
     return 0;
 }
 
-void Webcam::saveFrameAsJPEG(IMFSample* sample, const std::wstring& filePath) {
-    IMFMediaBuffer* buffer    = nullptr;
-    DWORD           maxLength = 0, currentLength = 0;
-    BYTE*           rawBuffer = nullptr;
-
-    // Get the buffer from the sample
-    HRESULT hr = sample->ConvertToContiguousBuffer(&buffer);
-    if (FAILED(hr)) {
-        error(hr, L"ConvertToContiguousBuffer failed");
-        return;
-    }
-
-    // Lock the buffer
-    hr = buffer->Lock(&rawBuffer, &maxLength, &currentLength);
-    if (FAILED(hr)) {
-        error(hr, L"Buffer lock failed");
-        buffer->Release();
-        return;
-    }
-
+void Webcam::saveFrameAsJPEG(const Frame& frame, const std::wstring& filePath) {
     // Write the buffer to file
-    std::ofstream outputFile(filePath, std::ios::out | std::ios::binary);
+    std::ofstream outputFile(std::filesystem::path(filePath),
+                             std::ios::out | std::ios::binary);
 
     std::cout << "outputFile opened" << std::endl;
-    outputFile.write(reinterpret_cast<const char*>(rawBuffer), currentLength);
+    outputFile.write(reinterpret_cast<const char*>(frame.buffer.data()),
+                     frame.buffer.size());
     outputFile.close();
-
-    // Unlock the buffer and release it
-    buffer->Unlock();
-    buffer->Release();
 }
 
 void Webcam::saveFrame(const std::wstring& filePath) {
-    if (!this->active_) {
+    if (!this->isActive()) {
         std::wcerr << L"Webcam is not active. Cannot capture frame."
                    << std::endl;
         return;
     }
 
-    DWORD      streamIndex, flags;
-    LONGLONG   timestamp;
-    IMFSample* sample = nullptr;
+    Frame   frame;
+    int16_t result = this->getFrame(frame);
+    if (result != 0) {
+        std::wcerr << L"getFrame failed: " << result << std::endl;
+        return;
+    }
 
-    HRESULT hr = this->source_reader_->ReadSample(
-        MF_SOURCE_READER_FIRST_VIDEO_STREAM, 0, &streamIndex, &flags,
-        &timestamp, &sample);
+    saveFrameAsJPEG(frame, filePath);
+}
 
-    if (FAILED(hr)) {
-        error(hr, L"ReadSample failed");
-        return;
+int16_t Webcam::tryGetLatest(Frame& frame) {
+    if (!this->isActive() || !this->session_) {
+        return -409;
     }
+    return this->session_->tryGetLatest(frame);
+}
 
-    if (sample) {
-        saveFrameAsJPEG(sample, filePath);
-        sample->Release();
-        return;
+int16_t Webcam::waitNext(Frame& frame, std::chrono::milliseconds timeout) {
+    if (!this->isActive() || !this->session_) {
+        return -409;
     }
-    this->saveFrame(filePath);
-    return;
+    return this->session_->waitNext(frame, timeout);
 }
 
-HRESULT Webcam::getFrame(IMFSample** sample) {
-    HRESULT  hr = S_OK;
-    DWORD    streamIndex, flags;
-    LONGLONG timestamp;
+int16_t Webcam::getFrame(Frame& frame) {
+    int16_t result = 204;
+    while (result == 204) {
+        result = this->waitNext(frame, std::chrono::milliseconds(1000));
+    }
+    return result;
+}
 
-    hr = source_reader_->ReadSample(MF_SOURCE_READER_FIRST_VIDEO_STREAM, 0,
-                                    &streamIndex, &flags, &timestamp, sample);
-    if (FAILED(hr)) {
-        return hr;
+int16_t Webcam::startRecording(const std::filesystem::path& path,
+                               const RecorderOptions&       options) {
+    if (!this->isActive() || !this->session_ || this->isRecording()) {
+        return -409;
     }
 
-    if (flags & MF_SOURCE_READERF_STREAMTICK) {
-        return MF_E_END_OF_STREAM;
+    const MediaFormat& format = this->getMediaFormats()[this->chosen_media_type_index_];
+    RecorderOptions    cropped = options;
+    if (this->roi_ && !cropped.crop.width && !cropped.crop.height) {
+        cropped.crop = recordingCrop(*this->roi_, format);
+    }
+    auto recorder = std::make_shared<Recorder>(path, format, cropped);
+    int16_t result = recorder->open();
+    if (result != 0) {
+        return result;
     }
 
-    return hr;
+    this->recorder_ = recorder;
+    // The recorder's queue and the frame its writer copies hold pool blocks
+    this->session_->setTap(
+        [recorder](const Frame& frame) { recorder->append(frame); },
+        cropped.queue_capacity + 1);
+    return 0;
+}
+
+int16_t Webcam::stopRecording() {
+    if (!this->recorder_) {
+        return 304;
+    }
+    if (this->session_) {
+        this->session_->setTap(nullptr);
+    }
+    int16_t result = this->recorder_->close();
+    this->recorder_.reset();
+    return result;
+}
+
+bool Webcam::isRecording() const {
+    return this->recorder_ && this->recorder_->isOpen();
+}
+
+CaptureStats Webcam::getCaptureStats() const {
+    return this->session_ ? this->session_->getStats() : CaptureStats{};
+}
+
+FramePoolStats Webcam::getFramePoolStats() const {
+    return this->session_ ? this->session_->getPoolStats() : FramePoolStats{};
+}
+
+RecorderStats Webcam::getRecorderStats() const {
+    return this->recorder_ ? this->recorder_->getStats() : RecorderStats{};
 }
@@ -1,47 +1,103 @@
 #ifndef WEBCAM_H
 #define WEBCAM_H
 
-#include "GUID_tools.h"
+#include "capture_session.h"
+#include "capture_source.h"
+#include "media_catalog.h"
+#include "recorder.h"
+#include "region_of_interest.h"
 #include <algorithm>
-#include <comdef.h>
 #include <fstream>
 #include <iostream>
-#include <mfapi.h>
-#include <mferror.h>
-#include <mfidl.h>
-#include <mfreadwrite.h>
+#include <memory>
 #include <string>
 #include <utility>
 #include <vector>
-#include <windows.h>
 
-void error(HRESULT hr, const std::wstring& message = L"");
+#ifdef _WIN32
+#include "mf_capture_source.h"
+#endif
 
+/**
+ * @brief A camera and its capture session.
+ *
+ * Move-only: the webcam owns its source, session and recorder, and passing
+ * it around never touches the device. Share one through a `shared_ptr`, as
+ * `WebcamManager` and `SyncGroup` do.
+ */
 class Webcam {
   private:
-    IMFActivate*               device_{nullptr};
-    IMFMediaSource*            active_device_{nullptr};
-    IMFSourceReader*           source_reader_{nullptr};
-    IMFAttributes*             config_{nullptr};
-    std::vector<IMFMediaType*> media_types_{};
+    std::shared_ptr<CaptureSource>      source_{};   // Shared with the session
+    std::unique_ptr<CaptureSession>     session_{};
+    std::shared_ptr<Recorder>           recorder_{}; // Shared with the tap
+    std::unique_ptr<const MediaCatalog> catalog_{};
+    CaptureOptions                      capture_options_{};
+    RoiRef                              roi_{};
 
     uint16_t     chosen_media_type_index_{};
     std::wstring name_{};
-    bool         active_{false};
 
   public:
     Webcam() = default;
+    explicit Webcam(std::shared_ptr<CaptureSource> source);
+#ifdef _WIN32
     Webcam(IMFActivate* device, IMFAttributes* config = nullptr);
-    Webcam(const Webcam& other);
-    ~Webcam();
+#endif
+    Webcam(Webcam&& other) noexcept = default;
+    Webcam(const Webcam&)           = delete;
+    ~Webcam()                       = default;
 
-    Webcam& operator=(const Webcam& other);
+    Webcam& operator=(Webcam&& other) noexcept = default;
+    Webcam& operator=(const Webcam&)           = delete;
 
-    bool         isActive() const;
+    bool                isActive() const;
+    const std::wstring& getName() const;
+
+    /**
+     * @brief Backend the camera reads from.
+     */
+    CaptureSource* getSource() const;
+
+#ifdef _WIN32
+    /**
+     * @brief Media Foundation activation object of the device.
+     * @return An AddRef'd pointer, or `nullptr` if the webcam is not backed by
+     * a Media Foundation device.
+     */
     IMFActivate* getDevice() const;
-    std::wstring getName() const;
+#endif
+
+    void     setMediaTypeIndex(uint16_t index);
+    uint16_t getMediaTypeIndex() const { return this->chosen_media_type_index_; }
+
+    /**
+     * @brief Ring size and full policy used by the next `activate`.
+     */
+    void setCaptureOptions(const CaptureOptions& options);
+
+    /**
+     * @brief Region the processing stages look at, stamped on every frame
+     * from now on, see `Frame::roi`. Null to process whole frames. Takes
+     * effect immediately on an active webcam; to change the region, build a
+     * new one rather than adding shapes to a shared one.
+     */
+    void setRegionOfInterest(RoiRef roi);
+
+    const RoiRef& getRegionOfInterest() const { return this->roi_; }
+
+    const std::vector<MediaFormat>& getMediaFormats() const;
 
-    void setMediaTypeIndex(uint16_t index);
+    /**
+     * @brief The media types as a catalog, decoded when the webcam was
+     * created.
+     */
+    const MediaCatalog& getMediaCatalog() const;
+
+    /**
+     * @brief Choose the best media type for `query` for the next `activate`.
+     * @return 0 on success, -404 if no media type satisfies it.
+     */
+    int16_t selectMediaType(const FormatQuery& query);
 
     void listMediaTypes();
     void printMediaType(uint64_t index);
@@ -51,10 +107,53 @@ class Webcam {
     int16_t activate(uint16_t index);
     int16_t deactivate();
 
-    void saveFrameAsJPEG(IMFSample* sample, const std::wstring& filePath);
+    void saveFrameAsJPEG(const Frame& frame, const std::wstring& filePath);
     void saveFrame(const std::wstring& filePath);
 
-    HRESULT getFrame(IMFSample** sample);
+    /**
+     * @brief Newest frame the capture thread has queued, never blocks.
+     * @return 0 on success, 204 if no new frame arrived, -410 at the end of
+     * the stream, -409 if the webcam is not active.
+     */
+    int16_t tryGetLatest(Frame& frame);
+
+    /**
+     * @brief Next frame in capture order, waiting up to `timeout`.
+     * @return 0 on success, 204 on timeout, -410 at the end of the stream,
+     * -409 if the webcam is not active.
+     */
+    int16_t waitNext(Frame& frame, std::chrono::milliseconds timeout);
+
+    /**
+     * @brief Next frame in capture order, waiting until one arrives.
+     * @return 0 on success, -410 at the end of the stream, -409 if the webcam
+     * is not active.
+     */
+    int16_t getFrame(Frame& frame);
+
+    /**
+     * @brief Append every captured frame to a recording at `path` until
+     * `stopRecording` or `deactivate`. Frames are written on a background
+     * thread, see `Recorder`. With a region of interest, raw frames are
+     * cropped to its bounding box, widened to the chroma grid, for the whole
+     * recording; compressed frames are written whole.
+     * @return 0 on success, -409 if the webcam is not active or already
+     * recording, otherwise the error of `Recorder::open`.
+     */
+    int16_t startRecording(const std::filesystem::path& path,
+                           const RecorderOptions&       options = {});
+
+    /**
+     * @brief Finish the recording: write what is queued and the index.
+     * @return 0 on success, 304 if not recording, -500 if a write failed.
+     */
+    int16_t stopRecording();
+
+    bool isRecording() const;
+
+    CaptureStats   getCaptureStats() const;
+    FramePoolStats getFramePoolStats() const;
+    RecorderStats  getRecorderStats() const;
 };
 
-#endif // WEBCAM_H
\ No newline at end of file
+#endif // WEBCAM_H
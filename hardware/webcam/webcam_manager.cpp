@@ -1,125 +1,480 @@
 #include "webcam_manager.h"
 
-WebcamManager::WebcamManager() {
+#include <algorithm>
+#include <set>
 
-    this->config_              = nullptr;
-    IMFActivate** devices_temp = nullptr;
-    uint32_t      device_count = 0;
+namespace {
+
+// Probing is bound by the devices, not the CPU; a few threads cover the
+// cameras a machine usually has
+constexpr std::size_t MAX_PROBE_THREADS = 8;
+
+// Oldest events are dropped when nobody reads them
+constexpr std::size_t MAX_DEVICE_EVENTS = 256;
+
+double millisecondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(
+               std::chrono::steady_clock::now() - start)
+        .count();
+}
+
+/**
+ * @brief Run `body(i)` for every i < count on up to `MAX_PROBE_THREADS`
+ * threads, until `stopping` is set.
+ */
+template <typename Body>
+void runConcurrently(std::size_t count, const std::atomic<bool>& stopping,
+                     Body body) {
+    std::atomic<std::size_t> next{0};
+    const auto               work = [&]() {
+        CoInitializeEx(nullptr, COINIT_MULTITHREADED);
+        for (std::size_t i = next++; i < count && !stopping; i = next++) {
+            body(i);
+        }
+        CoUninitialize();
+    };
+    std::vector<std::thread> threads;
+    for (std::size_t t = 1; t < std::min(count, MAX_PROBE_THREADS); ++t) {
+        threads.emplace_back(work);
+    }
+    work();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+}
+
+// Device path of a Media Foundation webcam, empty for other sources
+std::wstring deviceId(const Webcam& device) {
+    auto* source = dynamic_cast<MfCaptureSource*>(device.getSource());
+    return source ? source->getIdentity().id : std::wstring();
+}
+
+} // namespace
 
-    HRESULT hr = MFCreateAttributes(&this->config_, 1);
+WebcamManager::WebcamManager(std::filesystem::path cache_path) {
+
+    HRESULT hr = MFCreateAttributes(this->config_.put(), 1);
     if (SUCCEEDED(hr)) {
         hr = this->config_->SetGUID(
             MF_DEVSOURCE_ATTRIBUTE_SOURCE_TYPE,
             MF_DEVSOURCE_ATTRIBUTE_SOURCE_TYPE_VIDCAP_GUID);
     }
 
-    if (SUCCEEDED(hr)) {
-        hr = MFEnumDeviceSources(this->config_, &devices_temp, &device_count);
+    if (!cache_path.empty()) {
+        this->cache_ = std::make_shared<CapabilityCache>(std::move(cache_path));
+        this->cache_->load();
     }
 
-    if (SUCCEEDED(hr)) {
-        for (uint32_t i = 0; i < device_count; i++) {
-            this->devices_.emplace_back(devices_temp[i], this->config_);
+    error(hr, L"Unable to initialize webcam manager");
+    if (FAILED(hr)) {
+        // Nothing to scan, the future is ready with no devices
+        this->scan_promise_.set_value(0);
+        std::lock_guard<std::mutex> lock(this->scan_mutex_);
+        this->scan_done_ = this->scan_promise_.get_future().share();
+        return;
+    }
+    this->startScan();
+}
+
+void WebcamManager::startScan() {
+    // The scan thread is not running, only waiters share the future
+    this->scan_promise_ = std::promise<std::size_t>();
+    {
+        std::lock_guard<std::mutex> lock(this->scan_mutex_);
+        this->scan_done_ = this->scan_promise_.get_future().share();
+    }
+    this->scan_start_ = std::chrono::steady_clock::now();
+    this->stopping_   = false;
+    this->scanner_    = std::thread(&WebcamManager::scan, this);
+}
+
+void WebcamManager::stopScan() {
+    this->stopping_ = true;
+    if (this->scanner_.joinable()) {
+        this->scanner_.join();
+    }
+}
+
+void WebcamManager::scan() {
+    CoInitializeEx(nullptr, COINIT_MULTITHREADED);
+
+    IMFActivate** devices_temp = nullptr;
+    uint32_t      device_count = 0;
+
+    HRESULT hr =
+        MFEnumDeviceSources(this->config_.get(), &devices_temp, &device_count);
+    error(hr, L"Unable to enumerate devices");
+    if (FAILED(hr)) {
+        device_count = 0;
+    }
+
+    // The device path is stable while a camera stays plugged in, reading it
+    // needs no activation
+    std::vector<DeviceIdentity> identities;
+    std::set<std::wstring>      present;
+    for (uint32_t i = 0; i < device_count; i++) {
+        identities.push_back(MfCaptureSource::identify(devices_temp[i]));
+        present.insert(identities.back().id);
+    }
+
+    // Drop unplugged devices, and stale ones that are not streaming so they
+    // are created again from their updated cache entry
+    std::vector<std::shared_ptr<Webcam>> removed;
+    std::set<std::wstring>               known;
+    {
+        std::lock_guard<std::mutex> stale_lock(this->stale_mutex_);
+        std::lock_guard<std::mutex> lock(this->devices_mutex_);
+        const auto keep = [&](const std::shared_ptr<Webcam>& device) {
+            const std::wstring id    = deviceId(*device);
+            const bool         stale = std::find(this->stale_ids_.begin(),
+                                                 this->stale_ids_.end(),
+                                                 id) != this->stale_ids_.end();
+            if (id.empty() || !present.count(id) || (stale && !device->isActive())) {
+                removed.push_back(device);
+                return false;
+            }
+            known.insert(id);
+            return true;
+        };
+        this->devices_.erase(
+            std::remove_if(this->devices_.begin(), this->devices_.end(),
+                           [&](const auto& device) { return !keep(device); }),
+            this->devices_.end());
+        for (std::size_t i = this->published_.size(); i-- > 0;) {
+            if (std::find(removed.begin(), removed.end(), this->published_[i]) !=
+                removed.end()) {
+                this->published_.erase(this->published_.begin() + i);
+                this->init_stats_.erase(this->init_stats_.begin() + i);
+            }
+        }
+        for (std::size_t i = this->stale_ids_.size(); i-- > 0;) {
+            if (!known.count(this->stale_ids_[i])) {
+                this->stale_ids_.erase(this->stale_ids_.begin() + i);
+                this->stale_.erase(this->stale_.begin() + i);
+            }
+        }
+        this->scan_stats_.removed   = removed.size();
+        this->scan_stats_.unchanged = this->devices_.size();
+    }
+    // Other threads may be using them, the event hands them over
+    for (auto& device : removed) {
+        DeviceEvent event{DeviceEventType::Removed, device->getName(), deviceId(*device)};
+        event.device = std::move(device);
+        this->pushEvent(std::move(event));
+    }
+    removed.clear();
+
+    // Only new devices are created; cached ones need no activation and are
+    // published first
+    std::vector<uint32_t>                         pending;
+    std::vector<std::shared_ptr<MfCaptureSource>> cached;
+    for (uint32_t i = 0; i < device_count && !this->stopping_; i++) {
+        const DeviceIdentity& identity = identities[i];
+        if (known.count(identity.id)) {
+            continue;
+        }
+        const auto   start = std::chrono::steady_clock::now();
+        CachedDevice entry;
+        if (!this->cache_ || identity.id.empty() ||
+            !this->cache_->find(identity, entry)) {
+            pending.push_back(i);
+            continue;
         }
+        auto source = std::make_shared<MfCaptureSource>(
+            devices_temp[i], this->config_.get(), entry);
+        cached.push_back(source);
+        this->publish(source, {entry.name, i, true, 0, millisecondsSince(start)});
     }
 
+    runConcurrently(pending.size(), this->stopping_, [&](std::size_t k) {
+        const uint32_t i      = pending[k];
+        const auto     start  = std::chrono::steady_clock::now();
+        auto           source = std::make_shared<MfCaptureSource>(
+            devices_temp[i], this->config_.get());
+        const CachedDevice entry = source->describe();
+        if (this->cache_ && !entry.identity.id.empty() && !entry.formats.empty()) {
+            this->cache_->store(entry);
+        }
+        this->publish(source, {entry.name, i, false,
+                               static_cast<int16_t>(entry.formats.empty() ? -500 : 0),
+                               millisecondsSince(start)});
+    });
+
+    // The sources hold their own references
+    for (uint32_t i = 0; i < device_count; i++) {
+        devices_temp[i]->Release();
+    }
     CoTaskMemFree(devices_temp);
 
-    error(hr, L"Unable to initialize webcam manager");
+    std::size_t devices;
+    {
+        std::lock_guard<std::mutex> lock(this->devices_mutex_);
+        this->scan_stats_.milliseconds = millisecondsSince(this->scan_start_);
+        this->scan_stats_.devices      = this->devices_.size();
+        devices                        = this->devices_.size();
+    }
+    this->scan_promise_.set_value(devices);
+
+    // Check the cache entries while the devices are already in use
+    if (this->cache_) {
+        runConcurrently(cached.size(), this->stopping_, [&](std::size_t k) {
+            std::vector<MediaFormat> formats;
+            if (cached[k]->probe(formats) != 0 || formats.empty() ||
+                formats == cached[k]->getMediaFormats()) {
+                return;
+            }
+            CachedDevice entry = cached[k]->describe();
+            entry.formats      = std::move(formats);
+            this->cache_->store(entry);
+
+            std::lock_guard<std::mutex> lock(this->stale_mutex_);
+            this->stale_.push_back(entry.name);
+            this->stale_ids_.push_back(entry.identity.id);
+        });
+        // Also writes what the scan probed
+        this->cache_->save();
+    }
+
+    CoUninitialize();
+}
+
+void WebcamManager::publish(std::shared_ptr<CaptureSource> source,
+                            DeviceInitStats                stats) {
+    std::lock_guard<std::mutex> callback_lock(this->callback_mutex_);
+    auto device = std::make_shared<Webcam>(std::move(source));
+    {
+        std::lock_guard<std::mutex> lock(this->devices_mutex_);
+        stats.published = millisecondsSince(this->scan_start_);
+        this->devices_.push_back(device);
+        this->published_.push_back(device);
+        this->init_stats_.push_back(stats);
+        ++(stats.cached ? this->scan_stats_.cached : this->scan_stats_.probed);
+    }
+    this->pushEvent({DeviceEventType::Added, stats.name, deviceId(*device)});
+    if (this->callback_) {
+        this->callback_(*device, stats);
+    }
+}
+
+void WebcamManager::pushEvent(DeviceEvent event) {
+    {
+        std::lock_guard<std::mutex> lock(this->events_mutex_);
+        if (this->events_.size() == MAX_DEVICE_EVENTS) {
+            // Not released on this thread, see `rescanDevices`
+            if (this->events_.front().device) {
+                this->retired_.push_back(std::move(this->events_.front().device));
+            }
+            this->events_.pop_front();
+        }
+        this->events_.push_back(std::move(event));
+    }
+    this->events_ready_.notify_all();
+}
+
+std::shared_ptr<Webcam> WebcamManager::findDevice(std::size_t index) const {
+    std::lock_guard<std::mutex> lock(this->devices_mutex_);
+    return index < this->devices_.size() ? this->devices_[index] : nullptr;
+}
+
+std::shared_ptr<Webcam> WebcamManager::findDevice(std::wstring_view name) const {
+    std::lock_guard<std::mutex> lock(this->devices_mutex_);
+    for (const auto& device : this->devices_) {
+        if (device->getName() == name) {
+            return device;
+        }
+    }
+    return nullptr;
 }
 
 void WebcamManager::cloneDevice(std::size_t index) {
-    HRESULT        hr     = S_OK;
-    IMFAttributes* attrs  = NULL;
-    IMFActivate*   cloned = NULL;
+    this->getScanFuture().wait();
+    std::shared_ptr<Webcam> original = this->findDevice(index);
+    ComHandle<IMFActivate> device(original ? original->getDevice() : nullptr);
+    if (!device) {
+        return;
+    }
+    HRESULT                  hr = S_OK;
+    ComHandle<IMFAttributes> attrs;
+    ComHandle<IMFActivate>   cloned;
     // Get attributes from the original IMFActivate
-    hr =
-        this->devices_[index].getDevice()->QueryInterface(IID_PPV_ARGS(&attrs));
+    hr = device->QueryInterface(IID_PPV_ARGS(attrs.put()));
     if (SUCCEEDED(hr)) {
         // Create a new device source activation object with these attributes
-        hr = MFCreateDeviceSourceActivate(attrs, &cloned);
-        attrs->Release();
+        hr = MFCreateDeviceSourceActivate(attrs.get(), cloned.put());
     }
-    Webcam new_device(cloned, this->config_);
-    if (index < this->devices_.size()) {
-        this->devices_.insert(devices_.begin() + index + 1,
-                              std::move(new_device));
+    if (FAILED(hr)) {
+        error(hr, L"Unable to clone " + original->getName());
+        return;
+    }
+    auto new_device = std::make_shared<Webcam>(cloned.get(), this->config_.get());
+
+    std::lock_guard<std::mutex> lock(this->devices_mutex_);
+    const auto                  position =
+        std::find(this->devices_.begin(), this->devices_.end(), original);
+    if (position != this->devices_.end()) {
+        this->devices_.insert(position + 1, std::move(new_device));
     }
 }
 
 WebcamManager::~WebcamManager() {
+    this->stopScan();
     this->devices_.clear();
-    if (this->config_) {
-        this->config_->Release();
-    }
+    this->published_.clear();
 }
 
 Webcam& WebcamManager::operator[](std::size_t index) {
-    return this->devices_[index];
+    std::lock_guard<std::mutex> lock(this->devices_mutex_);
+    return *this->devices_[index];
 }
 
 const Webcam& WebcamManager::operator[](std::size_t index) const {
-    return this->devices_[index];
+    std::lock_guard<std::mutex> lock(this->devices_mutex_);
+    return *this->devices_[index];
 }
 
 void WebcamManager::rescanDevices() {
-    this->devices_.clear();
-
-    IMFActivate** devices_temp = nullptr;
-    uint32_t      device_count = 0;
+    this->stopScan();
+    {
+        std::lock_guard<std::mutex> lock(this->devices_mutex_);
+        this->scan_stats_ = {};
+    }
+    std::vector<std::shared_ptr<Webcam>> retired;
+    {
+        std::lock_guard<std::mutex> lock(this->events_mutex_);
+        retired.swap(this->retired_);
+    }
+    retired.clear(); // Closes them unless the caller still holds them
+    this->startScan();
+}
 
-    HRESULT hr =
-        MFEnumDeviceSources(this->config_, &devices_temp, &device_count);
+void WebcamManager::setDeviceCallback(DeviceCallback callback) {
+    std::lock_guard<std::mutex> callback_lock(this->callback_mutex_);
+    this->callback_ = std::move(callback);
+    if (!this->callback_) {
+        return;
+    }
+    std::vector<std::shared_ptr<Webcam>> devices;
+    std::vector<DeviceInitStats>         stats;
+    {
+        std::lock_guard<std::mutex> lock(this->devices_mutex_);
+        devices = this->published_;
+        stats   = this->init_stats_;
+    }
+    for (std::size_t i = 0; i < devices.size(); ++i) {
+        this->callback_(*devices[i], stats[i]);
+    }
+}
 
-    if (SUCCEEDED(hr)) {
-        for (uint32_t i = 0; i < device_count; i++) {
-            this->devices_.emplace_back(devices_temp[i]);
-        }
+int16_t WebcamManager::waitDeviceEvent(DeviceEvent&              event,
+                                       std::chrono::milliseconds timeout) {
+    std::vector<std::shared_ptr<Webcam>> retired;
+    std::unique_lock<std::mutex>         lock(this->events_mutex_);
+    retired.swap(this->retired_);
+    if (!this->events_ready_.wait_for(
+            lock, timeout, [this]() { return !this->events_.empty(); })) {
+        return 204;
     }
+    event = std::move(this->events_.front());
+    this->events_.pop_front();
+    return 0;
+}
 
-    CoTaskMemFree(devices_temp);
+std::shared_future<std::size_t> WebcamManager::getScanFuture() const {
+    std::lock_guard<std::mutex> lock(this->scan_mutex_);
+    return this->scan_done_;
+}
+
+bool WebcamManager::waitForDevices(std::chrono::milliseconds timeout) const {
+    // Waits on a copy, a rescan may replace the future meanwhile
+    return this->getScanFuture().wait_for(timeout) == std::future_status::ready;
+}
+
+DeviceScanStats WebcamManager::getScanStats() const {
+    std::lock_guard<std::mutex> lock(this->devices_mutex_);
+    return this->scan_stats_;
+}
+
+std::vector<DeviceInitStats> WebcamManager::getDeviceInitStats() const {
+    std::lock_guard<std::mutex> lock(this->devices_mutex_);
+    return this->init_stats_;
+}
 
-    error(hr, L"Unable to rescan devices");
+std::vector<std::wstring> WebcamManager::getStaleDevices() const {
+    std::lock_guard<std::mutex> lock(this->stale_mutex_);
+    return this->stale_;
 }
 
 std::vector<std::wstring> WebcamManager::getDeviceNames() const {
-    std::vector<std::wstring> device_names;
-    for (auto device : this->devices_) {
-        device_names.push_back(device.getName());
+    std::lock_guard<std::mutex> lock(this->devices_mutex_);
+    std::vector<std::wstring>   device_names;
+    for (const auto& device : this->devices_) {
+        device_names.push_back(device->getName());
     }
     return device_names;
 }
 
-std::vector<Webcam> WebcamManager::getDevices() const { return this->devices_; }
+DeviceView WebcamManager::getDevices() const {
+    return DeviceView(this->devices_mutex_, this->devices_);
+}
 
-bool WebcamManager::activateDevice(const std::wstring& name) {
-    for (auto& device : this->devices_) {
-        if (device.getName() == name) {
-            return SUCCEEDED(device.activate());
-        }
-    }
-    return false;
+std::size_t WebcamManager::getDeviceCount() const {
+    std::lock_guard<std::mutex> lock(this->devices_mutex_);
+    return this->devices_.size();
+}
+
+int16_t WebcamManager::findDeviceIndex(std::wstring_view name,
+                                       std::size_t&      index) const {
+    return this->getDevices().find(name, index);
+}
+
+bool WebcamManager::activateDevice(std::wstring_view name) {
+    std::shared_ptr<Webcam> device = this->findDevice(name);
+    return device && SUCCEEDED(device->activate());
 }
 
 bool WebcamManager::activateDevice(std::size_t index) {
-    if (index < this->devices_.size()) {
-        return SUCCEEDED(this->devices_[index].activate());
-    }
-    return false;
+    std::shared_ptr<Webcam> device = this->findDevice(index);
+    return device && SUCCEEDED(device->activate());
 }
 
-bool WebcamManager::deactivateDevice(const std::wstring& name) {
-    for (auto& device : this->devices_) {
-        if (device.getName() == name) {
-            return SUCCEEDED(device.deactivate());
-        }
-    }
-    return false;
+bool WebcamManager::deactivateDevice(std::wstring_view name) {
+    std::shared_ptr<Webcam> device = this->findDevice(name);
+    return device && SUCCEEDED(device->deactivate());
 }
 
 bool WebcamManager::deactivateDevice(std::size_t index) {
-    if (index < this->devices_.size()) {
-        return SUCCEEDED(this->devices_[index].deactivate());
+    std::shared_ptr<Webcam> device = this->findDevice(index);
+    return device && SUCCEEDED(device->deactivate());
+}
+
+std::shared_ptr<SyncGroup>
+WebcamManager::createSyncGroup(const std::vector<std::size_t>& indices,
+                               const SyncOptions&              options) {
+    std::vector<std::shared_ptr<Webcam>> cameras;
+    std::vector<std::shared_ptr<Webcam>> activated;
+    bool                                 failed = indices.empty();
+    for (std::size_t index : indices) {
+        std::shared_ptr<Webcam> device =
+            failed ? nullptr : this->findDevice(index);
+        if (!device) {
+            failed = true;
+            break;
+        }
+        if (!device->isActive()) {
+            if (device->activate() != 0) {
+                failed = true;
+                break;
+            }
+            activated.push_back(device);
+        }
+        cameras.push_back(std::move(device));
+    }
+
+    if (failed) {
+        for (const auto& device : activated) {
+            device->deactivate();
+        }
+        return nullptr;
     }
-    return false;
+    return std::make_shared<SyncGroup>(std::move(cameras), options);
 }
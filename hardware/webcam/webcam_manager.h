@@ -1,30 +1,190 @@
 #ifndef WEBCAM_MANAGER_H
 #define WEBCAM_MANAGER_H
 
+#include "capability_cache.h"
+#include "device_view.h"
+#include "frame_sync.h"
 #include "webcam.h"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <string_view>
+#include <thread>
 
+/**
+ * @brief How one device was initialized.
+ */
+struct DeviceInitStats {
+    std::wstring name{};
+    std::size_t  index{};        // Position in the driver's enumeration
+    bool         cached{};       // Created from the capability cache
+    int16_t      result{};       // -500 if probing found no media types
+    double       milliseconds{}; // Time to create the device
+    double       published{};    // Time from the start of the scan
+};
+
+/**
+ * @brief What the last scan changed.
+ */
+struct DeviceScanStats {
+    std::size_t devices{};      // Devices after the scan
+    std::size_t unchanged{};    // Kept from the previous scan
+    std::size_t removed{};      // Unplugged, or stale and created again
+    std::size_t cached{};       // Added from the capability cache
+    std::size_t probed{};       // Added by activating them
+    double      milliseconds{}; // Until every device was published
+};
+
+enum class DeviceEventType { Added, Removed };
+
+/**
+ * @brief A device appearing in or disappearing from the list.
+ */
+struct DeviceEvent {
+    DeviceEventType type{};
+    std::wstring    name{};
+    std::wstring    id{}; // Device path, see `DeviceIdentity`
+
+    // Removed only: the camera, still active if it was. Scans never touch
+    // it; the thread that uses it deactivates it, or lets it go and the last
+    // reference closes it.
+    std::shared_ptr<Webcam> device{};
+};
+
+/**
+ * @brief Called once per device as it is published, on a scan thread.
+ */
+using DeviceCallback =
+    std::function<void(const Webcam& device, const DeviceInitStats& stats)>;
+
+/**
+ * @brief The connected cameras.
+ *
+ * Devices are scanned in the background: the constructor and
+ * `rescanDevices` return right away, and each camera is published, appended
+ * to the list, as soon as it is ready. Cameras in the capability cache are
+ * ready immediately, the others are probed concurrently.
+ *
+ * Scans are incremental, devices are matched by their device path. A rescan
+ * only creates the cameras that were plugged in and only removes those that
+ * were unplugged; the others, and their sessions, are left alone. Removals
+ * shift the indices after them, references from `operator[]` are valid until
+ * that device is removed.
+ */
 class WebcamManager {
   private:
-    std::vector<Webcam> devices_{};
-    IMFAttributes*      config_{nullptr};
+    std::vector<std::shared_ptr<Webcam>> devices_{};
+    std::vector<std::shared_ptr<Webcam>> published_{};  // Scanned, without clones
+    std::vector<DeviceInitStats>         init_stats_{}; // Of published_
+    DeviceScanStats                      scan_stats_{};
+    mutable std::mutex                   devices_mutex_{};
+    ComHandle<IMFAttributes>             config_{};
+    std::shared_ptr<CapabilityCache>     cache_{};
+
+    DeviceCallback                        callback_{};
+    std::mutex                            callback_mutex_{}; // Serializes callbacks
+    std::promise<std::size_t>             scan_promise_{};
+    std::shared_future<std::size_t>       scan_done_{}; // Under scan_mutex_
+    mutable std::mutex                    scan_mutex_{};
+    std::thread                           scanner_{};
+    std::atomic<bool>                     stopping_{false};
+    std::chrono::steady_clock::time_point scan_start_{};
+
+    mutable std::mutex        stale_mutex_{};
+    std::vector<std::wstring> stale_{};
+    std::vector<std::wstring> stale_ids_{}; // Of stale_
+
+    std::deque<DeviceEvent>              events_{};
+    std::vector<std::shared_ptr<Webcam>> retired_{}; // Of dropped events
+    std::mutex                           events_mutex_{};
+    std::condition_variable              events_ready_{};
+
+    void startScan();
+    void stopScan();
+    void scan();
+    void publish(std::shared_ptr<CaptureSource> source, DeviceInitStats stats);
+    void pushEvent(DeviceEvent event);
+
+    std::shared_ptr<Webcam> findDevice(std::size_t index) const;
+    std::shared_ptr<Webcam> findDevice(std::wstring_view name) const;
 
   public:
-    WebcamManager();
+    /**
+     * @brief Start scanning the connected cameras. Devices found in the
+     * capability cache at `cache_path` are created from their entries without
+     * being activated, the others are probed and added to it. The cached
+     * entries are checked against the devices after the scan.
+     * @param cache_path Empty to probe every device and not use a cache.
+     */
+    explicit WebcamManager(
+        std::filesystem::path cache_path = CapabilityCache::defaultPath());
     ~WebcamManager();
 
     Webcam&       operator[](std::size_t index);
     const Webcam& operator[](std::size_t index) const;
 
+    /**
+     * @brief Insert a second instance of the device at `index` after it.
+     * Waits for the current scan to finish.
+     */
     void cloneDevice(std::size_t index);
 
     void cloneDevice(std::wstring name);
 
     /**
-     * @brief Updates the list of connected cameras
-     *
+     * @brief Updates the list of connected cameras: starts a scan that adds
+     * new devices and removes unplugged ones, see `getScanFuture`. Removed
+     * devices are handed over with their `DeviceEvent` instead of being
+     * deactivated on the scan thread, which could race the thread using
+     * them; removed devices whose events were dropped are released here.
      */
     void rescanDevices();
 
+    /**
+     * @brief Next device added or removed by a scan, in order. The first scan
+     * reports every device as added; up to 256 events are kept. Call it from
+     * the thread that uses the cameras: removed ones are released on it.
+     * @return 0 on success, 204 if no event arrived within `timeout`.
+     */
+    int16_t waitDeviceEvent(DeviceEvent& event, std::chrono::milliseconds timeout);
+
+    /**
+     * @brief Call `callback` for every device published from now on. Devices
+     * published before are reported right away, on the calling thread.
+     * Callbacks do not overlap; they may query the manager but must not set
+     * another callback.
+     */
+    void setDeviceCallback(DeviceCallback callback);
+
+    /**
+     * @brief Ready with the number of devices once the current scan has
+     * published all of them.
+     */
+    std::shared_future<std::size_t> getScanFuture() const;
+
+    /**
+     * @brief Wait until the current scan has published every device.
+     * @return false on timeout.
+     */
+    bool waitForDevices(std::chrono::milliseconds timeout) const;
+
+    DeviceScanStats getScanStats() const;
+
+    /**
+     * @brief Initialization time of each published device, in publishing
+     * order.
+     */
+    std::vector<DeviceInitStats> getDeviceInitStats() const;
+
+    /**
+     * @brief Names of devices whose media types no longer match their cache
+     * entry. The entry is updated; `rescanDevices` creates the device again
+     * with the new types unless it is active.
+     */
+    std::vector<std::wstring> getStaleDevices() const;
+
     /**
      * @brief Get the names of connected cameras
      *
@@ -35,16 +195,24 @@ class WebcamManager {
     /**
      * @brief Get the list of connected cameras
      *
-     * @return std::vector<Webcam>
+     * @return A locked view of the list, see `DeviceView`
      */
-    std::vector<Webcam> getDevices() const;
+    DeviceView getDevices() const;
+
+    std::size_t getDeviceCount() const;
+
+    /**
+     * @brief Index of the first device named `name`, without allocating.
+     * @return 0 on success, -404 if there is none.
+     */
+    int16_t findDeviceIndex(std::wstring_view name, std::size_t& index) const;
 
     /**
      * @brief Activate a device by name.
      * @param wstring The name of the device to activate.
      * @return true if the device was activated, false otherwise.
      */
-    bool activateDevice(const std::wstring& name);
+    bool activateDevice(std::wstring_view name);
 
     /**
      * @brief Activate a device by index.
@@ -58,7 +226,7 @@ class WebcamManager {
      * @param wstring The name of the device to activate.
      * @return true if the device was activated, false otherwise.
      */
-    bool deactivateDevice(const std::wstring& name);
+    bool deactivateDevice(std::wstring_view name);
 
     /**
      * @brief Deactivate a device by index.
@@ -66,6 +234,17 @@ class WebcamManager {
      * @return true if the device was activated, false otherwise.
      */
     bool deactivateDevice(std::size_t index);
+
+    /**
+     * @brief Activate the devices at `indices` that are not active yet and
+     * group them for synchronized capture, see `SyncGroup`.
+     * @param indices Devices in the order their frames appear in a frameset.
+     * @return The group, or `nullptr` if an index is out of range or a device
+     * failed to activate; devices this call activated are deactivated again.
+     */
+    std::shared_ptr<SyncGroup>
+    createSyncGroup(const std::vector<std::size_t>& indices,
+                    const SyncOptions&              options = {});
 };
 
 #endif // WEBACM_MANAGER_H
\ No newline at end of file
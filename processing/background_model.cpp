@@ -0,0 +1,296 @@
+#include "background_model.h"
+
+#include "background_model_kernel.h"
+#include "frame_cache.h"
+#include "hardware/webcam/frame_trace.h"
+#include "hardware/webcam/region_of_interest.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+using AverageFunction = uint32_t (*)(const BackgroundConstants&, const uint8_t*,
+                                     uint16_t*, uint8_t*, std::size_t);
+using MixtureFunction = uint32_t (*)(const BackgroundConstants&, const uint8_t*,
+                                     const MixturePlanes&, uint8_t*, std::size_t);
+
+struct Kernels {
+    AverageFunction average{nullptr};
+    MixtureFunction mixture{nullptr};
+};
+
+Kernels kernels(SimdKernel kernel) {
+    switch (kernel) {
+    case SimdKernel::Scalar:
+        return {averageSpanScalar, mixtureSpanScalar};
+#ifdef BACKGROUND_MODEL_SSE2
+    case SimdKernel::Sse2:
+        return {averageSpanSse2, mixtureSpanSse2};
+#endif
+#ifdef BACKGROUND_MODEL_AVX2
+    case SimdKernel::Avx2:
+        return {averageSpanAvx2, mixtureSpanAvx2};
+#endif
+#ifdef BACKGROUND_MODEL_AVX512
+    case SimdKernel::Avx512:
+        return {averageSpanAvx512, mixtureSpanAvx512};
+#endif
+    default:
+        return {};
+    }
+}
+
+BackgroundConstants makeConstants(const BackgroundOptions& options) {
+    auto fixed = [](double value, int shift, int32_t low, int32_t high) {
+        const double scaled = std::round(value * (1 << shift));
+        return static_cast<int32_t>(std::clamp<double>(scaled, low, high));
+    };
+    const double match   = options.match_sigmas * options.match_sigmas;
+    const double initial = options.initial_sigma * options.initial_sigma;
+
+    BackgroundConstants c;
+    c.rate              = fixed(options.learning_rate, 15, 1, BACKGROUND_WEIGHT_ONE);
+    c.threshold         = options.threshold;
+    c.match             = fixed(match, 12, 1, 0xFFFF);
+    c.initial_variance  = fixed(initial, 3, BACKGROUND_MIN_VARIANCE,
+                                BACKGROUND_MAX_VARIANCE);
+    c.background_weight = fixed(options.background_weight, 15, 0,
+                                BACKGROUND_WEIGHT_ONE);
+    return c;
+}
+
+} // namespace
+
+bool isBackgroundKernelAvailable(SimdKernel kernel) {
+    return kernels(kernel).average && cpuSupports(kernel);
+}
+
+SimdKernel bestBackgroundKernel() {
+    static const SimdKernel best = [] {
+        for (SimdKernel kernel :
+             {SimdKernel::Avx512, SimdKernel::Avx2, SimdKernel::Sse2}) {
+            if (isBackgroundKernelAvailable(kernel)) {
+                return kernel;
+            }
+        }
+        return SimdKernel::Scalar;
+    }();
+    return best;
+}
+
+BackgroundModel::BackgroundModel(const BackgroundOptions&    options,
+                                 std::shared_ptr<ThreadPool> workers)
+    : options_(options), workers_(std::move(workers)) {
+    if (!this->workers_) {
+        this->workers_ = std::make_shared<ThreadPool>(options.threads);
+    }
+}
+
+void BackgroundModel::reset() {
+    this->format_ = {};
+    this->frames_ = 0;
+}
+
+void BackgroundModel::initialize(const uint8_t* luma) {
+    const std::size_t size =
+        static_cast<std::size_t>(this->format_.width) * this->format_.height;
+
+    if (this->options_.mode == BackgroundMode::RunningAverage) {
+        this->average_.resize(size);
+        for (std::size_t i = 0; i < size; ++i) {
+            this->average_[i] = static_cast<uint16_t>(luma[i] << 7);
+        }
+        return;
+    }
+
+    // The first frame is the only, fully weighted mode
+    const BackgroundConstants c = makeConstants(this->options_);
+    for (std::size_t k = 0; k < BACKGROUND_MODES; ++k) {
+        this->mean_[k].assign(size, 0);
+        this->variance_[k].assign(size, static_cast<uint16_t>(c.initial_variance));
+        this->weight_[k].assign(size, 0);
+    }
+    for (std::size_t i = 0; i < size; ++i) {
+        this->mean_[0][i] = static_cast<uint16_t>(luma[i] << 7);
+    }
+    std::fill(this->weight_[0].begin(), this->weight_[0].end(),
+              static_cast<uint16_t>(BACKGROUND_WEIGHT_ONE));
+}
+
+int16_t BackgroundModel::apply(const Frame& frame, Frame& mask,
+                               const MotionMap* motion) {
+    TraceScope         trace(frame, TraceStage::Process, "background");
+    const MediaFormat& format    = frame.format;
+    const uint32_t     tile_size = this->options_.tile_size;
+    if (format.width == 0 || format.height == 0 || tile_size == 0 ||
+        tile_size % 16 != 0) {
+        return -400;
+    }
+
+    SimdKernel kernel = this->options_.kernel == SimdKernel::Auto
+                            ? bestBackgroundKernel()
+                            : this->options_.kernel;
+    if (!isBackgroundKernelAvailable(kernel)) {
+        return -404;
+    }
+    const Kernels functions = kernels(kernel);
+
+    Frame   luma;
+    int16_t result = frameProduct(frame, FrameProduct::Gray, luma);
+    if (result != 0) {
+        return result;
+    }
+
+    const std::size_t size    = static_cast<std::size_t>(format.width) * format.height;
+    const uint32_t    tiles_x = (format.width + tile_size - 1) / tile_size;
+    const uint32_t    tiles_y = (format.height + tile_size - 1) / tile_size;
+    if (format.subtype != this->format_.subtype ||
+        format.width != this->format_.width ||
+        format.height != this->format_.height) {
+        this->reset();
+        this->format_ = format;
+        this->pool_   = FramePool::create(size, 2, 4);
+    }
+
+    mask.buffer    = this->pool_->acquire(size);
+    mask.format    = {FOURCC_Y800, format.width, format.height,
+                      format.fps_numerator, format.fps_denominator};
+    mask.timestamp = frame.timestamp;
+    mask.sequence  = frame.sequence;
+    mask.arrival   = frame.arrival;
+    mask.capture   = frame.capture;
+    mask.trace_id  = frame.trace_id;
+    mask.roi       = frame.roi;
+
+    ++this->stats_.frames;
+    if (this->frames_++ == 0) {
+        this->initialize(luma.buffer.data());
+        this->tile_foreground_.assign(static_cast<std::size_t>(tiles_x) * tiles_y, 0);
+        std::memset(mask.buffer.data(), 0, size);
+        this->stats_.foreground_pixels = 0;
+        return 204;
+    }
+
+    const bool refresh = this->options_.refresh_interval != 0 &&
+                         this->frames_ % this->options_.refresh_interval == 0;
+    if (!this->options_.skip_static_tiles || refresh || !motion ||
+        motion->tile_size != tile_size || motion->tiles_x != tiles_x ||
+        motion->tiles_y != tiles_y) {
+        motion = nullptr;
+    }
+
+    const BackgroundConstants c       = makeConstants(this->options_);
+    const bool                mixture = this->options_.mode == BackgroundMode::Mixture;
+    const uint8_t*            source  = luma.buffer.data();
+    uint8_t*                  target  = mask.buffer.data();
+    uint8_t*                  flags   = this->tile_foreground_.data();
+    const uint32_t            width   = format.width;
+    const uint32_t            height  = format.height;
+    const auto roi = frame.roi ? frame.roi->getMask(width, height, tile_size) : nullptr;
+
+    MixturePlanes planes;
+    for (std::size_t k = 0; k < BACKGROUND_MODES; ++k) {
+        planes.mean[k]     = this->mean_[k].data();
+        planes.variance[k] = this->variance_[k].data();
+        planes.weight[k]   = this->weight_[k].data();
+    }
+
+    std::atomic<std::size_t> foreground{0};
+    std::atomic<uint64_t>    skipped{0};
+    auto band = [&](std::size_t begin, std::size_t end) {
+        std::size_t band_foreground = 0;
+        uint64_t    band_skipped    = 0;
+        for (std::size_t ty = begin; ty < end; ++ty) {
+            const uint32_t row_begin = static_cast<uint32_t>(ty) * tile_size;
+            const uint32_t row_end   = std::min(height, row_begin + tile_size);
+            uint8_t*       tile_flags = flags + ty * tiles_x;
+            auto           static_tile = [&](uint32_t tx) {
+                if (roi && roi->tile(tx, static_cast<uint32_t>(ty)) == RoiCoverage::Outside) {
+                    return true;
+                }
+                return motion && !motion->active[ty * tiles_x + tx] && !tile_flags[tx];
+            };
+            auto update = [&](uint32_t row, uint32_t x, std::size_t count) {
+                const std::size_t offset = std::size_t(row) * width + x;
+                if (mixture) {
+                    MixturePlanes span = planes;
+                    for (std::size_t k = 0; k < BACKGROUND_MODES; ++k) {
+                        span.mean[k] += offset, span.variance[k] += offset,
+                            span.weight[k] += offset;
+                    }
+                    band_foreground += functions.mixture(
+                        c, source + offset, span, target + offset, count);
+                } else {
+                    band_foreground += functions.average(
+                        c, source + offset, this->average_.data() + offset,
+                        target + offset, count);
+                }
+            };
+
+            // Runs of tiles that are all updated or all skipped
+            for (uint32_t tx = 0, run; tx < tiles_x; tx = run) {
+                const bool skip = static_tile(tx);
+                for (run = tx + 1; run < tiles_x && static_tile(run) == skip; ++run) {
+                }
+                const uint32_t    x_begin = tx * tile_size;
+                const std::size_t count   = std::min(width, run * tile_size) - x_begin;
+
+                if (skip) {
+                    band_skipped += run - tx;
+                    for (uint32_t row = row_begin; row < row_end; ++row) {
+                        std::memset(target + std::size_t(row) * width + x_begin, 0, count);
+                    }
+                    std::memset(tile_flags + tx, 0, run - tx);
+                    continue;
+                }
+                for (uint32_t row = row_begin; row < row_end; ++row) {
+                    if (!roi) {
+                        update(row, x_begin, count);
+                        continue;
+                    }
+                    // Pixels of partially covered tiles outside the region
+                    // are background and leave the model alone
+                    const uint32_t x_end = x_begin + static_cast<uint32_t>(count);
+                    uint32_t       done  = x_begin;
+                    uint8_t*       line  = target + std::size_t(row) * width;
+                    for (uint32_t i = roi->row_start[row];
+                         i < roi->row_start[row + 1] && roi->spans[i].begin < x_end; ++i) {
+                        const uint32_t begin = std::max(roi->spans[i].begin, done);
+                        const uint32_t end   = std::min(roi->spans[i].end, x_end);
+                        if (begin >= end) {
+                            continue;
+                        }
+                        std::memset(line + done, 0, begin - done);
+                        update(row, begin, end - begin);
+                        done = end;
+                    }
+                    std::memset(line + done, 0, x_end - done);
+                }
+
+                // Remember which of the updated tiles hold foreground
+                for (uint32_t t = tx; t < run; ++t) {
+                    const std::size_t x     = std::size_t(t) * tile_size;
+                    const std::size_t cells = std::min<std::size_t>(width - x, tile_size);
+                    uint8_t           any   = 0;
+                    for (uint32_t row = row_begin; row < row_end && !any; ++row) {
+                        const uint8_t* pixels = target + std::size_t(row) * width + x;
+                        for (std::size_t i = 0; i < cells; ++i) {
+                            any |= pixels[i];
+                        }
+                    }
+                    tile_flags[t] = any != 0;
+                }
+            }
+        }
+        foreground += band_foreground;
+        skipped += band_skipped;
+    };
+    this->workers_->parallelFor(tiles_y, 1, band);
+
+    const uint64_t tiles = static_cast<uint64_t>(tiles_x) * tiles_y;
+    this->stats_.tiles_skipped += skipped;
+    this->stats_.tiles_updated += tiles - skipped;
+    this->stats_.foreground_pixels = foreground;
+    return 0;
+}
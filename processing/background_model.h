@@ -0,0 +1,132 @@
+#ifndef BACKGROUND_MODEL_H
+#define BACKGROUND_MODEL_H
+
+#include "hardware/webcam/frame_pool.h"
+#include "motion_detector.h"
+#include "thread_pool.h"
+#include <memory>
+
+enum class BackgroundMode {
+    RunningAverage, // One exponentially averaged value per pixel
+    Mixture         // Several weighted Gaussian modes per pixel (MoG)
+};
+
+constexpr std::size_t BACKGROUND_MODES = 3; // Gaussians per pixel in `Mixture`
+
+struct BackgroundOptions {
+    BackgroundMode mode{BackgroundMode::RunningAverage};
+    double         learning_rate{0.02};    // Weight of each new frame
+    uint8_t        threshold{20};          // RunningAverage: foreground distance
+    double         match_sigmas{2.5};      // Mixture: distance matching a mode
+    double         initial_sigma{12.0};    // Mixture: spread of a new mode
+    double         background_weight{0.3}; // Mixture: weight of a background mode
+    uint32_t       tile_size{16};          // Multiple of 16, see `MotionMap`
+    bool           skip_static_tiles{false}; // Leave tiles without motion alone
+    uint32_t       refresh_interval{32};   // Update every tile this often anyway
+    std::size_t    threads{0};             // Private pool size, 0 for one per
+                                           // hardware thread
+    SimdKernel     kernel{SimdKernel::Auto};
+};
+
+/**
+ * @brief Counters of one model, `foreground_pixels` is for the last frame.
+ */
+struct BackgroundStats {
+    uint64_t    frames{};
+    uint64_t    tiles_updated{};
+    uint64_t    tiles_skipped{};
+    std::size_t foreground_pixels{};
+};
+
+/**
+ * @brief Kernel `SimdKernel::Auto` resolves to for background models.
+ */
+SimdKernel bestBackgroundKernel();
+
+/**
+ * @brief Whether `kernel` was compiled in and the CPU supports it.
+ */
+bool isBackgroundKernelAvailable(SimdKernel kernel);
+
+/**
+ * @brief Per-camera background subtraction on the luma plane.
+ *
+ * The model is updated in place with every frame and kept in 16-bit fixed
+ * point, one array per quantity (structure of arrays), so the SIMD kernels
+ * load a register of each quantity for consecutive pixels and every branch
+ * becomes a per-lane select. All kernels produce identical models and masks.
+ *
+ * - `RunningAverage` keeps the background in Q7 and moves it towards each
+ *   frame by `learning_rate`. Pixels further than `threshold` from it are
+ *   foreground.
+ * - `Mixture` keeps `BACKGROUND_MODES` Gaussians per pixel (mean in Q7,
+ *   variance in Q3, weight in Q15). A pixel within `match_sigmas` of a mode
+ *   updates it; otherwise it replaces the weakest mode. It is background
+ *   when the matched mode carries at least `background_weight`, so objects
+ *   that stop moving fade into the background and swaying leaves or
+ *   flicker, which keep returning to the same values, never leave it.
+ *
+ * Rows of tiles are updated in parallel. With `skip_static_tiles`, tiles
+ * that were all background and that a `MotionMap` of the same grid marks
+ * inactive are left alone and come out as background. Tiles holding
+ * foreground keep updating so stopped objects are absorbed, and every
+ * `refresh_interval` frames all tiles are updated so slow lighting changes
+ * are still learned.
+ *
+ * Frames with a `Frame::roi` only update the pixels inside it: tiles its
+ * mask leaves out are skipped like static ones, and pixels outside it in
+ * partially covered tiles are background.
+ *
+ * Masks are `FOURCC_Y800` frames, 255 for foreground and 0 for background,
+ * from the model's own `FramePool`.
+ */
+class BackgroundModel {
+  private:
+    BackgroundOptions           options_;
+    std::shared_ptr<ThreadPool> workers_;
+    std::shared_ptr<FramePool>  pool_{};
+
+    MediaFormat          format_{};
+    std::vector<uint8_t> tile_foreground_{}; // Per tile, from the last update
+    uint64_t             frames_{};
+
+    // Fixed-point model, one array per quantity and mode
+    std::vector<uint16_t> average_{};
+    std::vector<uint16_t> mean_[BACKGROUND_MODES]{};
+    std::vector<uint16_t> variance_[BACKGROUND_MODES]{};
+    std::vector<uint16_t> weight_[BACKGROUND_MODES]{};
+
+    BackgroundStats stats_{};
+
+    void initialize(const uint8_t* luma);
+
+  public:
+    /**
+     * @param workers Pool to update tiles on, shared with other stages. A
+     * private pool with `options.threads` workers is created if null.
+     */
+    explicit BackgroundModel(const BackgroundOptions&    options = {},
+                             std::shared_ptr<ThreadPool> workers = nullptr);
+
+    /**
+     * @brief Update the model with `frame` and produce its foreground mask.
+     * @param motion Tile motion of `frame`, used by `skip_static_tiles`.
+     * Ignored when absent or on a different tile grid.
+     * @return 0 on success, 204 for the first frame or after a format change
+     * (the model is seeded with it and the mask is empty), -400 for subtypes
+     * without luma, a short buffer or invalid options, -404 if the requested
+     * kernel is not available.
+     */
+    int16_t apply(const Frame& frame, Frame& mask,
+                  const MotionMap* motion = nullptr);
+
+    /**
+     * @brief Forget the learned background.
+     */
+    void reset();
+
+    const BackgroundOptions& getOptions() const { return this->options_; }
+    BackgroundStats          getStats() const { return this->stats_; }
+};
+
+#endif // BACKGROUND_MODEL_H
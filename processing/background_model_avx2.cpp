@@ -0,0 +1,72 @@
+#include "background_model_kernel.h"
+
+#include <immintrin.h>
+
+namespace {
+
+struct Avx2 {
+    using V = __m256i;
+
+    static V zero() { return _mm256_setzero_si256(); }
+    static V set1_epi16(int16_t value) { return _mm256_set1_epi16(value); }
+
+    static V and_(V a, V b) { return _mm256_and_si256(a, b); }
+    static V or_(V a, V b) { return _mm256_or_si256(a, b); }
+    static V andnot(V a, V b) { return _mm256_andnot_si256(a, b); }
+    static V add_epi16(V a, V b) { return _mm256_add_epi16(a, b); }
+    static V sub_epi16(V a, V b) { return _mm256_sub_epi16(a, b); }
+    static V subs_epu16(V a, V b) { return _mm256_subs_epu16(a, b); }
+    static V max_epi16(V a, V b) { return _mm256_max_epi16(a, b); }
+    static V min_epi16(V a, V b) { return _mm256_min_epi16(a, b); }
+    static V mulhi_epi16(V a, V b) { return _mm256_mulhi_epi16(a, b); }
+    static V mulhi_epu16(V a, V b) { return _mm256_mulhi_epu16(a, b); }
+    static V cmpgt_epi16(V a, V b) { return _mm256_cmpgt_epi16(a, b); }
+    static V cmpeq_epi16(V a, V b) { return _mm256_cmpeq_epi16(a, b); }
+    static V slli_epi16_3(V a) { return _mm256_slli_epi16(a, 3); }
+    static V slli_epi16_7(V a) { return _mm256_slli_epi16(a, 7); }
+    static V srli_epi16_7(V a) { return _mm256_srli_epi16(a, 7); }
+
+    // Sixteen pixels widened to 16 bits, in order across both lanes
+    static V loadLuma(const uint8_t* p) {
+        return _mm256_cvtepu8_epi16(
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(p)));
+    }
+
+    static V loadWords(const uint16_t* p) {
+        return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+    }
+
+    static void storeWords(uint16_t* p, V value) {
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), value);
+    }
+
+    // Packing works per lane; the permute brings both halves together
+    static void storeMask(uint8_t* p, V mask) {
+        V packed = _mm256_permute4x64_epi64(_mm256_packs_epi16(mask, mask), 0x08);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(p),
+                         _mm256_castsi256_si128(packed));
+    }
+
+    static uint32_t sumWords(V value) {
+        alignas(32) int16_t lanes[16];
+        _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), value);
+        uint32_t sum = 0;
+        for (int16_t lane : lanes) {
+            sum += static_cast<uint32_t>(lane);
+        }
+        return sum;
+    }
+};
+
+} // namespace
+
+uint32_t averageSpanAvx2(const BackgroundConstants& c, const uint8_t* luma,
+                         uint16_t* average, uint8_t* mask, std::size_t count) {
+    return averageSpanSimd<Avx2>(c, luma, average, mask, count);
+}
+
+uint32_t mixtureSpanAvx2(const BackgroundConstants& c, const uint8_t* luma,
+                         const MixturePlanes& planes, uint8_t* mask,
+                         std::size_t count) {
+    return mixtureSpanSimd<Avx2>(c, luma, planes, mask, count);
+}
@@ -0,0 +1,66 @@
+#include "background_model_kernel.h"
+
+#include <immintrin.h>
+
+namespace {
+
+struct Avx512 {
+    using V = __m512i;
+
+    static V zero() { return _mm512_setzero_si512(); }
+    static V set1_epi16(int16_t value) { return _mm512_set1_epi16(value); }
+
+    static V and_(V a, V b) { return _mm512_and_si512(a, b); }
+    static V or_(V a, V b) { return _mm512_or_si512(a, b); }
+    static V andnot(V a, V b) { return _mm512_andnot_si512(a, b); }
+    static V add_epi16(V a, V b) { return _mm512_add_epi16(a, b); }
+    static V sub_epi16(V a, V b) { return _mm512_sub_epi16(a, b); }
+    static V subs_epu16(V a, V b) { return _mm512_subs_epu16(a, b); }
+    static V max_epi16(V a, V b) { return _mm512_max_epi16(a, b); }
+    static V min_epi16(V a, V b) { return _mm512_min_epi16(a, b); }
+    static V mulhi_epi16(V a, V b) { return _mm512_mulhi_epi16(a, b); }
+    static V mulhi_epu16(V a, V b) { return _mm512_mulhi_epu16(a, b); }
+    static V slli_epi16_3(V a) { return _mm512_slli_epi16(a, 3); }
+    static V slli_epi16_7(V a) { return _mm512_slli_epi16(a, 7); }
+    static V srli_epi16_7(V a) { return _mm512_srli_epi16(a, 7); }
+
+    // Comparisons produce bit masks; expand them back to 0 / -1 lanes
+    static V cmpgt_epi16(V a, V b) {
+        return _mm512_movm_epi16(_mm512_cmpgt_epi16_mask(a, b));
+    }
+    static V cmpeq_epi16(V a, V b) {
+        return _mm512_movm_epi16(_mm512_cmpeq_epi16_mask(a, b));
+    }
+
+    // Thirty-two pixels widened to 16 bits
+    static V loadLuma(const uint8_t* p) {
+        return _mm512_cvtepu8_epi16(
+            _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)));
+    }
+
+    static V loadWords(const uint16_t* p) { return _mm512_loadu_si512(p); }
+    static void storeWords(uint16_t* p, V value) { _mm512_storeu_si512(p, value); }
+
+    static void storeMask(uint8_t* p, V mask) {
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(p),
+                            _mm512_cvtepi16_epi8(mask));
+    }
+
+    static uint32_t sumWords(V value) {
+        V pairs = _mm512_madd_epi16(value, _mm512_set1_epi16(1));
+        return static_cast<uint32_t>(_mm512_reduce_add_epi32(pairs));
+    }
+};
+
+} // namespace
+
+uint32_t averageSpanAvx512(const BackgroundConstants& c, const uint8_t* luma,
+                           uint16_t* average, uint8_t* mask, std::size_t count) {
+    return averageSpanSimd<Avx512>(c, luma, average, mask, count);
+}
+
+uint32_t mixtureSpanAvx512(const BackgroundConstants& c, const uint8_t* luma,
+                           const MixturePlanes& planes, uint8_t* mask,
+                           std::size_t count) {
+    return mixtureSpanSimd<Avx512>(c, luma, planes, mask, count);
+}
@@ -0,0 +1,308 @@
+#ifndef BACKGROUND_MODEL_KERNEL_H
+#define BACKGROUND_MODEL_KERNEL_H
+
+// Internal to the background model. The SIMD translation units include this
+// header and instantiate the `*SpanSimd` templates with their instruction set
+// wrapper; the scalar functions here are the reference every kernel matches.
+// Helpers are `static` so each translation unit keeps its own copy, built
+// with its own instruction set.
+//
+// Every quantity fits a signed 16-bit lane: luma in Q7, variance in Q3 and
+// weights in Q15. Updates are `value += 2 * mulhi(target - value, rate)`
+// with the rate in Q15, which is what `_mm_mulhi_epi16` computes.
+
+#include "background_model.h"
+
+constexpr int32_t BACKGROUND_WEIGHT_ONE   = 0x7FFF;      // Q15
+constexpr int32_t BACKGROUND_MIN_VARIANCE = 4 * 4 * 8;   // Q3, sigma of 4 levels
+constexpr int32_t BACKGROUND_MAX_VARIANCE = 0x7FFF;      // Q3, sigma of 64 levels
+constexpr int32_t BACKGROUND_MAX_DISTANCE = 0x7FFF >> 3; // Squared levels
+
+/**
+ * @brief Options converted to the fixed-point formats of the model.
+ */
+struct BackgroundConstants {
+    int32_t rate{};              // Q15
+    int32_t threshold{};         // Luma levels
+    int32_t match{};             // match_sigmas^2 in Q12, unsigned
+    int32_t initial_variance{};  // Q3
+    int32_t background_weight{}; // Q15
+};
+
+/**
+ * @brief Model planes of the mixture, advanced to the first pixel of a span.
+ */
+struct MixturePlanes {
+    uint16_t* mean[BACKGROUND_MODES];
+    uint16_t* variance[BACKGROUND_MODES];
+    uint16_t* weight[BACKGROUND_MODES];
+};
+
+static inline int32_t mulhiSigned(int32_t a, int32_t b) { return (a * b) >> 16; }
+
+static inline int32_t mulhiUnsigned(uint32_t a, uint32_t b) {
+    return static_cast<int32_t>((a * b) >> 16);
+}
+
+static inline int32_t approach(int32_t value, int32_t target, int32_t rate) {
+    return value + 2 * mulhiSigned(target - value, rate);
+}
+
+/**
+ * @brief Running average update and classification of `count` pixels.
+ * @return Foreground pixels.
+ */
+static inline uint32_t averageSpanScalar(const BackgroundConstants& c,
+                                         const uint8_t* luma, uint16_t* average,
+                                         uint8_t* mask, std::size_t count) {
+    uint32_t foreground = 0;
+    for (std::size_t i = 0; i < count; ++i) {
+        const int32_t x          = luma[i];
+        const int32_t a          = average[i];
+        const int32_t background = (a + 64) >> 7;
+        const int32_t distance   = x > background ? x - background : background - x;
+        const bool    moving     = distance > c.threshold;
+
+        average[i] = static_cast<uint16_t>(approach(a, x << 7, c.rate));
+        mask[i]    = moving ? 255 : 0;
+        foreground += moving;
+    }
+    return foreground;
+}
+
+/**
+ * @brief Mixture update and classification of `count` pixels.
+ *
+ * The first mode within `match` of the pixel is updated and the others
+ * decay. Without a match the weakest mode is replaced by the pixel.
+ *
+ * @return Foreground pixels.
+ */
+static inline uint32_t mixtureSpanScalar(const BackgroundConstants& c,
+                                         const uint8_t* luma,
+                                         const MixturePlanes& planes,
+                                         uint8_t* mask, std::size_t count) {
+    uint32_t foreground = 0;
+    for (std::size_t i = 0; i < count; ++i) {
+        const int32_t x = luma[i] << 7;
+
+        int     matched = -1;
+        int     weakest = 0;
+        int32_t distance[BACKGROUND_MODES];
+        int32_t difference[BACKGROUND_MODES];
+        for (std::size_t k = 0; k < BACKGROUND_MODES; ++k) {
+            const int32_t d     = x - planes.mean[k][i];
+            const int32_t twice = 2 * (d < 0 ? -d : d);
+            difference[k]       = d;
+            distance[k]         = mulhiUnsigned(twice, twice);
+            const int32_t limit = mulhiUnsigned(2 * planes.variance[k][i], c.match);
+            if (matched < 0 && distance[k] < limit) {
+                matched = static_cast<int>(k);
+            }
+            if (planes.weight[k][i] < planes.weight[weakest][i]) {
+                weakest = static_cast<int>(k);
+            }
+        }
+
+        const bool background =
+            matched >= 0 && planes.weight[matched][i] >= c.background_weight;
+        mask[i] = background ? 0 : 255;
+        foreground += !background;
+
+        for (std::size_t k = 0; k < BACKGROUND_MODES; ++k) {
+            const int32_t w = planes.weight[k][i];
+            if (static_cast<int>(k) != matched) {
+                planes.weight[k][i] = static_cast<uint16_t>(w - 2 * mulhiSigned(w, c.rate));
+                continue;
+            }
+            planes.weight[k][i] =
+                static_cast<uint16_t>(approach(w, BACKGROUND_WEIGHT_ONE, c.rate));
+            planes.mean[k][i] = static_cast<uint16_t>(
+                planes.mean[k][i] + 2 * mulhiSigned(difference[k], c.rate));
+
+            const int32_t target = std::min(distance[k], BACKGROUND_MAX_DISTANCE) << 3;
+            const int32_t v = approach(planes.variance[k][i], target, c.rate);
+            planes.variance[k][i] = static_cast<uint16_t>(
+                std::max(BACKGROUND_MIN_VARIANCE, std::min(v, BACKGROUND_MAX_VARIANCE)));
+        }
+        if (matched < 0) {
+            planes.mean[weakest][i]     = static_cast<uint16_t>(x);
+            planes.variance[weakest][i] = static_cast<uint16_t>(c.initial_variance);
+            planes.weight[weakest][i]   = static_cast<uint16_t>(c.rate);
+        }
+    }
+    return foreground;
+}
+
+/**
+ * @brief Running average over a span, shared by the SSE2, AVX2 and AVX-512
+ * kernels. `Isa` widens luma to one 16-bit lane per pixel, so one register
+ * covers `sizeof(V) / 2` pixels of every plane.
+ */
+template <typename Isa>
+uint32_t averageSpanSimd(const BackgroundConstants& c, const uint8_t* luma,
+                         uint16_t* average, uint8_t* mask, std::size_t count) {
+    using V                     = typename Isa::V;
+    constexpr std::size_t PIXELS = sizeof(V) / 2;
+
+    const V rate      = Isa::set1_epi16(c.rate);
+    const V threshold = Isa::set1_epi16(c.threshold);
+    const V round     = Isa::set1_epi16(64);
+    V       moving    = Isa::zero(); // Minus the foreground count per lane
+
+    std::size_t i = 0;
+    for (; i + PIXELS <= count; i += PIXELS) {
+        V x          = Isa::loadLuma(luma + i);
+        V a          = Isa::loadWords(average + i);
+        V background = Isa::srli_epi16_7(Isa::add_epi16(a, round));
+        V distance   = Isa::sub_epi16(Isa::max_epi16(x, background),
+                                      Isa::min_epi16(x, background));
+        V foreground = Isa::cmpgt_epi16(distance, threshold);
+        V step = Isa::mulhi_epi16(Isa::sub_epi16(Isa::slli_epi16_7(x), a), rate);
+
+        Isa::storeWords(average + i, Isa::add_epi16(a, Isa::add_epi16(step, step)));
+        Isa::storeMask(mask + i, foreground);
+        moving = Isa::sub_epi16(moving, foreground);
+    }
+    return Isa::sumWords(moving) +
+           averageSpanScalar(c, luma + i, average + i, mask + i, count - i);
+}
+
+/**
+ * @brief Mixture over a span, see `averageSpanSimd`. Every branch of the
+ * scalar reference becomes a lane mask and a select.
+ */
+template <typename Isa>
+uint32_t mixtureSpanSimd(const BackgroundConstants& c, const uint8_t* luma,
+                         const MixturePlanes& planes, uint8_t* mask,
+                         std::size_t count) {
+    using V                     = typename Isa::V;
+    constexpr std::size_t PIXELS = sizeof(V) / 2;
+    constexpr std::size_t K      = BACKGROUND_MODES;
+
+    const V zero         = Isa::zero();
+    const V ones         = Isa::set1_epi16(-1);
+    const V rate         = Isa::set1_epi16(static_cast<int16_t>(c.rate));
+    const V match        = Isa::set1_epi16(static_cast<int16_t>(c.match));
+    const V weight_one   = Isa::set1_epi16(BACKGROUND_WEIGHT_ONE);
+    const V min_variance = Isa::set1_epi16(BACKGROUND_MIN_VARIANCE);
+    const V max_variance = Isa::set1_epi16(BACKGROUND_MAX_VARIANCE);
+    const V max_distance = Isa::set1_epi16(BACKGROUND_MAX_DISTANCE);
+    const V initial      = Isa::set1_epi16(static_cast<int16_t>(c.initial_variance));
+    const V below_weight =
+        Isa::set1_epi16(static_cast<int16_t>(c.background_weight - 1));
+
+    auto select = [](V condition, V a, V b) {
+        return Isa::or_(Isa::and_(condition, a), Isa::andnot(condition, b));
+    };
+    auto approach = [&](V value, V target) {
+        V step = Isa::mulhi_epi16(Isa::sub_epi16(target, value), rate);
+        return Isa::add_epi16(value, Isa::add_epi16(step, step));
+    };
+
+    V moving = zero; // Minus the foreground count per lane
+
+    std::size_t i = 0;
+    for (; i + PIXELS <= count; i += PIXELS) {
+        V x = Isa::slli_epi16_7(Isa::loadLuma(luma + i));
+
+        V mean[K], variance[K], weight[K], difference[K], distance[K], hit[K];
+        for (std::size_t k = 0; k < K; ++k) {
+            mean[k]     = Isa::loadWords(planes.mean[k] + i);
+            variance[k] = Isa::loadWords(planes.variance[k] + i);
+            weight[k]   = Isa::loadWords(planes.weight[k] + i);
+
+            difference[k] = Isa::sub_epi16(x, mean[k]);
+            V twice       = Isa::max_epi16(difference[k],
+                                           Isa::sub_epi16(zero, difference[k]));
+            twice         = Isa::add_epi16(twice, twice);
+            distance[k]   = Isa::mulhi_epu16(twice, twice);
+            V limit = Isa::mulhi_epu16(Isa::add_epi16(variance[k], variance[k]),
+                                       match);
+            // distance < limit, unsigned
+            hit[k] = Isa::andnot(
+                Isa::cmpeq_epi16(Isa::subs_epu16(limit, distance[k]), zero), ones);
+        }
+
+        V selected[K];
+        V any       = hit[0];
+        selected[0] = hit[0];
+        for (std::size_t k = 1; k < K; ++k) {
+            selected[k] = Isa::andnot(any, hit[k]);
+            any         = Isa::or_(any, hit[k]);
+        }
+
+        // The weakest mode is the first one with the smallest weight: lighter
+        // than every mode before it and no heavier than any after it
+        V weakest[K];
+        for (std::size_t k = 0; k < K; ++k) {
+            V beaten = zero;
+            for (std::size_t j = 0; j < K; ++j) {
+                if (j < k) {
+                    V lighter = Isa::cmpgt_epi16(weight[j], weight[k]);
+                    beaten    = Isa::or_(beaten, Isa::andnot(lighter, ones));
+                } else if (j > k) {
+                    beaten = Isa::or_(beaten, Isa::cmpgt_epi16(weight[k], weight[j]));
+                }
+            }
+            weakest[k] = Isa::andnot(beaten, ones);
+        }
+
+        V matched_weight = zero;
+        for (std::size_t k = 0; k < K; ++k) {
+            matched_weight = Isa::or_(matched_weight, Isa::and_(selected[k], weight[k]));
+        }
+        V background = Isa::and_(any, Isa::cmpgt_epi16(matched_weight, below_weight));
+        V foreground = Isa::andnot(background, ones);
+        Isa::storeMask(mask + i, foreground);
+        moving = Isa::sub_epi16(moving, foreground);
+
+        for (std::size_t k = 0; k < K; ++k) {
+            V decayed = Isa::mulhi_epi16(weight[k], rate);
+            decayed   = Isa::sub_epi16(weight[k], Isa::add_epi16(decayed, decayed));
+            V w       = select(selected[k], approach(weight[k], weight_one), decayed);
+
+            V step = Isa::mulhi_epi16(difference[k], rate);
+            V m    = select(selected[k], Isa::add_epi16(mean[k], Isa::add_epi16(step, step)),
+                            mean[k]);
+
+            // min(distance, max_distance) << 3, unsigned
+            V target = Isa::sub_epi16(distance[k],
+                                      Isa::subs_epu16(distance[k], max_distance));
+            V v      = approach(variance[k], Isa::slli_epi16_3(target));
+            v        = Isa::max_epi16(min_variance, Isa::min_epi16(v, max_variance));
+            v        = select(selected[k], v, variance[k]);
+
+            V replace = Isa::andnot(any, weakest[k]);
+            Isa::storeWords(planes.mean[k] + i, select(replace, x, m));
+            Isa::storeWords(planes.variance[k] + i, select(replace, initial, v));
+            Isa::storeWords(planes.weight[k] + i, select(replace, rate, w));
+        }
+    }
+
+    MixturePlanes rest = planes;
+    for (std::size_t k = 0; k < K; ++k) {
+        rest.mean[k] += i, rest.variance[k] += i, rest.weight[k] += i;
+    }
+    return Isa::sumWords(moving) +
+           mixtureSpanScalar(c, luma + i, rest, mask + i, count - i);
+}
+
+uint32_t averageSpanSse2(const BackgroundConstants& c, const uint8_t* luma,
+                         uint16_t* average, uint8_t* mask, std::size_t count);
+uint32_t averageSpanAvx2(const BackgroundConstants& c, const uint8_t* luma,
+                         uint16_t* average, uint8_t* mask, std::size_t count);
+uint32_t averageSpanAvx512(const BackgroundConstants& c, const uint8_t* luma,
+                           uint16_t* average, uint8_t* mask, std::size_t count);
+
+uint32_t mixtureSpanSse2(const BackgroundConstants& c, const uint8_t* luma,
+                         const MixturePlanes& planes, uint8_t* mask,
+                         std::size_t count);
+uint32_t mixtureSpanAvx2(const BackgroundConstants& c, const uint8_t* luma,
+                         const MixturePlanes& planes, uint8_t* mask,
+                         std::size_t count);
+uint32_t mixtureSpanAvx512(const BackgroundConstants& c, const uint8_t* luma,
+                           const MixturePlanes& planes, uint8_t* mask,
+                           std::size_t count);
+
+#endif // BACKGROUND_MODEL_KERNEL_H
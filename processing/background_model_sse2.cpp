@@ -0,0 +1,70 @@
+#include "background_model_kernel.h"
+
+#include <emmintrin.h>
+
+namespace {
+
+struct Sse2 {
+    using V = __m128i;
+
+    static V zero() { return _mm_setzero_si128(); }
+    static V set1_epi16(int16_t value) { return _mm_set1_epi16(value); }
+
+    static V and_(V a, V b) { return _mm_and_si128(a, b); }
+    static V or_(V a, V b) { return _mm_or_si128(a, b); }
+    static V andnot(V a, V b) { return _mm_andnot_si128(a, b); }
+    static V add_epi16(V a, V b) { return _mm_add_epi16(a, b); }
+    static V sub_epi16(V a, V b) { return _mm_sub_epi16(a, b); }
+    static V subs_epu16(V a, V b) { return _mm_subs_epu16(a, b); }
+    static V max_epi16(V a, V b) { return _mm_max_epi16(a, b); }
+    static V min_epi16(V a, V b) { return _mm_min_epi16(a, b); }
+    static V mulhi_epi16(V a, V b) { return _mm_mulhi_epi16(a, b); }
+    static V mulhi_epu16(V a, V b) { return _mm_mulhi_epu16(a, b); }
+    static V cmpgt_epi16(V a, V b) { return _mm_cmpgt_epi16(a, b); }
+    static V cmpeq_epi16(V a, V b) { return _mm_cmpeq_epi16(a, b); }
+    static V slli_epi16_3(V a) { return _mm_slli_epi16(a, 3); }
+    static V slli_epi16_7(V a) { return _mm_slli_epi16(a, 7); }
+    static V srli_epi16_7(V a) { return _mm_srli_epi16(a, 7); }
+
+    // Eight pixels widened to 16 bits
+    static V loadLuma(const uint8_t* p) {
+        return _mm_unpacklo_epi8(
+            _mm_loadl_epi64(reinterpret_cast<const __m128i*>(p)), zero());
+    }
+
+    static V loadWords(const uint16_t* p) {
+        return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+    }
+
+    static void storeWords(uint16_t* p, V value) {
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(p), value);
+    }
+
+    // 0 / -1 lanes to 0 / 255 bytes
+    static void storeMask(uint8_t* p, V mask) {
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(p), _mm_packs_epi16(mask, mask));
+    }
+
+    static uint32_t sumWords(V value) {
+        alignas(16) int16_t lanes[8];
+        _mm_store_si128(reinterpret_cast<__m128i*>(lanes), value);
+        uint32_t sum = 0;
+        for (int16_t lane : lanes) {
+            sum += static_cast<uint32_t>(lane);
+        }
+        return sum;
+    }
+};
+
+} // namespace
+
+uint32_t averageSpanSse2(const BackgroundConstants& c, const uint8_t* luma,
+                         uint16_t* average, uint8_t* mask, std::size_t count) {
+    return averageSpanSimd<Sse2>(c, luma, average, mask, count);
+}
+
+uint32_t mixtureSpanSse2(const BackgroundConstants& c, const uint8_t* luma,
+                         const MixturePlanes& planes, uint8_t* mask,
+                         std::size_t count) {
+    return mixtureSpanSimd<Sse2>(c, luma, planes, mask, count);
+}
@@ -0,0 +1,358 @@
+#include "blob_extractor.h"
+
+#include "hardware/webcam/frame_trace.h"
+#include "hardware/webcam/region_of_interest.h"
+#include <algorithm>
+#include <cstring>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace {
+
+constexpr uint32_t BANDS_PER_WORKER = 4;
+constexpr uint32_t MIN_BAND_ROWS    = 16;
+
+constexpr uint32_t CHUNK_PIXELS     = 64;
+
+constexpr uint64_t LOWS   = 0x7F7F7F7F7F7F7F7Full;
+constexpr uint64_t HIGHS  = 0x8080808080808080ull;
+constexpr uint64_t GATHER = 0x0102040810204080ull;
+
+uint32_t lowestBit(uint64_t value) {
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward64(&index, value);
+    return index;
+#else
+    return static_cast<uint32_t>(__builtin_ctzll(value));
+#endif
+}
+
+/**
+ * @brief Bit `i` set if pixel `i` of the `count` (at most 64) at `row` is
+ * non-zero, eight pixels per step. Empty chunks, the bulk of sparse masks,
+ * return after one OR of their words.
+ */
+uint64_t foregroundBits(const uint8_t* row, uint32_t count) {
+    if (count == CHUNK_PIXELS) {
+        uint64_t words[CHUNK_PIXELS / 8];
+        std::memcpy(words, row, sizeof(words));
+        uint64_t any = 0;
+        for (uint64_t word : words) {
+            any |= word;
+        }
+        if (any == 0) {
+            return 0;
+        }
+        uint64_t bits = 0;
+        for (uint32_t i = 0; i < CHUNK_PIXELS / 8; ++i) {
+            // High bit of every non-zero byte, then those eight bits packed
+            const uint64_t high = (words[i] | ((words[i] & LOWS) + LOWS)) & HIGHS;
+            bits |= (((high >> 7) * GATHER) >> 56) << (i * 8);
+        }
+        return bits;
+    }
+    uint64_t bits = 0;
+    for (uint32_t i = 0; i < count; ++i) {
+        bits |= static_cast<uint64_t>(row[i] != 0) << i;
+    }
+    return bits;
+}
+
+uint64_t sumSquares(uint64_t n) {
+    return n == 0 ? 0 : (n - 1) * n * (2 * n - 1) / 6;
+}
+
+void addRun(Blob& blob, uint32_t y, uint32_t begin, uint32_t end) {
+    const uint64_t length = end - begin;
+    const uint64_t sum_x  = (static_cast<uint64_t>(begin) + end - 1) * length / 2;
+    if (blob.area == 0) {
+        blob.left = begin, blob.right = end - 1;
+        blob.top = y, blob.bottom = y;
+    } else {
+        blob.left   = std::min(blob.left, begin);
+        blob.right  = std::max(blob.right, end - 1);
+        blob.top    = std::min(blob.top, y);
+        blob.bottom = std::max(blob.bottom, y);
+    }
+    blob.area   += length;
+    blob.sum_x  += sum_x;
+    blob.sum_y  += length * y;
+    blob.sum_xx += sumSquares(end) - sumSquares(begin);
+    blob.sum_xy += sum_x * y;
+    blob.sum_yy += length * y * y;
+}
+
+void mergeBlob(Blob& blob, const Blob& other) {
+    blob.left   = std::min(blob.left, other.left);
+    blob.right  = std::max(blob.right, other.right);
+    blob.top    = std::min(blob.top, other.top);
+    blob.bottom = std::max(blob.bottom, other.bottom);
+    blob.area   += other.area;
+    blob.sum_x  += other.sum_x;
+    blob.sum_y  += other.sum_y;
+    blob.sum_xx += other.sum_xx;
+    blob.sum_xy += other.sum_xy;
+    blob.sum_yy += other.sum_yy;
+}
+
+void finishBlob(Blob& blob) {
+    const double area = static_cast<double>(blob.area);
+    blob.centroid_x   = static_cast<double>(blob.sum_x) / area;
+    blob.centroid_y   = static_cast<double>(blob.sum_y) / area;
+    blob.mu20 = static_cast<double>(blob.sum_xx) / area - blob.centroid_x * blob.centroid_x;
+    blob.mu11 = static_cast<double>(blob.sum_xy) / area - blob.centroid_x * blob.centroid_y;
+    blob.mu02 = static_cast<double>(blob.sum_yy) / area - blob.centroid_y * blob.centroid_y;
+}
+
+uint32_t findRoot(std::vector<uint32_t>& parent, uint32_t index) {
+    while (parent[index] != index) {
+        parent[index] = parent[parent[index]]; // Path halving
+        index         = parent[index];
+    }
+    return index;
+}
+
+// Links the higher root below the lower one, so a root is always the lowest
+// index of its set
+void unite(std::vector<uint32_t>& parent, uint32_t a, uint32_t b) {
+    a = findRoot(parent, a);
+    b = findRoot(parent, b);
+    if (a < b) {
+        parent[b] = a;
+    } else if (b < a) {
+        parent[a] = b;
+    }
+}
+
+/**
+ * @brief Calls `join(i, j)` for every run `lower[i]`, `i` in `[row, row_end)`,
+ * touching a run `upper[j]` of the row above, `j` in `[above, above_end)`.
+ * Runs of a row are sorted by column. `reach` is 1 when diagonal neighbours
+ * touch.
+ */
+template <typename Run, typename Join>
+void joinRows(const Run* upper, uint32_t above, uint32_t above_end,
+              const Run* lower, uint32_t row, uint32_t row_end, uint32_t reach,
+              Join&& join) {
+    uint32_t first = above;
+    for (uint32_t i = row; i < row_end; ++i) {
+        // Runs ending before this one starts cannot touch later ones either
+        while (first < above_end && upper[first].end + reach <= lower[i].begin) {
+            ++first;
+        }
+        for (uint32_t j = first;
+             j < above_end && upper[j].begin < lower[i].end + reach; ++j) {
+            join(i, j);
+        }
+    }
+}
+
+} // namespace
+
+BlobExtractor::BlobExtractor(const BlobOptions&          options,
+                             std::shared_ptr<ThreadPool> workers)
+    : options_(options), workers_(std::move(workers)) {
+    if (!this->workers_) {
+        this->workers_ = std::make_shared<ThreadPool>(options.threads);
+    }
+}
+
+void BlobExtractor::labelBand(Band& band, const uint8_t* mask,
+                              std::size_t stride, uint32_t width,
+                              uint32_t row_begin, uint32_t row_end,
+                              const RoiMask* roi) const {
+    band.runs.clear();
+    band.row_start.clear();
+    // Runs start and end where a pixel differs from its left neighbour
+    auto scan = [&](const uint8_t* row, uint32_t x_begin, uint32_t x_end) {
+        uint64_t carry = 0; // Last pixel of the previous chunk
+        uint32_t begin = 0;
+        bool     open  = false;
+        for (uint32_t x = x_begin; x < x_end; x += CHUNK_PIXELS) {
+            const uint64_t bits =
+                foregroundBits(row + x, std::min(CHUNK_PIXELS, x_end - x));
+            uint64_t edges = bits ^ (bits << 1 | carry);
+            carry          = bits >> 63;
+            while (edges != 0) {
+                const uint32_t at = x + lowestBit(edges);
+                edges &= edges - 1;
+                if (open) {
+                    band.runs.push_back({begin, at});
+                } else {
+                    begin = at;
+                }
+                open = !open;
+            }
+        }
+        if (open) {
+            band.runs.push_back({begin, x_end});
+        }
+    };
+    for (uint32_t y = row_begin; y < row_end; ++y) {
+        band.row_start.push_back(static_cast<uint32_t>(band.runs.size()));
+        const uint8_t* row = mask + y * stride;
+        if (!roi) {
+            scan(row, 0, width);
+            continue;
+        }
+        // Spans of a row are disjoint and apart, so are their runs
+        for (uint32_t i = roi->row_start[y]; i < roi->row_start[y + 1]; ++i) {
+            scan(row, roi->spans[i].begin, roi->spans[i].end);
+        }
+    }
+    band.row_start.push_back(static_cast<uint32_t>(band.runs.size()));
+
+    const auto count = static_cast<uint32_t>(band.runs.size());
+    band.parent.resize(count);
+    for (uint32_t i = 0; i < count; ++i) {
+        band.parent[i] = i;
+    }
+    const uint32_t reach = this->options_.eight_connected ? 1 : 0;
+    for (uint32_t r = 1; r < row_end - row_begin; ++r) {
+        // A run is still alone when it meets its first run above, and takes
+        // that run's root; only later meetings can join two sets
+        uint32_t joined = count;
+        joinRows(band.runs.data(), band.row_start[r - 1], band.row_start[r],
+                 band.runs.data(), band.row_start[r], band.row_start[r + 1], reach,
+                 [&](uint32_t a, uint32_t b) {
+                     if (a != joined) {
+                         band.parent[a] = findRoot(band.parent, b);
+                         joined         = a;
+                     } else {
+                         unite(band.parent, a, b);
+                     }
+                 });
+    }
+
+    // Roots come first in their set, so one forward pass numbers components
+    // in raster order and replaces each parent by its component
+    band.components.clear();
+    for (uint32_t r = 0; r < row_end - row_begin; ++r) {
+        for (uint32_t i = band.row_start[r]; i < band.row_start[r + 1]; ++i) {
+            const uint32_t above = band.parent[i];
+            if (above == i) {
+                band.parent[i] = static_cast<uint32_t>(band.components.size());
+                band.components.emplace_back();
+            } else {
+                // Lower indices were already replaced by their component
+                band.parent[i] = band.parent[above];
+            }
+            addRun(band.components[band.parent[i]], row_begin + r,
+                   band.runs[i].begin, band.runs[i].end);
+        }
+    }
+}
+
+int16_t BlobExtractor::extract(const uint8_t* mask, std::size_t stride,
+                               uint32_t width, uint32_t height,
+                               std::vector<Blob>& blobs, const RoiMask* roi) {
+    blobs.clear();
+    this->stats_ = {};
+    if (!mask || width == 0 || height == 0 || stride < width ||
+        (roi && (roi->width != width || roi->height != height))) {
+        return -400;
+    }
+
+    // Only the rows the region reaches are split into bands
+    const uint32_t first     = roi ? roi->top : 0;
+    const uint32_t rows      = roi ? roi->bottom - roi->top : height;
+    uint32_t       band_rows = this->options_.band_rows;
+    if (band_rows == 0) {
+        const std::size_t bands = this->workers_->size() * BANDS_PER_WORKER;
+        band_rows = static_cast<uint32_t>((rows + bands - 1) / bands);
+        band_rows = std::max(band_rows, MIN_BAND_ROWS);
+    }
+    const uint32_t bands = (rows + band_rows - 1) / band_rows;
+    if (bands == 0) {
+        return 0;
+    }
+    if (this->bands_.size() < bands) {
+        this->bands_.resize(bands);
+    }
+
+    this->workers_->parallelFor(
+        bands, 1, [&](std::size_t begin, std::size_t end) {
+            for (std::size_t b = begin; b < end; ++b) {
+                const auto top = first + static_cast<uint32_t>(b * band_rows);
+                this->labelBand(this->bands_[b], mask, stride, width, top,
+                                std::min(top + band_rows, first + rows), roi);
+            }
+        });
+
+    // Components of all bands are numbered band after band, which keeps the
+    // raster order of their first runs
+    std::size_t components = 0;
+    for (uint32_t b = 0; b < bands; ++b) {
+        components        += this->bands_[b].components.size();
+        this->stats_.runs += this->bands_[b].runs.size();
+    }
+    this->parent_.resize(components);
+    this->label_.resize(components);
+    for (uint32_t i = 0; i < components; ++i) {
+        this->parent_[i] = i;
+    }
+
+    const uint32_t reach  = this->options_.eight_connected ? 1 : 0;
+    uint32_t       offset = 0; // First component of band `b`
+    for (uint32_t b = 0; b + 1 < bands; ++b) {
+        const Band&    upper      = this->bands_[b];
+        const Band&    lower      = this->bands_[b + 1];
+        const uint32_t next       = offset + static_cast<uint32_t>(upper.components.size());
+        // Join the last row of `upper` with the first row of `lower`
+        joinRows(upper.runs.data(), upper.row_start[upper.row_start.size() - 2],
+                 static_cast<uint32_t>(upper.runs.size()), lower.runs.data(), 0,
+                 lower.row_start[1], reach, [&](uint32_t a, uint32_t b) {
+                     unite(this->parent_, next + lower.parent[a],
+                           offset + upper.parent[b]);
+                 });
+        offset = next;
+    }
+
+    offset = 0;
+    for (uint32_t b = 0; b < bands; ++b) {
+        const std::vector<Blob>& partial = this->bands_[b].components;
+        for (uint32_t c = 0; c < partial.size(); ++c) {
+            const uint32_t index = offset + c;
+            const uint32_t root  = findRoot(this->parent_, index);
+            if (root == index) {
+                this->label_[index] = static_cast<uint32_t>(blobs.size());
+                blobs.push_back(partial[c]);
+            } else {
+                this->label_[index] = this->label_[root];
+                mergeBlob(blobs[this->label_[root]], partial[c]);
+            }
+        }
+        offset += static_cast<uint32_t>(partial.size());
+    }
+
+    std::size_t kept = 0;
+    for (Blob& blob : blobs) {
+        if (blob.area >= this->options_.min_area) {
+            finishBlob(blob);
+            blobs[kept++] = blob;
+        }
+    }
+    this->stats_.dropped = blobs.size() - kept;
+    this->stats_.blobs   = kept;
+    this->stats_.bands   = bands;
+    blobs.resize(kept);
+    return 0;
+}
+
+int16_t BlobExtractor::extract(const Frame& mask, std::vector<Blob>& blobs) {
+    TraceScope         trace(mask, TraceStage::Process, "blobs");
+    const MediaFormat& format = mask.format;
+    if (format.subtype != FOURCC_Y800 ||
+        mask.buffer.size() < static_cast<std::size_t>(format.width) * format.height) {
+        blobs.clear();
+        this->stats_ = {};
+        return -400;
+    }
+    const auto roi = mask.roi ? mask.roi->getMask(format.width, format.height)
+                              : nullptr;
+    return this->extract(mask.buffer.data(), format.width, format.width,
+                         format.height, blobs, roi.get());
+}
@@ -0,0 +1,127 @@
+#ifndef BLOB_EXTRACTOR_H
+#define BLOB_EXTRACTOR_H
+
+#include "hardware/webcam/frame.h"
+#include "thread_pool.h"
+#include <memory>
+#include <vector>
+
+struct RoiMask;
+
+struct BlobOptions {
+    bool        eight_connected{true}; // Diagonal neighbours join blobs
+    uint32_t    min_area{1};           // Smaller blobs are dropped
+    uint32_t    band_rows{0};          // Rows labelled per task, 0 to split
+                                       // the mask into 4 bands per worker
+    std::size_t threads{0};            // Private pool size, 0 for one per
+                                       // hardware thread
+};
+
+/**
+ * @brief One connected foreground region.
+ *
+ * Moments are exact sums over the region's pixel coordinates; the centroid
+ * and the central second moments (per pixel, the covariance of the pixel
+ * coordinates) are derived from them.
+ */
+struct Blob {
+    uint32_t left{};   // Bounding box, inclusive
+    uint32_t top{};
+    uint32_t right{};
+    uint32_t bottom{};
+    uint64_t area{};   // Pixels
+    uint64_t sum_x{};  // First order moments
+    uint64_t sum_y{};
+    uint64_t sum_xx{}; // Second order moments
+    uint64_t sum_xy{};
+    uint64_t sum_yy{};
+    double   centroid_x{};
+    double   centroid_y{};
+    double   mu20{};
+    double   mu11{};
+    double   mu02{};
+};
+
+/**
+ * @brief Counters of the last extraction.
+ */
+struct BlobStats {
+    std::size_t runs{};    // Horizontal runs of foreground pixels
+    std::size_t blobs{};   // Blobs reported
+    std::size_t dropped{}; // Blobs below `min_area`
+    std::size_t bands{};   // Tasks the mask was split into
+};
+
+/**
+ * @brief Connected-components labelling of foreground masks.
+ *
+ * The mask is split into bands of rows labelled in parallel. Each band
+ * collects the runs of non-zero pixels of its rows from a bit per pixel,
+ * 64 pixels at a time, joins overlapping runs of consecutive rows with a
+ * union-find over runs and sums the moments of each of its components. A
+ * sequential pass then joins the components that touch across band borders
+ * and merges their sums, so its cost depends on the number of components,
+ * not on the size of the mask. Roots are always the lowest index, which
+ * makes the result independent of the band split: blobs come out ordered by
+ * their first pixel in raster order.
+ *
+ * All buffers, and the caller's blob vector, are reused from frame to frame.
+ */
+class BlobExtractor {
+  private:
+    struct Run {
+        uint32_t begin; // First column
+        uint32_t end;   // One past the last column
+    };
+
+    struct Band {
+        std::vector<Run>      runs{};
+        std::vector<uint32_t> row_start{}; // First run of each row, and the end
+        std::vector<uint32_t> parent{};    // Union-find, then component per run
+        std::vector<Blob>     components{};
+    };
+
+    BlobOptions                 options_;
+    std::shared_ptr<ThreadPool> workers_;
+    std::vector<Band>           bands_{};
+    std::vector<uint32_t>       parent_{}; // Union-find over all components
+    std::vector<uint32_t>       label_{};  // Blob of each root component
+    BlobStats                   stats_{};
+
+    void labelBand(Band& band, const uint8_t* mask, std::size_t stride,
+                   uint32_t width, uint32_t row_begin, uint32_t row_end,
+                   const RoiMask* roi) const;
+
+  public:
+    /**
+     * @param workers Pool to label bands on, shared with other stages. A
+     * private pool with `options.threads` workers is created if null.
+     */
+    explicit BlobExtractor(const BlobOptions&          options = {},
+                           std::shared_ptr<ThreadPool> workers = nullptr);
+
+    /**
+     * @brief Label a mask of `width * height` bytes, non-zero for foreground.
+     * @param stride Bytes between rows of `mask`.
+     * @param blobs Cleared and filled; its capacity is reused.
+     * @param roi Region rasterized for this mask. Only the pixels inside it
+     * are read, the others count as background. Null reads the whole mask.
+     * @return 0 on success, -400 for an empty or null mask or a region of
+     * another size.
+     */
+    int16_t extract(const uint8_t* mask, std::size_t stride, uint32_t width,
+                    uint32_t height, std::vector<Blob>& blobs,
+                    const RoiMask* roi = nullptr);
+
+    /**
+     * @brief Label a `FOURCC_Y800` mask frame, such as a `BackgroundModel`
+     * mask, within its `Frame::roi`.
+     * @return 0 on success, -400 for other subtypes or a short buffer.
+     */
+    int16_t extract(const Frame& mask, std::vector<Blob>& blobs);
+
+    const BlobOptions& getOptions() const { return this->options_; }
+    BlobStats          getStats() const { return this->stats_; }
+};
+
+#endif // BLOB_EXTRACTOR_H
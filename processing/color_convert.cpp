@@ -0,0 +1,245 @@
+#include "color_convert.h"
+
+#include "color_convert_kernel.h"
+#include "hardware/webcam/frame_trace.h"
+#include "hardware/webcam/pixel_format.h"
+#include "hardware/webcam/region_of_interest.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+using RowsFunction = void (*)(const ConvertJob&, uint32_t, uint32_t);
+
+ColorCoefficients makeCoefficients(ColorMatrix matrix, ColorRange range) {
+    const double kr = matrix == ColorMatrix::Bt709 ? 0.2126 : 0.299;
+    const double kb = matrix == ColorMatrix::Bt709 ? 0.0722 : 0.114;
+    const double kg = 1.0 - kr - kb;
+
+    double y_scale = 1.0, c_scale = 1.0;
+    if (range == ColorRange::Limited) {
+        y_scale = 255.0 / 219.0;
+        c_scale = 255.0 / 224.0;
+    }
+
+    auto q13 = [](double value) {
+        return static_cast<int32_t>(std::lround(value * (1 << COLOR_SHIFT)));
+    };
+
+    ColorCoefficients c;
+    c.y_offset = range == ColorRange::Limited ? 16 : 0;
+    c.y_scale  = q13(y_scale);
+    c.r_v      = q13(2.0 * (1.0 - kr) * c_scale);
+    c.g_u      = q13(2.0 * (1.0 - kb) * kb / kg * c_scale);
+    c.g_v      = q13(2.0 * (1.0 - kr) * kr / kg * c_scale);
+    c.b_u      = q13(2.0 * (1.0 - kb) * c_scale);
+    return c;
+}
+
+const ColorCoefficients& coefficients(ColorMatrix matrix, ColorRange range) {
+    static const ColorCoefficients table[2][2] = {
+        {makeCoefficients(ColorMatrix::Bt601, ColorRange::Limited),
+         makeCoefficients(ColorMatrix::Bt601, ColorRange::Full)},
+        {makeCoefficients(ColorMatrix::Bt709, ColorRange::Limited),
+         makeCoefficients(ColorMatrix::Bt709, ColorRange::Full)},
+    };
+    return table[matrix == ColorMatrix::Bt709][range == ColorRange::Full];
+}
+
+RowsFunction rowsFunction(SimdKernel kernel) {
+    switch (kernel) {
+    case SimdKernel::Scalar:
+        return convertRowsScalar;
+#ifdef COLOR_CONVERT_SSE2
+    case SimdKernel::Sse2:
+        return convertRowsSse2;
+#endif
+#ifdef COLOR_CONVERT_AVX2
+    case SimdKernel::Avx2:
+        return convertRowsAvx2;
+#endif
+#ifdef COLOR_CONVERT_AVX512
+    case SimdKernel::Avx512:
+        return convertRowsAvx512;
+#endif
+    default:
+        return nullptr;
+    }
+}
+
+/**
+ * @brief Convert the tiles `roi` covers, one run of tiles at a time.
+ *
+ * A run starts on a tile edge, which is even, so it starts on a chroma
+ * sample too; the kernels see a narrower image whose planes begin at the
+ * run's first column.
+ */
+void convertCovered(RowsFunction rows, const ConvertJob& job,
+                    const PixelFormatTraits& traits, const RoiMask& roi) {
+    auto column = [&](std::size_t plane, uint32_t x) {
+        return (x >> traits.plane[plane].shift_x) * traits.plane[plane].bytes;
+    };
+    const std::size_t pixel_size = bytesPerPixel(job.output);
+
+    for (uint32_t ty = 0; ty < roi.tiles_y; ++ty) {
+        const uint32_t row_begin = ty * roi.tile_size;
+        const uint32_t row_end   = std::min(job.height, row_begin + roi.tile_size);
+        for (uint32_t i = roi.tile_row_start[ty]; i < roi.tile_row_start[ty + 1]; ++i) {
+            const uint32_t x_begin = roi.tile_runs[i].begin * roi.tile_size;
+            const uint32_t x_end   = std::min(job.width, roi.tile_runs[i].end * roi.tile_size);
+
+            ConvertJob run = job;
+            run.y          = job.y + column(0, x_begin);
+            run.u          = job.u ? job.u + column(1, x_begin) : nullptr;
+            run.v          = job.v ? job.v + column(2, x_begin) : nullptr;
+            run.width      = x_end - x_begin;
+            run.dst        = job.dst + x_begin * pixel_size;
+            rows(run, row_begin, row_end);
+        }
+    }
+}
+
+} // namespace
+
+bool isConvertible(uint32_t subtype) {
+    const PixelFormatTraits* traits = findPixelFormat(subtype);
+    return traits && traits->conversion != PixelConversion::None;
+}
+
+std::size_t bytesPerPixel(PixelOutput output) {
+    return output == PixelOutput::Gray ? 1 : 4;
+}
+
+uint32_t outputSubtype(PixelOutput output) {
+    switch (output) {
+    case PixelOutput::Bgra:
+        return FOURCC_BGRA;
+    case PixelOutput::Gray:
+        return FOURCC_Y800;
+    default:
+        return FOURCC_RGBA;
+    }
+}
+
+bool isColorKernelAvailable(SimdKernel kernel) {
+    return rowsFunction(kernel) && cpuSupports(kernel);
+}
+
+SimdKernel bestColorKernel() {
+    static const SimdKernel best = [] {
+        for (SimdKernel kernel :
+             {SimdKernel::Avx512, SimdKernel::Avx2, SimdKernel::Sse2}) {
+            if (isColorKernelAvailable(kernel)) {
+                return kernel;
+            }
+        }
+        return SimdKernel::Scalar;
+    }();
+    return best;
+}
+
+int16_t convertImage(uint32_t subtype, const uint8_t* src, uint32_t width,
+                     uint32_t height, uint8_t* dst, std::size_t dst_stride,
+                     PixelOutput output, const ColorSettings& settings,
+                     const RoiMask* roi) {
+    if (!isConvertible(subtype) || !src || !dst ||
+        dst_stride < width * bytesPerPixel(output) ||
+        (roi && (roi->width != width || roi->height != height ||
+                 roi->tile_size % 2 != 0))) {
+        return -400;
+    }
+
+    SimdKernel kernel = settings.kernel == SimdKernel::Auto
+                            ? bestColorKernel()
+                            : settings.kernel;
+    if (!isColorKernelAvailable(kernel)) {
+        return -404;
+    }
+
+    const PixelFormatTraits& traits = *findPixelFormat(subtype);
+
+    ConvertJob job;
+    job.y            = src;
+    job.y_stride     = planeStride(traits, 0, width);
+    job.width        = width;
+    job.height       = height;
+    job.dst          = dst;
+    job.dst_stride   = dst_stride;
+    job.output       = output;
+    job.coefficients = coefficients(settings.matrix, settings.range);
+
+    switch (traits.conversion) {
+    case PixelConversion::Packed422:
+        job.layout = YuvLayout::Packed422;
+        job.uyvy   = traits.chroma_first;
+        break;
+    case PixelConversion::SemiPlanar420:
+        job.layout    = YuvLayout::SemiPlanar420;
+        job.u         = src + planeOffset(traits, 1, width, height);
+        job.uv_stride = planeStride(traits, 1, width);
+        break;
+    default:
+        job.layout    = YuvLayout::Planar420;
+        job.u         = src + planeOffset(traits, 1, width, height);
+        job.v         = src + planeOffset(traits, 2, width, height);
+        job.uv_stride = planeStride(traits, 1, width);
+        if (traits.swap_chroma) {
+            std::swap(job.u, job.v);
+        }
+        break;
+    }
+
+    if (roi) {
+        convertCovered(rowsFunction(kernel), job, traits, *roi);
+    } else {
+        rowsFunction(kernel)(job, 0, height);
+    }
+    return 0;
+}
+
+int16_t convertFrame(const Frame& frame, uint8_t* dst, std::size_t dst_stride,
+                     PixelOutput output, const ColorSettings& settings) {
+    if (frame.buffer.size() < rawFrameSize(frame.format)) {
+        return -400;
+    }
+    TraceScope trace(frame, TraceStage::Convert);
+    const auto roi = frame.roi ? frame.roi->getMask(frame.format.width,
+                                                    frame.format.height)
+                               : nullptr;
+    return convertImage(frame.format.subtype, frame.buffer.data(),
+                        frame.format.width, frame.format.height, dst,
+                        dst_stride, output, settings, roi.get());
+}
+
+bool hasLumaPlane(uint32_t subtype) {
+    const PixelFormatTraits* traits = findPixelFormat(subtype);
+    return traits && traits->luma_plane;
+}
+
+int16_t extractLuma(const Frame& frame, FrameBufferRef& luma) {
+    const MediaFormat& format = frame.format;
+    const PixelFormatTraits* traits = findPixelFormat(format.subtype);
+    const bool packed = traits && traits->conversion == PixelConversion::Packed422;
+    if ((!packed && !hasLumaPlane(format.subtype)) ||
+        frame.buffer.size() < rawFrameSize(format)) {
+        return -400;
+    }
+    if (!packed) {
+        luma = frame.buffer;
+        return 0;
+    }
+
+    TraceScope        trace(frame, TraceStage::Convert, "luma");
+    const std::size_t size = static_cast<std::size_t>(format.width) * format.height;
+    if (luma.capacity() < size || luma.useCount() > 1) {
+        luma = FrameBufferRef::allocate(size);
+    }
+    luma.setSize(size);
+    const auto roi = frame.roi ? frame.roi->getMask(format.width, format.height)
+                               : nullptr;
+    // Full range BT.601 gray is the identity on Y
+    return convertImage(format.subtype, frame.buffer.data(), format.width,
+                        format.height, luma.data(), format.width,
+                        PixelOutput::Gray, {ColorMatrix::Bt601, ColorRange::Full},
+                        roi.get());
+}
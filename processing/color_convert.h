@@ -0,0 +1,103 @@
+#ifndef COLOR_CONVERT_H
+#define COLOR_CONVERT_H
+
+#include "cpu_features.h"
+#include "hardware/webcam/frame.h"
+#include "hardware/webcam/frame_pool.h"
+#include <cstddef>
+#include <cstdint>
+
+struct RoiMask;
+
+enum class ColorMatrix { Bt601, Bt709 };
+
+enum class ColorRange {
+    Limited, // Y in 16..235, chroma in 16..240 (what cameras send)
+    Full     // Y and chroma in 0..255 (JPEG)
+};
+
+enum class PixelOutput {
+    Rgba, // R, G, B, A bytes, DXGI_FORMAT_R8G8B8A8_UNORM
+    Bgra, // B, G, R, A bytes, DXGI_FORMAT_B8G8R8A8_UNORM
+    Gray  // One luma byte per pixel
+};
+
+struct ColorSettings {
+    ColorMatrix matrix{ColorMatrix::Bt601};
+    ColorRange  range{ColorRange::Limited};
+    SimdKernel  kernel{SimdKernel::Auto};
+};
+
+/**
+ * @brief Whether `subtype` has a conversion path in the pixel format
+ * registry (YUY2, UYVY, NV12, I420, IYUV and YV12).
+ */
+bool isConvertible(uint32_t subtype);
+
+/**
+ * @brief Bytes per output pixel, 4 for RGBA/BGRA and 1 for gray.
+ */
+std::size_t bytesPerPixel(PixelOutput output);
+
+/**
+ * @brief FourCC of frames holding `output` pixels, e.g. `FOURCC_RGBA`.
+ */
+uint32_t outputSubtype(PixelOutput output);
+
+/**
+ * @brief Kernel `SimdKernel::Auto` resolves to on this CPU.
+ */
+SimdKernel bestColorKernel();
+
+/**
+ * @brief Whether `kernel` was compiled in and the CPU supports it.
+ */
+bool isColorKernelAvailable(SimdKernel kernel);
+
+/**
+ * @brief Convert a tightly packed YUV image.
+ *
+ * All kernels produce bit-identical output: the SIMD paths evaluate the same
+ * 13-bit fixed-point formula as the scalar reference.
+ *
+ * @param dst_stride Bytes between output rows.
+ * @param roi Region to convert, rasterized for this image with an even tile
+ * size. Only the tiles it covers are written; the rest of `dst` keeps what
+ * it held, so the cost follows the region's area. Null converts the whole
+ * image.
+ * @return 0 on success, -400 for an unsupported subtype, output that does
+ * not fit or a mask of another size, -404 if the requested kernel is not
+ * available.
+ */
+int16_t convertImage(uint32_t subtype, const uint8_t* src, uint32_t width,
+                     uint32_t height, uint8_t* dst, std::size_t dst_stride,
+                     PixelOutput output, const ColorSettings& settings = {},
+                     const RoiMask* roi = nullptr);
+
+/**
+ * @brief Convert a captured frame, see `convertImage`. Frames with a
+ * `Frame::roi` are converted over the tiles of its mask only.
+ */
+int16_t convertFrame(const Frame& frame, uint8_t* dst, std::size_t dst_stride,
+                     PixelOutput output, const ColorSettings& settings = {});
+
+/**
+ * @brief Whether frames of `subtype` start with a full resolution luma plane
+ * (NV12, I420, IYUV, YV12 and Y800).
+ */
+bool hasLumaPlane(uint32_t subtype);
+
+/**
+ * @brief The luma of `frame` as a tightly packed plane of `width * height`
+ * bytes.
+ *
+ * Frames with a luma plane share their buffer with `luma`. Packed 4:2:2
+ * frames are converted into `luma`, reusing its block when it is big enough
+ * and not shared with anyone else. For frames with a `Frame::roi` only the
+ * tiles its mask covers are extracted, the rest of the plane is undefined.
+ *
+ * @return 0 on success, -400 for subtypes without luma or a short buffer.
+ */
+int16_t extractLuma(const Frame& frame, FrameBufferRef& luma);
+
+#endif // COLOR_CONVERT_H
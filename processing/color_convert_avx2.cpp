@@ -0,0 +1,68 @@
+#include "color_convert_kernel.h"
+
+#include <immintrin.h>
+
+namespace {
+
+struct Avx2 {
+    using V                        = __m256i;
+    static constexpr uint32_t LANES = 2;
+
+    static V zero() { return _mm256_setzero_si256(); }
+    static V set1_epi16(int16_t value) { return _mm256_set1_epi16(value); }
+    static V set1_epi32(int32_t value) { return _mm256_set1_epi32(value); }
+
+    static V and_(V a, V b) { return _mm256_and_si256(a, b); }
+    static V srli_epi16_8(V a) { return _mm256_srli_epi16(a, 8); }
+    static V sub_epi16(V a, V b) { return _mm256_sub_epi16(a, b); }
+    static V add_epi32(V a, V b) { return _mm256_add_epi32(a, b); }
+    static V srai_epi32(V a, int shift) { return _mm256_srai_epi32(a, shift); }
+    static V madd(V a, V b) { return _mm256_madd_epi16(a, b); }
+    static V packs_epi32(V a, V b) { return _mm256_packs_epi32(a, b); }
+    static V packus_epi16(V a, V b) { return _mm256_packus_epi16(a, b); }
+    static V unpacklo_epi8(V a, V b) { return _mm256_unpacklo_epi8(a, b); }
+    static V unpackhi_epi8(V a, V b) { return _mm256_unpackhi_epi8(a, b); }
+    static V unpacklo_epi16(V a, V b) { return _mm256_unpacklo_epi16(a, b); }
+    static V unpackhi_epi16(V a, V b) { return _mm256_unpackhi_epi16(a, b); }
+    static V unpacklo_epi32(V a, V b) { return _mm256_unpacklo_epi32(a, b); }
+    static V unpackhi_epi32(V a, V b) { return _mm256_unpackhi_epi32(a, b); }
+
+    static V loadBytes(const uint8_t* p) {
+        return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+    }
+
+    // Lane n gets bytes 32n..32n+15 in `first` and 32n+16..32n+31 in `second`
+    static void loadPacked(const uint8_t* p, V& first, V& second) {
+        V a    = loadBytes(p);
+        V b    = loadBytes(p + 32);
+        first  = _mm256_permute2x128_si256(a, b, 0x20);
+        second = _mm256_permute2x128_si256(a, b, 0x31);
+    }
+
+    static V loadPlanarUv(const uint8_t* u, const uint8_t* v) {
+        __m128i us   = _mm_loadu_si128(reinterpret_cast<const __m128i*>(u));
+        __m128i vs   = _mm_loadu_si128(reinterpret_cast<const __m128i*>(v));
+        __m128i low  = _mm_unpacklo_epi8(us, vs);
+        __m128i high = _mm_unpackhi_epi8(us, vs);
+        return _mm256_inserti128_si256(_mm256_castsi128_si256(low), high, 1);
+    }
+
+    static void storeBytes(uint8_t* p, V value) {
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), value);
+    }
+
+    // o0..o3 hold pixels 0-3, 4-7, 8-11, 12-15 of each lane's 16 pixel group
+    static void storeRgba(uint8_t* p, V o0, V o1, V o2, V o3) {
+        storeBytes(p, _mm256_permute2x128_si256(o0, o1, 0x20));
+        storeBytes(p + 32, _mm256_permute2x128_si256(o2, o3, 0x20));
+        storeBytes(p + 64, _mm256_permute2x128_si256(o0, o1, 0x31));
+        storeBytes(p + 96, _mm256_permute2x128_si256(o2, o3, 0x31));
+    }
+};
+
+} // namespace
+
+void convertRowsAvx2(const ConvertJob& job, uint32_t row_begin,
+                     uint32_t row_end) {
+    convertRowsSimd<Avx2>(job, row_begin, row_end);
+}
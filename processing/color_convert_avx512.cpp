@@ -0,0 +1,70 @@
+#include "color_convert_kernel.h"
+
+#include <immintrin.h>
+
+namespace {
+
+struct Avx512 {
+    using V                        = __m512i;
+    static constexpr uint32_t LANES = 4;
+
+    static V zero() { return _mm512_setzero_si512(); }
+    static V set1_epi16(int16_t value) { return _mm512_set1_epi16(value); }
+    static V set1_epi32(int32_t value) { return _mm512_set1_epi32(value); }
+
+    static V and_(V a, V b) { return _mm512_and_si512(a, b); }
+    static V srli_epi16_8(V a) { return _mm512_srli_epi16(a, 8); }
+    static V sub_epi16(V a, V b) { return _mm512_sub_epi16(a, b); }
+    static V add_epi32(V a, V b) { return _mm512_add_epi32(a, b); }
+    static V srai_epi32(V a, int shift) { return _mm512_srai_epi32(a, shift); }
+    static V madd(V a, V b) { return _mm512_madd_epi16(a, b); }
+    static V packs_epi32(V a, V b) { return _mm512_packs_epi32(a, b); }
+    static V packus_epi16(V a, V b) { return _mm512_packus_epi16(a, b); }
+    static V unpacklo_epi8(V a, V b) { return _mm512_unpacklo_epi8(a, b); }
+    static V unpackhi_epi8(V a, V b) { return _mm512_unpackhi_epi8(a, b); }
+    static V unpacklo_epi16(V a, V b) { return _mm512_unpacklo_epi16(a, b); }
+    static V unpackhi_epi16(V a, V b) { return _mm512_unpackhi_epi16(a, b); }
+    static V unpacklo_epi32(V a, V b) { return _mm512_unpacklo_epi32(a, b); }
+    static V unpackhi_epi32(V a, V b) { return _mm512_unpackhi_epi32(a, b); }
+
+    static V loadBytes(const uint8_t* p) { return _mm512_loadu_si512(p); }
+
+    // Lane n gets bytes 32n..32n+15 in `first` and 32n+16..32n+31 in `second`
+    static void loadPacked(const uint8_t* p, V& first, V& second) {
+        V a    = loadBytes(p);
+        V b    = loadBytes(p + 64);
+        first  = _mm512_shuffle_i64x2(a, b, 0x88);
+        second = _mm512_shuffle_i64x2(a, b, 0xDD);
+    }
+
+    static V loadPlanarUv(const uint8_t* u, const uint8_t* v) {
+        __m256i us   = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(u));
+        __m256i vs   = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(v));
+        __m256i low  = _mm256_unpacklo_epi8(us, vs); // Chroma 0-7 | 16-23
+        __m256i high = _mm256_unpackhi_epi8(us, vs); // Chroma 8-15 | 24-31
+        return _mm512_inserti64x4(
+            _mm512_castsi256_si512(_mm256_permute2x128_si256(low, high, 0x20)),
+            _mm256_permute2x128_si256(low, high, 0x31), 1);
+    }
+
+    static void storeBytes(uint8_t* p, V value) { _mm512_storeu_si512(p, value); }
+
+    // 4x4 transpose of 128-bit blocks: store n holds lane n of o0..o3
+    static void storeRgba(uint8_t* p, V o0, V o1, V o2, V o3) {
+        V t0 = _mm512_shuffle_i64x2(o0, o1, 0x44);
+        V t1 = _mm512_shuffle_i64x2(o0, o1, 0xEE);
+        V t2 = _mm512_shuffle_i64x2(o2, o3, 0x44);
+        V t3 = _mm512_shuffle_i64x2(o2, o3, 0xEE);
+        storeBytes(p, _mm512_shuffle_i64x2(t0, t2, 0x88));
+        storeBytes(p + 64, _mm512_shuffle_i64x2(t0, t2, 0xDD));
+        storeBytes(p + 128, _mm512_shuffle_i64x2(t1, t3, 0x88));
+        storeBytes(p + 192, _mm512_shuffle_i64x2(t1, t3, 0xDD));
+    }
+};
+
+} // namespace
+
+void convertRowsAvx512(const ConvertJob& job, uint32_t row_begin,
+                       uint32_t row_end) {
+    convertRowsSimd<Avx512>(job, row_begin, row_end);
+}
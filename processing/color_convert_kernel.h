@@ -0,0 +1,247 @@
+#ifndef COLOR_CONVERT_KERNEL_H
+#define COLOR_CONVERT_KERNEL_H
+
+// Internal to the color conversion module. The SIMD translation units include
+// this header and instantiate `convertRowsSimd` with their instruction set
+// wrapper; the scalar functions here are the reference every kernel matches.
+// Helpers are `static` so each translation unit keeps its own copy, built
+// with its own instruction set.
+
+#include "color_convert.h"
+#include <utility>
+
+constexpr int COLOR_SHIFT = 13;
+constexpr int COLOR_ROUND = 1 << (COLOR_SHIFT - 1);
+
+/**
+ * @brief Fixed-point (Q13) YUV to RGB coefficients.
+ *
+ * Every value fits an int16 so the SIMD kernels can use 16x16->32 bit
+ * multiply-adds. `g_u` and `g_v` are stored positive and subtracted.
+ */
+struct ColorCoefficients {
+    int32_t y_offset{};
+    int32_t y_scale{};
+    int32_t r_v{};
+    int32_t g_u{};
+    int32_t g_v{};
+    int32_t b_u{};
+};
+
+enum class YuvLayout {
+    Packed422,     // YUY2, UYVY
+    SemiPlanar420, // NV12, interleaved UV plane in `u`
+    Planar420      // I420, IYUV, YV12
+};
+
+struct ConvertJob {
+    YuvLayout      layout{YuvLayout::Packed422};
+    bool           uyvy{false}; // Packed422 byte order is U Y V Y
+    const uint8_t* y{nullptr};  // Luma plane, or the packed image
+    const uint8_t* u{nullptr};
+    const uint8_t* v{nullptr};
+    std::size_t    y_stride{};
+    std::size_t    uv_stride{};
+    uint32_t       width{};
+    uint32_t       height{};
+    uint8_t*       dst{nullptr};
+    std::size_t    dst_stride{};
+    PixelOutput    output{PixelOutput::Rgba};
+
+    ColorCoefficients coefficients{};
+};
+
+static inline uint8_t clampColor(int32_t value) {
+    return static_cast<uint8_t>(value < 0 ? 0 : (value > 255 ? 255 : value));
+}
+
+static inline void writePixel(const ColorCoefficients& c, PixelOutput output,
+                              int32_t y, int32_t u, int32_t v, uint8_t* dst) {
+    const int32_t luma = (y - c.y_offset) * c.y_scale + COLOR_ROUND;
+    if (output == PixelOutput::Gray) {
+        dst[0] = clampColor(luma >> COLOR_SHIFT);
+        return;
+    }
+    const int32_t d = u - 128;
+    const int32_t e = v - 128;
+    const uint8_t r = clampColor((luma + c.r_v * e) >> COLOR_SHIFT);
+    const uint8_t g = clampColor((luma - c.g_u * d - c.g_v * e) >> COLOR_SHIFT);
+    const uint8_t b = clampColor((luma + c.b_u * d) >> COLOR_SHIFT);
+    if (output == PixelOutput::Rgba) {
+        dst[0] = r, dst[1] = g, dst[2] = b;
+    } else {
+        dst[0] = b, dst[1] = g, dst[2] = r;
+    }
+    dst[3] = 255;
+}
+
+/**
+ * @brief Scalar conversion of pixels `[x_begin, width)` of one row.
+ */
+static inline void convertRowScalar(const ConvertJob& job, uint32_t row,
+                                    uint32_t x_begin) {
+    const std::size_t pixel_size = bytesPerPixel(job.output);
+    uint8_t*          dst        = job.dst + row * job.dst_stride;
+
+    for (uint32_t x = x_begin; x < job.width; ++x) {
+        int32_t y, u, v;
+        switch (job.layout) {
+        case YuvLayout::Packed422: {
+            const uint8_t* pair = job.y + row * job.y_stride + (x / 2) * 4;
+            if (job.uyvy) {
+                y = pair[1 + (x & 1) * 2], u = pair[0], v = pair[2];
+            } else {
+                y = pair[(x & 1) * 2], u = pair[1], v = pair[3];
+            }
+            break;
+        }
+        case YuvLayout::SemiPlanar420: {
+            const uint8_t* uv = job.u + (row / 2) * job.uv_stride + (x / 2) * 2;
+            y = job.y[row * job.y_stride + x], u = uv[0], v = uv[1];
+            break;
+        }
+        default: {
+            const std::size_t chroma = (row / 2) * job.uv_stride + x / 2;
+            y = job.y[row * job.y_stride + x], u = job.u[chroma],
+            v = job.v[chroma];
+            break;
+        }
+        }
+        writePixel(job.coefficients, job.output, y, u, v, dst + x * pixel_size);
+    }
+}
+
+static inline void convertRowsScalar(const ConvertJob& job, uint32_t row_begin,
+                                     uint32_t row_end) {
+    for (uint32_t row = row_begin; row < row_end; ++row) {
+        convertRowScalar(job, row, 0);
+    }
+}
+
+/**
+ * @brief Row loop shared by the SSE2, AVX2 and AVX-512 kernels.
+ *
+ * `Isa` wraps the intrinsics of one instruction set. All arithmetic it
+ * exposes works within 128-bit lanes, so each lane converts its own group of
+ * 16 pixels exactly like the SSE2 kernel would; only the loads and the RGBA
+ * store move data between lanes. Pixels past the last full block go through
+ * the scalar path.
+ */
+template <typename Isa>
+void convertRowsSimd(const ConvertJob& job, uint32_t row_begin,
+                     uint32_t row_end) {
+    using V                  = typename Isa::V;
+    constexpr uint32_t BLOCK = 16 * Isa::LANES;
+
+    const ColorCoefficients& c = job.coefficients;
+    auto pair = [](int32_t low, int32_t high) {
+        return Isa::set1_epi32(static_cast<int32_t>(
+            (static_cast<uint32_t>(high) << 16) |
+            (static_cast<uint32_t>(low) & 0xFFFF)));
+    };
+    const V y_k      = pair(c.y_scale, COLOR_ROUND);
+    const V r_k      = pair(0, c.r_v);
+    const V g_k      = pair(-c.g_u, -c.g_v);
+    const V b_k      = pair(c.b_u, 0);
+    const V ones     = Isa::set1_epi16(1);
+    const V y_offset = Isa::set1_epi16(static_cast<int16_t>(c.y_offset));
+    const V bias     = Isa::set1_epi16(128);
+    const V low_byte = Isa::set1_epi16(0x00FF);
+    const V alpha    = Isa::set1_epi16(-1);
+    const V zero     = Isa::zero();
+    const bool gray  = job.output == PixelOutput::Gray;
+    const bool bgra  = job.output == PixelOutput::Bgra;
+
+    // Eight pixels per lane: luma as int16, chroma as (u, v) int16 pairs
+    auto channel = [&](V luma_low, V luma_high, V chroma, const V& k) {
+        V term = Isa::madd(chroma, k);
+        V low  = Isa::srai_epi32(
+            Isa::add_epi32(luma_low, Isa::unpacklo_epi32(term, term)),
+            COLOR_SHIFT);
+        V high = Isa::srai_epi32(
+            Isa::add_epi32(luma_high, Isa::unpackhi_epi32(term, term)),
+            COLOR_SHIFT);
+        return Isa::packs_epi32(low, high);
+    };
+
+    for (uint32_t row = row_begin; row < row_end; ++row) {
+        const uint8_t* y_row = job.y + row * job.y_stride;
+        const uint8_t* u_row = job.u ? job.u + (row / 2) * job.uv_stride : nullptr;
+        const uint8_t* v_row = job.v ? job.v + (row / 2) * job.uv_stride : nullptr;
+        uint8_t*       dst   = job.dst + row * job.dst_stride;
+
+        uint32_t x = 0;
+        for (; x + BLOCK <= job.width; x += BLOCK) {
+            V y0, y1, uv0, uv1; // Pixels 0-7 and 8-15 of each lane
+            if (job.layout == YuvLayout::Packed422) {
+                V first, second;
+                Isa::loadPacked(y_row + x * 2, first, second);
+                if (job.uyvy) {
+                    y0 = Isa::srli_epi16_8(first), uv0 = Isa::and_(first, low_byte);
+                    y1 = Isa::srli_epi16_8(second), uv1 = Isa::and_(second, low_byte);
+                } else {
+                    y0 = Isa::and_(first, low_byte), uv0 = Isa::srli_epi16_8(first);
+                    y1 = Isa::and_(second, low_byte), uv1 = Isa::srli_epi16_8(second);
+                }
+            } else {
+                V luma   = Isa::loadBytes(y_row + x);
+                V chroma = job.layout == YuvLayout::SemiPlanar420
+                               ? Isa::loadBytes(u_row + x)
+                               : Isa::loadPlanarUv(u_row + x / 2, v_row + x / 2);
+                y0  = Isa::unpacklo_epi8(luma, zero);
+                y1  = Isa::unpackhi_epi8(luma, zero);
+                uv0 = Isa::unpacklo_epi8(chroma, zero);
+                uv1 = Isa::unpackhi_epi8(chroma, zero);
+            }
+            y0  = Isa::sub_epi16(y0, y_offset);
+            y1  = Isa::sub_epi16(y1, y_offset);
+            uv0 = Isa::sub_epi16(uv0, bias);
+            uv1 = Isa::sub_epi16(uv1, bias);
+
+            // Luma term with rounding, 32-bit, four pixels per register
+            V l0 = Isa::madd(Isa::unpacklo_epi16(y0, ones), y_k);
+            V l1 = Isa::madd(Isa::unpackhi_epi16(y0, ones), y_k);
+            V l2 = Isa::madd(Isa::unpacklo_epi16(y1, ones), y_k);
+            V l3 = Isa::madd(Isa::unpackhi_epi16(y1, ones), y_k);
+
+            if (gray) {
+                V g0 = Isa::packs_epi32(Isa::srai_epi32(l0, COLOR_SHIFT),
+                                        Isa::srai_epi32(l1, COLOR_SHIFT));
+                V g1 = Isa::packs_epi32(Isa::srai_epi32(l2, COLOR_SHIFT),
+                                        Isa::srai_epi32(l3, COLOR_SHIFT));
+                Isa::storeBytes(dst + x, Isa::packus_epi16(g0, g1));
+                continue;
+            }
+
+            V r = Isa::packus_epi16(channel(l0, l1, uv0, r_k),
+                                    channel(l2, l3, uv1, r_k));
+            V g = Isa::packus_epi16(channel(l0, l1, uv0, g_k),
+                                    channel(l2, l3, uv1, g_k));
+            V b = Isa::packus_epi16(channel(l0, l1, uv0, b_k),
+                                    channel(l2, l3, uv1, b_k));
+            if (bgra) {
+                std::swap(r, b);
+            }
+            V rg_low  = Isa::unpacklo_epi8(r, g);
+            V rg_high = Isa::unpackhi_epi8(r, g);
+            V ba_low  = Isa::unpacklo_epi8(b, alpha);
+            V ba_high = Isa::unpackhi_epi8(b, alpha);
+            Isa::storeRgba(dst + x * 4, Isa::unpacklo_epi16(rg_low, ba_low),
+                           Isa::unpackhi_epi16(rg_low, ba_low),
+                           Isa::unpacklo_epi16(rg_high, ba_high),
+                           Isa::unpackhi_epi16(rg_high, ba_high));
+        }
+        if (x < job.width) {
+            convertRowScalar(job, row, x);
+        }
+    }
+}
+
+void convertRowsSse2(const ConvertJob& job, uint32_t row_begin,
+                     uint32_t row_end);
+void convertRowsAvx2(const ConvertJob& job, uint32_t row_begin,
+                     uint32_t row_end);
+void convertRowsAvx512(const ConvertJob& job, uint32_t row_begin,
+                       uint32_t row_end);
+
+#endif // COLOR_CONVERT_KERNEL_H
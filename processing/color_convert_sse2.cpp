@@ -0,0 +1,62 @@
+#include "color_convert_kernel.h"
+
+#include <emmintrin.h>
+
+namespace {
+
+struct Sse2 {
+    using V                        = __m128i;
+    static constexpr uint32_t LANES = 1;
+
+    static V zero() { return _mm_setzero_si128(); }
+    static V set1_epi16(int16_t value) { return _mm_set1_epi16(value); }
+    static V set1_epi32(int32_t value) { return _mm_set1_epi32(value); }
+
+    static V and_(V a, V b) { return _mm_and_si128(a, b); }
+    static V srli_epi16_8(V a) { return _mm_srli_epi16(a, 8); }
+    static V sub_epi16(V a, V b) { return _mm_sub_epi16(a, b); }
+    static V add_epi32(V a, V b) { return _mm_add_epi32(a, b); }
+    static V srai_epi32(V a, int shift) { return _mm_srai_epi32(a, shift); }
+    static V madd(V a, V b) { return _mm_madd_epi16(a, b); }
+    static V packs_epi32(V a, V b) { return _mm_packs_epi32(a, b); }
+    static V packus_epi16(V a, V b) { return _mm_packus_epi16(a, b); }
+    static V unpacklo_epi8(V a, V b) { return _mm_unpacklo_epi8(a, b); }
+    static V unpackhi_epi8(V a, V b) { return _mm_unpackhi_epi8(a, b); }
+    static V unpacklo_epi16(V a, V b) { return _mm_unpacklo_epi16(a, b); }
+    static V unpackhi_epi16(V a, V b) { return _mm_unpackhi_epi16(a, b); }
+    static V unpacklo_epi32(V a, V b) { return _mm_unpacklo_epi32(a, b); }
+    static V unpackhi_epi32(V a, V b) { return _mm_unpackhi_epi32(a, b); }
+
+    static V loadBytes(const uint8_t* p) {
+        return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+    }
+
+    static void loadPacked(const uint8_t* p, V& first, V& second) {
+        first  = loadBytes(p);
+        second = loadBytes(p + 16);
+    }
+
+    static V loadPlanarUv(const uint8_t* u, const uint8_t* v) {
+        return _mm_unpacklo_epi8(
+            _mm_loadl_epi64(reinterpret_cast<const __m128i*>(u)),
+            _mm_loadl_epi64(reinterpret_cast<const __m128i*>(v)));
+    }
+
+    static void storeBytes(uint8_t* p, V value) {
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(p), value);
+    }
+
+    static void storeRgba(uint8_t* p, V o0, V o1, V o2, V o3) {
+        storeBytes(p, o0);
+        storeBytes(p + 16, o1);
+        storeBytes(p + 32, o2);
+        storeBytes(p + 48, o3);
+    }
+};
+
+} // namespace
+
+void convertRowsSse2(const ConvertJob& job, uint32_t row_begin,
+                     uint32_t row_end) {
+    convertRowsSimd<Sse2>(job, row_begin, row_end);
+}
@@ -0,0 +1,86 @@
+#include "cpu_features.h"
+
+#include <cstdint>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) ||             \
+    defined(__i386__)
+#define CPU_FEATURES_X86
+#ifdef _MSC_VER
+#include <immintrin.h>
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+namespace {
+
+#ifdef CPU_FEATURES_X86
+void cpuid(uint32_t leaf, uint32_t subleaf, uint32_t regs[4]) {
+#ifdef _MSC_VER
+    int values[4];
+    __cpuidex(values, static_cast<int>(leaf), static_cast<int>(subleaf));
+    for (int i = 0; i < 4; ++i) {
+        regs[i] = static_cast<uint32_t>(values[i]);
+    }
+#else
+    __cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+}
+
+uint64_t xgetbv0() {
+#ifdef _MSC_VER
+    return _xgetbv(0);
+#else
+    uint32_t eax, edx;
+    __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+    return (static_cast<uint64_t>(edx) << 32) | eax;
+#endif
+}
+#endif
+
+CpuFeatures detect() {
+    CpuFeatures features;
+#ifdef CPU_FEATURES_X86
+    uint32_t regs[4];
+    cpuid(0, 0, regs);
+    const uint32_t max_leaf = regs[0];
+
+    cpuid(1, 0, regs);
+    features.sse2        = (regs[3] >> 26) & 1;
+    const bool osxsave   = (regs[2] >> 27) & 1;
+    const bool avx       = (regs[2] >> 28) & 1;
+    uint64_t   xcr0      = osxsave ? xgetbv0() : 0;
+    const bool ymm_state = (xcr0 & 0x6) == 0x6;
+    const bool zmm_state = (xcr0 & 0xE6) == 0xE6;
+
+    if (max_leaf >= 7) {
+        cpuid(7, 0, regs);
+        features.avx2     = avx && ymm_state && ((regs[1] >> 5) & 1);
+        features.avx512bw = zmm_state && ((regs[1] >> 16) & 1) && // F
+                            ((regs[1] >> 30) & 1);                 // BW
+    }
+#endif
+    return features;
+}
+
+} // namespace
+
+const CpuFeatures& getCpuFeatures() {
+    static const CpuFeatures features = detect();
+    return features;
+}
+
+bool cpuSupports(SimdKernel kernel) {
+    const CpuFeatures& cpu = getCpuFeatures();
+    switch (kernel) {
+    case SimdKernel::Sse2:
+        return cpu.sse2;
+    case SimdKernel::Avx2:
+        return cpu.avx2;
+    case SimdKernel::Avx512:
+        return cpu.avx512bw;
+    default:
+        return true;
+    }
+}
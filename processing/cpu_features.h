@@ -0,0 +1,31 @@
+#ifndef CPU_FEATURES_H
+#define CPU_FEATURES_H
+
+/**
+ * @brief Instruction set extensions usable by the current process.
+ *
+ * AVX flags are only set when the OS also saves the wider registers.
+ */
+struct CpuFeatures {
+    bool sse2{false};
+    bool avx2{false};
+    bool avx512bw{false}; // AVX-512 F + BW, what the 8/16-bit kernels need
+};
+
+/**
+ * @brief Instruction set a processing kernel is built for. `Auto` picks the
+ * widest one the CPU supports and the module was compiled with.
+ */
+enum class SimdKernel { Auto, Scalar, Sse2, Avx2, Avx512 };
+
+/**
+ * @brief Detected once and cached.
+ */
+const CpuFeatures& getCpuFeatures();
+
+/**
+ * @brief Whether the CPU can run `kernel`, regardless of what was compiled.
+ */
+bool cpuSupports(SimdKernel kernel);
+
+#endif // CPU_FEATURES_H
@@ -0,0 +1,178 @@
+#include "frame_cache.h"
+
+#include "color_convert.h"
+#include "optical_flow_kernel.h"
+#include <chrono>
+#include <mutex>
+
+namespace {
+
+constexpr std::size_t POOLED_PRODUCTS = 8; // Free blocks kept per product type
+
+struct ProductCounters {
+    std::atomic<uint64_t> hits{};
+    std::atomic<uint64_t> misses{};
+    std::atomic<uint64_t> failures{};
+    std::atomic<uint64_t> compute_ns{};
+    std::atomic<uint64_t> max_compute_ns{};
+};
+
+ProductCounters counters[FRAME_PRODUCTS];
+
+/**
+ * @brief Attached to a frame's buffer by the first `frameProduct` call.
+ *
+ * Holds no handle to that buffer: a planar frame's gray product is the frame
+ * itself and is rebuilt from the caller's frame on every request.
+ */
+struct Products {
+    std::once_flag once[FRAME_PRODUCTS];
+    int16_t        status[FRAME_PRODUCTS]{};
+    Frame          frames[FRAME_PRODUCTS]{};
+};
+
+FramePool& productPool(FrameProduct product) {
+    static const std::shared_ptr<FramePool> pools[FRAME_PRODUCTS] = {
+        FramePool::create(0, 0, POOLED_PRODUCTS),
+        FramePool::create(0, 0, POOLED_PRODUCTS),
+        FramePool::create(0, 0, POOLED_PRODUCTS),
+        FramePool::create(0, 0, POOLED_PRODUCTS)};
+    return *pools[static_cast<std::size_t>(product)];
+}
+
+Frame derivedFrame(const Frame& source, FrameProduct product, uint32_t subtype,
+                   uint32_t width, uint32_t height, std::size_t size) {
+    Frame frame;
+    frame.buffer    = productPool(product).acquire(size);
+    frame.format    = {subtype, width, height, source.format.fps_numerator,
+                       source.format.fps_denominator};
+    frame.timestamp = source.timestamp;
+    frame.sequence  = source.sequence;
+    frame.arrival   = source.arrival;
+    frame.capture   = source.capture;
+    frame.trace_id  = source.trace_id;
+    frame.roi       = source.roi;
+    return frame;
+}
+
+int16_t halve(const Frame& frame, FrameProduct source, FrameProduct product,
+              Frame& result) {
+    Frame   larger;
+    int16_t status = frameProduct(frame, source, larger);
+    if (status != 0) {
+        return status;
+    }
+    const uint32_t width  = larger.format.width / 2;
+    const uint32_t height = larger.format.height / 2;
+    if (width == 0 || height == 0) {
+        return -400;
+    }
+    result = derivedFrame(frame, product, FOURCC_Y800, width, height,
+                          static_cast<std::size_t>(width) * height);
+    flowKernels(bestFlowKernel())
+        ->downsample(larger.buffer.data(), larger.format.width,
+                     result.buffer.data(), width, width, 0, height);
+    return 0;
+}
+
+int16_t compute(const Frame& frame, FrameProduct product, Frame& result) {
+    const MediaFormat& format = frame.format;
+    const std::size_t  pixels = static_cast<std::size_t>(format.width) * format.height;
+    switch (product) {
+    case FrameProduct::Gray: {
+        if (hasLumaPlane(format.subtype)) {
+            // Served from the frame itself
+            return frame.buffer.size() >= pixels && pixels > 0 ? 0 : -400;
+        }
+        result = derivedFrame(frame, product, FOURCC_Y800, format.width,
+                              format.height, pixels);
+        return extractLuma(frame, result.buffer);
+    }
+    case FrameProduct::Half:
+        return halve(frame, FrameProduct::Gray, product, result);
+    case FrameProduct::Quarter:
+        return halve(frame, FrameProduct::Half, product, result);
+    case FrameProduct::Rgba:
+        result = derivedFrame(frame, product, FOURCC_RGBA, format.width,
+                              format.height, pixels * 4);
+        return convertFrame(frame, result.buffer.data(),
+                            static_cast<std::size_t>(format.width) * 4,
+                            PixelOutput::Rgba);
+    }
+    return -400;
+}
+
+void recordCompute(ProductCounters& counter, uint64_t ns, bool failed) {
+    counter.misses.fetch_add(1, std::memory_order_relaxed);
+    counter.failures.fetch_add(failed, std::memory_order_relaxed);
+    counter.compute_ns.fetch_add(ns, std::memory_order_relaxed);
+    uint64_t slowest = counter.max_compute_ns.load(std::memory_order_relaxed);
+    while (ns > slowest && !counter.max_compute_ns.compare_exchange_weak(
+                               slowest, ns, std::memory_order_relaxed)) {
+    }
+}
+
+} // namespace
+
+int16_t frameProduct(const Frame& frame, FrameProduct product, Frame& result) {
+    const auto index = static_cast<std::size_t>(product);
+    if (!frame.buffer || index >= FRAME_PRODUCTS) {
+        return -400;
+    }
+    auto products = std::static_pointer_cast<Products>(
+        frame.buffer.attachment([] { return std::make_shared<Products>(); }));
+
+    ProductCounters& counter  = counters[index];
+    bool             computed = false;
+    std::call_once(products->once[index], [&] {
+        computed   = true;
+        auto start = std::chrono::steady_clock::now();
+        Frame derived;
+        products->status[index] = compute(frame, product, derived);
+        if (products->status[index] == 0) {
+            products->frames[index] = std::move(derived);
+        }
+        recordCompute(counter,
+                      static_cast<uint64_t>(
+                          std::chrono::duration_cast<std::chrono::nanoseconds>(
+                              std::chrono::steady_clock::now() - start)
+                              .count()),
+                      products->status[index] != 0);
+    });
+    if (!computed) {
+        counter.hits.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    const int16_t status = products->status[index];
+    if (status != 0) {
+        return status;
+    }
+    if (product == FrameProduct::Gray && hasLumaPlane(frame.format.subtype)) {
+        result                = frame;
+        result.format.subtype = FOURCC_Y800;
+    } else {
+        result = products->frames[index];
+    }
+    return 0;
+}
+
+FrameProductStats getFrameProductStats(FrameProduct product) {
+    const ProductCounters& counter = counters[static_cast<std::size_t>(product)];
+    FrameProductStats      stats;
+    stats.hits           = counter.hits.load(std::memory_order_relaxed);
+    stats.misses         = counter.misses.load(std::memory_order_relaxed);
+    stats.failures       = counter.failures.load(std::memory_order_relaxed);
+    stats.compute_ns     = counter.compute_ns.load(std::memory_order_relaxed);
+    stats.max_compute_ns = counter.max_compute_ns.load(std::memory_order_relaxed);
+    return stats;
+}
+
+void resetFrameProductStats() {
+    for (ProductCounters& counter : counters) {
+        counter.hits.store(0, std::memory_order_relaxed);
+        counter.misses.store(0, std::memory_order_relaxed);
+        counter.failures.store(0, std::memory_order_relaxed);
+        counter.compute_ns.store(0, std::memory_order_relaxed);
+        counter.max_compute_ns.store(0, std::memory_order_relaxed);
+    }
+}
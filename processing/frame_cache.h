@@ -0,0 +1,56 @@
+#ifndef FRAME_CACHE_H
+#define FRAME_CACHE_H
+
+#include "hardware/webcam/frame.h"
+#include <cstdint>
+
+/**
+ * @brief Images derived from a captured frame that several stages share.
+ */
+enum class FrameProduct {
+    Gray,    // Y800 luma at full resolution
+    Half,    // Y800 at half width and height, 2x2 box average of `Gray`
+    Quarter, // Y800 at a quarter of the width and height, from `Half`
+    Rgba     // RGBA, BT.601 limited range
+};
+
+constexpr std::size_t FRAME_PRODUCTS = 4;
+
+/**
+ * @brief Process-wide counters of one product type, cumulative.
+ */
+struct FrameProductStats {
+    uint64_t hits{};           // Requests served from a frame's cache
+    uint64_t misses{};         // Requests that computed the product
+    uint64_t failures{};       // Misses the frame could not produce
+    uint64_t compute_ns{};     // Time spent computing, over all misses,
+                               // including products computed on the way
+    uint64_t max_compute_ns{}; // Slowest single computation
+};
+
+/**
+ * @brief `product` of `frame`, computed on the first request and cached with
+ * the frame's buffer.
+ *
+ * The cache is attached to the buffer, so every copy of the frame shares it
+ * and it is freed when the buffer is released. When several threads ask for
+ * the same product at once, one computes it and the others wait for it.
+ * Products are frames of their own, in pooled buffers, and may outlive the
+ * frame they were derived from. `Gray` of a planar frame is the frame itself
+ * relabelled as `FOURCC_Y800` and costs nothing.
+ *
+ * The frame's pixels must not change once a product was requested. For a
+ * frame with a `Frame::roi`, converted products are only computed over the
+ * tiles of its mask and their other pixels are undefined.
+ *
+ * @return 0 on success, -400 for a frame without a buffer or a subtype that
+ * cannot produce `product` (no luma for the gray products, compressed
+ * frames for `Rgba`), or a short buffer.
+ */
+int16_t frameProduct(const Frame& frame, FrameProduct product, Frame& result);
+
+FrameProductStats getFrameProductStats(FrameProduct product);
+
+void resetFrameProductStats();
+
+#endif // FRAME_CACHE_H
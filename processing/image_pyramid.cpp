@@ -0,0 +1,144 @@
+#include "image_pyramid.h"
+
+#include "optical_flow_kernel.h"
+#include <cstring>
+
+namespace {
+
+constexpr uint32_t    MIN_LEVEL_SIZE = 8;
+constexpr std::size_t ROW_ALIGNMENT  = 64;  // Pixels
+constexpr std::size_t LEVEL_PADDING  = 128; // Pixels readable past the last row
+constexpr std::size_t ROWS_PER_TASK  = 32;
+
+const FlowKernels SCALAR_KERNELS{downsampleScalar, gradientsScalar,
+                                 sampleTemplateScalar, mismatchScalar};
+
+void forRows(ThreadPool* workers, uint32_t rows,
+             const std::function<void(std::size_t, std::size_t)>& body) {
+    if (workers) {
+        workers->parallelFor(rows, ROWS_PER_TASK, body);
+    } else {
+        body(0, rows);
+    }
+}
+
+} // namespace
+
+const FlowKernels* flowKernels(SimdKernel kernel) {
+    switch (kernel) {
+    case SimdKernel::Scalar:
+        return &SCALAR_KERNELS;
+#ifdef OPTICAL_FLOW_SSE2
+    case SimdKernel::Sse2:
+        return &flowKernelsSse2();
+#endif
+#ifdef OPTICAL_FLOW_AVX2
+    case SimdKernel::Avx2:
+        return &flowKernelsAvx2();
+#endif
+#ifdef OPTICAL_FLOW_AVX512
+    case SimdKernel::Avx512:
+        return &flowKernelsAvx512();
+#endif
+    default:
+        return nullptr;
+    }
+}
+
+bool isFlowKernelAvailable(SimdKernel kernel) {
+    return flowKernels(kernel) && cpuSupports(kernel);
+}
+
+SimdKernel bestFlowKernel() {
+    static const SimdKernel best = [] {
+        for (SimdKernel kernel :
+             {SimdKernel::Avx512, SimdKernel::Avx2, SimdKernel::Sse2}) {
+            if (isFlowKernelAvailable(kernel)) {
+                return kernel;
+            }
+        }
+        return SimdKernel::Scalar;
+    }();
+    return best;
+}
+
+int16_t ImagePyramid::build(const uint8_t* luma, std::size_t stride,
+                            uint32_t width, uint32_t height, uint32_t levels,
+                            bool gradients, SimdKernel kernel,
+                            ThreadPool* workers) {
+    if (!luma || width == 0 || height == 0 || levels == 0 || stride < width) {
+        return -400;
+    }
+    if (kernel == SimdKernel::Auto) {
+        kernel = bestFlowKernel();
+    }
+    if (!isFlowKernelAvailable(kernel)) {
+        return -404;
+    }
+    const FlowKernels& functions = *flowKernels(kernel);
+
+    // Geometry first, so storage of an unchanged pyramid is reused as is
+    this->levels_.clear();
+    for (uint32_t w = width, h = height; this->levels_.size() < levels;
+         w /= 2, h /= 2) {
+        if (!this->levels_.empty() && (w < MIN_LEVEL_SIZE || h < MIN_LEVEL_SIZE)) {
+            break;
+        }
+        PyramidLevel level;
+        level.width  = w;
+        level.height = h;
+        level.stride = (w + ROW_ALIGNMENT - 1) / ROW_ALIGNMENT * ROW_ALIGNMENT;
+        this->levels_.push_back(level);
+    }
+
+    const std::size_t count = this->levels_.size();
+    this->images_.resize(count);
+    if (gradients) {
+        this->gradients_.resize(2 * count);
+    } else {
+        this->gradients_.clear();
+    }
+    for (std::size_t i = 0; i < count; ++i) {
+        PyramidLevel&     level = this->levels_[i];
+        const std::size_t size  = level.stride * level.height + LEVEL_PADDING;
+        this->images_[i].resize(size);
+        level.image = this->images_[i].data();
+        if (gradients) {
+            this->gradients_[2 * i].resize(size);
+            this->gradients_[2 * i + 1].resize(size);
+            level.dx = this->gradients_[2 * i].data();
+            level.dy = this->gradients_[2 * i + 1].data();
+        }
+    }
+
+    uint8_t* base = this->images_[0].data();
+    forRows(workers, height, [&](std::size_t begin, std::size_t end) {
+        for (std::size_t y = begin; y < end; ++y) {
+            std::memcpy(base + y * this->levels_[0].stride, luma + y * stride, width);
+        }
+    });
+
+    for (std::size_t i = 0; i < count; ++i) {
+        const PyramidLevel& level = this->levels_[i];
+        uint8_t*            image = this->images_[i].data();
+        if (i > 0) {
+            const PyramidLevel& parent = this->levels_[i - 1];
+            forRows(workers, level.height, [&](std::size_t begin, std::size_t end) {
+                functions.downsample(parent.image, parent.stride, image,
+                                     level.stride, level.width,
+                                     static_cast<uint32_t>(begin),
+                                     static_cast<uint32_t>(end));
+            });
+        }
+        if (gradients) {
+            int16_t* dx = this->gradients_[2 * i].data();
+            int16_t* dy = this->gradients_[2 * i + 1].data();
+            forRows(workers, level.height, [&](std::size_t begin, std::size_t end) {
+                functions.gradients(image, level.stride, level.width, level.height,
+                                    dx, dy, static_cast<uint32_t>(begin),
+                                    static_cast<uint32_t>(end));
+            });
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,70 @@
+#ifndef IMAGE_PYRAMID_H
+#define IMAGE_PYRAMID_H
+
+#include "cpu_features.h"
+#include "thread_pool.h"
+#include <cstdint>
+#include <vector>
+
+/**
+ * @brief One level of an `ImagePyramid`, borrowed from it.
+ *
+ * `dx` and `dy` are Scharr derivatives (32 times the per-pixel slope) and
+ * are null when the pyramid was built without gradients. All three planes
+ * share `stride`, counted in pixels, and readable padding follows the last
+ * row so kernels may read a full register past the right edge.
+ */
+struct PyramidLevel {
+    uint32_t       width{};
+    uint32_t       height{};
+    std::size_t    stride{};
+    const uint8_t* image{nullptr};
+    const int16_t* dx{nullptr};
+    const int16_t* dy{nullptr};
+};
+
+/**
+ * @brief Kernel `SimdKernel::Auto` resolves to for pyramids and optical flow.
+ */
+SimdKernel bestFlowKernel();
+
+/**
+ * @brief Whether `kernel` was compiled in and the CPU supports it.
+ */
+bool isFlowKernelAvailable(SimdKernel kernel);
+
+/**
+ * @brief Luma plane and its 2x2 box-averaged reductions.
+ *
+ * Level 0 is a copy of the source plane into padded storage, every further
+ * level halves both dimensions (rounding down) until `levels` are built or
+ * a level would drop below 8 pixels. Rebuilding a pyramid with the same
+ * geometry reuses its storage, so keeping two pyramids and swapping them
+ * allocates nothing after the first frame.
+ */
+class ImagePyramid {
+  private:
+    std::vector<PyramidLevel>         levels_{};
+    std::vector<std::vector<uint8_t>> images_{};
+    std::vector<std::vector<int16_t>> gradients_{}; // dx and dy per level
+
+  public:
+    /**
+     * @brief Rebuild from a luma plane.
+     * @param stride Bytes between rows of `luma`.
+     * @param gradients Also compute the derivatives of every level.
+     * @param workers Pool to build rows on, or null for the calling thread.
+     * @return 0 on success, -400 for an empty plane or `levels` of 0, -404 if
+     * the requested kernel is not available.
+     */
+    int16_t build(const uint8_t* luma, std::size_t stride, uint32_t width,
+                  uint32_t height, uint32_t levels, bool gradients,
+                  SimdKernel kernel = SimdKernel::Auto,
+                  ThreadPool* workers = nullptr);
+
+    std::size_t         size() const { return this->levels_.size(); }
+    const PyramidLevel& level(std::size_t index) const { return this->levels_[index]; }
+    bool hasGradients() const { return !this->gradients_.empty(); }
+};
+
+#endif // IMAGE_PYRAMID_H
@@ -0,0 +1,81 @@
+#include "latency_histogram.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+int highestBit(uint64_t value) {
+    int bit = 0;
+    while (value >>= 1) {
+        ++bit;
+    }
+    return bit;
+}
+
+} // namespace
+
+std::size_t LatencyHistogram::bucketOf(uint64_t value) {
+    if (value < SUB_BUCKETS) {
+        return static_cast<std::size_t>(value);
+    }
+    const int shift = highestBit(value) - SUB_BUCKET_BITS;
+    const std::size_t sub =
+        static_cast<std::size_t>(value >> shift) & (SUB_BUCKETS - 1);
+    return SUB_BUCKETS + static_cast<std::size_t>(shift) * SUB_BUCKETS + sub;
+}
+
+uint64_t LatencyHistogram::bucketHighest(std::size_t bucket) {
+    if (bucket < SUB_BUCKETS) {
+        return bucket;
+    }
+    const int      shift = static_cast<int>(bucket / SUB_BUCKETS) - 1;
+    const uint64_t sub   = bucket % SUB_BUCKETS;
+    const uint64_t low   = (SUB_BUCKETS + sub) << shift;
+    return low + ((uint64_t{1} << shift) - 1);
+}
+
+void LatencyHistogram::record(uint64_t value) {
+    ++this->counts_[bucketOf(value)];
+    ++this->count_;
+    this->sum_ += value;
+    this->min_ = std::min(this->min_, value);
+    this->max_ = std::max(this->max_, value);
+}
+
+void LatencyHistogram::merge(const LatencyHistogram& other) {
+    for (std::size_t i = 0; i < BUCKETS; ++i) {
+        this->counts_[i] += other.counts_[i];
+    }
+    this->count_ += other.count_;
+    this->sum_ += other.sum_;
+    this->min_ = std::min(this->min_, other.min_);
+    this->max_ = std::max(this->max_, other.max_);
+}
+
+void LatencyHistogram::reset() {
+    *this = LatencyHistogram();
+}
+
+double LatencyHistogram::mean() const {
+    return this->count_ ? static_cast<double>(this->sum_) / this->count_ : 0.0;
+}
+
+uint64_t LatencyHistogram::percentile(double percentile) const {
+    if (this->count_ == 0) {
+        return 0;
+    }
+    percentile = std::min(std::max(percentile, 0.0), 100.0);
+    uint64_t rank = static_cast<uint64_t>(
+        std::ceil(percentile / 100.0 * static_cast<double>(this->count_)));
+    rank = std::max<uint64_t>(rank, 1);
+
+    uint64_t seen = 0;
+    for (std::size_t i = 0; i < BUCKETS; ++i) {
+        seen += this->counts_[i];
+        if (seen >= rank) {
+            return std::min(std::max(bucketHighest(i), this->min_), this->max_);
+        }
+    }
+    return this->max_;
+}
@@ -0,0 +1,54 @@
+#ifndef LATENCY_HISTOGRAM_H
+#define LATENCY_HISTOGRAM_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @brief Log-linear histogram of non-negative integer samples.
+ *
+ * Values are grouped by power of two and each power of two is split into 16
+ * linear sub-buckets, so any recorded value is reported within 1/16 of its
+ * true value over the whole 64-bit range with a fixed 8 KiB footprint.
+ * Recording does not allocate. Not thread safe; keep one per thread and
+ * `merge` them for reporting.
+ */
+class LatencyHistogram {
+  public:
+    static constexpr int         SUB_BUCKET_BITS = 4;
+    static constexpr std::size_t SUB_BUCKETS     = 1 << SUB_BUCKET_BITS;
+    static constexpr std::size_t BUCKETS =
+        SUB_BUCKETS + (64 - SUB_BUCKET_BITS) * SUB_BUCKETS;
+
+  private:
+    std::array<uint64_t, BUCKETS> counts_{};
+    uint64_t                      count_{};
+    uint64_t                      sum_{};
+    uint64_t                      min_{UINT64_MAX};
+    uint64_t                      max_{};
+
+    static std::size_t bucketOf(uint64_t value);
+    static uint64_t    bucketHighest(std::size_t bucket);
+
+  public:
+    void record(uint64_t value);
+    void merge(const LatencyHistogram& other);
+    void reset();
+
+    uint64_t count() const { return this->count_; }
+    uint64_t min() const { return this->count_ ? this->min_ : 0; }
+    uint64_t max() const { return this->max_; }
+    double   mean() const;
+
+    /**
+     * @brief Smallest recorded value that `percentile` percent of the samples
+     * do not exceed, to the histogram's precision.
+     *
+     * @param percentile 0 to 100.
+     * @return 0 if nothing was recorded.
+     */
+    uint64_t percentile(double percentile) const;
+};
+
+#endif // LATENCY_HISTOGRAM_H
@@ -0,0 +1,229 @@
+#include "load_shedder.h"
+
+#include <algorithm>
+
+namespace {
+
+constexpr std::size_t MAX_PENDING_DECISIONS = 1024; // Oldest are dropped
+
+double smooth(double average, double sample, double weight) {
+    return average + (sample - average) * weight;
+}
+
+} // namespace
+
+std::vector<LoadLevel> defaultLoadLevels() {
+    return {
+        {2, 0, false},
+        {2, 720, false},
+        {3, 720, true},
+        {4, 480, true},
+    };
+}
+
+const char* loadReasonName(LoadReason reason) {
+    switch (reason) {
+    case LoadReason::Latency:
+        return "latency";
+    case LoadReason::Queue:
+        return "queue";
+    case LoadReason::Budget:
+        return "budget";
+    case LoadReason::Recovered:
+        return "recovered";
+    }
+    return "unknown";
+}
+
+std::size_t reducedMediaType(const MediaCatalog& catalog, std::size_t selected,
+                             uint32_t max_height) {
+    if (max_height == 0 || selected >= catalog.size() ||
+        catalog.height(selected) <= max_height) {
+        return selected;
+    }
+    FormatQuery query;
+    query.min_fps           = catalog.fps(selected);
+    query.max_height        = max_height;
+    query.preferred_subtype = catalog.subtype(selected);
+    query.goal              = FormatGoal::MaxResolution;
+
+    std::size_t index = selected;
+    return catalog.findBest(query, index) == 0 ? index : selected;
+}
+
+LoadShedder::LoadShedder(const LoadShedOptions& options) : options_(options) {
+    this->levels_.push_back(LoadLevel{});
+    const std::vector<LoadLevel>& ladder =
+        options.levels.empty() ? defaultLoadLevels() : options.levels;
+    this->levels_.insert(this->levels_.end(), ladder.begin(), ladder.end());
+    for (LoadLevel& level : this->levels_) {
+        level.analyze_every = std::max<uint32_t>(level.analyze_every, 1);
+    }
+    this->options_.smoothing   = std::clamp(options.smoothing, 0.01, 1.0);
+    this->options_.max_backoff = std::max<uint32_t>(options.max_backoff, 1);
+    this->stats_.frames_at_level.resize(this->levels_.size());
+    this->backoff_.resize(this->levels_.size(), 1);
+}
+
+void LoadShedder::recordStage(std::size_t stage, double ms) {
+    if (stage >= LOAD_SHED_MAX_STAGES) {
+        return;
+    }
+    if (this->stats_.stage_ms.size() <= stage) {
+        this->stats_.stage_ms.resize(stage + 1, -1.0);
+    }
+    double& average = this->stats_.stage_ms[stage];
+    average = average < 0 ? ms : smooth(average, ms, this->options_.smoothing);
+    this->frame_ms_ += ms;
+}
+
+bool LoadShedder::observe(std::size_t queue_depth, double latency_ms) {
+    const double weight = this->options_.smoothing;
+    if (this->primed_) {
+        this->latency_ms_    = smooth(this->latency_ms_, latency_ms, weight);
+        this->processing_ms_ = smooth(this->processing_ms_, this->frame_ms_, weight);
+        this->queue_depth_ =
+            smooth(this->queue_depth_, static_cast<double>(queue_depth), weight);
+    } else {
+        this->latency_ms_    = latency_ms;
+        this->processing_ms_ = this->frame_ms_;
+        this->queue_depth_   = static_cast<double>(queue_depth);
+        this->primed_        = true;
+    }
+    this->frame_ms_ = 0;
+    ++this->stats_.frames;
+    ++this->stats_.frames_at_level[this->level_];
+
+    if (this->settle_ > 0) {
+        --this->settle_;
+        return false;
+    }
+
+    const LoadShedOptions& options = this->options_;
+    if (this->probing_ && this->stats_.frames - this->changed_at_ >=
+                              options.settle_frames + options.recover_after) {
+        // The step down held
+        this->probing_               = false;
+        this->backoff_[this->level_] = 1;
+    }
+
+    const double queue_limit =
+        static_cast<double>(std::max<std::size_t>(options.max_queue_depth, 1));
+    const bool over_latency = this->latency_ms_ > options.target_latency_ms;
+    const bool over_queue   = this->queue_depth_ >= queue_limit;
+    const bool over_budget  = options.frame_budget_ms > 0 &&
+                              this->processing_ms_ > options.frame_budget_ms;
+
+    if (over_latency || over_queue || over_budget) {
+        ++this->stats_.overloaded;
+        this->healthy_run_ = 0;
+        if (++this->over_run_ >= options.escalate_after &&
+            this->level_ + 1 < this->levels_.size()) {
+            this->change(this->level_ + 1, over_latency ? LoadReason::Latency
+                                           : over_queue ? LoadReason::Queue
+                                                        : LoadReason::Budget);
+            return true;
+        }
+        return false;
+    }
+
+    const double fraction = options.recover_fraction;
+    const bool   healthy =
+        this->latency_ms_ < options.target_latency_ms * fraction &&
+        this->queue_depth_ < queue_limit * fraction &&
+        (options.frame_budget_ms <= 0 ||
+         this->processing_ms_ < options.frame_budget_ms * fraction);
+    this->over_run_ = 0;
+    if (!healthy) {
+        this->healthy_run_ = 0;
+        return false;
+    }
+    if (this->level_ > 0 &&
+        ++this->healthy_run_ >= options.recover_after * this->backoff_[this->level_ - 1]) {
+        this->change(this->level_ - 1, LoadReason::Recovered);
+        return true;
+    }
+    return false;
+}
+
+void LoadShedder::change(uint32_t level, LoadReason reason) {
+    LoadDecision decision;
+    decision.time          = hostTime100ns();
+    decision.frame         = this->stats_.frames;
+    decision.from          = this->level_;
+    decision.to            = level;
+    decision.reason        = reason;
+    decision.latency_ms    = this->latency_ms_;
+    decision.processing_ms = this->processing_ms_;
+    decision.queue_depth   = this->queue_depth_;
+    const std::vector<double>& stages = this->stats_.stage_ms;
+    if (!stages.empty()) {
+        decision.busiest_stage = static_cast<std::size_t>(
+            std::max_element(stages.begin(), stages.end()) - stages.begin());
+    }
+    if (this->decisions_.size() == MAX_PENDING_DECISIONS) {
+        this->decisions_.erase(this->decisions_.begin());
+    }
+    this->decisions_.push_back(decision);
+
+    if (level > this->level_) {
+        ++this->stats_.escalations;
+        if (this->probing_) {
+            // The level below did not hold; wait longer before trying it again
+            uint32_t& backoff = this->backoff_[this->level_];
+            backoff           = std::min(backoff * 2, this->options_.max_backoff);
+            ++this->stats_.failed_recoveries;
+        }
+        this->probing_ = false;
+    } else {
+        ++this->stats_.recoveries;
+        this->probing_ = true;
+    }
+    this->changed_at_  = this->stats_.frames;
+    this->level_       = level;
+    this->over_run_    = 0;
+    this->healthy_run_ = 0;
+    this->settle_      = this->options_.settle_frames;
+}
+
+bool LoadShedder::shouldAnalyze(uint64_t sequence) {
+    if (sequence % this->levels_[this->level_].analyze_every == 0) {
+        ++this->stats_.analyzed;
+        return true;
+    }
+    ++this->stats_.skipped;
+    return false;
+}
+
+bool LoadShedder::isStageEnabled(std::size_t stage) const {
+    if (stage >= LOAD_SHED_MAX_STAGES ||
+        !this->levels_[this->level_].drop_optional) {
+        return true;
+    }
+    return !((this->options_.optional_stages >> stage) & 1u);
+}
+
+std::size_t LoadShedder::getMediaType(const MediaCatalog& catalog,
+                                      std::size_t        selected) const {
+    return reducedMediaType(catalog, selected,
+                            this->levels_[this->level_].max_height);
+}
+
+std::size_t LoadShedder::takeDecisions(std::vector<LoadDecision>& out) {
+    const std::size_t count = this->decisions_.size();
+    out.insert(out.end(), this->decisions_.begin(), this->decisions_.end());
+    this->decisions_.clear();
+    return count;
+}
+
+LoadShedStats LoadShedder::getStats() const {
+    LoadShedStats stats = this->stats_;
+    stats.level         = this->level_;
+    stats.latency_ms    = this->latency_ms_;
+    stats.processing_ms = this->processing_ms_;
+    stats.queue_depth   = this->queue_depth_;
+    for (double& ms : stats.stage_ms) {
+        ms = std::max(ms, 0.0);
+    }
+    return stats;
+}
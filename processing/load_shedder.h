@@ -0,0 +1,188 @@
+#ifndef LOAD_SHEDDER_H
+#define LOAD_SHEDDER_H
+
+#include "hardware/webcam/media_catalog.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+constexpr std::size_t LOAD_SHED_MAX_STAGES = 32; // Bits of `optional_stages`
+
+/**
+ * @brief One step of the degradation ladder. Level 0 is normal operation and
+ * each level above it sheds more work.
+ */
+struct LoadLevel {
+    uint32_t analyze_every{1};     // Analyze one frame in this many
+    uint32_t max_height{0};        // Tallest media type to run at, 0 keeps
+                                   // the one the user selected
+    bool     drop_optional{false}; // Turn off the optional stages
+};
+
+struct LoadShedOptions {
+    double      target_latency_ms{100}; // End-to-end latency to stay below
+    double      frame_budget_ms{0};     // Processing time per frame before the
+                                        // pipeline falls behind, 0 to ignore
+    std::size_t max_queue_depth{2};     // Queued frames that count as overload
+    double      recover_fraction{0.5};  // Step down once every signal is below
+                                        // this fraction of its limit
+    uint32_t    escalate_after{5};      // Overloaded frames in a row to step up
+    uint32_t    recover_after{60};      // Healthy frames in a row to step down
+    uint32_t    settle_frames{30};      // Frames not judged after a change
+    uint32_t    max_backoff{16};        // Largest factor on `recover_after`
+                                        // after failed recoveries
+    double      smoothing{0.2};         // Weight of a new sample in the
+                                        // moving averages
+    uint32_t    optional_stages{0};     // Bit `i` marks stage `i` optional
+    std::vector<LoadLevel> levels{};    // Levels above 0 in order, empty for
+                                        // `defaultLoadLevels()`
+};
+
+/**
+ * @brief Skip analysis first, then lower the resolution, then turn off the
+ * optional stages.
+ */
+std::vector<LoadLevel> defaultLoadLevels();
+
+enum class LoadReason : uint8_t {
+    Latency,  // Smoothed latency above the target
+    Queue,    // Smoothed queue depth at the limit
+    Budget,   // Smoothed processing time above the frame budget
+    Recovered // Every signal below its recovery threshold
+};
+
+const char* loadReasonName(LoadReason reason);
+
+/**
+ * @brief A level change, with the smoothed signals that caused it.
+ */
+struct LoadDecision {
+    int64_t     time{};          // `hostTime100ns()`
+    uint64_t    frame{};         // Frames observed before the change
+    uint32_t    from{};
+    uint32_t    to{};
+    LoadReason  reason{};
+    double      latency_ms{};
+    double      processing_ms{};
+    double      queue_depth{};
+    std::size_t busiest_stage{}; // Stage with the most smoothed time
+};
+
+/**
+ * @brief Counters and smoothed signals of one shedder.
+ */
+struct LoadShedStats {
+    uint32_t level{};
+    uint64_t frames{};      // Frames observed
+    uint64_t analyzed{};    // Frames `shouldAnalyze` let through
+    uint64_t skipped{};     // Frames it turned down
+    uint64_t overloaded{};  // Frames judged overloaded
+    uint64_t escalations{};
+    uint64_t recoveries{};
+    uint64_t failed_recoveries{}; // Recoveries undone before they held
+    double   latency_ms{};
+    double   processing_ms{};
+    double   queue_depth{};
+
+    std::vector<uint64_t> frames_at_level{}; // Per level
+    std::vector<double>   stage_ms{};        // Smoothed time per stage
+};
+
+/**
+ * @brief Lower-resolution media type to run at for `max_height`.
+ *
+ * Picks the largest media type of `catalog` no taller than `max_height` that
+ * keeps the frame rate of `selected`, preferring its subtype. `max_height` 0
+ * or no such media type keeps `selected`.
+ */
+std::size_t reducedMediaType(const MediaCatalog& catalog, std::size_t selected,
+                             uint32_t max_height);
+
+/**
+ * @brief Adaptive load shedding for one camera pipeline.
+ *
+ * The pipeline reports the time of each stage with `recordStage` and, once a
+ * frame is done, its end-to-end latency and the frames queued behind it with
+ * `observe`. Latency, queue depth and processing time are smoothed; when any
+ * of them stays over its limit for `escalate_after` frames the shedder steps
+ * up one level, and when all of them stay below `recover_fraction` of their
+ * limits for `recover_after` frames it steps back down. The gap between the
+ * two thresholds and the `settle_frames` after each change keep it from
+ * oscillating between levels whose cost straddles a limit. When the cost of
+ * two levels is far apart, a step down can still overload right away; each
+ * such failed recovery doubles the healthy frames needed to try that level
+ * again, up to `max_backoff` times `recover_after`, and a step down that
+ * holds resets it.
+ *
+ * The pipeline applies the current level by asking `shouldAnalyze`,
+ * `isStageEnabled` and `getMediaType`. Every change is kept as a
+ * `LoadDecision` for `takeDecisions`, next to the counters of `getStats`.
+ * Not thread safe.
+ */
+class LoadShedder {
+  private:
+    LoadShedOptions        options_;
+    std::vector<LoadLevel> levels_{}; // Level 0 first
+    uint32_t               level_{};
+
+    double   latency_ms_{}; // Smoothed signals
+    double   processing_ms_{};
+    double   queue_depth_{};
+    double   frame_ms_{};   // Stage time of the frame being processed
+    bool     primed_{false};
+    uint32_t over_run_{};
+    uint32_t healthy_run_{};
+    uint32_t settle_{};
+    bool     probing_{false}; // Last change stepped down and has not held yet
+    uint64_t changed_at_{};   // Frames observed at the last change
+
+    std::vector<uint32_t> backoff_{}; // Factor on `recover_after` per level
+
+    LoadShedStats             stats_{};
+    std::vector<LoadDecision> decisions_{};
+
+    void change(uint32_t level, LoadReason reason);
+
+  public:
+    explicit LoadShedder(const LoadShedOptions& options = {});
+
+    /**
+     * @brief Add `ms` spent in `stage` on the current frame.
+     */
+    void recordStage(std::size_t stage, double ms);
+
+    /**
+     * @brief Finish the current frame and judge the load.
+     * @param queue_depth Frames waiting behind it.
+     * @param latency_ms From the frame's arrival to the end of its processing.
+     * @return true if the level changed.
+     */
+    bool observe(std::size_t queue_depth, double latency_ms);
+
+    /**
+     * @brief Whether frame `sequence` is analyzed at the current level.
+     */
+    bool shouldAnalyze(uint64_t sequence);
+
+    bool isStageEnabled(std::size_t stage) const;
+
+    /**
+     * @brief Media type to run at the current level, see `reducedMediaType`.
+     */
+    std::size_t getMediaType(const MediaCatalog& catalog,
+                             std::size_t        selected) const;
+
+    /**
+     * @brief Move the decisions since the last call to `out`.
+     * @return Number of decisions moved.
+     */
+    std::size_t takeDecisions(std::vector<LoadDecision>& out);
+
+    uint32_t               getLevel() const { return this->level_; }
+    const LoadLevel&       getLoadLevel() const { return this->levels_[this->level_]; }
+    std::size_t            getLevelCount() const { return this->levels_.size(); }
+    const LoadShedOptions& getOptions() const { return this->options_; }
+    LoadShedStats          getStats() const;
+};
+
+#endif // LOAD_SHEDDER_H
@@ -0,0 +1,379 @@
+#include "mjpeg_decoder.h"
+
+#include "hardware/webcam/frame_trace.h"
+#include "hardware/webcam/pixel_format.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+namespace {
+
+// stb_image allocates the decoded image itself. While a worker decodes, the
+// call that allocates the final image is served from the pooled frame buffer
+// instead, which saves copying every decoded frame. That call is recognised
+// by its place in stb's JPEG path: it directly follows the allocation of the
+// last component's line buffer (width + 3 bytes) and asks for exactly the
+// output size. Every other allocation goes to the heap; if stb ever allocates
+// differently the image lands on the heap and is copied into the pool.
+thread_local uint8_t*    decode_target      = nullptr;
+thread_local std::size_t decode_target_size = 0;
+thread_local std::size_t decode_line_size   = 0;
+thread_local bool        decode_after_line  = false;
+thread_local bool        decode_target_used = false;
+
+void* decodeMalloc(std::size_t size) {
+    if (decode_target && !decode_target_used) {
+        const bool output = decode_after_line && size == decode_target_size;
+        decode_after_line = size == decode_line_size;
+        if (output) {
+            decode_target_used = true;
+            return decode_target;
+        }
+    }
+    return std::malloc(size);
+}
+
+void decodeFree(void* pointer) {
+    if (pointer && pointer == decode_target) {
+        return;
+    }
+    std::free(pointer);
+}
+
+// stb_image wants all three hooks, but its JPEG decoder never reallocates
+[[maybe_unused]] void* decodeRealloc(void* pointer, std::size_t size) {
+    if (pointer && pointer == decode_target) {
+        void* moved = std::malloc(size);
+        if (moved) {
+            std::memcpy(moved, pointer, std::min(size, decode_target_size));
+        }
+        return moved;
+    }
+    return std::realloc(pointer, size);
+}
+
+} // namespace
+
+#define STB_IMAGE_IMPLEMENTATION
+#define STB_IMAGE_STATIC
+#define STBI_ONLY_JPEG
+#define STBI_NO_STDIO
+#define STBI_MALLOC(size)           decodeMalloc(size)
+#define STBI_FREE(pointer)          decodeFree(pointer)
+#define STBI_REALLOC(pointer, size) decodeRealloc(pointer, size)
+#include "external/stb_image.h"
+
+namespace {
+
+// Decoded frames held by the consumer on top of the in-flight ones
+constexpr std::size_t CONSUMER_BUFFERS = 2;
+
+// Standard luminance and chrominance tables, JPEG specification annex K.3.
+// MJPEG cameras encode with these and omit the DHT segment (AVI1 format).
+constexpr uint8_t DEFAULT_HUFFMAN_TABLES[] = {
+    0xFF, 0xC4, 0x01, 0xA2,
+    // DC luminance
+    0x00, 0x00, 0x01, 0x05, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06,
+    0x07, 0x08, 0x09, 0x0A, 0x0B,
+    // DC chrominance
+    0x01, 0x00, 0x03, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06,
+    0x07, 0x08, 0x09, 0x0A, 0x0B,
+    // AC luminance
+    0x10, 0x00, 0x02, 0x01, 0x03, 0x03, 0x02, 0x04, 0x03, 0x05, 0x05, 0x04,
+    0x04, 0x00, 0x00, 0x01, 0x7D, 0x01, 0x02, 0x03, 0x00, 0x04, 0x11, 0x05,
+    0x12, 0x21, 0x31, 0x41, 0x06, 0x13, 0x51, 0x61, 0x07, 0x22, 0x71, 0x14,
+    0x32, 0x81, 0x91, 0xA1, 0x08, 0x23, 0x42, 0xB1, 0xC1, 0x15, 0x52, 0xD1,
+    0xF0, 0x24, 0x33, 0x62, 0x72, 0x82, 0x09, 0x0A, 0x16, 0x17, 0x18, 0x19,
+    0x1A, 0x25, 0x26, 0x27, 0x28, 0x29, 0x2A, 0x34, 0x35, 0x36, 0x37, 0x38,
+    0x39, 0x3A, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49, 0x4A, 0x53, 0x54,
+    0x55, 0x56, 0x57, 0x58, 0x59, 0x5A, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68,
+    0x69, 0x6A, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7A, 0x83, 0x84,
+    0x85, 0x86, 0x87, 0x88, 0x89, 0x8A, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97,
+    0x98, 0x99, 0x9A, 0xA2, 0xA3, 0xA4, 0xA5, 0xA6, 0xA7, 0xA8, 0xA9, 0xAA,
+    0xB2, 0xB3, 0xB4, 0xB5, 0xB6, 0xB7, 0xB8, 0xB9, 0xBA, 0xC2, 0xC3, 0xC4,
+    0xC5, 0xC6, 0xC7, 0xC8, 0xC9, 0xCA, 0xD2, 0xD3, 0xD4, 0xD5, 0xD6, 0xD7,
+    0xD8, 0xD9, 0xDA, 0xE1, 0xE2, 0xE3, 0xE4, 0xE5, 0xE6, 0xE7, 0xE8, 0xE9,
+    0xEA, 0xF1, 0xF2, 0xF3, 0xF4, 0xF5, 0xF6, 0xF7, 0xF8, 0xF9, 0xFA,
+    // AC chrominance
+    0x11, 0x00, 0x02, 0x01, 0x02, 0x04, 0x04, 0x03, 0x04, 0x07, 0x05, 0x04,
+    0x04, 0x00, 0x01, 0x02, 0x77, 0x00, 0x01, 0x02, 0x03, 0x11, 0x04, 0x05,
+    0x21, 0x31, 0x06, 0x12, 0x41, 0x51, 0x07, 0x61, 0x71, 0x13, 0x22, 0x32,
+    0x81, 0x08, 0x14, 0x42, 0x91, 0xA1, 0xB1, 0xC1, 0x09, 0x23, 0x33, 0x52,
+    0xF0, 0x15, 0x62, 0x72, 0xD1, 0x0A, 0x16, 0x24, 0x34, 0xE1, 0x25, 0xF1,
+    0x17, 0x18, 0x19, 0x1A, 0x26, 0x27, 0x28, 0x29, 0x2A, 0x35, 0x36, 0x37,
+    0x38, 0x39, 0x3A, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49, 0x4A, 0x53,
+    0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5A, 0x63, 0x64, 0x65, 0x66, 0x67,
+    0x68, 0x69, 0x6A, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7A, 0x82,
+    0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89, 0x8A, 0x92, 0x93, 0x94, 0x95,
+    0x96, 0x97, 0x98, 0x99, 0x9A, 0xA2, 0xA3, 0xA4, 0xA5, 0xA6, 0xA7, 0xA8,
+    0xA9, 0xAA, 0xB2, 0xB3, 0xB4, 0xB5, 0xB6, 0xB7, 0xB8, 0xB9, 0xBA, 0xC2,
+    0xC3, 0xC4, 0xC5, 0xC6, 0xC7, 0xC8, 0xC9, 0xCA, 0xD2, 0xD3, 0xD4, 0xD5,
+    0xD6, 0xD7, 0xD8, 0xD9, 0xDA, 0xE2, 0xE3, 0xE4, 0xE5, 0xE6, 0xE7, 0xE8,
+    0xE9, 0xEA, 0xF2, 0xF3, 0xF4, 0xF5, 0xF6, 0xF7, 0xF8, 0xF9, 0xFA,
+};
+static_assert(sizeof(DEFAULT_HUFFMAN_TABLES) == 2 + 0x01A2,
+              "DHT segment length does not match its content");
+
+/**
+ * @brief Whether a DHT segment comes before the first scan. Malformed
+ * headers report true and are left for the decoder to reject.
+ */
+bool hasHuffmanTables(const uint8_t* data, std::size_t size) {
+    std::size_t pos = 2; // After SOI
+    while (pos + 4 <= size) {
+        if (data[pos] != 0xFF) {
+            return true;
+        }
+        const uint8_t marker = data[pos + 1];
+        if (marker == 0xFF) {
+            ++pos; // Fill byte
+            continue;
+        }
+        if (marker == 0xC4) {
+            return true;
+        }
+        if (marker == 0xDA) {
+            return false;
+        }
+        if (marker == 0x01 || (marker >= 0xD0 && marker <= 0xD7)) {
+            pos += 2;
+            continue;
+        }
+        pos += 2 + ((static_cast<std::size_t>(data[pos + 2]) << 8) | data[pos + 3]);
+    }
+    return true;
+}
+
+int64_t microseconds(std::chrono::steady_clock::duration duration) {
+    return std::chrono::duration_cast<std::chrono::microseconds>(duration)
+        .count();
+}
+
+/**
+ * @brief Decode one JPEG into a buffer from `pool`.
+ */
+bool decodeJpeg(const Frame& source, PixelOutput output, FramePool& pool,
+                Frame& decoded) {
+    const uint8_t* data = source.buffer.data();
+    std::size_t    size = source.buffer.size();
+    if (size < 4 || data[0] != 0xFF || data[1] != 0xD8) {
+        return false;
+    }
+
+    thread_local std::vector<uint8_t> patched;
+    if (!hasHuffmanTables(data, size)) {
+        patched.resize(size + sizeof(DEFAULT_HUFFMAN_TABLES));
+        std::memcpy(patched.data(), data, 2);
+        std::memcpy(patched.data() + 2, DEFAULT_HUFFMAN_TABLES,
+                    sizeof(DEFAULT_HUFFMAN_TABLES));
+        std::memcpy(patched.data() + 2 + sizeof(DEFAULT_HUFFMAN_TABLES),
+                    data + 2, size - 2);
+        data = patched.data();
+        size = patched.size();
+    }
+
+    int width, height, components;
+    if (!stbi_info_from_memory(data, static_cast<int>(size), &width, &height,
+                               &components)) {
+        return false;
+    }
+
+    const int         channels = output == PixelOutput::Gray ? 1 : 4;
+    const std::size_t bytes =
+        static_cast<std::size_t>(width) * height * channels;
+    // stb_image allocates its output with one spare byte
+    FrameBufferRef buffer = pool.acquire(bytes + 1);
+
+    decode_target      = buffer.data();
+    decode_target_size = bytes + 1;
+    decode_line_size   = static_cast<std::size_t>(width) + 3;
+    decode_after_line  = false;
+    decode_target_used = false;
+    uint8_t* pixels    = stbi_load_from_memory(
+        data, static_cast<int>(size), &width, &height, &components, channels);
+    decode_target = nullptr;
+
+    if (!pixels) {
+        return false;
+    }
+    if (pixels != buffer.data()) {
+        std::memcpy(buffer.data(), pixels, bytes);
+        std::free(pixels);
+    }
+
+    buffer.setSize(bytes);
+
+    if (output == PixelOutput::Bgra) {
+        uint8_t* pixel = buffer.data();
+        for (std::size_t i = 0; i < bytes; i += 4) {
+            std::swap(pixel[i], pixel[i + 2]);
+        }
+    }
+
+    decoded.buffer = std::move(buffer);
+    decoded.format = {outputSubtype(output), static_cast<uint32_t>(width),
+                      static_cast<uint32_t>(height),
+                      source.format.fps_numerator,
+                      source.format.fps_denominator};
+    decoded.timestamp = source.timestamp;
+    decoded.sequence  = source.sequence;
+    decoded.arrival   = source.arrival;
+    decoded.capture   = source.capture;
+    decoded.trace_id  = source.trace_id;
+    decoded.roi       = source.roi;
+    return true;
+}
+
+} // namespace
+
+MjpegDecoder::MjpegDecoder(const MjpegDecoderOptions&  options,
+                           std::shared_ptr<ThreadPool> workers)
+    : options_(options), workers_(std::move(workers)) {
+    if (!this->workers_) {
+        this->workers_ = std::make_shared<ThreadPool>(this->options_.threads);
+    }
+    if (this->options_.max_in_flight == 0) {
+        this->options_.max_in_flight = 2 * this->workers_->size();
+    }
+    std::size_t blocks = this->options_.max_in_flight + CONSUMER_BUFFERS;
+    this->pool_        = FramePool::create(0, 0, blocks);
+}
+
+MjpegDecoder::~MjpegDecoder() {
+    std::unique_lock<std::mutex> lock(this->mutex_);
+    this->ready_.wait(lock, [this] { return this->running_ == 0; });
+}
+
+int16_t MjpegDecoder::submit(const Frame&              frame,
+                             std::chrono::milliseconds wait) {
+    if (pixelDecoder(frame.format.subtype) != PixelDecoder::Mjpeg ||
+        frame.buffer.size() == 0) {
+        return -400;
+    }
+
+    std::unique_lock<std::mutex> lock(this->mutex_);
+    auto has_slot = [this] {
+        return this->pending_.size() < this->options_.max_in_flight;
+    };
+    if (!has_slot() && !this->slot_free_.wait_for(lock, wait, has_slot)) {
+        ++this->stats_.rejected;
+        return -429;
+    }
+
+    Key key{frame.timestamp, this->next_ticket_++};
+    this->pending_[key].submitted = std::chrono::steady_clock::now();
+    ++this->running_;
+    ++this->stats_.submitted;
+    lock.unlock();
+
+    this->workers_->submit([this, key, frame] { this->decode(key, frame); });
+    return 0;
+}
+
+void MjpegDecoder::decode(Key key, Frame source) {
+    const auto start = std::chrono::steady_clock::now();
+    Frame      decoded;
+    bool       ok;
+    {
+        TraceScope trace(source, TraceStage::Decode);
+        ok = decodeJpeg(source, this->options_.output, *this->pool_, decoded);
+    }
+    const auto end = std::chrono::steady_clock::now();
+    source         = Frame();
+
+    {
+        std::lock_guard<std::mutex> lock(this->mutex_);
+        Pending& pending = this->pending_[key];
+        pending.done     = true;
+        pending.ok       = ok;
+        pending.frame    = std::move(decoded);
+
+        this->stats_.decode_time.record(microseconds(end - start));
+        if (ok) {
+            ++this->stats_.decoded;
+            this->stats_.latency.record(microseconds(end - pending.submitted));
+        } else {
+            ++this->stats_.failed;
+        }
+        --this->running_;
+        // Notified under the lock, the destructor may run as soon as it is
+        // released
+        this->ready_.notify_all();
+    }
+}
+
+int16_t MjpegDecoder::decodeFrame(const Frame& frame, Frame& decoded) {
+    if (pixelDecoder(frame.format.subtype) != PixelDecoder::Mjpeg ||
+        frame.buffer.size() == 0) {
+        return -400;
+    }
+    const auto start = std::chrono::steady_clock::now();
+    bool       ok;
+    {
+        TraceScope trace(frame, TraceStage::Decode);
+        ok = decodeJpeg(frame, this->options_.output, *this->pool_, decoded);
+    }
+    const int64_t elapsed = microseconds(std::chrono::steady_clock::now() - start);
+
+    std::lock_guard<std::mutex> lock(this->mutex_);
+    ++this->stats_.submitted;
+    this->stats_.decode_time.record(elapsed);
+    if (!ok) {
+        ++this->stats_.failed;
+        return -400;
+    }
+    ++this->stats_.decoded;
+    this->stats_.latency.record(elapsed);
+    return 0;
+}
+
+bool MjpegDecoder::popReady(Frame& frame) {
+    while (!this->pending_.empty() && this->pending_.begin()->second.done) {
+        auto     first = this->pending_.begin();
+        bool     ok    = first->second.ok;
+        Frame    ready = std::move(first->second.frame);
+        this->pending_.erase(first);
+        this->slot_free_.notify_one();
+        if (ok) {
+            frame = std::move(ready);
+            return true;
+        }
+    }
+    return false;
+}
+
+int16_t MjpegDecoder::tryGet(Frame& frame) {
+    std::lock_guard<std::mutex> lock(this->mutex_);
+    return this->popReady(frame) ? 0 : 204;
+}
+
+int16_t MjpegDecoder::waitNext(Frame&                    frame,
+                               std::chrono::milliseconds timeout) {
+    const auto deadline = std::chrono::steady_clock::now() + timeout;
+
+    std::unique_lock<std::mutex> lock(this->mutex_);
+    for (;;) {
+        if (this->popReady(frame)) {
+            return 0;
+        }
+        if (this->pending_.empty() ||
+            this->ready_.wait_until(lock, deadline) == std::cv_status::timeout) {
+            return this->popReady(frame) ? 0 : 204;
+        }
+    }
+}
+
+MjpegDecoderStats MjpegDecoder::getStats() const {
+    std::lock_guard<std::mutex> lock(this->mutex_);
+    MjpegDecoderStats stats = this->stats_;
+    stats.in_flight         = this->pending_.size();
+    return stats;
+}
+
+FramePoolStats MjpegDecoder::getPoolStats() const {
+    return this->pool_->getStats();
+}
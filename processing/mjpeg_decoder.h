@@ -0,0 +1,128 @@
+#ifndef MJPEG_DECODER_H
+#define MJPEG_DECODER_H
+
+#include "color_convert.h"
+#include "hardware/webcam/frame.h"
+#include "latency_histogram.h"
+#include "thread_pool.h"
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+
+struct MjpegDecoderOptions {
+    std::size_t threads{0};       // Decode workers, 0 for one per hardware thread
+    std::size_t max_in_flight{0}; // Frames submitted and not yet taken, 0 for
+                                  // two per worker
+    PixelOutput output{PixelOutput::Rgba};
+};
+
+/**
+ * @brief Counters of one decoder, times are in microseconds.
+ */
+struct MjpegDecoderStats {
+    uint64_t    submitted{}; // Frames accepted by `submit`
+    uint64_t    decoded{};   // Frames decoded successfully
+    uint64_t    failed{};    // Frames that were not a decodable JPEG
+    uint64_t    rejected{};  // `submit` calls refused at `max_in_flight`
+    std::size_t in_flight{}; // Frames submitted and not yet taken
+
+    LatencyHistogram decode_time{}; // Time a worker spent on one frame
+    LatencyHistogram latency{};     // From `submit` until the frame was ready
+};
+
+/**
+ * @brief Decodes MJPEG frames on a work-stealing pool.
+ *
+ * Consecutive frames decode concurrently and come out ordered by timestamp,
+ * so the consumer sees the same sequence the camera produced. Decoded frames
+ * are `FOURCC_RGBA`, `FOURCC_BGRA` or `FOURCC_Y800` and live in the
+ * decoder's `FramePool`, which stops allocating once `max_in_flight` frames
+ * have been through it.
+ *
+ * `max_in_flight` bounds both memory and latency: when the consumer or the
+ * workers fall behind, `submit` refuses new frames instead of queueing them.
+ *
+ * Camera MJPEG usually leaves out the Huffman tables; the standard ones from
+ * the JPEG specification are inserted for such frames.
+ */
+class MjpegDecoder {
+  private:
+    struct Pending {
+        bool  done{false};
+        bool  ok{false};
+        Frame frame{};
+
+        std::chrono::steady_clock::time_point submitted{};
+    };
+    using Key = std::pair<int64_t, uint64_t>; // Timestamp, submission ticket
+
+    MjpegDecoderOptions         options_;
+    std::shared_ptr<ThreadPool> workers_;
+    std::shared_ptr<FramePool>  pool_;
+
+    mutable std::mutex      mutex_{};
+    std::condition_variable ready_{};
+    std::condition_variable slot_free_{};
+    std::map<Key, Pending>  pending_{};
+    uint64_t                next_ticket_{};
+    std::size_t             running_{}; // Decode tasks not yet finished
+
+    MjpegDecoderStats stats_{};
+
+    void decode(Key key, Frame source);
+    bool popReady(Frame& frame);
+
+  public:
+    /**
+     * @param workers Pool to decode on, shared with other stages. A private
+     * pool with `options.threads` workers is created if null.
+     */
+    explicit MjpegDecoder(const MjpegDecoderOptions&  options = {},
+                          std::shared_ptr<ThreadPool> workers = nullptr);
+    MjpegDecoder(const MjpegDecoder&) = delete;
+    ~MjpegDecoder();
+
+    MjpegDecoder& operator=(const MjpegDecoder&) = delete;
+
+    /**
+     * @brief Queue a compressed frame, waiting up to `wait` for an in-flight
+     * slot.
+     *
+     * The frame's buffer is shared, not copied, until it is decoded.
+     *
+     * @return 0 on success, -400 if the frame is not MJPEG or empty, -429 if
+     * `max_in_flight` frames are still outstanding.
+     */
+    int16_t submit(const Frame&              frame,
+                   std::chrono::milliseconds wait = std::chrono::milliseconds(0));
+
+    /**
+     * @brief Next decoded frame in timestamp order, if it is ready.
+     * @return 0 on success, 204 if the next frame is still decoding or nothing
+     * was submitted.
+     */
+    int16_t tryGet(Frame& frame);
+
+    /**
+     * @brief Next decoded frame in timestamp order, waiting up to `timeout`.
+     * @return 0 on success, 204 on timeout or if nothing was submitted.
+     */
+    int16_t waitNext(Frame& frame, std::chrono::milliseconds timeout);
+
+    /**
+     * @brief Decode `frame` on the calling thread, for callers that schedule
+     * decoding themselves, such as a `StageGraph` stage. Thread safe and
+     * counted in the stats, but not in `max_in_flight`.
+     * @return 0 on success, -400 if the frame is not MJPEG, empty or not a
+     * decodable JPEG.
+     */
+    int16_t decodeFrame(const Frame& frame, Frame& decoded);
+
+    std::size_t       getMaxInFlight() const { return this->options_.max_in_flight; }
+    MjpegDecoderStats getStats() const;
+    FramePoolStats    getPoolStats() const;
+};
+
+#endif // MJPEG_DECODER_H
@@ -0,0 +1,33 @@
+#include "motion_detect_kernel.h"
+
+#include <immintrin.h>
+
+namespace {
+
+struct Avx2 {
+    using V = __m256i;
+
+    static V zero() { return _mm256_setzero_si256(); }
+    static V set1_epi8(char value) { return _mm256_set1_epi8(value); }
+
+    static V or_(V a, V b) { return _mm256_or_si256(a, b); }
+    static V subs_epu8(V a, V b) { return _mm256_subs_epu8(a, b); }
+    static V min_epu8(V a, V b) { return _mm256_min_epu8(a, b); }
+    static V sad_epu8(V a, V b) { return _mm256_sad_epu8(a, b); }
+    static V add_epi64(V a, V b) { return _mm256_add_epi64(a, b); }
+
+    static V loadBytes(const uint8_t* p) {
+        return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+    }
+
+    static void store(uint64_t* p, V value) {
+        _mm256_store_si256(reinterpret_cast<__m256i*>(p), value);
+    }
+};
+
+} // namespace
+
+void motionRowsAvx2(const MotionJob& job, uint32_t row_begin,
+                    uint32_t row_end, uint32_t* energy, uint32_t* changed) {
+    motionRowsSimd<Avx2>(job, row_begin, row_end, energy, changed);
+}
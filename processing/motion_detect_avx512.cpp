@@ -0,0 +1,28 @@
+#include "motion_detect_kernel.h"
+
+#include <immintrin.h>
+
+namespace {
+
+struct Avx512 {
+    using V = __m512i;
+
+    static V zero() { return _mm512_setzero_si512(); }
+    static V set1_epi8(char value) { return _mm512_set1_epi8(value); }
+
+    static V or_(V a, V b) { return _mm512_or_si512(a, b); }
+    static V subs_epu8(V a, V b) { return _mm512_subs_epu8(a, b); }
+    static V min_epu8(V a, V b) { return _mm512_min_epu8(a, b); }
+    static V sad_epu8(V a, V b) { return _mm512_sad_epu8(a, b); }
+    static V add_epi64(V a, V b) { return _mm512_add_epi64(a, b); }
+
+    static V loadBytes(const uint8_t* p) { return _mm512_loadu_si512(p); }
+    static void store(uint64_t* p, V value) { _mm512_store_si512(p, value); }
+};
+
+} // namespace
+
+void motionRowsAvx512(const MotionJob& job, uint32_t row_begin,
+                      uint32_t row_end, uint32_t* energy, uint32_t* changed) {
+    motionRowsSimd<Avx512>(job, row_begin, row_end, energy, changed);
+}
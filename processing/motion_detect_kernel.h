@@ -0,0 +1,106 @@
+#ifndef MOTION_DETECT_KERNEL_H
+#define MOTION_DETECT_KERNEL_H
+
+// Internal to the motion detector. The SIMD translation units include this
+// header and instantiate `motionRowsSimd` with their instruction set wrapper;
+// the scalar function here is the reference every kernel matches.
+// Helpers are `static` so each translation unit keeps its own copy, built
+// with its own instruction set.
+
+#include "motion_detector.h"
+
+struct MotionJob {
+    const uint8_t* previous{nullptr};
+    const uint8_t* current{nullptr};
+    std::size_t    stride{};
+    uint32_t       width{};
+    uint32_t       tile_size{};
+    uint8_t        threshold{};
+};
+
+/**
+ * @brief Scalar accumulation of columns `[x_begin, width)` of rows
+ * `[row_begin, row_end)` into the tiles of one tile row.
+ */
+static inline void motionRowsScalar(const MotionJob& job, uint32_t row_begin,
+                                    uint32_t row_end, uint32_t x_begin,
+                                    uint32_t* energy, uint32_t* changed) {
+    for (uint32_t row = row_begin; row < row_end; ++row) {
+        const uint8_t* a = job.previous + row * job.stride;
+        const uint8_t* b = job.current + row * job.stride;
+        for (uint32_t x = x_begin; x < job.width; ++x) {
+            const uint32_t diff = a[x] > b[x] ? a[x] - b[x] : b[x] - a[x];
+            const uint32_t tile = x / job.tile_size;
+            energy[tile] += diff;
+            changed[tile] += diff > job.threshold;
+        }
+    }
+}
+
+static inline void motionRowsScalar(const MotionJob& job, uint32_t row_begin,
+                                    uint32_t row_end, uint32_t* energy,
+                                    uint32_t* changed) {
+    motionRowsScalar(job, row_begin, row_end, 0, energy, changed);
+}
+
+/**
+ * @brief Tile row loop shared by the SSE2, AVX2 and AVX-512 kernels.
+ *
+ * Walks down one register wide column at a time. The absolute difference is
+ * `subs(a, b) | subs(b, a)`; `sad` against zero sums it per 8 bytes, and the
+ * changed count is the same sum over `min(subs(diff, threshold), 1)`. The
+ * 64-bit sums stay in registers until the column is done and are then added
+ * to the tiles their 16 byte halves belong to. Columns past the last full
+ * register go through the scalar path.
+ */
+template <typename Isa>
+void motionRowsSimd(const MotionJob& job, uint32_t row_begin,
+                    uint32_t row_end, uint32_t* energy, uint32_t* changed) {
+    using V                  = typename Isa::V;
+    constexpr uint32_t WIDTH = sizeof(V);
+    constexpr uint32_t SUMS  = WIDTH / 8;
+
+    const V zero      = Isa::zero();
+    const V one       = Isa::set1_epi8(1);
+    const V threshold = Isa::set1_epi8(static_cast<char>(job.threshold));
+
+    uint32_t x = 0;
+    for (; x + WIDTH <= job.width; x += WIDTH) {
+        const uint8_t* a = job.previous + row_begin * job.stride + x;
+        const uint8_t* b = job.current + row_begin * job.stride + x;
+
+        V energy_sum  = zero;
+        V changed_sum = zero;
+        for (uint32_t row = row_begin; row < row_end;
+             ++row, a += job.stride, b += job.stride) {
+            V pa   = Isa::loadBytes(a);
+            V pb   = Isa::loadBytes(b);
+            V diff = Isa::or_(Isa::subs_epu8(pa, pb), Isa::subs_epu8(pb, pa));
+            V over = Isa::min_epu8(Isa::subs_epu8(diff, threshold), one);
+            energy_sum  = Isa::add_epi64(energy_sum, Isa::sad_epu8(diff, zero));
+            changed_sum = Isa::add_epi64(changed_sum, Isa::sad_epu8(over, zero));
+        }
+
+        alignas(64) uint64_t energies[SUMS];
+        alignas(64) uint64_t counts[SUMS];
+        Isa::store(energies, energy_sum);
+        Isa::store(counts, changed_sum);
+        for (uint32_t i = 0; i < SUMS; i += 2) {
+            const uint32_t tile = (x + i * 8) / job.tile_size;
+            energy[tile] += static_cast<uint32_t>(energies[i] + energies[i + 1]);
+            changed[tile] += static_cast<uint32_t>(counts[i] + counts[i + 1]);
+        }
+    }
+    if (x < job.width) {
+        motionRowsScalar(job, row_begin, row_end, x, energy, changed);
+    }
+}
+
+void motionRowsSse2(const MotionJob& job, uint32_t row_begin,
+                    uint32_t row_end, uint32_t* energy, uint32_t* changed);
+void motionRowsAvx2(const MotionJob& job, uint32_t row_begin,
+                    uint32_t row_end, uint32_t* energy, uint32_t* changed);
+void motionRowsAvx512(const MotionJob& job, uint32_t row_begin,
+                      uint32_t row_end, uint32_t* energy, uint32_t* changed);
+
+#endif // MOTION_DETECT_KERNEL_H
@@ -0,0 +1,33 @@
+#include "motion_detect_kernel.h"
+
+#include <emmintrin.h>
+
+namespace {
+
+struct Sse2 {
+    using V = __m128i;
+
+    static V zero() { return _mm_setzero_si128(); }
+    static V set1_epi8(char value) { return _mm_set1_epi8(value); }
+
+    static V or_(V a, V b) { return _mm_or_si128(a, b); }
+    static V subs_epu8(V a, V b) { return _mm_subs_epu8(a, b); }
+    static V min_epu8(V a, V b) { return _mm_min_epu8(a, b); }
+    static V sad_epu8(V a, V b) { return _mm_sad_epu8(a, b); }
+    static V add_epi64(V a, V b) { return _mm_add_epi64(a, b); }
+
+    static V loadBytes(const uint8_t* p) {
+        return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+    }
+
+    static void store(uint64_t* p, V value) {
+        _mm_store_si128(reinterpret_cast<__m128i*>(p), value);
+    }
+};
+
+} // namespace
+
+void motionRowsSse2(const MotionJob& job, uint32_t row_begin,
+                    uint32_t row_end, uint32_t* energy, uint32_t* changed) {
+    motionRowsSimd<Sse2>(job, row_begin, row_end, energy, changed);
+}
@@ -0,0 +1,190 @@
+#include "motion_detector.h"
+
+#include "frame_cache.h"
+#include "hardware/webcam/frame_trace.h"
+#include "hardware/webcam/region_of_interest.h"
+#include "motion_detect_kernel.h"
+#include <algorithm>
+
+namespace {
+
+using RowsFunction = void (*)(const MotionJob&, uint32_t, uint32_t, uint32_t*,
+                              uint32_t*);
+
+constexpr uint32_t MAX_TILE_SIZE = 256; // Keeps a tile's energy in 32 bits
+
+RowsFunction rowsFunction(SimdKernel kernel) {
+    switch (kernel) {
+    case SimdKernel::Scalar:
+        return motionRowsScalar;
+#ifdef MOTION_DETECT_SSE2
+    case SimdKernel::Sse2:
+        return motionRowsSse2;
+#endif
+#ifdef MOTION_DETECT_AVX2
+    case SimdKernel::Avx2:
+        return motionRowsAvx2;
+#endif
+#ifdef MOTION_DETECT_AVX512
+    case SimdKernel::Avx512:
+        return motionRowsAvx512;
+#endif
+    default:
+        return nullptr;
+    }
+}
+
+bool isValidTileSize(uint32_t tile_size) {
+    return tile_size != 0 && tile_size % 16 == 0 && tile_size <= MAX_TILE_SIZE;
+}
+
+/**
+ * @brief Size the tile grid for `width` x `height` and clear it.
+ */
+void prepareMap(MotionMap& map, uint32_t width, uint32_t height,
+                uint32_t tile_size) {
+    map.tile_size = tile_size;
+    map.tiles_x   = (width + tile_size - 1) / tile_size;
+    map.tiles_y   = (height + tile_size - 1) / tile_size;
+
+    const std::size_t tiles = static_cast<std::size_t>(map.tiles_x) * map.tiles_y;
+    map.energy.assign(tiles, 0);
+    map.changed.assign(tiles, 0);
+    map.active.assign(tiles, 0);
+    map.active_tiles = 0;
+    map.total_energy = 0;
+}
+
+} // namespace
+
+bool isMotionKernelAvailable(SimdKernel kernel) {
+    return rowsFunction(kernel) && cpuSupports(kernel);
+}
+
+SimdKernel bestMotionKernel() {
+    static const SimdKernel best = [] {
+        for (SimdKernel kernel :
+             {SimdKernel::Avx512, SimdKernel::Avx2, SimdKernel::Sse2}) {
+            if (isMotionKernelAvailable(kernel)) {
+                return kernel;
+            }
+        }
+        return SimdKernel::Scalar;
+    }();
+    return best;
+}
+
+int16_t detectMotion(const uint8_t* previous, const uint8_t* current,
+                     std::size_t stride, uint32_t width, uint32_t height,
+                     const MotionOptions& options, MotionMap& map,
+                     const RoiMask* roi) {
+    if (!previous || !current || width == 0 || height == 0 || stride < width ||
+        !isValidTileSize(options.tile_size) ||
+        (roi && (roi->width != width || roi->height != height ||
+                 roi->tile_size != options.tile_size))) {
+        return -400;
+    }
+
+    SimdKernel kernel = options.kernel == SimdKernel::Auto ? bestMotionKernel()
+                                                           : options.kernel;
+    if (!isMotionKernelAvailable(kernel)) {
+        return -404;
+    }
+    RowsFunction rows = rowsFunction(kernel);
+
+    prepareMap(map, width, height, options.tile_size);
+
+    MotionJob job;
+    job.previous  = previous;
+    job.current   = current;
+    job.stride    = stride;
+    job.width     = width;
+    job.tile_size = options.tile_size;
+    job.threshold = options.threshold;
+
+    for (uint32_t ty = 0; ty < map.tiles_y; ++ty) {
+        const uint32_t    row_begin = ty * options.tile_size;
+        const uint32_t    row_end   = std::min(height, row_begin + options.tile_size);
+        const std::size_t first     = static_cast<std::size_t>(ty) * map.tiles_x;
+        if (roi) {
+            // Each run of covered tiles is an image of its own, tiles
+            // outside the region keep no energy
+            for (uint32_t i = roi->tile_row_start[ty]; i < roi->tile_row_start[ty + 1]; ++i) {
+                const RoiSpan& tiles   = roi->tile_runs[i];
+                const uint32_t x_begin = tiles.begin * options.tile_size;
+                MotionJob      run     = job;
+                run.previous += x_begin;
+                run.current  += x_begin;
+                run.width     = std::min(width, tiles.end * options.tile_size) - x_begin;
+                rows(run, row_begin, row_end, map.energy.data() + first + tiles.begin,
+                     map.changed.data() + first + tiles.begin);
+            }
+        } else {
+            rows(job, row_begin, row_end, map.energy.data() + first,
+                 map.changed.data() + first);
+        }
+
+        for (uint32_t tx = 0; tx < map.tiles_x; ++tx) {
+            const uint32_t tile_width =
+                std::min(width - tx * options.tile_size, options.tile_size);
+            const double pixels = static_cast<double>(tile_width) *
+                                  (row_end - row_begin);
+            const std::size_t tile = first + tx;
+            map.total_energy += map.energy[tile];
+            if (map.changed[tile] > options.active_fraction * pixels) {
+                map.active[tile] = 1;
+                ++map.active_tiles;
+            }
+        }
+    }
+    return 0;
+}
+
+MotionDetector::MotionDetector(const MotionOptions& options)
+    : options_(options) {}
+
+void MotionDetector::reset() {
+    this->format_ = {};
+    this->previous_.reset();
+}
+
+int16_t MotionDetector::process(const Frame& frame, MotionMap& map) {
+    TraceScope         trace(frame, TraceStage::Process, "motion");
+    const MediaFormat& format = frame.format;
+    if (format.width == 0 || format.height == 0 ||
+        !isValidTileSize(this->options_.tile_size)) {
+        return -400;
+    }
+
+    if (format.subtype != this->format_.subtype ||
+        format.width != this->format_.width ||
+        format.height != this->format_.height) {
+        this->reset();
+        this->format_ = format;
+    }
+
+    Frame   luma;
+    int16_t result = frameProduct(frame, FrameProduct::Gray, luma);
+    if (result != 0) {
+        return result;
+    }
+
+    result = 204;
+    if (this->previous_) {
+        const auto roi = frame.roi ? frame.roi->getMask(format.width, format.height,
+                                                        this->options_.tile_size)
+                                   : nullptr;
+        result = detectMotion(this->previous_.data(), luma.buffer.data(),
+                              format.width, format.width, format.height,
+                              this->options_, map, roi.get());
+    } else {
+        prepareMap(map, format.width, format.height, this->options_.tile_size);
+    }
+    if (result < 0) {
+        return result;
+    }
+    map.timestamp = frame.timestamp;
+
+    this->previous_ = std::move(luma.buffer);
+    return result;
+}
@@ -0,0 +1,98 @@
+#ifndef MOTION_DETECTOR_H
+#define MOTION_DETECTOR_H
+
+#include "cpu_features.h"
+#include "hardware/webcam/frame.h"
+#include <vector>
+
+struct RoiMask;
+
+struct MotionOptions {
+    uint32_t   tile_size{16};         // Tile edge in pixels, a multiple of 16
+    uint8_t    threshold{12};         // Luma difference that counts as changed
+    double     active_fraction{0.02}; // Changed pixels that make a tile active
+    SimdKernel kernel{SimdKernel::Auto};
+};
+
+/**
+ * @brief Per-tile motion of one frame against the previous one, row-major.
+ *
+ * Reused from frame to frame; the vectors only grow when the tile grid does.
+ * Tiles on the right and bottom edge may cover fewer pixels.
+ */
+struct MotionMap {
+    uint32_t              tile_size{};
+    uint32_t              tiles_x{};
+    uint32_t              tiles_y{};
+    std::vector<uint32_t> energy{};  // Sum of absolute luma differences
+    std::vector<uint32_t> changed{}; // Pixels that moved more than `threshold`
+    std::vector<uint8_t>  active{};  // 1 where `changed` exceeds the fraction
+    std::size_t           active_tiles{};
+    uint64_t              total_energy{};
+    int64_t               timestamp{};
+};
+
+/**
+ * @brief Kernel `SimdKernel::Auto` resolves to for motion detection.
+ */
+SimdKernel bestMotionKernel();
+
+/**
+ * @brief Whether `kernel` was compiled in and the CPU supports it.
+ */
+bool isMotionKernelAvailable(SimdKernel kernel);
+
+/**
+ * @brief Compare two luma planes tile by tile.
+ *
+ * All kernels produce identical maps. Each 16 pixel column of a tile row is
+ * reduced in registers over all rows of the tile before anything is written,
+ * so the cost is two streaming reads of the planes.
+ *
+ * @param stride Bytes between rows of both planes.
+ * @param roi Region rasterized for these planes on the map's tile grid. Only
+ * the tiles it covers are compared, the others have no energy and are never
+ * active. Null compares the whole planes.
+ * @return 0 on success, -400 for invalid options, planes or mask, -404 if
+ * the requested kernel is not available.
+ */
+int16_t detectMotion(const uint8_t* previous, const uint8_t* current,
+                     std::size_t stride, uint32_t width, uint32_t height,
+                     const MotionOptions& options, MotionMap& map,
+                     const RoiMask* roi = nullptr);
+
+/**
+ * @brief Tracks motion between consecutive frames of one stream.
+ *
+ * Works on the frame's cached `FrameProduct::Gray`, so planar frames (NV12,
+ * I420, IYUV, YV12, Y800) are compared in place and packed 4:2:2 frames share
+ * their extracted luma with the other stages. The previous plane is kept by
+ * reference, not copied. Frames with a `Frame::roi` are compared over the
+ * tiles of its mask only.
+ */
+class MotionDetector {
+  private:
+    MotionOptions  options_;
+    MediaFormat    format_{};
+    FrameBufferRef previous_{}; // Luma plane at offset 0
+
+  public:
+    explicit MotionDetector(const MotionOptions& options = {});
+
+    /**
+     * @brief Compare `frame` with the previous frame and fill `map`.
+     * @return 0 on success, 204 for the first frame or after a format change
+     * (nothing to compare with), -400 for subtypes without a luma plane or a
+     * short buffer, -404 if the requested kernel is not available.
+     */
+    int16_t process(const Frame& frame, MotionMap& map);
+
+    /**
+     * @brief Forget the previous frame.
+     */
+    void reset();
+
+    const MotionOptions& getOptions() const { return this->options_; }
+};
+
+#endif // MOTION_DETECTOR_H
@@ -0,0 +1,280 @@
+#include "optical_flow.h"
+
+#include "frame_cache.h"
+#include "hardware/webcam/frame_trace.h"
+#include "optical_flow_kernel.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+constexpr uint32_t    PATCH_STRIDE    = 32; // Widest register, in pixels
+constexpr uint32_t    MAX_WINDOW_SIZE = 31;
+constexpr std::size_t POINTS_PER_TASK = 32;
+
+// Scharr derivatives are 32 times the slope and samples are in Q5, so every
+// window sum carries a factor of 32 * 32
+constexpr double SUM_SCALE = 1024.0;
+
+bool isValidOptions(const FlowOptions& options) {
+    return options.window_size >= 3 && options.window_size <= MAX_WINDOW_SIZE &&
+           options.window_size % 2 == 1 && options.levels > 0 &&
+           options.max_iterations > 0;
+}
+
+/**
+ * @brief Window of `level` whose centre is at `(x, y)`, false if part of it
+ * (or of the extra column and row bilinear sampling reads) is outside.
+ */
+bool placeWindow(const PyramidLevel& level, double x, double y, uint32_t size,
+                 FlowWindow& window) {
+    const double left = x - (size - 1) / 2.0;
+    const double top  = y - (size - 1) / 2.0;
+    if (!std::isfinite(left) || !std::isfinite(top) || left < 0 || top < 0 ||
+        left + size >= level.width || top + size >= level.height) {
+        return false;
+    }
+    const auto   x0 = static_cast<std::size_t>(left);
+    const auto   y0 = static_cast<std::size_t>(top);
+    const double a  = left - static_cast<double>(x0);
+    const double b  = top - static_cast<double>(y0);
+    const double one = 1 << FLOW_WEIGHT_BITS;
+
+    window.image  = level.image + y0 * level.stride + x0;
+    window.dx     = level.dx ? level.dx + y0 * level.stride + x0 : nullptr;
+    window.dy     = level.dy ? level.dy + y0 * level.stride + x0 : nullptr;
+    window.stride = level.stride;
+    window.size   = size;
+    window.padded = PATCH_STRIDE;
+    window.w00    = static_cast<int32_t>(std::lround((1 - a) * (1 - b) * one));
+    window.w01    = static_cast<int32_t>(std::lround(a * (1 - b) * one));
+    window.w10    = static_cast<int32_t>(std::lround((1 - a) * b * one));
+    window.w11    = (1 << FLOW_WEIGHT_BITS) - window.w00 - window.w01 - window.w10;
+    return true;
+}
+
+// Pixel centres of a 2x2 box reduction sit between those of its parent
+double toLevel(double value, std::size_t level) {
+    return (value + 0.5) / static_cast<double>(1u << level) - 0.5;
+}
+
+/**
+ * @brief Moves a window centre inwards until the window fits `extent`,
+ * false if it never does.
+ */
+bool clampCentre(double& value, uint32_t extent, uint32_t size) {
+    if (extent <= size + 1) {
+        return false;
+    }
+    const double half = (size - 1) / 2.0;
+    value             = std::clamp(value, half, extent - size - 1 + half);
+    return true;
+}
+
+struct PointScratch {
+    alignas(64) int16_t patch[MAX_WINDOW_SIZE * PATCH_STRIDE];
+    alignas(64) int16_t patch_dx[MAX_WINDOW_SIZE * PATCH_STRIDE];
+    alignas(64) int16_t patch_dy[MAX_WINDOW_SIZE * PATCH_STRIDE];
+};
+
+/**
+ * @brief Track one point down all levels.
+ *
+ * Windows that would cross the border are moved inwards, template and
+ * search window alike, so points near the edge follow their neighbourhood
+ * instead of skipping the coarse levels that carry large motion.
+ */
+FlowPoint trackPoint(const FlowKernels& kernels, const ImagePyramid& previous,
+                     const ImagePyramid& next, std::size_t levels,
+                     const FlowOptions& options, const FlowPoint& point,
+                     PointScratch& scratch) {
+    const uint32_t      size    = options.window_size;
+    const double        area    = static_cast<double>(size) * size;
+    const double        epsilon = options.epsilon * options.epsilon;
+    const PyramidLevel& base    = previous.level(0);
+
+    FlowPoint result = point;
+    result.found     = false;
+    result.error     = 0;
+    auto inside = [&](double x, double y) {
+        return x >= 0 && y >= 0 && x <= base.width - 1 && y <= base.height - 1;
+    };
+    if (!inside(point.x, point.y)) {
+        return result;
+    }
+
+    // Displacement on the current level, doubled on the way down
+    double     dx = 0, dy = 0;
+    double     cx = 0, cy = 0; // Window centre in the previous image
+    FlowWindow window;
+    for (std::size_t l = levels; l-- > 0;) {
+        dx *= 2, dy *= 2;
+        const PyramidLevel& level = previous.level(l);
+        cx = toLevel(point.x, l);
+        cy = toLevel(point.y, l);
+        if (!clampCentre(cx, level.width, size) ||
+            !clampCentre(cy, level.height, size)) {
+            continue; // Only coarse levels can be this small
+        }
+
+        placeWindow(level, cx, cy, size, window);
+        int64_t g[3];
+        kernels.sampleTemplate(window, scratch.patch, scratch.patch_dx,
+                               scratch.patch_dy, g);
+        const double a11 = static_cast<double>(g[0]);
+        const double a12 = static_cast<double>(g[1]);
+        const double a22 = static_cast<double>(g[2]);
+        const double det = a11 * a22 - a12 * a12;
+        const double min_eigen =
+            (a11 + a22 - std::sqrt((a11 - a22) * (a11 - a22) + 4 * a12 * a12)) /
+            (2 * area * SUM_SCALE);
+        if (min_eigen < options.min_eigenvalue || det <= 0) {
+            if (l == 0) {
+                return result;
+            }
+            continue;
+        }
+
+        double previous_x = 0, previous_y = 0;
+        for (uint32_t i = 0; i < options.max_iterations; ++i) {
+            if (!placeWindow(next.level(l), cx + dx, cy + dy, size, window)) {
+                if (l == 0) {
+                    return result;
+                }
+                break;
+            }
+            int64_t b[3];
+            kernels.mismatch(window, scratch.patch, scratch.patch_dx,
+                             scratch.patch_dy, b);
+            const double bx     = static_cast<double>(b[0]);
+            const double by     = static_cast<double>(b[1]);
+            const double step_x = (a12 * by - a22 * bx) / det;
+            const double step_y = (a12 * bx - a11 * by) / det;
+            dx += step_x;
+            dy += step_y;
+            if (step_x * step_x + step_y * step_y <= epsilon) {
+                break;
+            }
+            // Stepping back and forth around the minimum, settle in between
+            if (i > 0 && std::abs(step_x + previous_x) < 0.01 &&
+                std::abs(step_y + previous_y) < 0.01) {
+                dx -= step_x * 0.5;
+                dy -= step_y * 0.5;
+                break;
+            }
+            previous_x = step_x;
+            previous_y = step_y;
+        }
+    }
+
+    result.x = static_cast<float>(point.x + dx);
+    result.y = static_cast<float>(point.y + dy);
+    if (!inside(result.x, result.y) ||
+        !placeWindow(next.level(0), cx + dx, cy + dy, size, window)) {
+        return result;
+    }
+    int64_t b[3];
+    kernels.mismatch(window, scratch.patch, scratch.patch_dx, scratch.patch_dy, b);
+    result.found = true;
+    result.error = static_cast<float>(static_cast<double>(b[2]) /
+                                      (area * (1 << FLOW_SAMPLE_BITS)));
+    return result;
+}
+
+} // namespace
+
+int16_t computeFlow(const ImagePyramid& previous, const ImagePyramid& next,
+                    const std::vector<FlowPoint>& points,
+                    std::vector<FlowPoint>& tracked, const FlowOptions& options,
+                    ThreadPool* workers) {
+    if (!isValidOptions(options) || previous.size() == 0 ||
+        previous.size() != next.size() || !previous.hasGradients() ||
+        previous.level(0).width != next.level(0).width ||
+        previous.level(0).height != next.level(0).height) {
+        return -400;
+    }
+    SimdKernel kernel = options.kernel == SimdKernel::Auto ? bestFlowKernel()
+                                                           : options.kernel;
+    if (!isFlowKernelAvailable(kernel)) {
+        return -404;
+    }
+    const FlowKernels& kernels = *flowKernels(kernel);
+    const std::size_t  levels  = std::min<std::size_t>(options.levels, previous.size());
+
+    tracked.resize(points.size());
+    auto chunk = [&](std::size_t begin, std::size_t end) {
+        PointScratch scratch;
+        for (std::size_t i = begin; i < end; ++i) {
+            tracked[i] = trackPoint(kernels, previous, next, levels, options,
+                                    points[i], scratch);
+        }
+    };
+    if (workers) {
+        workers->parallelFor(points.size(), POINTS_PER_TASK, chunk);
+    } else {
+        chunk(0, points.size());
+    }
+    return 0;
+}
+
+OpticalFlowTracker::OpticalFlowTracker(const FlowOptions&          options,
+                                       std::shared_ptr<ThreadPool> workers)
+    : options_(options), workers_(std::move(workers)) {
+    if (!this->workers_) {
+        this->workers_ = std::make_shared<ThreadPool>(options.threads);
+    }
+}
+
+void OpticalFlowTracker::reset() {
+    this->format_ = {};
+    this->primed_ = false;
+}
+
+int16_t OpticalFlowTracker::track(const Frame&                  frame,
+                                  const std::vector<FlowPoint>& points,
+                                  std::vector<FlowPoint>&       tracked) {
+    TraceScope         trace(frame, TraceStage::Process, "flow");
+    const MediaFormat& format = frame.format;
+    if (format.width == 0 || format.height == 0 ||
+        !isValidOptions(this->options_)) {
+        return -400;
+    }
+    if (format.subtype != this->format_.subtype ||
+        format.width != this->format_.width ||
+        format.height != this->format_.height) {
+        this->reset();
+        this->format_ = format;
+    }
+
+    Frame   luma;
+    int16_t result = frameProduct(frame, FrameProduct::Gray, luma);
+    if (result != 0) {
+        return result;
+    }
+
+    // Build into the older pyramid; the other one still holds the last frame
+    const std::size_t next = this->current_ ^ 1;
+    result = this->pyramids_[next].build(luma.buffer.data(), format.width,
+                                         format.width, format.height,
+                                         this->options_.levels, true,
+                                         this->options_.kernel,
+                                         this->workers_.get());
+    if (result != 0) {
+        return result;
+    }
+
+    if (this->primed_) {
+        result = computeFlow(this->pyramids_[this->current_], this->pyramids_[next],
+                             points, tracked, this->options_, this->workers_.get());
+    } else {
+        tracked = points;
+        for (FlowPoint& point : tracked) {
+            point.found = false;
+            point.error = 0;
+        }
+        result = 204;
+    }
+    this->current_ = next;
+    this->primed_  = true;
+    return result;
+}
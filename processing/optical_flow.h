@@ -0,0 +1,102 @@
+#ifndef OPTICAL_FLOW_H
+#define OPTICAL_FLOW_H
+
+#include "hardware/webcam/frame.h"
+#include "image_pyramid.h"
+#include <memory>
+
+struct FlowOptions {
+    uint32_t    window_size{21};    // Odd, 3 to 31 pixels
+    uint32_t    levels{4};          // Pyramid levels, full resolution included
+    uint32_t    max_iterations{30}; // Per level
+    double      epsilon{0.01};      // Step in pixels that ends the iterations
+    double      min_eigenvalue{0.1}; // Smallest eigenvalue of the window's
+                                     // gradient matrix per pixel, in squared
+                                     // levels per pixel; flatter windows are lost
+    std::size_t threads{0};         // Private pool size, 0 for one per
+                                    // hardware thread
+    SimdKernel  kernel{SimdKernel::Auto};
+};
+
+/**
+ * @brief Point tracked from one frame into the next.
+ */
+struct FlowPoint {
+    float x{};
+    float y{};
+    bool  found{false}; // False if the point left the image or its window
+                        // has too little texture to be followed
+    float error{};      // Mean absolute luma difference over the window
+};
+
+/**
+ * @brief Pyramidal Lucas-Kanade flow of sparse points between two pyramids.
+ *
+ * Starting on the coarsest level, every point's displacement is refined by
+ * Gauss-Newton steps on a `window_size` square around it and doubled into
+ * the next finer level. Windows are sampled bilinearly in fixed point and all
+ * sums are exact integers, so every kernel returns the same points. Points
+ * are independent and split across `workers`.
+ *
+ * @param previous Pyramid of the earlier frame, built with gradients.
+ * @param next Pyramid of the later frame, same geometry.
+ * @param workers Pool to track points on, or null for the calling thread.
+ * @return 0 on success, -400 for mismatched pyramids, missing gradients or
+ * invalid options, -404 if the requested kernel is not available.
+ */
+int16_t computeFlow(const ImagePyramid& previous, const ImagePyramid& next,
+                    const std::vector<FlowPoint>& points,
+                    std::vector<FlowPoint>& tracked, const FlowOptions& options,
+                    ThreadPool* workers = nullptr);
+
+/**
+ * @brief Tracks points through consecutive frames of one stream.
+ *
+ * Keeps two pyramids and swaps them: the pyramid built for a frame is the
+ * previous pyramid of the next one, so every frame is reduced and
+ * differentiated exactly once, and neither allocates after the first frame.
+ * Level 0 comes from the frame's cached `FrameProduct::Gray`.
+ */
+class OpticalFlowTracker {
+  private:
+    FlowOptions                 options_;
+    std::shared_ptr<ThreadPool> workers_;
+    MediaFormat                 format_{};
+    ImagePyramid                pyramids_[2]{};
+    std::size_t                 current_{};
+    bool                        primed_{false};
+
+  public:
+    /**
+     * @param workers Pool to build pyramids and track points on, shared with
+     * other stages. A private pool with `options.threads` workers is created
+     * if null.
+     */
+    explicit OpticalFlowTracker(const FlowOptions&          options = {},
+                                std::shared_ptr<ThreadPool> workers = nullptr);
+
+    /**
+     * @brief Build the pyramid of `frame` and track `points`, given in the
+     * previous frame, into it.
+     * @return 0 on success, 204 for the first frame or after a format change
+     * (nothing to track into; `tracked` holds the points, none found), -400
+     * for subtypes without luma, a short buffer or invalid options, -404 if
+     * the requested kernel is not available.
+     */
+    int16_t track(const Frame& frame, const std::vector<FlowPoint>& points,
+                  std::vector<FlowPoint>& tracked);
+
+    /**
+     * @brief Forget the previous frame.
+     */
+    void reset();
+
+    /**
+     * @brief Pyramid of the last frame passed to `track`, empty before it.
+     */
+    const ImagePyramid& getPyramid() const { return this->pyramids_[this->current_]; }
+
+    const FlowOptions& getOptions() const { return this->options_; }
+};
+
+#endif // OPTICAL_FLOW_H
@@ -0,0 +1,75 @@
+#include "optical_flow_kernel.h"
+
+#include <immintrin.h>
+
+namespace {
+
+struct Avx2 {
+    using V = __m256i;
+
+    static V zero() { return _mm256_setzero_si256(); }
+    static V set1_epi16(int16_t value) { return _mm256_set1_epi16(value); }
+    static V set1_epi32(int32_t value) { return _mm256_set1_epi32(value); }
+    static V laneIndex() {
+        return _mm256_setr_epi16(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13,
+                                 14, 15);
+    }
+
+    static V and_(V a, V b) { return _mm256_and_si256(a, b); }
+    static V add_epi16(V a, V b) { return _mm256_add_epi16(a, b); }
+    static V sub_epi16(V a, V b) { return _mm256_sub_epi16(a, b); }
+    static V mullo_epi16(V a, V b) { return _mm256_mullo_epi16(a, b); }
+    static V max_epi16(V a, V b) { return _mm256_max_epi16(a, b); }
+    static V cmpgt_epi16(V a, V b) { return _mm256_cmpgt_epi16(a, b); }
+    static V srli_epi16_2(V a) { return _mm256_srli_epi16(a, 2); }
+    static V srli_epi16_8(V a) { return _mm256_srli_epi16(a, 8); }
+    static V add_epi32(V a, V b) { return _mm256_add_epi32(a, b); }
+    static V srai_epi32(V a, int shift) { return _mm256_srai_epi32(a, shift); }
+    static V madd_epi16(V a, V b) { return _mm256_madd_epi16(a, b); }
+    static V unpacklo_epi16(V a, V b) { return _mm256_unpacklo_epi16(a, b); }
+    static V unpackhi_epi16(V a, V b) { return _mm256_unpackhi_epi16(a, b); }
+    static V packs_epi32(V a, V b) { return _mm256_packs_epi32(a, b); }
+
+    static V loadBytes(const uint8_t* p) {
+        return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+    }
+
+    // Sixteen pixels widened to 16 bits, in order across both lanes
+    static V loadPixels(const uint8_t* p) {
+        return _mm256_cvtepu8_epi16(
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(p)));
+    }
+
+    static V loadWords(const int16_t* p) {
+        return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+    }
+
+    static void storeWords(int16_t* p, V value) {
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), value);
+    }
+
+    // Packing works per lane; the permute brings both halves together
+    static void storeNarrow(uint8_t* p, V value) {
+        V packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(value, value), 0x08);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(p),
+                         _mm256_castsi256_si128(packed));
+    }
+
+    // Sign-extends the 32-bit lanes and adds them to 64-bit lanes
+    static V accumulate64(V sums, V value) {
+        V sign = _mm256_srai_epi32(value, 31);
+        return _mm256_add_epi64(sums,
+                                _mm256_add_epi64(_mm256_unpacklo_epi32(value, sign),
+                                                 _mm256_unpackhi_epi32(value, sign)));
+    }
+
+    static int64_t sum64(V value) {
+        alignas(32) int64_t lanes[4];
+        _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), value);
+        return lanes[0] + lanes[1] + lanes[2] + lanes[3];
+    }
+};
+
+} // namespace
+
+const FlowKernels& flowKernelsAvx2() { return FlowSimd<Avx2>::kernels(); }
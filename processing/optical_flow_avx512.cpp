@@ -0,0 +1,70 @@
+#include "optical_flow_kernel.h"
+
+#include <immintrin.h>
+
+namespace {
+
+struct Avx512 {
+    using V = __m512i;
+
+    static V zero() { return _mm512_setzero_si512(); }
+    static V set1_epi16(int16_t value) { return _mm512_set1_epi16(value); }
+    static V set1_epi32(int32_t value) { return _mm512_set1_epi32(value); }
+    static V laneIndex() {
+        alignas(64) static const int16_t lanes[32] = {
+            0,  1,  2,  3,  4,  5,  6,  7,  8,  9,  10, 11, 12, 13, 14, 15,
+            16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29, 30, 31};
+        return _mm512_load_si512(lanes);
+    }
+
+    static V and_(V a, V b) { return _mm512_and_si512(a, b); }
+    static V add_epi16(V a, V b) { return _mm512_add_epi16(a, b); }
+    static V sub_epi16(V a, V b) { return _mm512_sub_epi16(a, b); }
+    static V mullo_epi16(V a, V b) { return _mm512_mullo_epi16(a, b); }
+    static V max_epi16(V a, V b) { return _mm512_max_epi16(a, b); }
+    static V srli_epi16_2(V a) { return _mm512_srli_epi16(a, 2); }
+    static V srli_epi16_8(V a) { return _mm512_srli_epi16(a, 8); }
+    static V add_epi32(V a, V b) { return _mm512_add_epi32(a, b); }
+    static V srai_epi32(V a, int shift) {
+        return _mm512_srai_epi32(a, static_cast<unsigned>(shift));
+    }
+    static V madd_epi16(V a, V b) { return _mm512_madd_epi16(a, b); }
+    static V unpacklo_epi16(V a, V b) { return _mm512_unpacklo_epi16(a, b); }
+    static V unpackhi_epi16(V a, V b) { return _mm512_unpackhi_epi16(a, b); }
+    static V packs_epi32(V a, V b) { return _mm512_packs_epi32(a, b); }
+
+    // Comparisons produce bit masks; expand them back to 0 / -1 lanes
+    static V cmpgt_epi16(V a, V b) {
+        return _mm512_movm_epi16(_mm512_cmpgt_epi16_mask(a, b));
+    }
+
+    static V loadBytes(const uint8_t* p) { return _mm512_loadu_si512(p); }
+
+    // Thirty-two pixels widened to 16 bits
+    static V loadPixels(const uint8_t* p) {
+        return _mm512_cvtepu8_epi16(
+            _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)));
+    }
+
+    static V loadWords(const int16_t* p) { return _mm512_loadu_si512(p); }
+    static void storeWords(int16_t* p, V value) { _mm512_storeu_si512(p, value); }
+
+    static void storeNarrow(uint8_t* p, V value) {
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(p),
+                            _mm512_cvtepi16_epi8(value));
+    }
+
+    // Sign-extends the 32-bit lanes and adds them to 64-bit lanes
+    static V accumulate64(V sums, V value) {
+        V sign = _mm512_srai_epi32(value, 31);
+        return _mm512_add_epi64(sums,
+                                _mm512_add_epi64(_mm512_unpacklo_epi32(value, sign),
+                                                 _mm512_unpackhi_epi32(value, sign)));
+    }
+
+    static int64_t sum64(V value) { return _mm512_reduce_add_epi64(value); }
+};
+
+} // namespace
+
+const FlowKernels& flowKernelsAvx512() { return FlowSimd<Avx512>::kernels(); }
@@ -0,0 +1,406 @@
+#ifndef OPTICAL_FLOW_KERNEL_H
+#define OPTICAL_FLOW_KERNEL_H
+
+// Internal to the image pyramid, the optical flow tracker and the frame
+// cache. The SIMD translation units include this header and instantiate the
+// `*Simd` templates with their instruction set wrapper; the scalar functions
+// here are the reference every kernel matches. Helpers are `static` so each
+// translation unit keeps its own copy, built with its own instruction set.
+//
+// Window sums are exact integers: interpolated samples are 16-bit, products
+// are summed in 32-bit lanes per row and widened to 64 bits between rows,
+// so every kernel tracks points to the same bits.
+
+#include "image_pyramid.h"
+#include <algorithm>
+#include <cstdint>
+
+constexpr int FLOW_WEIGHT_BITS = 14; // Bilinear weights in Q14
+constexpr int FLOW_SAMPLE_BITS = 5;  // Interpolated luma in Q5
+
+/**
+ * @brief Window of one point on one pyramid level.
+ *
+ * `image`, `dx` and `dy` point at the top-left pixel of the window; the
+ * bilinear weights of the sub-pixel position sum to `1 << FLOW_WEIGHT_BITS`.
+ * Rows are read in whole registers, up to `padded` pixels plus one, which
+ * the level padding covers.
+ */
+struct FlowWindow {
+    const uint8_t* image{nullptr};
+    const int16_t* dx{nullptr};
+    const int16_t* dy{nullptr};
+    std::size_t    stride{}; // Pixels between rows of all three planes
+    int32_t        w00{}, w01{}, w10{}, w11{};
+    uint32_t       size{};   // Window edge
+    uint32_t       padded{}; // Row length of the patches, a multiple of 32
+};
+
+/**
+ * @brief Kernels of one instruction set.
+ */
+struct FlowKernels {
+    // 2x2 box average of `src` into rows `[row_begin, row_end)` of `dst`
+    void (*downsample)(const uint8_t* src, std::size_t src_stride,
+                       uint8_t* dst, std::size_t dst_stride, uint32_t width,
+                       uint32_t row_begin, uint32_t row_end);
+
+    // Scharr derivatives of rows `[row_begin, row_end)`, zero on the border
+    void (*gradients)(const uint8_t* image, std::size_t stride, uint32_t width,
+                      uint32_t height, int16_t* dx, int16_t* dy,
+                      uint32_t row_begin, uint32_t row_end);
+
+    // Samples the previous image and its gradients over the window into
+    // `padded`-strided patches and returns sum dx^2, dx*dy and dy^2
+    void (*sampleTemplate)(const FlowWindow& window, int16_t* patch,
+                           int16_t* patch_dx, int16_t* patch_dy,
+                           int64_t* sums);
+
+    // Samples the next image over the window and returns
+    // sum (J - I) * dx, (J - I) * dy and |J - I|, all in Q5
+    void (*mismatch)(const FlowWindow& window, const int16_t* patch,
+                     const int16_t* patch_dx, const int16_t* patch_dy,
+                     int64_t* sums);
+};
+
+static inline int32_t flowInterpolate(const FlowWindow& w, int32_t v00,
+                                      int32_t v01, int32_t v10, int32_t v11,
+                                      int shift) {
+    return (v00 * w.w00 + v01 * w.w01 + v10 * w.w10 + v11 * w.w11 +
+            (1 << (shift - 1))) >>
+           shift;
+}
+
+static inline void downsampleColumns(const uint8_t* src, std::size_t src_stride,
+                                     uint8_t* dst, std::size_t dst_stride,
+                                     uint32_t x_begin, uint32_t width,
+                                     uint32_t row_begin, uint32_t row_end) {
+    for (uint32_t y = row_begin; y < row_end; ++y) {
+        const uint8_t* a   = src + 2 * y * src_stride;
+        const uint8_t* b   = a + src_stride;
+        uint8_t*       out = dst + y * dst_stride;
+        for (uint32_t x = x_begin; x < width; ++x) {
+            out[x] = static_cast<uint8_t>(
+                (a[2 * x] + a[2 * x + 1] + b[2 * x] + b[2 * x + 1] + 2) >> 2);
+        }
+    }
+}
+
+static inline void downsampleScalar(const uint8_t* src, std::size_t src_stride,
+                                    uint8_t* dst, std::size_t dst_stride,
+                                    uint32_t width, uint32_t row_begin,
+                                    uint32_t row_end) {
+    downsampleColumns(src, src_stride, dst, dst_stride, 0, width, row_begin,
+                      row_end);
+}
+
+static inline void gradientPixel(const uint8_t* p, std::size_t stride,
+                                 int16_t* dx, int16_t* dy) {
+    const uint8_t* a = p - stride;
+    const uint8_t* c = p + stride;
+    *dx = static_cast<int16_t>(3 * (a[1] - a[-1] + c[1] - c[-1]) +
+                               10 * (p[1] - p[-1]));
+    *dy = static_cast<int16_t>(3 * (c[-1] - a[-1] + c[1] - a[1]) +
+                               10 * (c[0] - a[0]));
+}
+
+static inline void gradientsScalar(const uint8_t* image, std::size_t stride,
+                                   uint32_t width, uint32_t height,
+                                   int16_t* dx, int16_t* dy, uint32_t row_begin,
+                                   uint32_t row_end) {
+    for (uint32_t y = row_begin; y < row_end; ++y) {
+        int16_t* row_dx = dx + y * stride;
+        int16_t* row_dy = dy + y * stride;
+        if (y == 0 || y + 1 >= height || width < 3) {
+            std::fill(row_dx, row_dx + width, int16_t{0});
+            std::fill(row_dy, row_dy + width, int16_t{0});
+            continue;
+        }
+        row_dx[0] = row_dy[0] = 0;
+        row_dx[width - 1] = row_dy[width - 1] = 0;
+        for (uint32_t x = 1; x + 1 < width; ++x) {
+            gradientPixel(image + y * stride + x, stride, row_dx + x, row_dy + x);
+        }
+    }
+}
+
+static inline void sampleTemplateScalar(const FlowWindow& w, int16_t* patch,
+                                        int16_t* patch_dx, int16_t* patch_dy,
+                                        int64_t* sums) {
+    const int image_shift = FLOW_WEIGHT_BITS - FLOW_SAMPLE_BITS;
+    sums[0] = sums[1] = sums[2] = 0;
+    for (uint32_t y = 0; y < w.size; ++y) {
+        const std::size_t row = y * w.stride;
+        const std::size_t out = y * w.padded;
+        for (uint32_t x = 0; x < w.padded; ++x) {
+            if (x >= w.size) {
+                patch[out + x] = patch_dx[out + x] = patch_dy[out + x] = 0;
+                continue;
+            }
+            const std::size_t i = row + x;
+            const std::size_t s = w.stride;
+            const int32_t value = flowInterpolate(
+                w, w.image[i], w.image[i + 1], w.image[i + s], w.image[i + s + 1],
+                image_shift);
+            const int32_t gx = flowInterpolate(w, w.dx[i], w.dx[i + 1], w.dx[i + s],
+                                               w.dx[i + s + 1], FLOW_WEIGHT_BITS);
+            const int32_t gy = flowInterpolate(w, w.dy[i], w.dy[i + 1], w.dy[i + s],
+                                               w.dy[i + s + 1], FLOW_WEIGHT_BITS);
+            patch[out + x]    = static_cast<int16_t>(value);
+            patch_dx[out + x] = static_cast<int16_t>(gx);
+            patch_dy[out + x] = static_cast<int16_t>(gy);
+            sums[0] += gx * gx;
+            sums[1] += gx * gy;
+            sums[2] += gy * gy;
+        }
+    }
+}
+
+static inline void mismatchScalar(const FlowWindow& w, const int16_t* patch,
+                                  const int16_t* patch_dx,
+                                  const int16_t* patch_dy, int64_t* sums) {
+    const int image_shift = FLOW_WEIGHT_BITS - FLOW_SAMPLE_BITS;
+    sums[0] = sums[1] = sums[2] = 0;
+    for (uint32_t y = 0; y < w.size; ++y) {
+        for (uint32_t x = 0; x < w.size; ++x) {
+            const std::size_t i     = y * w.stride + x;
+            const std::size_t s     = w.stride;
+            const std::size_t p     = y * w.padded + x;
+            const int32_t     value = flowInterpolate(
+                w, w.image[i], w.image[i + 1], w.image[i + s], w.image[i + s + 1],
+                image_shift);
+            const int32_t diff = value - patch[p];
+            sums[0] += diff * patch_dx[p];
+            sums[1] += diff * patch_dy[p];
+            sums[2] += diff < 0 ? -diff : diff;
+        }
+    }
+}
+
+/**
+ * @brief Shared by the SSE2, AVX2 and AVX-512 kernels.
+ *
+ * `Isa` holds one 16-bit lane per pixel. Interpolation interleaves the left
+ * and right neighbours with `unpack` and applies each weight pair with one
+ * `madd`; because unpack and pack both work within 128-bit lanes, pixels
+ * come back in order after `packs_epi32`.
+ */
+template <typename Isa>
+struct FlowSimd {
+    using V                         = typename Isa::V;
+    static constexpr uint32_t LANES = sizeof(V) / 2;
+
+    static V interpolate(V v00, V v01, V v10, V v11, V top, V bottom,
+                         V round, int shift) {
+        V low  = Isa::add_epi32(
+            Isa::add_epi32(Isa::madd_epi16(Isa::unpacklo_epi16(v00, v01), top),
+                           Isa::madd_epi16(Isa::unpacklo_epi16(v10, v11), bottom)),
+            round);
+        V high = Isa::add_epi32(
+            Isa::add_epi32(Isa::madd_epi16(Isa::unpackhi_epi16(v00, v01), top),
+                           Isa::madd_epi16(Isa::unpackhi_epi16(v10, v11), bottom)),
+            round);
+        return Isa::packs_epi32(Isa::srai_epi32(low, shift),
+                                Isa::srai_epi32(high, shift));
+    }
+
+    // Pairs of weights for `madd` against interleaved neighbours
+    static V pair(int32_t left, int32_t right) {
+        return Isa::set1_epi32(static_cast<int32_t>(
+            (static_cast<uint32_t>(right) << 16) |
+            (static_cast<uint32_t>(left) & 0xFFFF)));
+    }
+
+    static void downsample(const uint8_t* src, std::size_t src_stride,
+                           uint8_t* dst, std::size_t dst_stride, uint32_t width,
+                           uint32_t row_begin, uint32_t row_end) {
+        const V        low_byte = Isa::set1_epi16(0x00FF);
+        const V        two      = Isa::set1_epi16(2);
+        const uint32_t x_end    = width / LANES * LANES;
+        for (uint32_t y = row_begin; y < row_end; ++y) {
+            const uint8_t* a   = src + 2 * y * src_stride;
+            const uint8_t* b   = a + src_stride;
+            uint8_t*       out = dst + y * dst_stride;
+            for (uint32_t x = 0; x < x_end; x += LANES) {
+                V top    = Isa::loadBytes(a + 2 * x);
+                V bottom = Isa::loadBytes(b + 2 * x);
+                V sum    = Isa::add_epi16(
+                    Isa::add_epi16(Isa::and_(top, low_byte), Isa::srli_epi16_8(top)),
+                    Isa::add_epi16(Isa::and_(bottom, low_byte),
+                                   Isa::srli_epi16_8(bottom)));
+                Isa::storeNarrow(out + x, Isa::srli_epi16_2(Isa::add_epi16(sum, two)));
+            }
+        }
+        downsampleColumns(src, src_stride, dst, dst_stride, x_end, width,
+                          row_begin, row_end);
+    }
+
+    static void gradients(const uint8_t* image, std::size_t stride,
+                          uint32_t width, uint32_t height, int16_t* dx,
+                          int16_t* dy, uint32_t row_begin, uint32_t row_end) {
+        const V three = Isa::set1_epi16(3);
+        const V ten   = Isa::set1_epi16(10);
+        for (uint32_t y = row_begin; y < row_end; ++y) {
+            if (y == 0 || y + 1 >= height || width < LANES + 2) {
+                gradientsScalar(image, stride, width, height, dx, dy, y, y + 1);
+                continue;
+            }
+            const uint8_t* b      = image + y * stride;
+            const uint8_t* a      = b - stride;
+            const uint8_t* c      = b + stride;
+            int16_t*       row_dx = dx + y * stride;
+            int16_t*       row_dy = dy + y * stride;
+            row_dx[0] = row_dy[0] = 0;
+            row_dx[width - 1] = row_dy[width - 1] = 0;
+
+            uint32_t x = 1;
+            for (; x + LANES + 1 <= width; x += LANES) {
+                V a0 = Isa::loadPixels(a + x - 1), a1 = Isa::loadPixels(a + x),
+                  a2 = Isa::loadPixels(a + x + 1);
+                V b0 = Isa::loadPixels(b + x - 1), b2 = Isa::loadPixels(b + x + 1);
+                V c0 = Isa::loadPixels(c + x - 1), c1 = Isa::loadPixels(c + x),
+                  c2 = Isa::loadPixels(c + x + 1);
+
+                V gx = Isa::add_epi16(
+                    Isa::mullo_epi16(Isa::add_epi16(Isa::sub_epi16(a2, a0),
+                                                    Isa::sub_epi16(c2, c0)),
+                                     three),
+                    Isa::mullo_epi16(Isa::sub_epi16(b2, b0), ten));
+                V gy = Isa::add_epi16(
+                    Isa::mullo_epi16(Isa::add_epi16(Isa::sub_epi16(c0, a0),
+                                                    Isa::sub_epi16(c2, a2)),
+                                     three),
+                    Isa::mullo_epi16(Isa::sub_epi16(c1, a1), ten));
+                Isa::storeWords(row_dx + x, gx);
+                Isa::storeWords(row_dy + x, gy);
+            }
+            for (; x + 1 < width; ++x) {
+                gradientPixel(b + x, stride, row_dx + x, row_dy + x);
+            }
+        }
+    }
+
+    static void sampleTemplate(const FlowWindow& w, int16_t* patch,
+                               int16_t* patch_dx, int16_t* patch_dy,
+                               int64_t* sums) {
+        const int image_shift = FLOW_WEIGHT_BITS - FLOW_SAMPLE_BITS;
+        const V   top         = pair(w.w00, w.w01);
+        const V   bottom      = pair(w.w10, w.w11);
+        const V   image_round = Isa::set1_epi32(1 << (image_shift - 1));
+        const V   grad_round  = Isa::set1_epi32(1 << (FLOW_WEIGHT_BITS - 1));
+        const std::size_t s   = w.stride;
+
+        for (uint32_t y = 0; y < w.size; ++y) {
+            const std::size_t row = y * s;
+            const std::size_t out = y * w.padded;
+            for (uint32_t x = 0; x < w.size; x += LANES) {
+                const uint8_t* p = w.image + row + x;
+                const int16_t* gx = w.dx + row + x;
+                const int16_t* gy = w.dy + row + x;
+                Isa::storeWords(patch + out + x,
+                                interpolate(Isa::loadPixels(p), Isa::loadPixels(p + 1),
+                                            Isa::loadPixels(p + s),
+                                            Isa::loadPixels(p + s + 1), top,
+                                            bottom, image_round, image_shift));
+                Isa::storeWords(patch_dx + out + x,
+                                interpolate(Isa::loadWords(gx), Isa::loadWords(gx + 1),
+                                            Isa::loadWords(gx + s),
+                                            Isa::loadWords(gx + s + 1), top,
+                                            bottom, grad_round, FLOW_WEIGHT_BITS));
+                Isa::storeWords(patch_dy + out + x,
+                                interpolate(Isa::loadWords(gy), Isa::loadWords(gy + 1),
+                                            Isa::loadWords(gy + s),
+                                            Isa::loadWords(gy + s + 1), top,
+                                            bottom, grad_round, FLOW_WEIGHT_BITS));
+            }
+            // Columns past the window must not contribute to any sum
+            for (uint32_t x = w.size; x < w.padded; ++x) {
+                patch[out + x] = patch_dx[out + x] = patch_dy[out + x] = 0;
+            }
+        }
+
+        V xx = Isa::zero(), xy = Isa::zero(), yy = Isa::zero();
+        for (uint32_t y = 0; y < w.size; ++y) {
+            V row_xx = Isa::zero(), row_xy = Isa::zero(), row_yy = Isa::zero();
+            for (uint32_t x = 0; x < w.size; x += LANES) {
+                V gx   = Isa::loadWords(patch_dx + y * w.padded + x);
+                V gy   = Isa::loadWords(patch_dy + y * w.padded + x);
+                row_xx = Isa::add_epi32(row_xx, Isa::madd_epi16(gx, gx));
+                row_xy = Isa::add_epi32(row_xy, Isa::madd_epi16(gx, gy));
+                row_yy = Isa::add_epi32(row_yy, Isa::madd_epi16(gy, gy));
+            }
+            xx = Isa::accumulate64(xx, row_xx);
+            xy = Isa::accumulate64(xy, row_xy);
+            yy = Isa::accumulate64(yy, row_yy);
+        }
+        sums[0] = Isa::sum64(xx);
+        sums[1] = Isa::sum64(xy);
+        sums[2] = Isa::sum64(yy);
+    }
+
+    static void mismatch(const FlowWindow& w, const int16_t* patch,
+                         const int16_t* patch_dx, const int16_t* patch_dy,
+                         int64_t* sums) {
+        const int image_shift = FLOW_WEIGHT_BITS - FLOW_SAMPLE_BITS;
+        const V   top         = pair(w.w00, w.w01);
+        const V   bottom      = pair(w.w10, w.w11);
+        const V   round       = Isa::set1_epi32(1 << (image_shift - 1));
+        const V   ones        = Isa::set1_epi16(1);
+        const V   zero        = Isa::zero();
+        const std::size_t s   = w.stride;
+
+        // Padding columns have zero gradients but not a zero difference, so
+        // the error sum masks them out
+        V inside[32 / LANES + 1];
+        for (uint32_t x = 0; x < w.size; x += LANES) {
+            const int32_t left = static_cast<int32_t>(w.size) - static_cast<int32_t>(x);
+            inside[x / LANES]  = Isa::cmpgt_epi16(
+                Isa::set1_epi16(static_cast<int16_t>(std::clamp(left, 0, 64))),
+                Isa::laneIndex());
+        }
+
+        V bx = zero, by = zero, error = zero;
+        for (uint32_t y = 0; y < w.size; ++y) {
+            V row_bx = zero, row_by = zero, row_error = zero;
+            for (uint32_t x = 0; x < w.size; x += LANES) {
+                const uint8_t* p = w.image + y * s + x;
+                const std::size_t i = y * w.padded + x;
+                V value = interpolate(Isa::loadPixels(p), Isa::loadPixels(p + 1),
+                                      Isa::loadPixels(p + s),
+                                      Isa::loadPixels(p + s + 1), top, bottom,
+                                      round, image_shift);
+                V diff  = Isa::sub_epi16(value, Isa::loadWords(patch + i));
+                V gx    = Isa::loadWords(patch_dx + i);
+                V gy    = Isa::loadWords(patch_dy + i);
+                row_bx  = Isa::add_epi32(row_bx, Isa::madd_epi16(diff, gx));
+                row_by  = Isa::add_epi32(row_by, Isa::madd_epi16(diff, gy));
+                V absdiff = Isa::and_(Isa::max_epi16(diff, Isa::sub_epi16(zero, diff)),
+                                      inside[x / LANES]);
+                row_error = Isa::add_epi32(row_error, Isa::madd_epi16(absdiff, ones));
+            }
+            bx    = Isa::accumulate64(bx, row_bx);
+            by    = Isa::accumulate64(by, row_by);
+            error = Isa::accumulate64(error, row_error);
+        }
+        sums[0] = Isa::sum64(bx);
+        sums[1] = Isa::sum64(by);
+        sums[2] = Isa::sum64(error);
+    }
+
+    static const FlowKernels& kernels() {
+        static const FlowKernels table{downsample, gradients, sampleTemplate,
+                                       mismatch};
+        return table;
+    }
+};
+
+/**
+ * @brief Kernels of `kernel`, null if it was not compiled in.
+ */
+const FlowKernels* flowKernels(SimdKernel kernel);
+
+const FlowKernels& flowKernelsSse2();
+const FlowKernels& flowKernelsAvx2();
+const FlowKernels& flowKernelsAvx512();
+
+#endif // OPTICAL_FLOW_KERNEL_H
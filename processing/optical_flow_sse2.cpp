@@ -0,0 +1,68 @@
+#include "optical_flow_kernel.h"
+
+#include <emmintrin.h>
+
+namespace {
+
+struct Sse2 {
+    using V = __m128i;
+
+    static V zero() { return _mm_setzero_si128(); }
+    static V set1_epi16(int16_t value) { return _mm_set1_epi16(value); }
+    static V set1_epi32(int32_t value) { return _mm_set1_epi32(value); }
+    static V laneIndex() { return _mm_setr_epi16(0, 1, 2, 3, 4, 5, 6, 7); }
+
+    static V and_(V a, V b) { return _mm_and_si128(a, b); }
+    static V add_epi16(V a, V b) { return _mm_add_epi16(a, b); }
+    static V sub_epi16(V a, V b) { return _mm_sub_epi16(a, b); }
+    static V mullo_epi16(V a, V b) { return _mm_mullo_epi16(a, b); }
+    static V max_epi16(V a, V b) { return _mm_max_epi16(a, b); }
+    static V cmpgt_epi16(V a, V b) { return _mm_cmpgt_epi16(a, b); }
+    static V srli_epi16_2(V a) { return _mm_srli_epi16(a, 2); }
+    static V srli_epi16_8(V a) { return _mm_srli_epi16(a, 8); }
+    static V add_epi32(V a, V b) { return _mm_add_epi32(a, b); }
+    static V srai_epi32(V a, int shift) { return _mm_srai_epi32(a, shift); }
+    static V madd_epi16(V a, V b) { return _mm_madd_epi16(a, b); }
+    static V unpacklo_epi16(V a, V b) { return _mm_unpacklo_epi16(a, b); }
+    static V unpackhi_epi16(V a, V b) { return _mm_unpackhi_epi16(a, b); }
+    static V packs_epi32(V a, V b) { return _mm_packs_epi32(a, b); }
+
+    static V loadBytes(const uint8_t* p) {
+        return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+    }
+
+    // Eight pixels widened to 16 bits
+    static V loadPixels(const uint8_t* p) {
+        return _mm_unpacklo_epi8(
+            _mm_loadl_epi64(reinterpret_cast<const __m128i*>(p)), zero());
+    }
+
+    static V loadWords(const int16_t* p) {
+        return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+    }
+
+    static void storeWords(int16_t* p, V value) {
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(p), value);
+    }
+
+    static void storeNarrow(uint8_t* p, V value) {
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(p), _mm_packus_epi16(value, value));
+    }
+
+    // Sign-extends the 32-bit lanes and adds them to 64-bit lanes
+    static V accumulate64(V sums, V value) {
+        V sign = _mm_srai_epi32(value, 31);
+        return _mm_add_epi64(sums, _mm_add_epi64(_mm_unpacklo_epi32(value, sign),
+                                                 _mm_unpackhi_epi32(value, sign)));
+    }
+
+    static int64_t sum64(V value) {
+        alignas(16) int64_t lanes[2];
+        _mm_store_si128(reinterpret_cast<__m128i*>(lanes), value);
+        return lanes[0] + lanes[1];
+    }
+};
+
+} // namespace
+
+const FlowKernels& flowKernelsSse2() { return FlowSimd<Sse2>::kernels(); }
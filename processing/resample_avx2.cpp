@@ -0,0 +1,71 @@
+#include "resample_kernel.h"
+
+#include <immintrin.h>
+
+namespace {
+
+struct Avx2 {
+    using V                         = __m256i;
+    static constexpr uint32_t LANES = 2;
+
+    static V zero() { return _mm256_setzero_si256(); }
+    static V set1_epi32(int32_t value) { return _mm256_set1_epi32(value); }
+
+    static V add_epi32(V a, V b) { return _mm256_add_epi32(a, b); }
+    static V srai_epi32(V a, int shift) { return _mm256_srai_epi32(a, shift); }
+    static V madd(V a, V b) { return _mm256_madd_epi16(a, b); }
+    static V packs_epi32(V a, V b) { return _mm256_packs_epi32(a, b); }
+    static V packus_epi16(V a, V b) { return _mm256_packus_epi16(a, b); }
+    static V unpacklo_epi8(V a, V b) { return _mm256_unpacklo_epi8(a, b); }
+    static V unpackhi_epi8(V a, V b) { return _mm256_unpackhi_epi8(a, b); }
+    static V unpacklo_epi16(V a, V b) { return _mm256_unpacklo_epi16(a, b); }
+    static V unpackhi_epi16(V a, V b) { return _mm256_unpackhi_epi16(a, b); }
+    static V srli_bytes8(V a) { return _mm256_bsrli_epi128(a, 8); }
+    static V srli_bytes4(V a) { return _mm256_bsrli_epi128(a, 4); }
+
+    static V loadBytes(const uint8_t* p) {
+        return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+    }
+
+    static void storeBytes(uint8_t* p, V value) {
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), value);
+    }
+
+    // 8 bytes per lane, widened to 16 bits
+    static V loadLanes64(const uint8_t* const* p) {
+        return _mm256_cvtepu8_epi16(
+            _mm_unpacklo_epi64(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(p[0])),
+                               _mm_loadl_epi64(reinterpret_cast<const __m128i*>(p[1]))));
+    }
+
+    static V loadLanes128(const int16_t* const* p) {
+        return _mm256_inserti128_si256(
+            _mm256_castsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p[0]))),
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(p[1])), 1);
+    }
+
+    static V broadcastLanes32(const int32_t* values) {
+        return _mm256_permutevar8x32_epi32(
+            _mm256_castsi128_si256(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(values))),
+            _mm256_setr_epi32(0, 0, 0, 0, 1, 1, 1, 1));
+    }
+
+    // Low 4 bytes of each lane to consecutive pixels
+    static void storeLanes32(uint8_t* p, V value) {
+        alignas(32) int32_t lanes[8];
+        _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), value);
+        std::memcpy(p, &lanes[0], 4);
+        std::memcpy(p + 4, &lanes[4], 4);
+    }
+
+    static void storeLanes8(uint8_t* p, V value) {
+        alignas(32) uint8_t lanes[32];
+        _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), value);
+        p[0] = lanes[0];
+        p[1] = lanes[16];
+    }
+};
+
+} // namespace
+
+const ResampleKernels& resampleKernelsAvx2() { return ResampleSimd<Avx2>::kernels(); }
@@ -0,0 +1,78 @@
+#include "resample_kernel.h"
+
+#include <immintrin.h>
+
+namespace {
+
+struct Avx512 {
+    using V                         = __m512i;
+    static constexpr uint32_t LANES = 4;
+
+    static V zero() { return _mm512_setzero_si512(); }
+    static V set1_epi32(int32_t value) { return _mm512_set1_epi32(value); }
+
+    static V add_epi32(V a, V b) { return _mm512_add_epi32(a, b); }
+    static V srai_epi32(V a, int shift) { return _mm512_srai_epi32(a, shift); }
+    static V madd(V a, V b) { return _mm512_madd_epi16(a, b); }
+    static V packs_epi32(V a, V b) { return _mm512_packs_epi32(a, b); }
+    static V packus_epi16(V a, V b) { return _mm512_packus_epi16(a, b); }
+    static V unpacklo_epi8(V a, V b) { return _mm512_unpacklo_epi8(a, b); }
+    static V unpackhi_epi8(V a, V b) { return _mm512_unpackhi_epi8(a, b); }
+    static V unpacklo_epi16(V a, V b) { return _mm512_unpacklo_epi16(a, b); }
+    static V unpackhi_epi16(V a, V b) { return _mm512_unpackhi_epi16(a, b); }
+    static V srli_bytes8(V a) { return _mm512_bsrli_epi128(a, 8); }
+    static V srli_bytes4(V a) { return _mm512_bsrli_epi128(a, 4); }
+
+    static V loadBytes(const uint8_t* p) { return _mm512_loadu_si512(p); }
+
+    static void storeBytes(uint8_t* p, V value) { _mm512_storeu_si512(p, value); }
+
+    // 8 bytes per lane, widened to 16 bits
+    static V loadLanes64(const uint8_t* const* p) {
+        long long q[4];
+        for (int l = 0; l < 4; ++l) {
+            std::memcpy(&q[l], p[l], sizeof(q[l]));
+        }
+        return _mm512_cvtepu8_epi16(_mm256_setr_epi64x(q[0], q[1], q[2], q[3]));
+    }
+
+    static V loadLanes128(const int16_t* const* p) {
+        auto lane = [&](int l) {
+            return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p[l]));
+        };
+        V value = _mm512_castsi128_si512(lane(0));
+        value   = _mm512_inserti32x4(value, lane(1), 1);
+        value   = _mm512_inserti32x4(value, lane(2), 2);
+        return _mm512_inserti32x4(value, lane(3), 3);
+    }
+
+    static V broadcastLanes32(const int32_t* values) {
+        return _mm512_permutexvar_epi32(
+            _mm512_setr_epi32(0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3),
+            _mm512_castsi128_si512(_mm_loadu_si128(reinterpret_cast<const __m128i*>(values))));
+    }
+
+    // Low 4 bytes of each lane to consecutive pixels
+    static void storeLanes32(uint8_t* p, V value) {
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(p),
+                         _mm512_castsi512_si128(_mm512_permutexvar_epi32(
+                             _mm512_setr_epi32(0, 4, 8, 12, 0, 0, 0, 0, 0, 0, 0, 0,
+                                               0, 0, 0, 0),
+                             value)));
+    }
+
+    static void storeLanes8(uint8_t* p, V value) {
+        alignas(64) uint8_t lanes[64];
+        _mm512_store_si512(lanes, value);
+        p[0] = lanes[0];
+        p[1] = lanes[16];
+        p[2] = lanes[32];
+        p[3] = lanes[48];
+    }
+};
+
+} // namespace
+
+const ResampleKernels& resampleKernelsAvx512() {
+    return ResampleSimd<Avx512>::kernels();
+}
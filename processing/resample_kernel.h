@@ -0,0 +1,242 @@
+#ifndef RESAMPLE_KERNEL_H
+#define RESAMPLE_KERNEL_H
+
+// Internal to the resampler. The SIMD translation units include this header
+// and instantiate `ResampleSimd` with their instruction set wrapper; the
+// scalar functions here are the reference every kernel matches.
+//
+// Every output value is `(sum of weight * sample + half) >> 14` clamped to
+// 0..255, summed in 32 bits, so the result does not depend on the kernel.
+
+#include "resampler.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+constexpr int     RESAMPLE_WEIGHT_BITS = 14; // Weights in Q14
+constexpr int32_t RESAMPLE_ROUND       = 1 << (RESAMPLE_WEIGHT_BITS - 1);
+
+/**
+ * @brief Filter weights of one axis.
+ *
+ * Output pixel `i` reads `taps` consecutive source pixels from `start[i]`
+ * with weights `weights[i * taps ...]`, which sum to `1 << 14`. Windows are
+ * moved inside the source rather than clipped, with zero weights where the
+ * filter does not reach, so every pixel has the same tap count. `taps` is
+ * rounded up to a multiple of the alignment it was built for when the source
+ * is wide enough, which lets the horizontal kernels load whole groups.
+ */
+struct ResampleWeights {
+    uint32_t              source{};
+    uint32_t              alignment{}; // Tap multiple it was built for
+    uint32_t              taps{};
+    std::vector<uint32_t> start{};
+    std::vector<int16_t>  weights{};
+};
+
+/**
+ * @brief Kernels of one instruction set.
+ */
+struct ResampleKernels {
+    // Filters one row of `channels` (1 or 4) bytes per pixel into
+    // `dst_width` pixels
+    void (*horizontal)(const uint8_t* src, uint8_t* dst, uint32_t channels,
+                       const ResampleWeights& axis, uint32_t dst_width);
+
+    // Weighted sum of `taps` rows into `bytes` bytes of `dst`
+    void (*vertical)(const uint8_t* const* rows, const int16_t* weights,
+                     uint32_t taps, uint8_t* dst, std::size_t bytes);
+};
+
+static inline uint8_t resampleClamp(int32_t sum) {
+    return static_cast<uint8_t>(
+        std::clamp<int32_t>((sum + RESAMPLE_ROUND) >> RESAMPLE_WEIGHT_BITS, 0, 255));
+}
+
+static inline void resampleHorizontalScalar(const uint8_t* src, uint8_t* dst,
+                                            uint32_t channels,
+                                            const ResampleWeights& axis,
+                                            uint32_t x_begin, uint32_t dst_width) {
+    for (uint32_t x = x_begin; x < dst_width; ++x) {
+        const uint8_t* in = src + static_cast<std::size_t>(axis.start[x]) * channels;
+        const int16_t* w  = axis.weights.data() + static_cast<std::size_t>(x) * axis.taps;
+        for (uint32_t c = 0; c < channels; ++c) {
+            int32_t sum = 0;
+            for (uint32_t k = 0; k < axis.taps; ++k) {
+                sum += w[k] * in[k * channels + c];
+            }
+            dst[x * channels + c] = resampleClamp(sum);
+        }
+    }
+}
+
+static inline void resampleHorizontalScalar(const uint8_t* src, uint8_t* dst,
+                                            uint32_t channels,
+                                            const ResampleWeights& axis,
+                                            uint32_t dst_width) {
+    resampleHorizontalScalar(src, dst, channels, axis, 0, dst_width);
+}
+
+static inline void resampleVerticalScalar(const uint8_t* const* rows,
+                                          const int16_t* weights, uint32_t taps,
+                                          uint8_t* dst, std::size_t begin,
+                                          std::size_t bytes) {
+    for (std::size_t x = begin; x < bytes; ++x) {
+        int32_t sum = 0;
+        for (uint32_t k = 0; k < taps; ++k) {
+            sum += weights[k] * rows[k][x];
+        }
+        dst[x] = resampleClamp(sum);
+    }
+}
+
+static inline void resampleVerticalScalar(const uint8_t* const* rows,
+                                          const int16_t* weights, uint32_t taps,
+                                          uint8_t* dst, std::size_t bytes) {
+    resampleVerticalScalar(rows, weights, taps, dst, 0, bytes);
+}
+
+/**
+ * @brief Kernels shared by SSE2, AVX2 and AVX-512.
+ *
+ * Both passes multiply pairs of 16-bit samples by pairs of weights with
+ * `madd`. The vertical pass interleaves two rows and runs a register of
+ * output bytes at a time. The horizontal pass computes one output pixel per
+ * 128-bit lane (`Isa::LANES` pixels per register): RGBA takes two source
+ * pixels per step and pairs their channels, gray takes eight source pixels
+ * per step and sums the lane at the end. Pixels left over at the end of a
+ * row, and rows whose tap count is not a whole number of steps, go through
+ * the scalar path.
+ */
+template <typename Isa> struct ResampleSimd {
+    using V                         = typename Isa::V;
+    static constexpr uint32_t LANES = Isa::LANES;
+
+    static V descale(V sum) {
+        return Isa::srai_epi32(Isa::add_epi32(sum, Isa::set1_epi32(RESAMPLE_ROUND)),
+                               RESAMPLE_WEIGHT_BITS);
+    }
+
+    static int32_t weightPair(const int16_t* w) {
+        int32_t pair;
+        std::memcpy(&pair, w, sizeof(pair));
+        return pair;
+    }
+
+    static void horizontalRgba(const uint8_t* src, uint8_t* dst,
+                               const ResampleWeights& axis, uint32_t dst_width) {
+        const uint32_t taps = axis.taps;
+        uint32_t       x    = 0;
+        for (; x + LANES <= dst_width; x += LANES) {
+            const uint8_t* in[LANES];
+            const int16_t* w[LANES];
+            for (uint32_t l = 0; l < LANES; ++l) {
+                in[l] = src + static_cast<std::size_t>(axis.start[x + l]) * 4;
+                w[l]  = axis.weights.data() + static_cast<std::size_t>(x + l) * taps;
+            }
+            V sum = Isa::zero();
+            for (uint32_t k = 0; k < taps; k += 2) {
+                const uint8_t* pixels[LANES];
+                int32_t        pairs[LANES];
+                for (uint32_t l = 0; l < LANES; ++l) {
+                    pixels[l] = in[l] + k * 4;
+                    pairs[l]  = weightPair(w[l] + k);
+                }
+                // r0 g0 b0 a0 r1 g1 b1 a1 -> r0 r1 g0 g1 b0 b1 a0 a1
+                V p = Isa::loadLanes64(pixels);
+                p   = Isa::unpacklo_epi16(p, Isa::srli_bytes8(p));
+                sum = Isa::add_epi32(sum, Isa::madd(p, Isa::broadcastLanes32(pairs)));
+            }
+            V packed = Isa::packs_epi32(descale(sum), Isa::zero());
+            Isa::storeLanes32(dst + static_cast<std::size_t>(x) * 4,
+                              Isa::packus_epi16(packed, Isa::zero()));
+        }
+        resampleHorizontalScalar(src, dst, 4, axis, x, dst_width);
+    }
+
+    static void horizontalGray(const uint8_t* src, uint8_t* dst,
+                               const ResampleWeights& axis, uint32_t dst_width) {
+        const uint32_t taps = axis.taps;
+        uint32_t       x    = 0;
+        for (; x + LANES <= dst_width; x += LANES) {
+            V sum = Isa::zero();
+            for (uint32_t k = 0; k < taps; k += 8) {
+                const uint8_t* pixels[LANES];
+                const int16_t* w[LANES];
+                for (uint32_t l = 0; l < LANES; ++l) {
+                    pixels[l] = src + axis.start[x + l] + k;
+                    w[l] = axis.weights.data() + static_cast<std::size_t>(x + l) * taps + k;
+                }
+                sum = Isa::add_epi32(sum, Isa::madd(Isa::loadLanes64(pixels),
+                                                    Isa::loadLanes128(w)));
+            }
+            sum      = Isa::add_epi32(sum, Isa::srli_bytes8(sum));
+            sum      = Isa::add_epi32(sum, Isa::srli_bytes4(sum));
+            V packed = Isa::packs_epi32(descale(sum), Isa::zero());
+            Isa::storeLanes8(dst + x, Isa::packus_epi16(packed, Isa::zero()));
+        }
+        resampleHorizontalScalar(src, dst, 1, axis, x, dst_width);
+    }
+
+    static void horizontal(const uint8_t* src, uint8_t* dst, uint32_t channels,
+                           const ResampleWeights& axis, uint32_t dst_width) {
+        if (channels == 4 && axis.taps % 2 == 0) {
+            horizontalRgba(src, dst, axis, dst_width);
+        } else if (channels == 1 && axis.taps % 8 == 0) {
+            horizontalGray(src, dst, axis, dst_width);
+        } else {
+            resampleHorizontalScalar(src, dst, channels, axis, dst_width);
+        }
+    }
+
+    static void vertical(const uint8_t* const* rows, const int16_t* weights,
+                         uint32_t taps, uint8_t* dst, std::size_t bytes) {
+        constexpr std::size_t WIDTH = sizeof(V);
+        const V               zero  = Isa::zero();
+
+        std::size_t x = 0;
+        for (; x + WIDTH <= bytes; x += WIDTH) {
+            V sums[4] = {zero, zero, zero, zero};
+            for (uint32_t k = 0; k < taps; k += 2) {
+                // An odd last tap is paired with a zero row and weight
+                const bool pair  = k + 1 < taps;
+                const V    first = Isa::loadBytes(rows[k] + x);
+                const V    second = pair ? Isa::loadBytes(rows[k + 1] + x) : zero;
+                const V    w = Isa::set1_epi32(static_cast<int32_t>(
+                    static_cast<uint16_t>(weights[k]) |
+                    (pair ? static_cast<uint32_t>(static_cast<uint16_t>(weights[k + 1]))
+                                << 16
+                          : 0u)));
+
+                const V low0  = Isa::unpacklo_epi8(first, zero);
+                const V low1  = Isa::unpacklo_epi8(second, zero);
+                const V high0 = Isa::unpackhi_epi8(first, zero);
+                const V high1 = Isa::unpackhi_epi8(second, zero);
+                sums[0] = Isa::add_epi32(sums[0], Isa::madd(Isa::unpacklo_epi16(low0, low1), w));
+                sums[1] = Isa::add_epi32(sums[1], Isa::madd(Isa::unpackhi_epi16(low0, low1), w));
+                sums[2] = Isa::add_epi32(sums[2], Isa::madd(Isa::unpacklo_epi16(high0, high1), w));
+                sums[3] = Isa::add_epi32(sums[3], Isa::madd(Isa::unpackhi_epi16(high0, high1), w));
+            }
+            const V low  = Isa::packs_epi32(descale(sums[0]), descale(sums[1]));
+            const V high = Isa::packs_epi32(descale(sums[2]), descale(sums[3]));
+            Isa::storeBytes(dst + x, Isa::packus_epi16(low, high));
+        }
+        resampleVerticalScalar(rows, weights, taps, dst, x, bytes);
+    }
+
+    static const ResampleKernels& kernels() {
+        static const ResampleKernels table{horizontal, vertical};
+        return table;
+    }
+};
+
+/**
+ * @brief Kernels of `kernel`, null if it was not compiled in.
+ */
+const ResampleKernels* resampleKernels(SimdKernel kernel);
+
+const ResampleKernels& resampleKernelsSse2();
+const ResampleKernels& resampleKernelsAvx2();
+const ResampleKernels& resampleKernelsAvx512();
+
+#endif // RESAMPLE_KERNEL_H
@@ -0,0 +1,61 @@
+#include "resample_kernel.h"
+
+#include <emmintrin.h>
+
+namespace {
+
+struct Sse2 {
+    using V                         = __m128i;
+    static constexpr uint32_t LANES = 1;
+
+    static V zero() { return _mm_setzero_si128(); }
+    static V set1_epi32(int32_t value) { return _mm_set1_epi32(value); }
+
+    static V add_epi32(V a, V b) { return _mm_add_epi32(a, b); }
+    static V srai_epi32(V a, int shift) { return _mm_srai_epi32(a, shift); }
+    static V madd(V a, V b) { return _mm_madd_epi16(a, b); }
+    static V packs_epi32(V a, V b) { return _mm_packs_epi32(a, b); }
+    static V packus_epi16(V a, V b) { return _mm_packus_epi16(a, b); }
+    static V unpacklo_epi8(V a, V b) { return _mm_unpacklo_epi8(a, b); }
+    static V unpackhi_epi8(V a, V b) { return _mm_unpackhi_epi8(a, b); }
+    static V unpacklo_epi16(V a, V b) { return _mm_unpacklo_epi16(a, b); }
+    static V unpackhi_epi16(V a, V b) { return _mm_unpackhi_epi16(a, b); }
+    static V srli_bytes8(V a) { return _mm_srli_si128(a, 8); }
+    static V srli_bytes4(V a) { return _mm_srli_si128(a, 4); }
+
+    static V loadBytes(const uint8_t* p) {
+        return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+    }
+
+    static void storeBytes(uint8_t* p, V value) {
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(p), value);
+    }
+
+    // 8 bytes per lane, widened to 16 bits
+    static V loadLanes64(const uint8_t* const* p) {
+        return _mm_unpacklo_epi8(
+            _mm_loadl_epi64(reinterpret_cast<const __m128i*>(p[0])), zero());
+    }
+
+    static V loadLanes128(const int16_t* const* p) {
+        return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p[0]));
+    }
+
+    static V broadcastLanes32(const int32_t* values) {
+        return _mm_set1_epi32(values[0]);
+    }
+
+    // Low 4 bytes of each lane to consecutive pixels
+    static void storeLanes32(uint8_t* p, V value) {
+        const int32_t low = _mm_cvtsi128_si32(value);
+        std::memcpy(p, &low, sizeof(low));
+    }
+
+    static void storeLanes8(uint8_t* p, V value) {
+        p[0] = static_cast<uint8_t>(_mm_cvtsi128_si32(value));
+    }
+};
+
+} // namespace
+
+const ResampleKernels& resampleKernelsSse2() { return ResampleSimd<Sse2>::kernels(); }
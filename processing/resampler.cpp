@@ -0,0 +1,347 @@
+#include "resampler.h"
+
+#include "hardware/webcam/frame_trace.h"
+#include "resample_kernel.h"
+#include <cmath>
+#include <map>
+#include <mutex>
+#include <tuple>
+
+namespace {
+
+const ResampleKernels SCALAR_KERNELS{resampleHorizontalScalar,
+                                     resampleVerticalScalar};
+
+// Weight tables kept process-wide; the cache is emptied when it reaches this
+constexpr std::size_t MAX_CACHED_WEIGHTS = 64;
+
+// Strips shorter than this cost more in refiltered source rows than they
+// gain in parallelism
+constexpr uint32_t MIN_STRIP_ROWS = 16;
+
+double filterSupport(ResampleFilter filter) {
+    switch (filter) {
+    case ResampleFilter::Box:
+        return 0.5;
+    case ResampleFilter::Bilinear:
+        return 1.0;
+    default:
+        return 3.0;
+    }
+}
+
+double sinc(double x) {
+    if (x == 0.0) {
+        return 1.0;
+    }
+    x *= 3.14159265358979323846;
+    return std::sin(x) / x;
+}
+
+double filterValue(ResampleFilter filter, double x) {
+    switch (filter) {
+    case ResampleFilter::Box:
+        return x > -0.5 && x <= 0.5 ? 1.0 : 0.0;
+    case ResampleFilter::Bilinear:
+        x = std::fabs(x);
+        return x < 1.0 ? 1.0 - x : 0.0;
+    default:
+        return std::fabs(x) < 3.0 ? sinc(x) * sinc(x / 3.0) : 0.0;
+    }
+}
+
+/**
+ * @brief Weights mapping `source` pixels to `size`, in windows of the same
+ * tap count.
+ *
+ * When downscaling, the filter is stretched by the scale factor so every
+ * source pixel contributes (area averaging for `Box`).
+ */
+std::shared_ptr<ResampleWeights> buildWeights(uint32_t source, uint32_t size,
+                                              ResampleFilter filter,
+                                              uint32_t alignment) {
+    const double scale   = static_cast<double>(source) / size;
+    const double stretch = std::max(scale, 1.0);
+    const double support = filterSupport(filter) * stretch;
+
+    // Widest window any output pixel can need, aligned if the source allows
+    const uint32_t window  = static_cast<uint32_t>(std::ceil(support)) * 2 + 1;
+    const uint32_t aligned = (window + alignment - 1) / alignment * alignment;
+    auto           axis    = std::make_shared<ResampleWeights>();
+    axis->source           = source;
+    axis->alignment        = alignment;
+    axis->taps             = std::min(aligned <= source ? aligned : window, source);
+    axis->start.resize(size);
+    axis->weights.assign(static_cast<std::size_t>(size) * axis->taps, 0);
+
+    std::vector<double> weights(axis->taps);
+    for (uint32_t i = 0; i < size; ++i) {
+        const double center = (i + 0.5) * scale;
+        const auto   first  = static_cast<uint32_t>(
+            std::max(0.0, std::floor(center - support + 0.5)));
+        const auto last = static_cast<uint32_t>(
+            std::min<double>(source, std::floor(center + support + 0.5)));
+        const uint32_t start = std::min(first, source - axis->taps);
+        axis->start[i]       = start;
+
+        double total = 0;
+        std::fill(weights.begin(), weights.end(), 0.0);
+        for (uint32_t x = first; x < last && x - start < axis->taps; ++x) {
+            weights[x - start] = filterValue(filter, (x - center + 0.5) / stretch);
+            total += weights[x - start];
+        }
+        if (total == 0) {
+            // Nothing in reach, e.g. a box narrower than the pixel pitch
+            weights[std::min<uint32_t>(static_cast<uint32_t>(center), source - 1) -
+                    start] = 1.0;
+            total          = 1.0;
+        }
+
+        // Round to Q14 and give the rounding error to the largest weight, so
+        // flat areas stay exactly flat
+        int16_t*    fixed   = axis->weights.data() + static_cast<std::size_t>(i) * axis->taps;
+        int32_t     sum     = 0;
+        std::size_t largest = 0;
+        for (std::size_t k = 0; k < weights.size(); ++k) {
+            fixed[k] = static_cast<int16_t>(
+                std::lround(weights[k] / total * (1 << RESAMPLE_WEIGHT_BITS)));
+            sum += fixed[k];
+            largest = fixed[k] > fixed[largest] ? k : largest;
+        }
+        fixed[largest] = static_cast<int16_t>(fixed[largest] +
+                                              (1 << RESAMPLE_WEIGHT_BITS) - sum);
+    }
+    return axis;
+}
+
+/**
+ * @brief Weights from the process-wide cache, built on a miss.
+ */
+std::shared_ptr<const ResampleWeights> cachedWeights(uint32_t source, uint32_t size,
+                                                     ResampleFilter filter,
+                                                     uint32_t alignment, bool& built) {
+    using Key = std::tuple<uint32_t, uint32_t, ResampleFilter, uint32_t>;
+    static std::mutex                                             mutex;
+    static std::map<Key, std::shared_ptr<const ResampleWeights>> cache;
+
+    const Key                   key{source, size, filter, alignment};
+    std::lock_guard<std::mutex> lock(mutex);
+    auto                        found = cache.find(key);
+    built                             = found == cache.end();
+    if (!built) {
+        return found->second;
+    }
+    if (cache.size() >= MAX_CACHED_WEIGHTS) {
+        cache.clear();
+    }
+    return cache[key] = buildWeights(source, size, filter, alignment);
+}
+
+} // namespace
+
+const ResampleKernels* resampleKernels(SimdKernel kernel) {
+    switch (kernel) {
+    case SimdKernel::Scalar:
+        return &SCALAR_KERNELS;
+#ifdef RESAMPLE_SSE2
+    case SimdKernel::Sse2:
+        return &resampleKernelsSse2();
+#endif
+#ifdef RESAMPLE_AVX2
+    case SimdKernel::Avx2:
+        return &resampleKernelsAvx2();
+#endif
+#ifdef RESAMPLE_AVX512
+    case SimdKernel::Avx512:
+        return &resampleKernelsAvx512();
+#endif
+    default:
+        return nullptr;
+    }
+}
+
+bool isResampleKernelAvailable(SimdKernel kernel) {
+    return resampleKernels(kernel) && cpuSupports(kernel);
+}
+
+SimdKernel bestResampleKernel() {
+    static const SimdKernel best = [] {
+        for (SimdKernel kernel :
+             {SimdKernel::Avx512, SimdKernel::Avx2, SimdKernel::Sse2}) {
+            if (isResampleKernelAvailable(kernel)) {
+                return kernel;
+            }
+        }
+        return SimdKernel::Scalar;
+    }();
+    return best;
+}
+
+Resampler::Resampler(const ResampleOptions&      options,
+                     std::shared_ptr<ThreadPool> workers)
+    : options_(options), workers_(std::move(workers)),
+      pool_(FramePool::create(0, 0, 4)) {
+    if (!this->workers_) {
+        this->workers_ = std::make_shared<ThreadPool>(options.threads);
+    }
+}
+
+void Resampler::prepare(uint32_t src_width, uint32_t src_height,
+                        uint32_t dst_width, uint32_t dst_height,
+                        uint32_t channels) {
+    if (src_width == this->src_width_ && src_height == this->src_height_ &&
+        dst_width == this->dst_width_ && dst_height == this->dst_height_ &&
+        channels == this->channels_) {
+        return;
+    }
+    this->src_width_  = src_width;
+    this->src_height_ = src_height;
+    this->dst_width_  = dst_width;
+    this->dst_height_ = dst_height;
+    this->channels_   = channels;
+
+    auto fetch = [this](uint32_t source, uint32_t size, uint32_t alignment) {
+        if (source == size) {
+            // Every filter is the identity at scale 1
+            return std::shared_ptr<const ResampleWeights>();
+        }
+        bool built = false;
+        auto axis  = cachedWeights(source, size, this->options_.filter, alignment, built);
+        ++this->stats_.weight_lookups;
+        this->stats_.weight_builds += built;
+        return axis;
+    };
+    // The horizontal kernels step over 2 RGBA or 8 gray pixels per load
+    this->horizontal_ = fetch(src_width, dst_width, channels == 4 ? 2 : 8);
+    this->vertical_   = fetch(src_height, dst_height, 1);
+}
+
+int16_t Resampler::resample(const uint8_t* src, std::size_t src_stride,
+                            uint32_t src_width, uint32_t src_height,
+                            uint32_t channels, uint8_t* dst,
+                            std::size_t dst_stride, uint32_t dst_width,
+                            uint32_t dst_height) {
+    const std::size_t src_bytes = static_cast<std::size_t>(src_width) * channels;
+    const std::size_t dst_bytes = static_cast<std::size_t>(dst_width) * channels;
+    if (!src || !dst || (channels != 1 && channels != 4) || src_width == 0 ||
+        src_height == 0 || dst_width == 0 || dst_height == 0 ||
+        src_stride < src_bytes || dst_stride < dst_bytes) {
+        return -400;
+    }
+
+    SimdKernel kernel = this->options_.kernel == SimdKernel::Auto
+                            ? bestResampleKernel()
+                            : this->options_.kernel;
+    if (!isResampleKernelAvailable(kernel)) {
+        return -404;
+    }
+    const ResampleKernels& kernels = *resampleKernels(kernel);
+
+    this->prepare(src_width, src_height, dst_width, dst_height, channels);
+    const ResampleWeights* horizontal = this->horizontal_.get();
+    const ResampleWeights* vertical   = this->vertical_.get();
+
+    uint32_t strip_rows = this->options_.strip_rows;
+    if (strip_rows == 0) {
+        const auto workers = static_cast<uint32_t>(this->workers_->size());
+        strip_rows = std::max((dst_height + workers - 1) / workers, MIN_STRIP_ROWS);
+    }
+    const uint32_t strips = (dst_height + strip_rows - 1) / strip_rows;
+    if (this->strips_.size() < strips) {
+        this->strips_.resize(strips);
+    }
+
+    auto run = [&](std::size_t index) {
+        Strip&         strip = this->strips_[index];
+        const uint32_t begin = static_cast<uint32_t>(index) * strip_rows;
+        const uint32_t end   = std::min(dst_height, begin + strip_rows);
+
+        if (!vertical) {
+            for (uint32_t y = begin; y < end; ++y) {
+                const uint8_t* in  = src + y * src_stride;
+                uint8_t*       out = dst + y * dst_stride;
+                if (horizontal) {
+                    kernels.horizontal(in, out, channels, *horizontal, dst_width);
+                } else {
+                    std::memcpy(out, in, dst_bytes);
+                }
+            }
+            return;
+        }
+
+        // Source rows this strip reads, filtered horizontally once each
+        const uint32_t first  = vertical->start[begin];
+        const uint32_t last   = vertical->start[end - 1] + vertical->taps;
+        const uint8_t* rows   = src + first * src_stride;
+        std::size_t    stride = src_stride;
+        if (horizontal) {
+            strip.intermediate.resize((last - first) * dst_bytes);
+            for (uint32_t row = first; row < last; ++row) {
+                kernels.horizontal(src + row * src_stride,
+                                   strip.intermediate.data() + (row - first) * dst_bytes,
+                                   channels, *horizontal, dst_width);
+            }
+            rows   = strip.intermediate.data();
+            stride = dst_bytes;
+        }
+
+        strip.rows.resize(vertical->taps);
+        for (uint32_t y = begin; y < end; ++y) {
+            for (uint32_t k = 0; k < vertical->taps; ++k) {
+                strip.rows[k] = rows + (vertical->start[y] - first + k) * stride;
+            }
+            kernels.vertical(strip.rows.data(),
+                             vertical->weights.data() +
+                                 static_cast<std::size_t>(y) * vertical->taps,
+                             vertical->taps, dst + y * dst_stride, dst_bytes);
+        }
+    };
+    if (strips == 1) {
+        run(0);
+    } else {
+        this->workers_->parallelFor(strips, 1, [&](std::size_t begin, std::size_t end) {
+            for (std::size_t index = begin; index < end; ++index) {
+                run(index);
+            }
+        });
+    }
+
+    ++this->stats_.images;
+    return 0;
+}
+
+int16_t Resampler::resample(const Frame& frame, FrameProduct product,
+                            uint32_t width, uint32_t height, Frame& result) {
+    TraceScope trace(frame, TraceStage::Process, "resample");
+    if (width == 0 || height == 0) {
+        return -400;
+    }
+    Frame   image;
+    int16_t status = frameProduct(frame, product, image);
+    if (status != 0) {
+        return status;
+    }
+
+    const uint32_t channels = product == FrameProduct::Rgba ? 4 : 1;
+    const MediaFormat& format = image.format;
+    Frame              scaled;
+    scaled.buffer    = this->pool_->acquire(static_cast<std::size_t>(width) * height * channels);
+    scaled.format    = {channels == 4 ? FOURCC_RGBA : FOURCC_Y800, width, height,
+                        format.fps_numerator, format.fps_denominator};
+    scaled.timestamp = frame.timestamp;
+    scaled.sequence  = frame.sequence;
+    scaled.arrival   = frame.arrival;
+    scaled.capture   = frame.capture;
+    scaled.trace_id  = frame.trace_id;
+    scaled.roi       = frame.roi;
+
+    status = this->resample(image.buffer.data(),
+                            static_cast<std::size_t>(format.width) * channels,
+                            format.width, format.height, channels,
+                            scaled.buffer.data(), static_cast<std::size_t>(width) * channels,
+                            width, height);
+    if (status == 0) {
+        result = std::move(scaled);
+    }
+    return status;
+}
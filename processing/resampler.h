@@ -0,0 +1,123 @@
+#ifndef RESAMPLER_H
+#define RESAMPLER_H
+
+#include "cpu_features.h"
+#include "frame_cache.h"
+#include "hardware/webcam/frame_pool.h"
+#include "thread_pool.h"
+#include <memory>
+#include <vector>
+
+enum class ResampleFilter {
+    Box,      // Area average; nearest neighbour when upscaling
+    Bilinear, // Triangle, widened by the scale factor when downscaling
+    Lanczos3  // Windowed sinc with three lobes, sharpest and most taps
+};
+
+struct ResampleOptions {
+    ResampleFilter filter{ResampleFilter::Bilinear};
+    uint32_t       strip_rows{0}; // Output rows per task, 0 to split the
+                                  // image into one strip per worker
+    std::size_t    threads{0};    // Private pool size, 0 for one per
+                                  // hardware thread
+    SimdKernel     kernel{SimdKernel::Auto};
+};
+
+/**
+ * @brief Counters of one resampler.
+ */
+struct ResampleStats {
+    uint64_t images{};         // Images resampled
+    uint64_t weight_lookups{}; // Weight tables fetched on a geometry change
+    uint64_t weight_builds{};  // Lookups that missed the process-wide cache
+};
+
+struct ResampleWeights;
+
+/**
+ * @brief Kernel `SimdKernel::Auto` resolves to for resampling.
+ */
+SimdKernel bestResampleKernel();
+
+/**
+ * @brief Whether `kernel` was compiled in and the CPU supports it.
+ */
+bool isResampleKernelAvailable(SimdKernel kernel);
+
+/**
+ * @brief Scales 8-bit gray and RGBA images, for preview thumbnails and for
+ * running trackers at reduced resolution.
+ *
+ * The filter is applied separably: each source row is filtered horizontally
+ * into an 8-bit intermediate row, and each output row is a weighted sum of
+ * intermediate rows. Weights are Q14 integers with a fixed tap count per
+ * axis, computed once per source size, output size and filter and shared
+ * through a process-wide cache, so all kernels produce identical images and
+ * a resampler whose geometry does not change looks nothing up.
+ *
+ * Output rows are split into strips that run in parallel; each strip filters
+ * the source rows it needs into its own reused buffer. An axis whose size
+ * does not change is not filtered at all. Not thread safe.
+ */
+class Resampler {
+  private:
+    ResampleOptions             options_;
+    std::shared_ptr<ThreadPool> workers_;
+    std::shared_ptr<FramePool>  pool_{};
+
+    // Buffers of one output strip, reused between images
+    struct Strip {
+        std::vector<uint8_t>        intermediate{}; // Horizontally filtered rows
+        std::vector<const uint8_t*> rows{};         // Taps of one output row
+    };
+
+    // Geometry the weights were fetched for
+    uint32_t src_width_{}, src_height_{}, dst_width_{}, dst_height_{}, channels_{};
+
+    std::shared_ptr<const ResampleWeights> horizontal_{}; // Null if the width
+    std::shared_ptr<const ResampleWeights> vertical_{};   // or height is kept
+    std::vector<Strip>                     strips_{};
+
+    ResampleStats stats_{};
+
+    void prepare(uint32_t src_width, uint32_t src_height, uint32_t dst_width,
+                 uint32_t dst_height, uint32_t channels);
+
+  public:
+    /**
+     * @param workers Pool to run strips on, shared with other stages. A
+     * private pool with `options.threads` workers is created if null.
+     */
+    explicit Resampler(const ResampleOptions&      options = {},
+                       std::shared_ptr<ThreadPool> workers = nullptr);
+
+    /**
+     * @brief Resample an image of `channels` interleaved bytes per pixel.
+     * @param channels 1 for gray or one plane of a planar image, 4 for RGBA.
+     * @param src_stride,dst_stride Bytes between rows.
+     * @return 0 on success, -400 for empty or null images, short strides or
+     * another channel count, -404 if the requested kernel is not available.
+     */
+    int16_t resample(const uint8_t* src, std::size_t src_stride,
+                     uint32_t src_width, uint32_t src_height, uint32_t channels,
+                     uint8_t* dst, std::size_t dst_stride, uint32_t dst_width,
+                     uint32_t dst_height);
+
+    /**
+     * @brief `product` of `frame` scaled to `width` x `height`.
+     *
+     * The product comes from the frame's cache, so a frame that is already
+     * gray or RGBA, or whose product another stage computed, is not
+     * converted again. `result` is `FOURCC_RGBA` for `FrameProduct::Rgba` and
+     * `FOURCC_Y800` for the others, from the resampler's own `FramePool`.
+     *
+     * @return As `frameProduct` and `resample`.
+     */
+    int16_t resample(const Frame& frame, FrameProduct product, uint32_t width,
+                     uint32_t height, Frame& result);
+
+    const ResampleOptions& getOptions() const { return this->options_; }
+    ResampleStats          getStats() const { return this->stats_; }
+};
+
+#endif // RESAMPLER_H
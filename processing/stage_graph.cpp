@@ -0,0 +1,296 @@
+#include "stage_graph.h"
+
+#include <algorithm>
+
+namespace {
+
+int64_t microseconds(std::chrono::steady_clock::duration duration) {
+    return std::chrono::duration_cast<std::chrono::microseconds>(duration)
+        .count();
+}
+
+} // namespace
+
+StageScheduler::StageScheduler(const StageSchedulerOptions& options,
+                               std::shared_ptr<ThreadPool>  workers)
+    : options_(options), workers_(std::move(workers)) {
+    if (!this->workers_) {
+        this->workers_ = std::make_shared<ThreadPool>(this->options_.threads);
+    }
+    if (this->options_.max_running == 0) {
+        this->options_.max_running = this->workers_->size();
+    }
+}
+
+StageScheduler::~StageScheduler() {
+    std::unique_lock<std::mutex> lock(this->mutex_);
+    this->idle_.wait(lock, [this] {
+        return this->running_ == 0 && this->ready_.empty();
+    });
+}
+
+bool StageScheduler::compare(const Ready& a, const Ready& b) {
+    // `b` runs before `a`
+    if (a.priority != b.priority) {
+        return a.priority < b.priority;
+    }
+    return a.age > b.age;
+}
+
+uint64_t StageScheduler::nextAge() {
+    std::lock_guard<std::mutex> lock(this->mutex_);
+    return this->next_age_++;
+}
+
+void StageScheduler::submit(int priority, uint64_t age, ThreadPool::Task task) {
+    std::lock_guard<std::mutex> lock(this->mutex_);
+    this->ready_.push_back({priority, age, std::move(task)});
+    std::push_heap(this->ready_.begin(), this->ready_.end(), compare);
+    this->max_ready_ = std::max(this->max_ready_, this->ready_.size());
+    this->dispatch();
+}
+
+void StageScheduler::dispatch() {
+    while (this->running_ < this->options_.max_running && !this->ready_.empty()) {
+        std::pop_heap(this->ready_.begin(), this->ready_.end(), compare);
+        ThreadPool::Task task = std::move(this->ready_.back().task);
+        this->ready_.pop_back();
+        ++this->running_;
+        ++this->tasks_;
+        this->workers_->submit([this, task = std::move(task)] {
+            task();
+            this->finish();
+        });
+    }
+}
+
+void StageScheduler::finish() {
+    std::lock_guard<std::mutex> lock(this->mutex_);
+    --this->running_;
+    this->dispatch();
+    if (this->running_ == 0 && this->ready_.empty()) {
+        // Notified under the lock, the destructor may run as soon as it is
+        // released
+        this->idle_.notify_all();
+    }
+}
+
+StageSchedulerStats StageScheduler::getStats() const {
+    std::lock_guard<std::mutex> lock(this->mutex_);
+    StageSchedulerStats stats;
+    stats.tasks       = this->tasks_;
+    stats.ready       = this->ready_.size();
+    stats.max_ready   = this->max_ready_;
+    stats.running     = this->running_;
+    stats.max_running = this->options_.max_running;
+    return stats;
+}
+
+StageGraph::StageGraph(const StageGraphOptions&        options,
+                       std::shared_ptr<StageScheduler> scheduler)
+    : options_(options), scheduler_(std::move(scheduler)) {
+    if (!this->scheduler_) {
+        this->scheduler_ = std::make_shared<StageScheduler>();
+    }
+    if (this->options_.max_frames == 0) {
+        this->options_.max_frames = 2 * this->scheduler_->getWorkers()->size();
+    }
+
+    // Node 0 holds the pushed frame and is resolved by `push`
+    Node source;
+    source.name   = "source";
+    source.create = [] { return std::static_pointer_cast<void>(std::make_shared<Frame>()); };
+    this->nodes_.push_back(std::move(source));
+}
+
+StageGraph::~StageGraph() {
+    std::unique_lock<std::mutex> lock(this->mutex_);
+    this->changed_.wait(lock, [this] {
+        return this->free_.size() == this->tokens_.size() && !this->sinking_;
+    });
+}
+
+std::size_t StageGraph::addNode(Node node) {
+    std::lock_guard<std::mutex> lock(this->mutex_);
+    if (this->started_ || node.inputs.empty() ||
+        std::any_of(node.inputs.begin(), node.inputs.end(), [this](std::size_t input) {
+            return input >= this->nodes_.size();
+        })) {
+        return SIZE_MAX;
+    }
+    const std::size_t index = this->nodes_.size();
+    for (std::size_t input : node.inputs) {
+        this->nodes_[input].consumers.push_back(index);
+    }
+    node.options.max_in_flight = std::max<std::size_t>(node.options.max_in_flight, 1);
+    node.stats.name            = node.name;
+    this->nodes_.push_back(std::move(node));
+    return index;
+}
+
+void StageGraph::setSink(StageSink sink) {
+    std::lock_guard<std::mutex> lock(this->mutex_);
+    if (!this->started_) {
+        this->sink_ = std::move(sink);
+    }
+}
+
+int16_t StageGraph::push(const Frame& frame, std::chrono::milliseconds wait) {
+    std::unique_lock<std::mutex> lock(this->mutex_);
+    if (this->nodes_.size() < 2) {
+        return -409;
+    }
+    this->started_ = true;
+
+    auto has_slot = [this] {
+        return !this->free_.empty() || this->tokens_.size() < this->options_.max_frames;
+    };
+    if (!has_slot() && !this->changed_.wait_for(lock, wait, has_slot)) {
+        ++this->stats_.rejected;
+        return -429;
+    }
+
+    StageToken* token;
+    if (!this->free_.empty()) {
+        token = this->free_.back();
+        this->free_.pop_back();
+    } else {
+        this->tokens_.push_back(std::make_unique<StageToken>());
+        token = this->tokens_.back().get();
+        for (const Node& node : this->nodes_) {
+            token->values.push_back(node.create());
+        }
+        token->results.resize(this->nodes_.size());
+        token->missing.resize(this->nodes_.size());
+    }
+    token->sequence   = this->next_sequence_++;
+    token->age        = this->scheduler_->nextAge();
+    token->pushed     = std::chrono::steady_clock::now();
+    token->unresolved = this->nodes_.size();
+    for (std::size_t i = 0; i < this->nodes_.size(); ++i) {
+        token->results[i] = 204;
+        token->missing[i] = static_cast<uint32_t>(this->nodes_[i].inputs.size());
+    }
+    *static_cast<Frame*>(token->values[0].get()) = frame;
+    ++this->stats_.pushed;
+
+    this->resolve(0, token, 0);
+    this->sink(lock);
+    return 0;
+}
+
+void StageGraph::ready(std::size_t node, StageToken* token) {
+    this->nodes_[node].pending[token->sequence] = {token, std::chrono::steady_clock::now()};
+    this->dispatch(node);
+}
+
+void StageGraph::dispatch(std::size_t index) {
+    Node& node = this->nodes_[index];
+    while (!node.pending.empty()) {
+        auto first = node.pending.begin();
+        if (node.options.ordered && first->first != node.next_sequence) {
+            break;
+        }
+        StageToken* token    = first->second.token;
+        const bool  runnable = std::all_of(
+            node.inputs.begin(), node.inputs.end(),
+            [token](std::size_t input) { return token->results[input] == 0; });
+        if (runnable && node.running >= node.options.max_in_flight) {
+            break;
+        }
+        const TimePoint since = first->second.since;
+        node.pending.erase(first);
+        if (node.options.ordered) {
+            ++node.next_sequence;
+        }
+        if (!runnable) {
+            ++node.stats.skipped;
+            this->resolve(index, token, 204);
+            continue;
+        }
+
+        ++node.running;
+        node.stats.max_running = std::max(node.stats.max_running, node.running);
+        this->scheduler_->submit(node.options.priority, token->age,
+                                 [this, index, token, since] {
+                                     this->execute(index, token, since);
+                                 });
+    }
+}
+
+void StageGraph::resolve(std::size_t node, StageToken* token, int16_t result) {
+    token->results[node] = result;
+    if (--token->unresolved == 0) {
+        this->completed_[token->sequence] = token;
+    }
+    for (std::size_t consumer : this->nodes_[node].consumers) {
+        if (--token->missing[consumer] == 0) {
+            this->ready(consumer, token);
+        }
+    }
+}
+
+void StageGraph::execute(std::size_t index, StageToken* token, TimePoint since) {
+    // Nodes are fixed once frames flow, only the scheduling state is locked
+    Node&         node   = this->nodes_[index];
+    const auto    start  = std::chrono::steady_clock::now();
+    const int16_t result = node.run(*token);
+    const auto    end    = std::chrono::steady_clock::now();
+
+    std::unique_lock<std::mutex> lock(this->mutex_);
+    --node.running;
+    ++node.stats.runs;
+    if (result < 0) {
+        ++node.stats.failed;
+    }
+    node.stats.time.record(microseconds(end - start));
+    node.stats.wait.record(microseconds(start - since));
+    this->resolve(index, token, result);
+    this->dispatch(index);
+    this->sink(lock);
+}
+
+void StageGraph::sink(std::unique_lock<std::mutex>& lock) {
+    if (this->sinking_) {
+        return; // That thread picks up this frame too
+    }
+    this->sinking_ = true;
+    while (!this->completed_.empty() &&
+           this->completed_.begin()->first == this->next_sink_) {
+        StageToken* token = this->completed_.begin()->second;
+        this->completed_.erase(this->completed_.begin());
+        if (this->sink_) {
+            lock.unlock();
+            this->sink_(StageFrame(*token));
+            lock.lock();
+        }
+        // The camera's buffer goes back now, stage outputs are reused
+        *static_cast<Frame*>(token->values[0].get()) = Frame();
+        ++this->next_sink_;
+        ++this->stats_.completed;
+        this->stats_.latency.record(
+            microseconds(std::chrono::steady_clock::now() - token->pushed));
+        this->free_.push_back(token);
+    }
+    this->sinking_ = false;
+    // Notified under the lock, the destructor may run as soon as it is
+    // released
+    this->changed_.notify_all();
+}
+
+bool StageGraph::drain(std::chrono::milliseconds timeout) {
+    std::unique_lock<std::mutex> lock(this->mutex_);
+    return this->changed_.wait_for(lock, timeout, [this] {
+        return this->free_.size() == this->tokens_.size() && !this->sinking_;
+    });
+}
+
+StageGraphStats StageGraph::getStats() const {
+    std::lock_guard<std::mutex> lock(this->mutex_);
+    StageGraphStats stats = this->stats_;
+    stats.in_flight       = this->tokens_.size() - this->free_.size();
+    for (std::size_t i = 1; i < this->nodes_.size(); ++i) {
+        stats.stages.push_back(this->nodes_[i].stats);
+    }
+    return stats;
+}
@@ -0,0 +1,371 @@
+#ifndef STAGE_GRAPH_H
+#define STAGE_GRAPH_H
+
+#include "hardware/webcam/frame.h"
+#include "latency_histogram.h"
+#include "thread_pool.h"
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+struct StageSchedulerOptions {
+    std::size_t threads{0};     // Private pool size, 0 for one per hardware
+                                // thread
+    std::size_t max_running{0}; // Stage tasks on the pool at once, 0 for one
+                                // per worker
+};
+
+/**
+ * @brief Counters of one scheduler.
+ */
+struct StageSchedulerStats {
+    uint64_t    tasks{};       // Stage tasks run
+    std::size_t ready{};       // Waiting for a worker now
+    std::size_t max_ready{};   // Most ever waiting
+    std::size_t running{};     // On the pool now
+    std::size_t max_running{}; // Limit on `running`
+};
+
+/**
+ * @brief Runs the stages of any number of `StageGraph`s on one shared pool.
+ *
+ * Stages that are ready wait in one queue ordered by priority and then by
+ * the age of their frame, so the oldest frame of the most important stage
+ * runs next whichever camera it came from. At most `max_running` of them are
+ * on the pool at once; the rest wait here instead of piling up in the pool's
+ * deques, so many cameras share the cores without oversubscribing them and
+ * a burst on one camera cannot push back the urgent stages of another.
+ * Stages still fan out with `parallelFor` on the same pool. Thread safe.
+ */
+class StageScheduler {
+  private:
+    struct Ready {
+        int             priority{};
+        uint64_t        age{};
+        ThreadPool::Task task{};
+    };
+
+    StageSchedulerOptions       options_;
+    std::shared_ptr<ThreadPool> workers_;
+
+    mutable std::mutex      mutex_{};
+    std::condition_variable idle_{};
+    std::vector<Ready>      ready_{}; // Heap, see `compare`
+    std::size_t             running_{};
+    uint64_t                next_age_{};
+    uint64_t                tasks_{};
+    std::size_t             max_ready_{};
+
+    static bool compare(const Ready& a, const Ready& b);
+    void        dispatch(); // With `mutex_` held
+    void        finish();
+
+  public:
+    /**
+     * @param workers Pool to run stages on, shared with other stages. A
+     * private pool with `options.threads` workers is created if null.
+     */
+    explicit StageScheduler(const StageSchedulerOptions& options = {},
+                            std::shared_ptr<ThreadPool>  workers = nullptr);
+    StageScheduler(const StageScheduler&) = delete;
+    ~StageScheduler();
+
+    StageScheduler& operator=(const StageScheduler&) = delete;
+
+    /**
+     * @brief Age for a new frame, older frames run first at equal priority.
+     */
+    uint64_t nextAge();
+
+    /**
+     * @brief Run `task` once a worker is free and no task with a higher
+     * priority, or an older one with the same priority, is waiting.
+     */
+    void submit(int priority, uint64_t age, ThreadPool::Task task);
+
+    const std::shared_ptr<ThreadPool>& getWorkers() const { return this->workers_; }
+    const StageSchedulerOptions&       getOptions() const { return this->options_; }
+    StageSchedulerStats                getStats() const;
+};
+
+/**
+ * @brief Output of a stage in a `StageGraph`, typed by the value the stage
+ * produces. Default constructed ports are invalid.
+ */
+template <typename T> struct StagePort {
+    std::size_t node{SIZE_MAX};
+
+    bool valid() const { return this->node != SIZE_MAX; }
+};
+
+struct StageOptions {
+    int         priority{0};      // Higher runs first among ready stages
+    std::size_t max_in_flight{1}; // Frames the stage works on at once
+    bool        ordered{true};    // Start frames in the order they were
+                                  // pushed, for stages that keep state
+};
+
+/**
+ * @brief Values of one frame on its way through a graph, recycled for later
+ * frames so stage outputs keep their buffers.
+ */
+struct StageToken {
+    uint64_t    sequence{};   // Frames pushed before this one
+    uint64_t    age{};        // From `StageScheduler::nextAge`
+    std::size_t unresolved{}; // Stages not yet run or skipped
+
+    std::chrono::steady_clock::time_point pushed{};
+
+    std::vector<std::shared_ptr<void>> values{};  // Output of each node;
+                                                  // node 0 is the frame
+    std::vector<int16_t>               results{}; // Of each node, 0 when
+                                                  // its value is valid
+    std::vector<uint32_t>              missing{}; // Inputs of each node
+                                                  // not yet resolved
+};
+
+/**
+ * @brief A frame that went through every stage, as the sink sees it.
+ */
+class StageFrame {
+  private:
+    const StageToken& token_;
+
+  public:
+    explicit StageFrame(const StageToken& token) : token_(token) {}
+
+    uint64_t     sequence() const { return this->token_.sequence; }
+    const Frame& frame() const {
+        return *static_cast<const Frame*>(this->token_.values[0].get());
+    }
+
+    /**
+     * @brief Result of the stage behind `port`: what it returned, or 204 if
+     * it was skipped because an input had no value.
+     */
+    template <typename T> int16_t result(StagePort<T> port) const {
+        return port.node < this->token_.results.size()
+                   ? this->token_.results[port.node]
+                   : static_cast<int16_t>(-404);
+    }
+
+    /**
+     * @brief Value the stage behind `port` produced for this frame, null if
+     * it did not return 0.
+     */
+    template <typename T> const T* get(StagePort<T> port) const {
+        return this->result(port) == 0
+                   ? static_cast<const T*>(this->token_.values[port.node].get())
+                   : nullptr;
+    }
+};
+
+/**
+ * @brief Called with every frame once all its stages are done, in the order
+ * the frames were pushed and never concurrently. Runs on a pool worker or in
+ * `push`, and must not push to the same graph.
+ */
+using StageSink = std::function<void(const StageFrame&)>;
+
+struct StageGraphOptions {
+    std::size_t max_frames{0}; // Frames in flight at once, 0 for two per
+                               // worker of the scheduler's pool
+};
+
+/**
+ * @brief Counters of one stage, times are in microseconds.
+ */
+struct StageNodeStats {
+    std::string name{};
+    uint64_t    runs{};         // Frames the stage ran on
+    uint64_t    skipped{};      // Frames it did not run on, an input was
+                                // missing
+    uint64_t    failed{};       // Runs that returned an error
+    std::size_t max_running{};  // Most frames it worked on at once
+
+    LatencyHistogram time{}; // Running
+    LatencyHistogram wait{}; // From ready to running
+};
+
+/**
+ * @brief Counters of one graph.
+ */
+struct StageGraphStats {
+    uint64_t    pushed{};    // Frames accepted by `push`
+    uint64_t    completed{}; // Frames handed to the sink
+    uint64_t    rejected{};  // `push` calls refused at `max_frames`
+    std::size_t in_flight{}; // Frames pushed and not yet completed
+
+    std::vector<StageNodeStats> stages{}; // Per stage in the order added
+    LatencyHistogram            latency{}; // From `push` to the sink
+};
+
+/**
+ * @brief Dataflow pipeline of one camera: stages wired into a DAG, run on a
+ * shared `StageScheduler`.
+ *
+ * Each stage is a function from the values of its input ports to a value of
+ * its own type. Inputs must exist when a stage is added, so every graph is
+ * acyclic, and ports are typed, so wiring a stage to the wrong kind of value
+ * does not compile:
+ *
+ *     StageGraph graph({}, scheduler);
+ *     auto gray = graph.addStage<Frame>(
+ *         "decode", {0, 4, false},
+ *         [&](const Frame& in, Frame& out) { return decoder.decodeFrame(in, out); },
+ *         graph.source());
+ *     auto map = graph.addStage<MotionMap>(
+ *         "motion", {},
+ *         [&](const Frame& in, MotionMap& out) { return motion.process(in, out); },
+ *         gray);
+ *
+ * A stage runs on a frame as soon as all its inputs have a value for it, so
+ * frames overlap: frame N+1 decodes while frame N is analyzed. Each stage
+ * works on at most `max_in_flight` frames at once, and `ordered` stages start
+ * them in push order, which keeps stateful stages such as the motion
+ * detector serial. A stage that returns anything but 0 produces no value,
+ * and the stages that depend on it skip the frame.
+ *
+ * Per-frame values live in tokens that are recycled, so a stage writing into
+ * its output reuses the previous frame's buffers. Stages must be added
+ * before the first `push`; `push` and the stats are thread safe.
+ */
+class StageGraph {
+  private:
+    using TimePoint = std::chrono::steady_clock::time_point;
+
+    struct Pending {
+        StageToken* token{};
+        TimePoint   since{}; // When its inputs were resolved
+    };
+
+    struct Node {
+        std::string                            name{};
+        StageOptions                           options{};
+        std::vector<std::size_t>               inputs{};
+        std::vector<std::size_t>               consumers{};
+        std::function<std::shared_ptr<void>()> create{};
+        std::function<int16_t(StageToken&)>    run{};
+
+        std::map<uint64_t, Pending> pending{}; // Ready, by sequence
+        std::size_t                 running{};
+        uint64_t                    next_sequence{}; // Ordered stages
+        StageNodeStats              stats{};
+    };
+
+    StageGraphOptions               options_;
+    std::shared_ptr<StageScheduler> scheduler_;
+    StageSink                       sink_{};
+
+    mutable std::mutex                       mutex_{};
+    std::condition_variable                  changed_{};
+    std::vector<Node>                        nodes_{};
+    std::vector<std::unique_ptr<StageToken>> tokens_{};
+    std::vector<StageToken*>                 free_{};
+    std::map<uint64_t, StageToken*>          completed_{}; // Not yet sunk
+    uint64_t                                 next_sequence_{};
+    uint64_t                                 next_sink_{};
+    bool                                     sinking_{false}; // A thread is
+                                                              // calling the sink
+    bool                                     started_{false};
+
+    StageGraphStats stats_{};
+
+    template <typename Out, typename Body, typename... In, std::size_t... I>
+    static int16_t call(Body& body, StageToken& token,
+                        const std::vector<std::size_t>& inputs,
+                        std::size_t self, std::index_sequence<I...>) {
+        return body(*static_cast<const In*>(token.values[inputs[I]].get())...,
+                    *static_cast<Out*>(token.values[self].get()));
+    }
+
+    std::size_t addNode(Node node);
+    void        ready(std::size_t node, StageToken* token);
+    void        dispatch(std::size_t node);
+    void        resolve(std::size_t node, StageToken* token, int16_t result);
+    void        execute(std::size_t node, StageToken* token, TimePoint since);
+    void        sink(std::unique_lock<std::mutex>& lock);
+
+  public:
+    /**
+     * @param scheduler Scheduler shared with the graphs of other cameras. A
+     * private one with default options is created if null.
+     */
+    explicit StageGraph(const StageGraphOptions&        options   = {},
+                        std::shared_ptr<StageScheduler> scheduler = nullptr);
+    StageGraph(const StageGraph&) = delete;
+    ~StageGraph();
+
+    StageGraph& operator=(const StageGraph&) = delete;
+
+    /**
+     * @brief The pushed frames, input of the first stages.
+     */
+    StagePort<Frame> source() const { return {0}; }
+
+    /**
+     * @brief Add a stage computing an `Out` from the values of `inputs`.
+     *
+     * `body` is called as `int16_t body(const In&... values, Out& out)` and
+     * returns 0 when `out` holds a value. It may run on several frames at
+     * once if `options.max_in_flight` allows it.
+     *
+     * @return Port of the stage's output, invalid if an input is invalid or
+     * the graph already started.
+     */
+    template <typename Out, typename Body, typename... In>
+    StagePort<Out> addStage(const std::string& name, const StageOptions& options,
+                            Body body, StagePort<In>... inputs) {
+        static_assert(sizeof...(In) > 0, "a stage needs at least one input");
+        Node node;
+        node.name    = name;
+        node.options = options;
+        node.inputs  = {inputs.node...};
+        node.create  = [] { return std::static_pointer_cast<void>(std::make_shared<Out>()); };
+        const std::size_t self = this->nodes_.size();
+        node.run = [body = std::move(body), inputs = node.inputs,
+                    self](StageToken& token) mutable -> int16_t {
+            return call<Out, Body, In...>(body, token, inputs, self,
+                                          std::index_sequence_for<In...>{});
+        };
+        return {this->addNode(std::move(node))};
+    }
+
+    /**
+     * @brief Receive completed frames, see `StageSink`. Set before the first
+     * `push`.
+     */
+    void setSink(StageSink sink);
+
+    /**
+     * @brief Start a frame through the graph, waiting up to `wait` for one of
+     * the `max_frames` slots.
+     *
+     * The frame's buffer is shared, not copied.
+     *
+     * @return 0 on success, -409 if the graph has no stages, -429 if
+     * `max_frames` frames are still in flight.
+     */
+    int16_t push(const Frame&              frame,
+                 std::chrono::milliseconds wait = std::chrono::milliseconds(0));
+
+    /**
+     * @brief Wait up to `timeout` until every pushed frame reached the sink.
+     * @return true if none is left in flight.
+     */
+    bool drain(std::chrono::milliseconds timeout);
+
+    std::size_t                            getMaxFrames() const { return this->options_.max_frames; }
+    const std::shared_ptr<StageScheduler>& getScheduler() const { return this->scheduler_; }
+    StageGraphStats                        getStats() const;
+};
+
+#endif // STAGE_GRAPH_H
@@ -0,0 +1,173 @@
+#include "thread_pool.h"
+
+#include <algorithm>
+
+namespace {
+
+thread_local const ThreadPool* current_pool  = nullptr;
+thread_local int               current_index = -1;
+
+} // namespace
+
+ThreadPool::ThreadPool(std::size_t threads) {
+    if (threads == 0) {
+        threads = std::thread::hardware_concurrency();
+    }
+    if (threads == 0) {
+        threads = 1;
+    }
+
+    for (std::size_t i = 0; i < threads; ++i) {
+        this->workers_.push_back(std::make_unique<Worker>());
+    }
+    for (std::size_t i = 0; i < threads; ++i) {
+        this->threads_.emplace_back(&ThreadPool::run, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(this->sleep_mutex_);
+        this->stopping_ = true;
+    }
+    this->wake_.notify_all();
+    for (std::thread& thread : this->threads_) {
+        thread.join();
+    }
+}
+
+void ThreadPool::submit(Task task) {
+    std::size_t index;
+    if (current_pool == this) {
+        index = static_cast<std::size_t>(current_index);
+    } else {
+        index = this->next_.fetch_add(1, std::memory_order_relaxed) %
+                this->workers_.size();
+    }
+
+    // Counted before it becomes visible so `queued_` never drops below the
+    // number of tasks in the deques
+    this->queued_.fetch_add(1);
+    {
+        Worker& worker = *this->workers_[index];
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        worker.tasks.push_back(std::move(task));
+    }
+
+    // Taking the mutex orders the wakeup after a worker that found nothing
+    // has started waiting
+    { std::lock_guard<std::mutex> lock(this->sleep_mutex_); }
+    this->wake_.notify_one();
+}
+
+void ThreadPool::parallelFor(
+    std::size_t count, std::size_t grain,
+    const std::function<void(std::size_t, std::size_t)>& body) {
+    if (count == 0) {
+        return;
+    }
+    grain = grain == 0 ? 1 : grain;
+
+    // Shared with the helpers, which may only get to run after the call
+    // returned. They touch `body` only after claiming a chunk, and every
+    // chunk is finished before the call returns.
+    struct Loop {
+        const std::function<void(std::size_t, std::size_t)>* body;
+        std::size_t              count;
+        std::size_t              grain;
+        std::size_t              chunks;
+        std::atomic<std::size_t> next{0};
+        std::atomic<std::size_t> done{0};
+        std::mutex               mutex;
+        std::condition_variable  finished;
+
+        void work() {
+            std::size_t completed = 0;
+            std::size_t chunk;
+            while ((chunk = this->next.fetch_add(1)) < this->chunks) {
+                const std::size_t begin = chunk * this->grain;
+                (*this->body)(begin, std::min(this->count, begin + this->grain));
+                ++completed;
+            }
+            if (completed &&
+                this->done.fetch_add(completed) + completed == this->chunks) {
+                std::lock_guard<std::mutex> lock(this->mutex);
+                this->finished.notify_all();
+            }
+        }
+    };
+
+    auto loop    = std::make_shared<Loop>();
+    loop->body   = &body;
+    loop->count  = count;
+    loop->grain  = grain;
+    loop->chunks = (count + grain - 1) / grain;
+
+    const std::size_t helpers = std::min(loop->chunks - 1, this->size());
+    for (std::size_t i = 0; i < helpers; ++i) {
+        this->submit([loop] { loop->work(); });
+    }
+    loop->work();
+
+    std::unique_lock<std::mutex> lock(loop->mutex);
+    loop->finished.wait(lock, [&] { return loop->done.load() == loop->chunks; });
+}
+
+int ThreadPool::currentWorker() {
+    return current_index;
+}
+
+bool ThreadPool::popLocal(std::size_t index, Task& task) {
+    Worker& worker = *this->workers_[index];
+    std::lock_guard<std::mutex> lock(worker.mutex);
+    if (worker.tasks.empty()) {
+        return false;
+    }
+    task = std::move(worker.tasks.back());
+    worker.tasks.pop_back();
+    return true;
+}
+
+bool ThreadPool::steal(std::size_t thief, Task& task) {
+    const std::size_t count = this->workers_.size();
+    for (std::size_t offset = 1; offset < count; ++offset) {
+        Worker& victim = *this->workers_[(thief + offset) % count];
+        std::unique_lock<std::mutex> lock(victim.mutex, std::try_to_lock);
+        if (!lock.owns_lock() || victim.tasks.empty()) {
+            continue;
+        }
+        task = std::move(victim.tasks.front());
+        victim.tasks.pop_front();
+        return true;
+    }
+    return false;
+}
+
+void ThreadPool::run(std::size_t index) {
+    current_pool  = this;
+    current_index = static_cast<int>(index);
+
+    Task task;
+    for (;;) {
+        if (this->popLocal(index, task) || this->steal(index, task)) {
+            this->queued_.fetch_sub(1);
+            task();
+            task = nullptr;
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(this->sleep_mutex_);
+        if (this->queued_.load() > 0) {
+            // Queued somewhere, possibly behind a victim lock we skipped
+            lock.unlock();
+            std::this_thread::yield();
+            continue;
+        }
+        if (this->stopping_) {
+            return;
+        }
+        this->wake_.wait(lock, [this] {
+            return this->queued_.load() > 0 || this->stopping_;
+        });
+    }
+}
@@ -0,0 +1,78 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief Fixed set of worker threads with one task deque each.
+ *
+ * Tasks submitted from a worker go to the back of that worker's own deque and
+ * are taken LIFO, so follow-up work stays on a warm cache. Tasks submitted
+ * from other threads are spread round-robin. An idle worker steals from the
+ * front of the other deques before it goes to sleep.
+ *
+ * The destructor runs every task that was already submitted, then joins.
+ */
+class ThreadPool {
+  public:
+    using Task = std::function<void()>;
+
+  private:
+    struct Worker {
+        std::mutex       mutex;
+        std::deque<Task> tasks;
+    };
+
+    std::vector<std::unique_ptr<Worker>> workers_;
+    std::vector<std::thread>             threads_;
+
+    std::mutex              sleep_mutex_;
+    std::condition_variable wake_;
+    std::atomic<std::size_t> queued_{0};
+    std::atomic<std::size_t> next_{0};
+    std::atomic<bool>        stopping_{false};
+
+    bool popLocal(std::size_t index, Task& task);
+    bool steal(std::size_t thief, Task& task);
+    void run(std::size_t index);
+
+  public:
+    /**
+     * @param threads Number of workers, 0 for one per hardware thread.
+     */
+    explicit ThreadPool(std::size_t threads = 0);
+    ThreadPool(const ThreadPool&) = delete;
+    ~ThreadPool();
+
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    void submit(Task task);
+
+    /**
+     * @brief Run `body(begin, end)` over `[0, count)` split into chunks of
+     * `grain` items and return when all of them are done.
+     *
+     * The calling thread works on chunks too, so this may be called from a
+     * worker of the same pool without deadlocking.
+     */
+    void parallelFor(std::size_t count, std::size_t grain,
+                     const std::function<void(std::size_t, std::size_t)>& body);
+
+    std::size_t size() const { return this->workers_.size(); }
+
+    /**
+     * @brief Index of the calling worker in the pool it belongs to, -1 on
+     * threads that are not pool workers.
+     */
+    static int currentWorker();
+};
+
+#endif // THREAD_POOL_H
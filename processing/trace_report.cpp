@@ -0,0 +1,149 @@
+#include "trace_report.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+
+namespace {
+
+// Frames this many ids behind the newest one are assumed never presented
+constexpr uint64_t MAX_OPEN_FRAMES = 4096;
+
+uint64_t microseconds(int64_t ticks) {
+    return ticks > 0 ? static_cast<uint64_t>(ticks) / 10 : 0;
+}
+
+void writeString(std::ostream& out, const std::string& value) {
+    out << '"';
+    for (char c : value) {
+        if (c == '"' || c == '\\') {
+            out << '\\' << c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            char escaped[8];
+            std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+            out << escaped;
+        } else {
+            out << c;
+        }
+    }
+    out << '"';
+}
+
+/**
+ * @brief Microseconds since `origin` with the 100 ns resolution of the clock.
+ */
+void writeTime(std::ostream& out, int64_t ticks, int64_t origin) {
+    char text[32];
+    std::snprintf(text, sizeof(text), "%.1f", (ticks - origin) / 10.0);
+    out << text;
+}
+
+} // namespace
+
+TraceReport::TraceReport(std::size_t max_events) : max_events_(max_events) {}
+
+void TraceReport::add(std::vector<TraceEvent> events) {
+    // Spans of one frame come from several threads' buffers
+    std::sort(events.begin(), events.end(),
+              [](const TraceEvent& a, const TraceEvent& b) { return a.begin < b.begin; });
+
+    for (const TraceEvent& event : events) {
+        this->stages_[traceEventName(event)].record(microseconds(event.end - event.begin));
+
+        auto origin = this->origins_.emplace(event.frame, event.begin).first;
+        origin->second = std::min(origin->second, event.begin);
+        this->newest_frame_ = std::max(this->newest_frame_, event.frame);
+        if (event.stage == TraceStage::Present) {
+            this->end_to_end_.record(microseconds(event.end - origin->second));
+            this->origins_.erase(origin);
+        }
+
+        if (this->events_.size() < this->max_events_) {
+            this->events_.push_back(event);
+        } else {
+            ++this->discarded_;
+        }
+    }
+
+    if (this->origins_.size() > MAX_OPEN_FRAMES) {
+        for (auto it = this->origins_.begin(); it != this->origins_.end();) {
+            it = it->first + MAX_OPEN_FRAMES < this->newest_frame_
+                     ? this->origins_.erase(it)
+                     : std::next(it);
+        }
+    }
+}
+
+std::size_t TraceReport::collect() {
+    std::vector<TraceEvent> events;
+    const std::size_t       count = collectTraceEvents(events);
+    this->add(std::move(events));
+    return count;
+}
+
+void TraceReport::writeChromeTrace(std::ostream& out) const {
+    std::vector<TraceEvent> events = this->events_;
+    std::sort(events.begin(), events.end(), [](const TraceEvent& a, const TraceEvent& b) {
+        return a.frame != b.frame ? a.frame < b.frame : a.begin < b.begin;
+    });
+    int64_t origin = events.empty() ? 0 : events.front().begin;
+    for (const TraceEvent& event : events) {
+        origin = std::min(origin, event.begin);
+    }
+
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    const char* separator = "";
+    for (const TraceThread& thread : getTraceThreads()) {
+        out << separator << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":"
+            << thread.index << ",\"args\":{\"name\":";
+        writeString(out, thread.name);
+        out << "}}";
+        separator = ",\n";
+    }
+
+    for (std::size_t i = 0; i < events.size(); ++i) {
+        const TraceEvent& event = events[i];
+        out << separator << "{\"name\":";
+        writeString(out, traceEventName(event));
+        out << ",\"cat\":\"frame\",\"ph\":\"X\",\"pid\":1,\"tid\":" << event.thread
+            << ",\"ts\":";
+        writeTime(out, event.begin, origin);
+        out << ",\"dur\":";
+        writeTime(out, event.end, event.begin);
+        out << ",\"args\":{\"frame\":" << event.frame << "}}";
+        separator = ",\n";
+
+        // Flow arrow through the frame's spans: start, steps, finish
+        const bool first = i == 0 || events[i - 1].frame != event.frame;
+        const bool last  = i + 1 == events.size() || events[i + 1].frame != event.frame;
+        if (first && last) {
+            continue;
+        }
+        out << separator << "{\"name\":\"frame\",\"cat\":\"frame\",\"ph\":\""
+            << (first ? "s" : last ? "f" : "t") << "\",\"id\":" << event.frame
+            << ",\"pid\":1,\"tid\":" << event.thread << ",\"ts\":";
+        writeTime(out, event.begin, origin);
+        // Binds the finish to the span it points into
+        out << (last ? ",\"bp\":\"e\"}" : "}");
+    }
+    out << "]}\n";
+}
+
+int16_t TraceReport::writeChromeTrace(const std::filesystem::path& path) const {
+    std::ofstream file(path, std::ios::out | std::ios::trunc);
+    if (!file) {
+        return -500;
+    }
+    this->writeChromeTrace(file);
+    file.flush();
+    return file ? 0 : -500;
+}
+
+void TraceReport::reset() {
+    this->stages_.clear();
+    this->end_to_end_.reset();
+    this->origins_.clear();
+    this->newest_frame_ = 0;
+    this->events_.clear();
+    this->discarded_ = 0;
+}
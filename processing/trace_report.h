@@ -0,0 +1,79 @@
+#ifndef TRACE_REPORT_H
+#define TRACE_REPORT_H
+
+#include "hardware/webcam/frame_trace.h"
+#include "latency_histogram.h"
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @brief Latency histograms and Chrome trace export of collected frame
+ * trace spans.
+ *
+ * Histograms are in microseconds, one per span name (`Capture`, `Queue`,
+ * `Decode`, `Convert`, `motion`, ...) plus the end-to-end latency of every
+ * presented frame, from its earliest span to the end of its `Present` span.
+ * Not thread safe.
+ */
+class TraceReport {
+  private:
+    std::map<std::string, LatencyHistogram> stages_{};
+    LatencyHistogram                        end_to_end_{};
+    std::unordered_map<uint64_t, int64_t>   origins_{}; // Earliest begin per frame
+    uint64_t                                newest_frame_{};
+    std::vector<TraceEvent>                 events_{};
+    std::size_t                             max_events_;
+    uint64_t                                discarded_{};
+
+  public:
+    /**
+     * @param max_events Spans kept for `writeChromeTrace`; later ones still
+     * update the histograms.
+     */
+    explicit TraceReport(std::size_t max_events = 1 << 20);
+
+    /**
+     * @brief Add spans, e.g. from `collectTraceEvents`.
+     */
+    void add(std::vector<TraceEvent> events);
+
+    /**
+     * @brief Collect the spans recorded since the last call and add them.
+     * @return Number of spans added.
+     */
+    std::size_t collect();
+
+    const std::map<std::string, LatencyHistogram>& getStages() const {
+        return this->stages_;
+    }
+    const LatencyHistogram& getEndToEnd() const { return this->end_to_end_; }
+
+    std::size_t getEventCount() const { return this->events_.size(); }
+
+    /**
+     * @brief Spans not kept for export because `max_events` was reached.
+     */
+    uint64_t getDiscarded() const { return this->discarded_; }
+
+    /**
+     * @brief Write the kept spans as Chrome trace event JSON, which
+     * chrome://tracing and Perfetto open. Each frame's spans are linked by a
+     * flow arrow.
+     */
+    void writeChromeTrace(std::ostream& out) const;
+
+    /**
+     * @return 0 on success, -500 if the file cannot be written.
+     */
+    int16_t writeChromeTrace(const std::filesystem::path& path) const;
+
+    void reset();
+};
+
+#endif // TRACE_REPORT_H
@@ -0,0 +1,109 @@
+// The capability cache round-trips its entries and rejects files that are
+// truncated or corrupt, even when their checksum matches.
+
+#include "hardware/webcam/capability_cache.h"
+#include "test_check.h"
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+namespace {
+
+uint64_t fnv1a(const uint8_t* data, std::size_t size) {
+    uint64_t hash = 1469598103934665603ull;
+    for (std::size_t i = 0; i < size; ++i) {
+        hash = (hash ^ data[i]) * 1099511628211ull;
+    }
+    return hash;
+}
+
+std::vector<uint8_t> readFile(const std::filesystem::path& path) {
+    std::ifstream file(path, std::ios::binary);
+    return {std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+}
+
+/**
+ * @brief Write `data` with the header checksum fixed up, so only the parser
+ * can reject it.
+ */
+void writeFile(const std::filesystem::path& path, std::vector<uint8_t> data) {
+    CapabilityCacheHeader header{};
+    std::memcpy(&header, data.data(), sizeof(header));
+    header.checksum = fnv1a(data.data() + sizeof(header), data.size() - sizeof(header));
+    std::memcpy(data.data(), &header, sizeof(header));
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<const char*>(data.data()),
+               static_cast<std::streamsize>(data.size()));
+}
+
+CachedDevice device(const wchar_t* id, const wchar_t* name) {
+    CachedDevice entry;
+    entry.identity = {id, L"10.0.1"};
+    entry.name     = name;
+    entry.formats  = {{FOURCC_YUY2, 640, 480, 30, 1}, {FOURCC_MJPG, 1920, 1080, 30, 1}};
+    return entry;
+}
+
+void testRoundTrip(const std::filesystem::path& path) {
+    CapabilityCache cache(path);
+    cache.store(device(L"\\\\?\\usb#vid_046d&pid_0825", L"Front"));
+    cache.store(device(L"\\\\?\\usb#vid_046d&pid_085c", L"Back"));
+    CHECK_EQ(cache.save(), 0);
+    CHECK_EQ(cache.save(), 304);
+
+    CapabilityCache loaded(path);
+    CHECK_EQ(loaded.load(), 0);
+    CHECK_EQ(loaded.size(), 2u);
+    CachedDevice found;
+    CHECK(loaded.find({L"\\\\?\\usb#vid_046d&pid_085c", L"10.0.1"}, found));
+    CHECK(found.name == L"Back");
+    CHECK_EQ(found.formats.size(), 2u);
+    CHECK(!loaded.find({L"\\\\?\\usb#vid_046d&pid_085c", L"10.0.2"}, found));
+}
+
+void testCorrupt(const std::filesystem::path& path) {
+    const std::vector<uint8_t> good = readFile(path);
+    CHECK(good.size() > sizeof(CapabilityCacheHeader) + 16);
+
+    // Cut inside the first length, the first string and the last format,
+    // with every device still announced by the header
+    for (std::size_t keep : {sizeof(CapabilityCacheHeader) + 2,
+                             sizeof(CapabilityCacheHeader) + 9, good.size() - 3}) {
+        writeFile(path, std::vector<uint8_t>(good.begin(), good.begin() + keep));
+        CapabilityCache cache(path);
+        CHECK_EQ(cache.load(), -400);
+        CHECK_EQ(cache.size(), 0u);
+    }
+
+    // A string longer than the rest of the file
+    std::vector<uint8_t> data = good;
+    const uint32_t length = 0x7FFFFFFF;
+    std::memcpy(data.data() + sizeof(CapabilityCacheHeader), &length, sizeof(length));
+    writeFile(path, data);
+    CapabilityCache cache(path);
+    CHECK_EQ(cache.load(), -400);
+
+    // A checksum that does not match
+    data = good;
+    data.back() ^= 1;
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<const char*>(data.data()),
+               static_cast<std::streamsize>(data.size()));
+    file.close();
+    CHECK_EQ(cache.load(), -400);
+
+    // Shorter than a header
+    std::filesystem::resize_file(path, 5);
+    CHECK_EQ(cache.load(), -400);
+    CHECK_EQ(cache.size(), 0u);
+}
+
+} // namespace
+
+int main() {
+    const auto path = std::filesystem::temp_directory_path() / "capability_cache_test.bin";
+    testRoundTrip(path);
+    testCorrupt(path);
+    std::filesystem::remove(path);
+    return testResult("capability_cache_test");
+}
@@ -0,0 +1,179 @@
+// Listing cameras the way the UI does takes no COM references and allocates
+// nothing. A mock COM type counts AddRef and Release, the global operator new
+// counts allocations; `WebcamManager` itself needs Media Foundation, so the
+// cameras wrap a mock source holding the same handles `MfCaptureSource` does.
+
+#include "hardware/webcam/com_handle.h"
+#include "hardware/webcam/device_view.h"
+#include "test_check.h"
+#include <cstdlib>
+#include <new>
+
+namespace {
+
+std::size_t allocations = 0;
+std::size_t ref_ops     = 0;
+
+/**
+ * @brief Reference-counted like a COM object, deleted by its last `Release`.
+ */
+class MockCom {
+  private:
+    unsigned long refs_{1};
+
+  public:
+    unsigned long AddRef() {
+        ++ref_ops;
+        return ++this->refs_;
+    }
+    unsigned long Release() {
+        ++ref_ops;
+        const unsigned long refs = --this->refs_;
+        if (refs == 0) {
+            delete this;
+        }
+        return refs;
+    }
+    unsigned long refs() const { return this->refs_; }
+};
+
+/**
+ * @brief A camera backed by two COM objects, like an activation object and
+ * its attributes.
+ */
+class MockComSource : public CaptureSource {
+  private:
+    ComHandle<MockCom>       device_;
+    ComHandle<MockCom>       attributes_;
+    std::wstring             name_;
+    std::vector<MediaFormat> formats_{{FOURCC_YUY2, 640, 480, 30, 1},
+                                      {FOURCC_MJPG, 1920, 1080, 30, 1}};
+
+  public:
+    MockComSource(std::wstring name, MockCom* device, MockCom* attributes)
+        : device_(ComHandle<MockCom>::share(device)),
+          attributes_(ComHandle<MockCom>::share(attributes)),
+          name_(std::move(name)) {}
+
+    std::wstring                    getName() const override { return this->name_; }
+    const std::vector<MediaFormat>& getMediaFormats() const override {
+        return this->formats_;
+    }
+    bool    isOpen() const override { return false; }
+    int16_t open(std::size_t) override { return -500; }
+    int16_t close() override { return 0; }
+    int16_t readFrame(Frame&) override { return -409; }
+};
+
+void testHandle() {
+    auto*             object = new MockCom();
+    const std::size_t before = ref_ops;
+    {
+        ComHandle<MockCom> owner(object); // Adopts the creation reference
+        ComHandle<MockCom> moved(std::move(owner));
+        ComHandle<MockCom> assigned;
+        assigned = std::move(moved);
+        CHECK(!owner && !moved);
+        CHECK_EQ(ref_ops - before, 0u);
+        CHECK_EQ(object->refs(), 1u);
+
+        ComHandle<MockCom> second = assigned.copy();
+        CHECK_EQ(ref_ops - before, 1u);
+        CHECK_EQ(object->refs(), 2u);
+        second.reset();
+        CHECK_EQ(ref_ops - before, 2u);
+        CHECK_EQ(object->refs(), 1u);
+
+        // detach hands the reference over, put takes one from an out parameter
+        MockCom* raw = assigned.detach();
+        CHECK(!assigned);
+        *assigned.put() = raw;
+        CHECK_EQ(ref_ops - before, 2u);
+        CHECK_EQ(object->refs(), 1u);
+    }
+    CHECK_EQ(ref_ops - before, 3u);
+}
+
+void testListing() {
+    auto* device     = new MockCom();
+    auto* attributes = new MockCom();
+    std::vector<std::shared_ptr<Webcam>> devices;
+    for (const wchar_t* name : {L"Front", L"Rear", L"Document"}) {
+        devices.push_back(std::make_shared<Webcam>(
+            std::make_shared<MockComSource>(name, device, attributes)));
+    }
+    // Moving a camera moves its handles
+    const std::size_t before_move = ref_ops;
+    Webcam            moved(std::move(*devices[2]));
+    *devices[2] = std::move(moved);
+    CHECK_EQ(ref_ops - before_move, 0u);
+
+    std::mutex        mutex;
+    const std::size_t before_refs        = ref_ops;
+    const std::size_t before_allocations = allocations;
+    std::size_t       characters = 0, formats = 0;
+    for (int call = 0; call < 1000; ++call) {
+        DeviceView view(mutex, devices);
+        for (const Webcam& camera : view) {
+            characters += camera.getName().size();
+            formats += camera.getMediaCatalog().size();
+        }
+        std::size_t index = SIZE_MAX;
+        CHECK_EQ(view.find(L"Rear", index), 0);
+        CHECK_EQ(index, 1u);
+        CHECK_EQ(view.find(L"Missing", index), -404);
+        CHECK_EQ(view[2].getName().size(), 8u);
+    }
+    CHECK_EQ(allocations - before_allocations, 0u);
+    CHECK_EQ(ref_ops - before_refs, 0u);
+    CHECK_EQ(characters, 1000u * 17);
+    CHECK_EQ(formats, 1000u * 6);
+    for (const auto& camera : devices) {
+        CHECK_EQ(camera.use_count(), 1);
+    }
+
+    CHECK_EQ(device->refs(), 4u);
+    devices.clear();
+    CHECK_EQ(device->refs(), 1u);
+    CHECK_EQ(attributes->refs(), 1u);
+    device->Release();
+    attributes->Release();
+}
+
+} // namespace
+
+// The scalar and array forms are replaced together, each pair on malloc and
+// free. GCC inlines the replacements into library code and then flags free on
+// memory from operator new, though both are these very functions.
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+void* operator new(std::size_t size) {
+    ++allocations;
+    if (void* memory = std::malloc(size ? size : 1)) {
+        return memory;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size) { return ::operator new(size); }
+
+void operator delete(void* memory) noexcept { std::free(memory); }
+
+void operator delete[](void* memory) noexcept { std::free(memory); }
+
+void operator delete(void* memory, std::size_t) noexcept { std::free(memory); }
+
+void operator delete[](void* memory, std::size_t) noexcept { std::free(memory); }
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+int main() {
+    testHandle();
+    testListing();
+    return testResult("device_view_test");
+}
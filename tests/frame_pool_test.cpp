@@ -0,0 +1,130 @@
+// The capture hot path takes every frame buffer from the session's pool: once
+// warm, neither the ring and its consumer nor a frame tap holding a backlog
+// allocate.
+
+#include "hardware/webcam/capture_session.h"
+#include "hardware/webcam/synthetic_source.h"
+#include "test_check.h"
+#include <memory>
+
+namespace {
+
+constexpr std::size_t RECORDER_QUEUE = 64; // `RecorderOptions::queue_capacity`
+
+std::shared_ptr<CaptureSource> openSource(MediaFormat& format) {
+    format = {FOURCC_YUY2, 320, 240, 30, 1};
+    auto source =
+        std::make_shared<SyntheticSource>(std::vector<MediaFormat>{format},
+                                          SourcePacing::Unthrottled);
+    CHECK_EQ(source->open(0), 0);
+    return source;
+}
+
+/**
+ * @brief Consume `count` frames one at a time, like the UI does.
+ */
+void consume(CaptureSession& session, int count) {
+    Frame frame;
+    for (int i = 0; i < count; ++i) {
+        const int16_t result =
+            session.waitNext(frame, std::chrono::milliseconds(1000));
+        CHECK_EQ(result, 0);
+        if (result != 0) {
+            return;
+        }
+    }
+}
+
+void testPool() {
+    auto pool = FramePool::create(1000, 4, 4);
+
+    std::vector<FrameBufferRef> held;
+    for (int round = 0; round < 3; ++round) {
+        for (int i = 0; i < 4; ++i) {
+            held.push_back(pool->acquire(1000));
+        }
+        held.clear();
+    }
+    FramePoolStats stats = pool->getStats();
+    CHECK_EQ(stats.hits, 12u);
+    CHECK_EQ(stats.misses, 0u);
+    CHECK_EQ(stats.outstanding, 0u);
+    CHECK_EQ(stats.high_water, 4u);
+
+    // One more than pooled allocates once, and is kept after `setMaxFree`
+    pool->setMaxFree(5);
+    for (int round = 0; round < 3; ++round) {
+        for (int i = 0; i < 5; ++i) {
+            held.push_back(pool->acquire(1000));
+            CHECK_EQ(reinterpret_cast<uintptr_t>(held.back().data()) %
+                         FRAME_BUFFER_ALIGNMENT,
+                     0u);
+        }
+        held.clear();
+    }
+    stats = pool->getStats();
+    CHECK_EQ(stats.misses, 1u);
+    CHECK_EQ(stats.high_water, 5u);
+}
+
+void testSteadyState() {
+    MediaFormat format;
+    auto        source = openSource(format);
+
+    CaptureSession session(source, format, CaptureOptions{});
+    session.start();
+    consume(session, 300);
+    session.stop();
+
+    FramePoolStats stats = session.getPoolStats();
+    CHECK(stats.hits >= 300);
+    CHECK_EQ(stats.misses, 0u);
+}
+
+/**
+ * @brief Let the tap's backlog fill up and then write it out at once, the
+ * way a recorder's queue behaves while the disk stalls and catches up.
+ */
+void backlogCycle(CaptureSession& session, FrameRing<Frame>& backlog) {
+    consume(session, 2 * static_cast<int>(RECORDER_QUEUE));
+    Frame frame;
+    while (backlog.tryPop(frame)) {
+        frame = Frame();
+    }
+}
+
+void testTapBacklog() {
+    MediaFormat format;
+    auto        source = openSource(format);
+
+    auto backlog =
+        std::make_shared<FrameRing<Frame>>(RECORDER_QUEUE, RingPolicy::OverwriteOldest);
+
+    CaptureSession session(source, format, CaptureOptions{});
+    session.setTap([backlog](const Frame& frame) { backlog->push(frame); },
+                   RECORDER_QUEUE);
+    session.start();
+
+    // The first backlog allocates the blocks it holds, later ones reuse them
+    backlogCycle(session, *backlog);
+    const uint64_t warm_misses = session.getPoolStats().misses;
+    for (int i = 0; i < 4; ++i) {
+        backlogCycle(session, *backlog);
+    }
+    session.stop();
+
+    FramePoolStats stats = session.getPoolStats();
+    CHECK(warm_misses > 0);
+    CHECK(warm_misses <= RECORDER_QUEUE);
+    CHECK_EQ(stats.misses, warm_misses);
+    CHECK(backlog->dropped() > 0);
+}
+
+} // namespace
+
+int main() {
+    testPool();
+    testSteadyState();
+    testTapBacklog();
+    return testResult("frame_pool_test");
+}
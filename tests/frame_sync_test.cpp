@@ -0,0 +1,172 @@
+// Framesets of scripted cameras: both policies for a camera that skips frames,
+// and a set never pairing frames further apart than the tolerance, also when
+// dropping old frames exposes a newer one.
+
+#include "hardware/webcam/frame_sync.h"
+#include "test_check.h"
+#include <thread>
+
+namespace {
+
+constexpr int64_t MS        = 10000; // 100 ns units
+constexpr int64_t TOLERANCE = 5 * MS;
+
+/**
+ * @brief Delivers one frame per scripted time, each when the host clock
+ * reaches it, then ends its stream.
+ */
+class ScriptedSource : public CaptureSource {
+  private:
+    std::vector<int64_t>     times_;
+    int64_t                  start_;
+    std::size_t              next_{};
+    bool                     open_{};
+    std::vector<MediaFormat> formats_{{FOURCC_Y800, 2, 2, 50, 1}};
+
+  public:
+    /**
+     * @param times Camera timestamps, 100 ns after `start` on the host clock.
+     */
+    ScriptedSource(std::vector<int64_t> times, int64_t start)
+        : times_(std::move(times)), start_(start) {}
+
+    std::wstring getName() const override { return L"Scripted"; }
+    const std::vector<MediaFormat>& getMediaFormats() const override {
+        return this->formats_;
+    }
+    bool isOpen() const override { return this->open_; }
+
+    int16_t open(std::size_t) override {
+        this->open_ = true;
+        return 0;
+    }
+    int16_t close() override {
+        this->open_ = false;
+        return 0;
+    }
+
+    int16_t readFrame(Frame& frame) override {
+        if (this->next_ == this->times_.size()) {
+            return -410;
+        }
+        const int64_t time = this->times_[this->next_++];
+        while (hostTime100ns() < this->start_ + time) {
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+        }
+        frame.buffer    = this->acquireBuffer(4);
+        frame.format    = this->formats_.front();
+        frame.timestamp = time;
+        frame.sequence  = this->next_ - 1;
+        return 0;
+    }
+};
+
+std::vector<std::shared_ptr<Webcam>>
+activate(const std::vector<std::vector<int64_t>>& scripts) {
+    // One start for every camera, so their clocks line up
+    const int64_t start = hostTime100ns() + 20 * MS;
+    std::vector<std::shared_ptr<Webcam>> cameras;
+    for (const auto& script : scripts) {
+        std::vector<int64_t> times;
+        for (int64_t ms : script) {
+            times.push_back(ms * MS);
+        }
+        cameras.push_back(std::make_shared<Webcam>(
+            std::make_shared<ScriptedSource>(std::move(times), start)));
+        cameras.back()->setCaptureOptions({16, RingPolicy::Block});
+        CHECK_EQ(cameras.back()->activate(), 0);
+    }
+    return cameras;
+}
+
+/**
+ * @brief Framesets until the group ends, each checked against the tolerance.
+ */
+std::vector<Frameset> collect(SyncGroup& group) {
+    std::vector<Frameset> sets;
+    Frameset              set;
+    int16_t               result;
+    while ((result = group.waitFrameset(set, std::chrono::milliseconds(1000))) == 0) {
+        for (const SyncedFrame& frame : set.frames) {
+            CHECK(frame.repeated ||
+                  std::abs(frame.aligned - set.timestamp) <= TOLERANCE);
+        }
+        sets.push_back(set);
+    }
+    CHECK_EQ(result, -410);
+    return sets;
+}
+
+int64_t cameraTime(const Frameset& set, std::size_t camera) {
+    return set.frames[camera].frame.timestamp / MS;
+}
+
+// Camera 1 skips the frames at 20 and 40 ms and then stalls
+const std::vector<std::vector<int64_t>> SKIPPING = {{0, 20, 40}, {0, 100}};
+
+void testDrop() {
+    SyncOptions options;
+    options.tolerance = TOLERANCE;
+    options.policy    = SyncPolicy::Drop;
+    SyncGroup group(activate(SKIPPING), options);
+
+    const std::vector<Frameset> sets = collect(group);
+    CHECK_EQ(sets.size(), 1u);
+    if (sets.size() == 1) {
+        CHECK_EQ(cameraTime(sets[0], 0), 0);
+        CHECK_EQ(cameraTime(sets[0], 1), 0);
+    }
+    const SyncStats stats = group.getStats();
+    CHECK_EQ(stats.framesets, 1u);
+    CHECK_EQ(stats.discarded, 2u);
+    CHECK_EQ(stats.members[0].dropped, 2u);
+}
+
+void testDuplicate() {
+    SyncOptions options;
+    options.tolerance = TOLERANCE;
+    options.policy    = SyncPolicy::Duplicate;
+    SyncGroup group(activate(SKIPPING), options);
+
+    const std::vector<Frameset> sets = collect(group);
+    CHECK_EQ(sets.size(), 3u);
+    for (std::size_t i = 0; i < sets.size() && i < 3; ++i) {
+        CHECK_EQ(cameraTime(sets[i], 0), static_cast<int64_t>(i) * 20);
+        CHECK_EQ(cameraTime(sets[i], 1), 0);
+        CHECK_EQ(sets[i].frames[1].repeated, i > 0);
+        CHECK(!sets[i].frames[0].repeated);
+    }
+    const SyncStats stats = group.getStats();
+    CHECK_EQ(stats.discarded, 0u);
+    CHECK_EQ(stats.members[1].repeated, 2u);
+}
+
+void testGap() {
+    // Both are buffered before the first set: dropping camera 0's frame at
+    // 0 ms leaves 20 ms, too far from camera 1's 10 ms
+    SyncOptions options;
+    options.tolerance = TOLERANCE;
+    auto cameras      = activate({{0, 20, 40}, {10, 20, 40}});
+    SyncGroup group(cameras, options);
+    std::this_thread::sleep_for(std::chrono::milliseconds(80));
+
+    const std::vector<Frameset> sets = collect(group);
+    CHECK_EQ(sets.size(), 2u);
+    for (std::size_t i = 0; i < sets.size() && i < 2; ++i) {
+        const int64_t time = 20 + static_cast<int64_t>(i) * 20;
+        CHECK_EQ(cameraTime(sets[i], 0), time);
+        CHECK_EQ(cameraTime(sets[i], 1), time);
+    }
+    const SyncStats stats = group.getStats();
+    CHECK_EQ(stats.members[0].dropped, 1u);
+    CHECK_EQ(stats.members[1].dropped, 1u);
+}
+
+} // namespace
+
+int main() {
+    testDrop();
+    testDuplicate();
+    testGap();
+    return testResult("frame_sync_test");
+}
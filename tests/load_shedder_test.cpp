@@ -0,0 +1,199 @@
+// Load shedding on synthetic latency and queue sequences: escalation and its
+// reasons, settling, recovery, the backoff after a failed recovery and its
+// reset, and the reduced media type of a level.
+
+#include "processing/load_shedder.h"
+#include "test_check.h"
+
+namespace {
+
+constexpr uint32_t LIMIT = 1000; // Frames without a change give up
+
+// Smoothing 1 judges every frame by itself
+LoadShedOptions testOptions() {
+    LoadShedOptions options;
+    options.target_latency_ms = 100;
+    options.max_queue_depth   = 2;
+    options.recover_fraction  = 0.5;
+    options.escalate_after    = 3;
+    options.recover_after     = 4;
+    options.settle_frames     = 2;
+    options.max_backoff       = 4;
+    options.smoothing         = 1.0;
+    return options;
+}
+
+/**
+ * @brief Observe frames with the same signals until the level changes.
+ * @return Frames observed, LIMIT if it did not change.
+ */
+uint32_t untilChange(LoadShedder& shedder, std::size_t queue, double latency_ms,
+                     double stage_ms = 0) {
+    for (uint32_t frame = 1; frame < LIMIT; ++frame) {
+        shedder.recordStage(1, stage_ms);
+        if (shedder.observe(queue, latency_ms)) {
+            return frame;
+        }
+    }
+    return LIMIT;
+}
+
+uint32_t overloaded(LoadShedder& shedder) { return untilChange(shedder, 0, 200); }
+uint32_t healthy(LoadShedder& shedder) { return untilChange(shedder, 0, 10); }
+
+void checkDecision(const LoadDecision& decision, uint32_t from, uint32_t to,
+                   LoadReason reason) {
+    CHECK_EQ(decision.from, from);
+    CHECK_EQ(decision.to, to);
+    CHECK_EQ(static_cast<int>(decision.reason), static_cast<int>(reason));
+}
+
+void testEscalation() {
+    LoadShedder shedder(testOptions());
+    CHECK_EQ(shedder.getLevelCount(), 5u);
+
+    CHECK_EQ(overloaded(shedder), 3u);
+    CHECK_EQ(shedder.getLevel(), 1u);
+    // Level 1 analyzes every other frame
+    CHECK(shedder.shouldAnalyze(0));
+    CHECK(!shedder.shouldAnalyze(1));
+
+    // Settling, then the queue
+    CHECK_EQ(untilChange(shedder, 5, 10), 2u + 3);
+    CHECK_EQ(shedder.getLevel(), 2u);
+
+    // A frame within the limits breaks the overloaded run
+    for (int i = 0; i < 2 + 2; ++i) {
+        CHECK(!shedder.observe(0, 200));
+    }
+    CHECK(!shedder.observe(0, 60)); // Neither overloaded nor healthy
+    CHECK_EQ(overloaded(shedder), 3u);
+    CHECK_EQ(shedder.getLevel(), 3u);
+
+    std::vector<LoadDecision> decisions;
+    CHECK_EQ(shedder.takeDecisions(decisions), 3u);
+    CHECK_EQ(shedder.takeDecisions(decisions), 0u);
+    if (decisions.size() == 3) {
+        checkDecision(decisions[0], 0, 1, LoadReason::Latency);
+        checkDecision(decisions[1], 1, 2, LoadReason::Queue);
+        checkDecision(decisions[2], 2, 3, LoadReason::Latency);
+        CHECK_EQ(decisions[0].frame, 3u);
+        CHECK_EQ(decisions[1].frame, 8u);
+        CHECK(decisions[1].queue_depth >= 2);
+    }
+    const LoadShedStats stats = shedder.getStats();
+    CHECK_EQ(stats.escalations, 3u);
+    CHECK_EQ(stats.recoveries, 0u);
+    CHECK_EQ(stats.frames_at_level[0], 3u);
+    CHECK_EQ(stats.frames_at_level[1], 5u);
+}
+
+void testBudget() {
+    LoadShedOptions options = testOptions();
+    options.frame_budget_ms = 10;
+    options.optional_stages = 1u << 4;
+    options.levels          = {{1, 0, true}};
+    LoadShedder shedder(options);
+
+    CHECK(shedder.isStageEnabled(4));
+    CHECK_EQ(untilChange(shedder, 0, 10, 30), 3u);
+    CHECK(!shedder.isStageEnabled(4));
+    CHECK(shedder.isStageEnabled(3));
+
+    std::vector<LoadDecision> decisions;
+    shedder.takeDecisions(decisions);
+    CHECK_EQ(decisions.size(), 1u);
+    if (decisions.size() == 1) {
+        checkDecision(decisions[0], 0, 1, LoadReason::Budget);
+        CHECK_EQ(decisions[0].busiest_stage, 1u);
+    }
+    // The top level cannot escalate, and recovers below half the budget only
+    CHECK_EQ(untilChange(shedder, 0, 10, 30), LIMIT);
+    CHECK_EQ(untilChange(shedder, 0, 10, 6), LIMIT);
+    CHECK_EQ(untilChange(shedder, 0, 10, 4), 4u);
+    CHECK(shedder.isStageEnabled(4));
+}
+
+void testBackoff() {
+    LoadShedder shedder(testOptions());
+    CHECK_EQ(overloaded(shedder), 3u);
+    CHECK_EQ(overloaded(shedder), 2u + 3);
+    CHECK_EQ(shedder.getLevel(), 2u);
+
+    CHECK_EQ(healthy(shedder), 2u + 4);
+    CHECK_EQ(shedder.getLevel(), 1u);
+    // Level 1 overloads right away: the next try needs twice the frames
+    CHECK_EQ(overloaded(shedder), 2u + 3);
+    CHECK_EQ(shedder.getLevel(), 2u);
+    CHECK_EQ(healthy(shedder), 2u + 2 * 4);
+    CHECK_EQ(shedder.getLevel(), 1u);
+
+    // It holds through settle_frames + recover_after, which resets the backoff
+    CHECK_EQ(healthy(shedder), 2u + 4);
+    CHECK_EQ(shedder.getLevel(), 0u);
+    CHECK_EQ(overloaded(shedder), 2u + 3);
+    CHECK_EQ(overloaded(shedder), 2u + 3);
+    CHECK_EQ(healthy(shedder), 2u + 4);
+    CHECK_EQ(shedder.getLevel(), 1u);
+
+    // Repeated failures double it up to max_backoff
+    for (uint32_t backoff : {2u, 4u, 4u}) {
+        CHECK_EQ(overloaded(shedder), 2u + 3);
+        CHECK_EQ(healthy(shedder), 2u + backoff * 4);
+    }
+
+    const LoadShedStats stats = shedder.getStats();
+    // Stepping up from level 0 right after reaching it failed as well
+    CHECK_EQ(stats.failed_recoveries, 5u);
+    CHECK_EQ(stats.escalations, 8u);
+    CHECK_EQ(stats.recoveries, 7u);
+    std::vector<LoadDecision> decisions;
+    shedder.takeDecisions(decisions);
+    CHECK_EQ(decisions.size(), 15u);
+    if (decisions.size() == 15) {
+        checkDecision(decisions[2], 2, 1, LoadReason::Recovered);
+        checkDecision(decisions[3], 1, 2, LoadReason::Latency);
+        checkDecision(decisions[5], 1, 0, LoadReason::Recovered);
+    }
+}
+
+void testReducedMediaType() {
+    const MediaCatalog catalog({
+        {FOURCC_YUY2, 1920, 1080, 30, 1}, // 0
+        {FOURCC_MJPG, 1920, 1080, 30, 1}, // 1
+        {FOURCC_MJPG, 1280, 720, 30, 1},  // 2
+        {FOURCC_YUY2, 1280, 720, 30, 1},  // 3
+        {FOURCC_YUY2, 640, 480, 30, 1},   // 4
+        {FOURCC_YUY2, 1280, 720, 10, 1},  // 5
+        {FOURCC_NV12, 960, 540, 60, 1},   // 6
+    });
+    // The largest that is low enough, of the same subtype if there is one
+    CHECK_EQ(reducedMediaType(catalog, 0, 720), 3u);
+    CHECK_EQ(reducedMediaType(catalog, 1, 720), 2u);
+    CHECK_EQ(reducedMediaType(catalog, 0, 480), 4u);
+    CHECK_EQ(reducedMediaType(catalog, 1, 480), 4u);
+    // Already low enough, no limit, or nothing keeps the frame rate
+    CHECK_EQ(reducedMediaType(catalog, 4, 720), 4u);
+    CHECK_EQ(reducedMediaType(catalog, 0, 0), 0u);
+    CHECK_EQ(reducedMediaType(catalog, 6, 480), 6u);
+    CHECK_EQ(reducedMediaType(catalog, 0, 360), 0u);
+    CHECK_EQ(reducedMediaType(catalog, 7, 480), 7u);
+
+    // Level 2 of the default ladder runs at 720 lines at most
+    LoadShedder shedder(testOptions());
+    CHECK_EQ(shedder.getMediaType(catalog, 0), 0u);
+    overloaded(shedder);
+    overloaded(shedder);
+    CHECK_EQ(shedder.getLevel(), 2u);
+    CHECK_EQ(shedder.getMediaType(catalog, 0), 3u);
+}
+
+} // namespace
+
+int main() {
+    testEscalation();
+    testBudget();
+    testBackoff();
+    testReducedMediaType();
+    return testResult("load_shedder_test");
+}
@@ -0,0 +1,148 @@
+// Best-format queries on hand-built catalogs: goals, tie-breaks, the subtype
+// preference, the bandwidth limit and queries nothing satisfies.
+
+#include "hardware/webcam/media_catalog.h"
+#include "test_check.h"
+#include <vector>
+
+namespace {
+
+// Bandwidths in bytes per second in the comments
+const std::vector<MediaFormat> FORMATS = {
+    {FOURCC_YUY2, 640, 480, 30, 1},          // 0: 18432000
+    {FOURCC_YUY2, 1280, 720, 10, 1},         // 1: 18432000
+    {FOURCC_MJPG, 1280, 720, 30, 1},         // 2: 10368000
+    {FOURCC_MJPG, 1920, 1080, 30, 1},        // 3: 23328000
+    {FOURCC_NV12, 1280, 720, 30, 1},         // 4: 41472000
+    {FOURCC_YUY2, 640, 480, 30, 1},          // 5: same as 0
+    {FOURCC_YUY2, 1280, 720, 30000, 1001},   // 6: 55240759
+    {FOURCC_MJPG, 640, 480, 60, 1},          // 7: 6912000
+    {FOURCC_YUY2, 640, 480, 90, 1},          // 8: 55296000
+};
+
+std::size_t best(const MediaCatalog& catalog, const FormatQuery& query) {
+    std::size_t index = SIZE_MAX;
+    CHECK_EQ(catalog.findBest(query, index), 0);
+    return index;
+}
+
+void testBandwidth(const MediaCatalog& catalog) {
+    CHECK_EQ(catalog.bandwidth(0), 18432000u);
+    CHECK_EQ(catalog.bandwidth(2), 10368000u);
+    CHECK_EQ(catalog.bandwidth(4), 41472000u);
+    CHECK_EQ(catalog.bandwidth(6), 55240759u);
+    CHECK_EQ(catalog.bandwidth(7), 6912000u);
+    CHECK(catalog.fps(6) < 30.0);
+}
+
+void testGoals(const MediaCatalog& catalog) {
+    FormatQuery query;
+    query.min_fps    = 30;
+    query.min_width  = 1280;
+    query.min_height = 720;
+    CHECK_EQ(best(catalog, query), 2u);
+
+    query.goal = FormatGoal::MaxResolution;
+    CHECK_EQ(best(catalog, query), 3u);
+
+    FormatQuery fastest;
+    fastest.goal = FormatGoal::MaxFrameRate;
+    CHECK_EQ(best(catalog, fastest), 8u);
+
+    // 29.97 fps satisfies a 30 fps minimum
+    FormatQuery yuy2;
+    yuy2.min_fps          = 30;
+    yuy2.min_height       = 720;
+    yuy2.required_subtype = FOURCC_YUY2;
+    CHECK_EQ(best(catalog, yuy2), 6u);
+}
+
+void testTies(const MediaCatalog& catalog) {
+    // 0, 1 and 5 need the same bandwidth, the larger frame wins
+    FormatQuery query;
+    query.required_subtype = FOURCC_YUY2;
+    CHECK_EQ(best(catalog, query), 1u);
+
+    // 0 and 5 are identical, the source's order decides
+    query.max_height = 480;
+    CHECK_EQ(best(catalog, query), 0u);
+    const std::vector<std::size_t> ranked = catalog.rank(query);
+    CHECK_EQ(ranked.size(), 3u);
+    if (ranked.size() == 3) {
+        CHECK_EQ(ranked[0], 0u);
+        CHECK_EQ(ranked[1], 5u);
+        CHECK_EQ(ranked[2], 8u);
+    }
+}
+
+void testPreference(const MediaCatalog& catalog) {
+    // MJPEG wins over a faster raw media type
+    FormatQuery query;
+    query.goal              = FormatGoal::MaxFrameRate;
+    query.preferred_subtype = FOURCC_MJPG;
+    CHECK_EQ(best(catalog, query), 7u);
+
+    // Another subtype is taken when no MJPEG media type fits
+    query.min_fps = 90;
+    CHECK_EQ(best(catalog, query), 8u);
+
+    // Any preferred subtype outranks the goal, here over cheaper MJPEG
+    FormatQuery raw;
+    raw.min_fps           = 30;
+    raw.min_height        = 720;
+    raw.preferred_subtype = FOURCC_NV12;
+    CHECK_EQ(best(catalog, raw), 4u);
+    raw.preferred_subtype = FOURCC_YUY2;
+    CHECK_EQ(best(catalog, raw), 6u);
+}
+
+void testBandwidthLimit(const MediaCatalog& catalog) {
+    FormatQuery query;
+    query.goal          = FormatGoal::MaxResolution;
+    query.max_bandwidth = 20000000;
+    CHECK_EQ(best(catalog, query), 2u);
+
+    // The limit is inclusive
+    query.max_bandwidth = 10368000;
+    CHECK_EQ(best(catalog, query), 2u);
+    query.max_bandwidth = 10367999;
+    CHECK_EQ(best(catalog, query), 7u);
+}
+
+void testNoMatch(const MediaCatalog& catalog) {
+    std::size_t index = 42;
+    FormatQuery query;
+    query.min_width = 4000;
+    CHECK_EQ(catalog.findBest(query, index), -404);
+    CHECK_EQ(index, 42u);
+    CHECK(catalog.rank(query).empty());
+
+    query               = FormatQuery{};
+    query.max_bandwidth = 1;
+    CHECK_EQ(catalog.findBest(query, index), -404);
+
+    query                  = FormatQuery{};
+    query.required_subtype = FOURCC_I420;
+    CHECK_EQ(catalog.findBest(query, index), -404);
+
+    MediaCatalog empty;
+    CHECK_EQ(empty.findBest(FormatQuery{}, index), -404);
+    CHECK_EQ(index, 42u);
+}
+
+} // namespace
+
+int main() {
+    const MediaCatalog catalog(FORMATS);
+    CHECK_EQ(catalog.size(), FORMATS.size());
+    for (std::size_t i = 0; i < catalog.size(); ++i) {
+        CHECK(catalog.format(i) == FORMATS[i]);
+    }
+    testBandwidth(catalog);
+    testGoals(catalog);
+    testTies(catalog);
+    testPreference(catalog);
+    testBandwidthLimit(catalog);
+    testNoMatch(catalog);
+    return testResult("media_catalog_test");
+}
@@ -0,0 +1,100 @@
+// Strided ranges over a recording visit the expected frames and their
+// iterators compare the same whichever side they are on. Writing it, the
+// recorder refuses a frame shorter than its media type.
+
+#include "hardware/webcam/recorder.h"
+#include "hardware/webcam/recording_reader.h"
+#include "hardware/webcam/synthetic_source.h"
+#include "test_check.h"
+#include <filesystem>
+#include <iterator>
+
+namespace {
+
+constexpr std::size_t FRAMES = 10;
+
+std::filesystem::path writeRecording() {
+    const MediaFormat format{FOURCC_NV12, 64, 48, 30, 1};
+    const auto        path =
+        std::filesystem::temp_directory_path() / "recording_reader_test.rec";
+
+    RecorderOptions options;
+    options.queue_capacity = FRAMES; // Nothing is dropped
+    options.direct_io      = false;
+    Recorder recorder(path, format, options);
+    CHECK_EQ(recorder.open(), 0);
+
+    // A short sample is refused rather than read past its end
+    Frame truncated;
+    truncated.format = format;
+    truncated.buffer = FrameBufferRef::allocate(rawFrameSize(format) - 1);
+    CHECK_EQ(recorder.append(truncated), -400);
+
+    for (std::size_t i = 0; i < FRAMES; ++i) {
+        Frame frame;
+        frame.format    = format;
+        frame.buffer    = FrameBufferRef::allocate(rawFrameSize(format));
+        frame.sequence  = i;
+        frame.timestamp = static_cast<int64_t>(i) * 333333;
+        SyntheticSource::render(format, i, 0, frame.buffer.data());
+        CHECK_EQ(recorder.append(frame), 0);
+    }
+    CHECK_EQ(recorder.close(), 0);
+    return path;
+}
+
+void testStrides(const RecordingReader& reader) {
+    const std::size_t strides[] = {1, 3, 4, 9, 10, 20};
+    for (std::size_t stride : strides) {
+        std::size_t expected = 0;
+        for (const FrameView& view : reader.frames(0, SIZE_MAX, stride)) {
+            CHECK_EQ(view.index, expected);
+            expected += stride;
+        }
+        CHECK_EQ(expected, (FRAMES + stride - 1) / stride * stride);
+    }
+
+    // A partial range stops at its end, not at the end of the recording
+    std::size_t count = 0;
+    for (const FrameView& view : reader.frames(2, 7, 2)) {
+        CHECK(view.index >= 2 && view.index < 7);
+        ++count;
+    }
+    CHECK_EQ(count, 3u);
+    CHECK_EQ(std::distance(reader.frames(5, 5).begin(), reader.frames(5, 5).end()), 0);
+}
+
+void testEquality(const RecordingReader& reader) {
+    RecordingReader::Range range = reader.frames(1, FRAMES, 4);
+    RecordingReader::Iterator it = range.begin();
+    const RecordingReader::Iterator end = range.end();
+
+    // Frames 1, 5 and 9, then the end
+    for (int step = 0; step < 3; ++step) {
+        CHECK(it != end);
+        CHECK(end != it);
+        ++it;
+    }
+    CHECK(it == end);
+    CHECK(end == it);
+
+    RecordingReader::Iterator other = range.begin();
+    ++other;
+    CHECK(!(other == range.begin()));
+    CHECK(!(range.begin() == other));
+}
+
+} // namespace
+
+int main() {
+    const auto path = writeRecording();
+    {
+        RecordingReader reader;
+        CHECK_EQ(reader.open(path), 0);
+        CHECK_EQ(reader.getFrameCount(), FRAMES);
+        testStrides(reader);
+        testEquality(reader);
+    }
+    std::filesystem::remove(path);
+    return testResult("recording_reader_test");
+}
@@ -0,0 +1,243 @@
+// Stage graphs on a shared scheduler: a fan-out and join whose parallel stage
+// finishes frames out of order, errors skipping the stages behind them, the
+// `max_frames` limit, and `drain` and the destructor waiting for the sink.
+
+#include "processing/stage_graph.h"
+#include "test_check.h"
+#include <atomic>
+#include <thread>
+
+namespace {
+
+constexpr int FRAMES = 64;
+
+std::shared_ptr<StageScheduler> createScheduler() {
+    StageSchedulerOptions options;
+    options.threads = 4;
+    return std::make_shared<StageScheduler>(options);
+}
+
+Frame numbered(uint64_t sequence) {
+    Frame frame;
+    frame.sequence = sequence;
+    return frame;
+}
+
+void testFanOutJoin() {
+    StageGraph graph({}, createScheduler());
+
+    // Every fourth frame decodes slowly, so the frames after it pass it
+    std::mutex            mutex;
+    std::vector<uint64_t> decoded, ordered, sunk;
+    auto                  decode = graph.addStage<uint64_t>(
+        "decode", {0, 4, false},
+        [&](const Frame& in, uint64_t& out) -> int16_t {
+            if (in.sequence % 4 == 0) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(5));
+            }
+            out = in.sequence * 10;
+            std::lock_guard<std::mutex> lock(mutex);
+            decoded.push_back(in.sequence);
+            return 0;
+        },
+        graph.source());
+    auto left = graph.addStage<uint64_t>(
+        "ordered", {},
+        [&](const uint64_t& in, uint64_t& out) -> int16_t {
+            std::lock_guard<std::mutex> lock(mutex);
+            ordered.push_back(in / 10);
+            out = in + 1;
+            return 0;
+        },
+        decode);
+    auto right = graph.addStage<uint64_t>(
+        "parallel", {0, 4, false},
+        [](const uint64_t& in, uint64_t& out) -> int16_t {
+            out = in + 2;
+            return 0;
+        },
+        decode);
+    auto join = graph.addStage<uint64_t>(
+        "join", {},
+        [](const uint64_t& a, const uint64_t& b, uint64_t& out) -> int16_t {
+            out = a + b;
+            return 0;
+        },
+        left, right);
+    CHECK(decode.valid() && left.valid() && right.valid() && join.valid());
+
+    std::atomic<int> wrong{0};
+    graph.setSink([&](const StageFrame& frame) {
+        const uint64_t* sum = frame.get(join);
+        if (!sum || *sum != frame.sequence() * 20 + 3 ||
+            frame.frame().sequence != frame.sequence()) {
+            ++wrong;
+        }
+        sunk.push_back(frame.sequence()); // Never concurrent
+    });
+
+    for (uint64_t i = 0; i < FRAMES; ++i) {
+        CHECK_EQ(graph.push(numbered(i), std::chrono::milliseconds(1000)), 0);
+    }
+    CHECK(graph.drain(std::chrono::milliseconds(5000)));
+
+    CHECK_EQ(wrong.load(), 0);
+    CHECK_EQ(sunk.size(), static_cast<std::size_t>(FRAMES));
+    CHECK_EQ(ordered.size(), static_cast<std::size_t>(FRAMES));
+    bool decoded_in_order = true;
+    for (std::size_t i = 0; i < sunk.size() && i < ordered.size(); ++i) {
+        CHECK_EQ(sunk[i], i);
+        CHECK_EQ(ordered[i], i);
+        decoded_in_order = decoded_in_order && decoded[i] == i;
+    }
+    CHECK(!decoded_in_order);
+
+    const StageGraphStats stats = graph.getStats();
+    CHECK_EQ(stats.pushed, static_cast<uint64_t>(FRAMES));
+    CHECK_EQ(stats.completed, static_cast<uint64_t>(FRAMES));
+    CHECK_EQ(stats.in_flight, 0u);
+    CHECK_EQ(stats.stages.size(), 4u);
+    for (const StageNodeStats& stage : stats.stages) {
+        CHECK_EQ(stage.runs, static_cast<uint64_t>(FRAMES));
+        CHECK_EQ(stage.skipped, 0u);
+    }
+    CHECK(stats.stages[0].max_running > 1);
+    CHECK_EQ(stats.stages[1].max_running, 1u);
+}
+
+void testFailedStage() {
+    StageGraph graph({}, createScheduler());
+    auto       check = graph.addStage<uint64_t>(
+        "check", {0, 4, false},
+        [](const Frame& in, uint64_t& out) -> int16_t {
+            out = in.sequence;
+            return in.sequence % 2 ? -500 : 0;
+        },
+        graph.source());
+    auto after = graph.addStage<uint64_t>(
+        "after", {},
+        [](const uint64_t& in, uint64_t& out) -> int16_t {
+            out = in;
+            return 0;
+        },
+        check);
+    auto last = graph.addStage<uint64_t>(
+        "last", {},
+        [](const uint64_t& in, uint64_t& out) -> int16_t {
+            out = in;
+            return 0;
+        },
+        after);
+    auto independent = graph.addStage<uint64_t>(
+        "independent", {},
+        [](const Frame& in, uint64_t& out) -> int16_t {
+            out = in.sequence;
+            return 0;
+        },
+        graph.source());
+
+    std::atomic<int> wrong{0};
+    graph.setSink([&](const StageFrame& frame) {
+        const bool failed = frame.sequence() % 2 != 0;
+        const bool ok =
+            frame.result(check) == (failed ? -500 : 0) &&
+            frame.result(after) == (failed ? 204 : 0) &&
+            frame.result(last) == (failed ? 204 : 0) &&
+            (frame.get(after) == nullptr) == failed &&
+            frame.get(independent) && *frame.get(independent) == frame.sequence();
+        wrong += ok ? 0 : 1;
+    });
+    for (uint64_t i = 0; i < FRAMES; ++i) {
+        CHECK_EQ(graph.push(numbered(i), std::chrono::milliseconds(1000)), 0);
+    }
+    CHECK(graph.drain(std::chrono::milliseconds(5000)));
+    CHECK_EQ(wrong.load(), 0);
+
+    const StageGraphStats stats = graph.getStats();
+    CHECK_EQ(stats.completed, static_cast<uint64_t>(FRAMES));
+    CHECK_EQ(stats.stages[0].failed, static_cast<uint64_t>(FRAMES / 2));
+    CHECK_EQ(stats.stages[1].runs, static_cast<uint64_t>(FRAMES / 2));
+    CHECK_EQ(stats.stages[1].skipped, static_cast<uint64_t>(FRAMES / 2));
+    CHECK_EQ(stats.stages[2].skipped, static_cast<uint64_t>(FRAMES / 2));
+    CHECK_EQ(stats.stages[3].runs, static_cast<uint64_t>(FRAMES));
+}
+
+void testMaxFrames() {
+    StageGraph empty({}, createScheduler());
+    CHECK_EQ(empty.push(numbered(0)), -409);
+
+    StageGraphOptions options;
+    options.max_frames = 2;
+    StageGraph graph(options, createScheduler());
+
+    std::mutex              mutex;
+    std::condition_variable opened;
+    bool                    open = false;
+    graph.addStage<uint64_t>(
+        "gate", {0, 2, false},
+        [&](const Frame& in, uint64_t& out) -> int16_t {
+            std::unique_lock<std::mutex> lock(mutex);
+            opened.wait(lock, [&] { return open; });
+            out = in.sequence;
+            return 0;
+        },
+        graph.source());
+    std::atomic<int> sunk{0};
+    graph.setSink([&](const StageFrame&) { ++sunk; });
+
+    CHECK_EQ(graph.push(numbered(0)), 0);
+    CHECK_EQ(graph.push(numbered(1)), 0);
+    CHECK_EQ(graph.push(numbered(2)), -429);
+    CHECK_EQ(graph.push(numbered(2), std::chrono::milliseconds(20)), -429);
+    CHECK(!graph.drain(std::chrono::milliseconds(20)));
+    StageGraphStats stats = graph.getStats();
+    CHECK_EQ(stats.rejected, 2u);
+    CHECK_EQ(stats.in_flight, 2u);
+    CHECK_EQ(sunk.load(), 0);
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        open = true;
+    }
+    opened.notify_all();
+    // A slot frees up while it waits
+    CHECK_EQ(graph.push(numbered(2), std::chrono::milliseconds(1000)), 0);
+    CHECK(graph.drain(std::chrono::milliseconds(1000)));
+    stats = graph.getStats();
+    CHECK_EQ(sunk.load(), 3);
+    CHECK_EQ(stats.pushed, 3u);
+    CHECK_EQ(stats.in_flight, 0u);
+}
+
+void testDestructor() {
+    std::atomic<int> sunk{0};
+    {
+        StageGraph graph({}, createScheduler());
+        graph.addStage<uint64_t>(
+            "slow", {0, 2, false},
+            [](const Frame& in, uint64_t& out) -> int16_t {
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+                out = in.sequence;
+                return 0;
+            },
+            graph.source());
+        graph.setSink([&](const StageFrame&) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(2));
+            ++sunk;
+        });
+        for (uint64_t i = 0; i < 6; ++i) {
+            CHECK_EQ(graph.push(numbered(i), std::chrono::milliseconds(1000)), 0);
+        }
+    }
+    CHECK_EQ(sunk.load(), 6);
+}
+
+} // namespace
+
+int main() {
+    testFanOutJoin();
+    testFailedStage();
+    testMaxFrames();
+    testDestructor();
+    return testResult("stage_graph_test");
+}
@@ -0,0 +1,50 @@
+#ifndef TEST_CHECK_H
+#define TEST_CHECK_H
+
+#include <cstdio>
+
+/**
+ * @brief Failed checks of the running test, its exit code is non-zero if any
+ * failed.
+ */
+inline int& testFailures() {
+    static int failures = 0;
+    return failures;
+}
+
+/**
+ * @brief Report `condition` with its source location if it does not hold and
+ * carry on, so one run lists every failure.
+ */
+#define CHECK(condition)                                                       \
+    do {                                                                       \
+        if (!(condition)) {                                                    \
+            std::fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__,        \
+                         __LINE__, #condition);                                \
+            ++testFailures();                                                  \
+        }                                                                      \
+    } while (false)
+
+#define CHECK_EQ(actual, expected)                                             \
+    do {                                                                       \
+        const auto check_actual_   = (actual);                                 \
+        const auto check_expected_ = (expected);                               \
+        if (!(check_actual_ == check_expected_)) {                             \
+            std::fprintf(stderr, "%s:%d: check failed: %s == %s (%lld vs %lld)\n", \
+                         __FILE__, __LINE__, #actual, #expected,               \
+                         static_cast<long long>(check_actual_),                \
+                         static_cast<long long>(check_expected_));             \
+            ++testFailures();                                                  \
+        }                                                                      \
+    } while (false)
+
+inline int testResult(const char* name) {
+    if (testFailures() != 0) {
+        std::fprintf(stderr, "%s: %d check(s) failed\n", name, testFailures());
+        return 1;
+    }
+    std::printf("%s: ok\n", name);
+    return 0;
+}
+
+#endif // TEST_CHECK_H
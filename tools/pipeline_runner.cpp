@@ -0,0 +1,887 @@
+// Headless run of the capture and processing pipeline, no window or GPU.
+//
+//   pipeline_runner [source...] [option...]
+//
+// Sources, each can be given several times:
+//   --synthetic FOURCC:WxH     Synthetic test pattern, e.g. NV12:1920x1080
+//   --replay FOURCC:WxH:PATH   Raw or concatenated MJPEG file
+//   --recording PATH           Recording written by Webcam::startRecording
+//   --camera INDEX             Media Foundation device (Windows only)
+//
+// Options:
+//   --stages LIST   Comma separated convert, motion, background, flow and
+//                   blobs; all of them by default
+//   --frames N      Frames per source, 600 by default, 0 for no limit
+//   --seconds S     Stop after S seconds
+//   --threads N     Worker threads, 0 (default) for one per hardware thread
+//   --roi L,T,R,B   Only process this rectangle, as fractions of the frame;
+//                   several are joined into one region
+//   --shed MS       Pace the sources like live cameras and shed load to keep
+//                   frame latency below MS milliseconds
+//   --graph         Run each source's stages as a `StageGraph` on one shared
+//                   scheduler instead of one after another
+//   --loop          Play files and recordings in a loop
+//   --json PATH     Also write the summary as JSON, for CI dashboards
+//   --trace PATH    Write a Chrome trace of the run (WEBCAM_ENABLE_TRACE) and
+//                   print the traced end-to-end latency
+//
+// File and synthetic sources run unthrottled into blocking rings, so every
+// frame is processed and the run measures throughput. Each source has its
+// own pipeline thread; decode, background, flow and blobs fan out on a
+// shared pool. MJPEG frames are decoded to gray when a tracking stage runs
+// and to RGBA otherwise. Prints frames/s, per-stage latency percentiles and
+// peak RSS, and exits with 1 on bad arguments or a failing source.
+//
+// With --shed, sources deliver frames at their frame rate into rings that
+// overwrite the oldest frame, and a `LoadShedder` per source skips analysis
+// of some frames, switches to lower-resolution media types (synthetic sources
+// then also offer 720p and 480p) and turns off flow and blobs when the
+// pipeline falls behind. Conversion runs on every frame, as the preview
+// would. Its level changes are printed and written to the JSON summary.
+//
+// With --graph, the pipeline thread only reads and pushes frames; decoding,
+// conversion and the analysis stages of consecutive frames overlap on the
+// pool, stateful stages stay serial and the sink counts finished frames.
+
+#include "hardware/webcam/pixel_format.h"
+#include "hardware/webcam/recording_source.h"
+#include "hardware/webcam/region_of_interest.h"
+#include "hardware/webcam/replay_source.h"
+#include "hardware/webcam/synthetic_source.h"
+#include "hardware/webcam/webcam.h"
+#include "processing/background_model.h"
+#include "processing/blob_extractor.h"
+#include "processing/frame_cache.h"
+#include "processing/load_shedder.h"
+#include "processing/mjpeg_decoder.h"
+#include "processing/motion_detector.h"
+#include "processing/optical_flow.h"
+#include "processing/stage_graph.h"
+#include "processing/trace_report.h"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cwchar>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include "hardware/webcam/webcam_manager.h"
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+namespace {
+
+enum Stage { Decode, Convert, Motion, Background, Flow, Blobs, STAGE_COUNT };
+
+const char* const STAGE_NAMES[STAGE_COUNT] = {"decode", "convert", "motion",
+                                              "background", "flow", "blobs"};
+
+struct SourceSpec {
+    enum class Kind { Synthetic, Replay, Recording, Camera } kind;
+    MediaFormat format{};
+    std::string path{};
+    std::size_t camera{};
+    uint32_t    seed{}; // Synthetic only, numbers them "Synthetic 0", "Synthetic 1"...
+};
+
+struct RunOptions {
+    std::vector<SourceSpec> sources{};
+    bool                    stages[STAGE_COUNT]{false, true, true, true, true, true};
+    uint64_t                frames{600};
+    double                  seconds{0};
+    std::size_t             threads{0};
+    RoiRef                  roi{};     // Null for whole frames
+    double                  shed_ms{0}; // Target frame latency, 0 to
+                                        // process every frame
+    bool                    graph{false};
+    bool                    loop{false};
+    std::string             json_path{};
+    std::string             trace_path{};
+};
+
+/**
+ * @brief One source and the stages that consume it, run on its own thread.
+ */
+struct Pipeline {
+    std::wstring                  name{};
+    Webcam*                       camera{};
+    std::shared_ptr<ThreadPool>   workers;
+    std::unique_ptr<Webcam>       owned{};
+    std::unique_ptr<MjpegDecoder> decoder{};
+    std::unique_ptr<LoadShedder>  shedder{};  // Null without --shed
+    uint16_t                      selected{}; // Media type before shedding
+    MotionDetector                motion{};
+    BackgroundModel               background;
+    OpticalFlowTracker            flow;
+    BlobExtractor                 blobs;
+
+    MotionMap                 map{};
+    Frame                     product{}, mask{};
+    std::vector<FlowPoint>    points{}, tracked{};
+    std::vector<Blob>         found{};
+    std::vector<LoadDecision> decisions{}; // Level changes of `shedder`
+
+    std::array<LatencyHistogram, STAGE_COUNT> latency{};
+    LatencyHistogram                          total{}; // Arrival to last stage
+    uint64_t                                  read{};
+    uint64_t                                  processed{};
+    int16_t                                   result{};
+    std::atomic<bool>                         done{false};
+
+    // With --graph; its stages use the members above, so it is destroyed first
+    std::unique_ptr<StageGraph> graph{};
+    std::vector<Stage>          graph_stages{}; // Stage of each graph node
+
+    explicit Pipeline(const std::shared_ptr<ThreadPool>& workers)
+        : workers(workers), background({}, workers), flow({}, workers),
+          blobs({}, workers) {}
+};
+
+bool parseFourCC(const std::string& text, uint32_t& fourcc) {
+    if (text.size() != 4) {
+        return false;
+    }
+    fourcc = makeFourCC(text[0], text[1], text[2], text[3]);
+    return findPixelFormat(fourcc) != nullptr;
+}
+
+/**
+ * @brief `FOURCC:WxH`, followed by `:rest` if `rest` is given.
+ */
+bool parseFormat(const std::string& text, MediaFormat& format,
+                 std::string* rest = nullptr) {
+    const std::size_t colon = text.find(':');
+    const std::size_t end   = rest ? text.find(':', colon + 1) : text.size();
+    if (colon == std::string::npos || end == std::string::npos ||
+        !parseFourCC(text.substr(0, colon), format.subtype)) {
+        return false;
+    }
+    unsigned width = 0, height = 0;
+    char     tail  = 0;
+    if (std::sscanf(text.substr(colon + 1, end - colon - 1).c_str(), "%ux%u%c",
+                    &width, &height, &tail) != 2 ||
+        width == 0 || height == 0) {
+        return false;
+    }
+    format = {format.subtype, width, height, 30, 1};
+    if (rest) {
+        *rest = text.substr(end + 1);
+        return !rest->empty();
+    }
+    return true;
+}
+
+bool parseStages(const std::string& text, bool* stages) {
+    std::fill(stages + Convert, stages + STAGE_COUNT, false);
+    std::size_t begin = 0;
+    while (begin <= text.size()) {
+        std::size_t end = std::min(text.find(',', begin), text.size());
+        const std::string name  = text.substr(begin, end - begin);
+        auto              found = std::find_if(
+            STAGE_NAMES + Convert, STAGE_NAMES + STAGE_COUNT,
+            [&](const char* stage) { return name == stage; });
+        if (found == STAGE_NAMES + STAGE_COUNT) {
+            return false;
+        }
+        stages[found - STAGE_NAMES] = true;
+        begin = end + 1;
+    }
+    return true;
+}
+
+void usage() {
+    std::fwprintf(stderr,
+                  L"usage: pipeline_runner [--synthetic FOURCC:WxH] "
+                  L"[--replay FOURCC:WxH:PATH] [--recording PATH] [--camera INDEX]\n"
+                  L"                       [--stages LIST] [--frames N] [--seconds S] "
+                  L"[--threads N] [--roi L,T,R,B] [--shed MS] [--graph]\n"
+                  L"                       [--loop] [--json PATH] [--trace PATH]\n");
+}
+
+bool parseArguments(int argc, char** argv, RunOptions& options) {
+    std::shared_ptr<RegionOfInterest> region; // Shapes of `options.roi`
+    for (int i = 1; i < argc; ++i) {
+        const std::string argument = argv[i];
+        if (argument == "--loop") {
+            options.loop = true;
+            continue;
+        }
+        if (argument == "--graph") {
+            options.graph = true;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            return false;
+        }
+        const std::string value = argv[++i];
+        SourceSpec        source{};
+        if (argument == "--synthetic") {
+            source.kind = SourceSpec::Kind::Synthetic;
+            source.seed = static_cast<uint32_t>(
+                std::count_if(options.sources.begin(), options.sources.end(),
+                              [](const SourceSpec& spec) {
+                                  return spec.kind == SourceSpec::Kind::Synthetic;
+                              }));
+            if (!parseFormat(value, source.format) ||
+                pixelFrameSize(*findPixelFormat(source.format.subtype), 1, 1) == 0) {
+                return false;
+            }
+            options.sources.push_back(source);
+        } else if (argument == "--replay") {
+            source.kind = SourceSpec::Kind::Replay;
+            if (!parseFormat(value, source.format, &source.path)) {
+                return false;
+            }
+            options.sources.push_back(source);
+        } else if (argument == "--recording") {
+            source.kind = SourceSpec::Kind::Recording;
+            source.path = value;
+            options.sources.push_back(source);
+        } else if (argument == "--camera") {
+            source.kind   = SourceSpec::Kind::Camera;
+            source.camera = std::strtoul(value.c_str(), nullptr, 10);
+            options.sources.push_back(source);
+        } else if (argument == "--stages") {
+            if (!parseStages(value, options.stages)) {
+                return false;
+            }
+        } else if (argument == "--frames") {
+            options.frames = std::strtoull(value.c_str(), nullptr, 10);
+        } else if (argument == "--seconds") {
+            options.seconds = std::atof(value.c_str());
+        } else if (argument == "--threads") {
+            options.threads = std::strtoul(value.c_str(), nullptr, 10);
+        } else if (argument == "--roi") {
+            float edges[4];
+            if (std::sscanf(value.c_str(), "%f,%f,%f,%f", &edges[0], &edges[1],
+                            &edges[2], &edges[3]) != 4) {
+                return false;
+            }
+            if (!region) {
+                region      = std::make_shared<RegionOfInterest>();
+                options.roi = region;
+            }
+            if (region->addRectangle(edges[0], edges[1], edges[2], edges[3]) != 0) {
+                return false;
+            }
+        } else if (argument == "--shed") {
+            options.shed_ms = std::atof(value.c_str());
+            if (!(options.shed_ms > 0)) {
+                return false;
+            }
+        } else if (argument == "--json") {
+            options.json_path = value;
+        } else if (argument == "--trace") {
+            options.trace_path = value;
+        } else {
+            return false;
+        }
+    }
+    // The shedder judges frames one after another on the pipeline thread
+    return !options.sources.empty() && !(options.graph && options.shed_ms > 0);
+}
+
+/**
+ * @brief `format` and, for load shedding, the same subtype and frame rate at
+ * the lower heights of the default ladder.
+ */
+std::vector<MediaFormat> syntheticFormats(const MediaFormat& format, bool shed) {
+    std::vector<MediaFormat> formats{format};
+    for (uint32_t height : {720u, 480u}) {
+        if (!shed || height >= format.height) {
+            continue;
+        }
+        MediaFormat reduced = format;
+        reduced.width  = std::max<uint32_t>(16, format.width * height / format.height / 16 * 16);
+        reduced.height = height;
+        formats.push_back(reduced);
+    }
+    return formats;
+}
+
+std::shared_ptr<CaptureSource> createSource(const SourceSpec& spec,
+                                            const RunOptions& options) {
+    const SourcePacing pacing =
+        options.shed_ms > 0 ? SourcePacing::Native : SourcePacing::Unthrottled;
+    switch (spec.kind) {
+    case SourceSpec::Kind::Synthetic:
+        return std::make_shared<SyntheticSource>(
+            syntheticFormats(spec.format, options.shed_ms > 0), pacing, spec.seed);
+    case SourceSpec::Kind::Replay:
+        return std::make_shared<ReplaySource>(spec.path, spec.format, pacing,
+                                              options.loop);
+    case SourceSpec::Kind::Recording:
+        return std::make_shared<RecordingSource>(spec.path, pacing, options.loop);
+    default:
+        return nullptr;
+    }
+}
+
+uint64_t microsecondsSince(std::chrono::steady_clock::time_point start) {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+                                     std::chrono::steady_clock::now() - start)
+                                     .count());
+}
+
+/**
+ * @brief Points to track, a grid 64 pixels apart inside a 32 pixel border.
+ */
+void seedPoints(const MediaFormat& format, std::vector<FlowPoint>& points) {
+    for (uint32_t y = 32; y + 32 < format.height; y += 64) {
+        for (uint32_t x = 32; x + 32 < format.width; x += 64) {
+            points.push_back({static_cast<float>(x), static_cast<float>(y)});
+        }
+    }
+}
+
+void processFrame(Pipeline& pipeline, const Frame& frame, const RunOptions& options) {
+    LoadShedder* shedder = pipeline.shedder.get();
+    auto timed = [&](Stage stage, auto&& work) {
+        const auto start = std::chrono::steady_clock::now();
+        const int16_t  result = work();
+        const uint64_t us     = microsecondsSince(start);
+        pipeline.latency[stage].record(us);
+        if (shedder) {
+            shedder->recordStage(stage, us / 1000.0);
+        }
+        return result;
+    };
+    // Analysis stages of the frame, conversion feeds the preview and always runs
+    bool stages[STAGE_COUNT];
+    const bool analyze = !shedder || shedder->shouldAnalyze(frame.sequence);
+    for (std::size_t stage = 0; stage < STAGE_COUNT; ++stage) {
+        stages[stage] = options.stages[stage] &&
+                        (stage <= Convert || !shedder ||
+                         (analyze && shedder->isStageEnabled(stage)));
+    }
+
+    const PixelFormatTraits* traits = findPixelFormat(frame.format.subtype);
+    if (stages[Convert] && traits && traits->conversion != PixelConversion::None) {
+        timed(Convert, [&] {
+            return frameProduct(frame, FrameProduct::Rgba, pipeline.product);
+        });
+    }
+    if (stages[Motion]) {
+        timed(Motion, [&] { return pipeline.motion.process(frame, pipeline.map); });
+    }
+    int16_t background = -400;
+    if (stages[Background]) {
+        background = timed(Background, [&] {
+            return pipeline.background.apply(
+                frame, pipeline.mask, stages[Motion] ? &pipeline.map : nullptr);
+        });
+    }
+    if (stages[Flow]) {
+        if (pipeline.points.empty()) {
+            seedPoints(frame.format, pipeline.points);
+        }
+        timed(Flow, [&] {
+            return pipeline.flow.track(frame, pipeline.points, pipeline.tracked);
+        });
+    }
+    if (stages[Blobs] && background == 0) {
+        timed(Blobs, [&] { return pipeline.blobs.extract(pipeline.mask, pipeline.found); });
+    }
+
+    // Where a viewer would show it, closes the frame's end-to-end trace
+    TraceScope present(frame, TraceStage::Present);
+    if (frame.arrival != 0) {
+        const int64_t latency = std::max<int64_t>(0, hostTime100ns() - frame.arrival);
+        pipeline.total.record(static_cast<uint64_t>(latency / 10));
+        if (shedder) {
+            std::size_t queued = pipeline.camera->getCaptureStats().queued;
+            if (pipeline.decoder) {
+                queued += pipeline.decoder->getStats().in_flight;
+            }
+            if (shedder->observe(queued, latency / 10000.0)) {
+                shedder->takeDecisions(pipeline.decisions);
+            }
+        }
+    }
+    ++pipeline.processed;
+}
+
+/**
+ * @brief Reopen the camera at the media type the shedder's level asks for.
+ * @return As `Webcam::activate`, 0 if the media type does not change.
+ */
+int16_t applyMediaType(Pipeline& pipeline) {
+    const std::size_t wanted = pipeline.shedder->getMediaType(
+        pipeline.camera->getMediaCatalog(), pipeline.selected);
+    if (wanted == pipeline.camera->getMediaTypeIndex()) {
+        return 0;
+    }
+    pipeline.camera->deactivate();
+    pipeline.camera->setMediaTypeIndex(static_cast<uint16_t>(wanted));
+    pipeline.points.clear(); // Laid out for the old frame size
+    return pipeline.camera->activate();
+}
+
+std::unique_ptr<MjpegDecoder> createDecoder(const Pipeline& pipeline,
+                                            const RunOptions& options) {
+    MjpegDecoderOptions decoder;
+    decoder.output = options.stages[Motion] || options.stages[Background] ||
+                             options.stages[Flow] || options.stages[Blobs]
+                         ? PixelOutput::Gray
+                         : PixelOutput::Rgba;
+    return std::make_unique<MjpegDecoder>(decoder, pipeline.workers);
+}
+
+/**
+ * @brief Wire the selected stages of `pipeline` into its graph, decoding
+ * first if `first` is MJPEG.
+ */
+void buildGraph(Pipeline& pipeline, const Frame& first, const RunOptions& options) {
+    StageGraph&        graph     = *pipeline.graph;
+    const std::size_t  workers   = pipeline.workers->size();
+    const StageOptions stateless = {0, workers, false};
+    const StageOptions stateful  = {};
+    auto               add       = [&](Stage stage, auto port) {
+        pipeline.graph_stages.push_back(stage);
+        return port;
+    };
+
+    StagePort<Frame> frames = graph.source();
+    if (pixelDecoder(first.format.subtype) == PixelDecoder::Mjpeg) {
+        pipeline.decoder = createDecoder(pipeline, options);
+        frames           = add(Decode, graph.addStage<Frame>(
+                                 "decode", stateless,
+                                 [&pipeline](const Frame& in, Frame& out) {
+                                     return pipeline.decoder->decodeFrame(in, out);
+                                 },
+                                 frames));
+    }
+    // Like processFrame, leaves out sources with nothing to convert: decoded
+    // frames are RGBA or gray already, and so is Y800
+    if (options.stages[Convert] && !pipeline.decoder &&
+        isConvertible(first.format.subtype)) {
+        add(Convert, graph.addStage<Frame>(
+                         "convert", stateless,
+                         [](const Frame& in, Frame& out) -> int16_t {
+                             const PixelFormatTraits* traits = findPixelFormat(in.format.subtype);
+                             if (!traits || traits->conversion == PixelConversion::None) {
+                                 return 204;
+                             }
+                             return frameProduct(in, FrameProduct::Rgba, out);
+                         },
+                         frames));
+    }
+    StagePort<MotionMap> map;
+    if (options.stages[Motion]) {
+        map = add(Motion, graph.addStage<MotionMap>(
+                              "motion", stateful,
+                              [&pipeline](const Frame& in, MotionMap& out) -> int16_t {
+                                  // The first frame only primes it, the map is empty
+                                  const int16_t result = pipeline.motion.process(in, out);
+                                  return result == 204 ? 0 : result;
+                              },
+                              frames));
+    }
+    StagePort<Frame> mask;
+    if (options.stages[Background] && map.valid()) {
+        mask = add(Background, graph.addStage<Frame>(
+                                   "background", stateful,
+                                   [&pipeline](const Frame& in, const MotionMap& motion,
+                                               Frame& out) {
+                                       return pipeline.background.apply(in, out, &motion);
+                                   },
+                                   frames, map));
+    } else if (options.stages[Background]) {
+        mask = add(Background, graph.addStage<Frame>(
+                                   "background", stateful,
+                                   [&pipeline](const Frame& in, Frame& out) {
+                                       return pipeline.background.apply(in, out);
+                                   },
+                                   frames));
+    }
+    if (options.stages[Flow]) {
+        add(Flow, graph.addStage<std::vector<FlowPoint>>(
+                      "flow", stateful,
+                      [&pipeline](const Frame& in, std::vector<FlowPoint>& out) -> int16_t {
+                          if (pipeline.points.empty()) {
+                              seedPoints(in.format, pipeline.points);
+                          }
+                          const int16_t result = pipeline.flow.track(in, pipeline.points, out);
+                          return result == 204 ? 0 : result;
+                      },
+                      frames));
+    }
+    if (options.stages[Blobs] && mask.valid()) {
+        add(Blobs, graph.addStage<std::vector<Blob>>(
+                       "blobs", stateful,
+                       [&pipeline](const Frame& in, std::vector<Blob>& out) {
+                           return pipeline.blobs.extract(in, out);
+                       },
+                       mask));
+    }
+    graph.setSink([&pipeline](const StageFrame& frame) {
+        TraceScope present(frame.frame(), TraceStage::Present);
+        if (frame.frame().arrival != 0) {
+            pipeline.total.record(static_cast<uint64_t>(
+                std::max<int64_t>(0, hostTime100ns() - frame.frame().arrival) / 10));
+        }
+        ++pipeline.processed;
+    });
+}
+
+void runPipeline(Pipeline& pipeline, const RunOptions& options,
+                 const std::atomic<bool>& stop) {
+    if constexpr (FRAME_TRACE_ENABLED) {
+        setTraceThreadName("pipeline " + std::string(pipeline.name.begin(),
+                                                     pipeline.name.end()));
+    }
+    Frame frame, decoded;
+    while (!stop.load(std::memory_order_relaxed) &&
+           (options.frames == 0 || pipeline.read < options.frames)) {
+        int16_t result = pipeline.camera->waitNext(frame, std::chrono::milliseconds(100));
+        if (result == 204) {
+            continue;
+        }
+        if (result != 0) {
+            pipeline.result = result == -410 ? 0 : result;
+            break;
+        }
+        ++pipeline.read;
+        if (pipeline.shedder) {
+            result = applyMediaType(pipeline);
+            if (result != 0) {
+                pipeline.result = result;
+                break;
+            }
+        }
+        if (pipeline.graph) {
+            if (pipeline.read == 1) {
+                buildGraph(pipeline, frame, options);
+            }
+            while (pipeline.graph->push(frame, std::chrono::milliseconds(100)) == -429 &&
+                   !stop.load(std::memory_order_relaxed)) {
+            }
+            continue;
+        }
+        if (!pipeline.decoder && pixelDecoder(frame.format.subtype) == PixelDecoder::Mjpeg) {
+            pipeline.decoder = createDecoder(pipeline, options);
+        }
+        if (!pipeline.decoder) {
+            processFrame(pipeline, frame, options);
+            continue;
+        }
+        // Keeps the decoder's in-flight window full; slots free up as
+        // decoded frames are taken, in order
+        while (pipeline.decoder->submit(frame) == -429) {
+            if (pipeline.decoder->waitNext(decoded, std::chrono::milliseconds(100)) == 0) {
+                processFrame(pipeline, decoded, options);
+            }
+        }
+        while (pipeline.decoder->tryGet(decoded) == 0) {
+            processFrame(pipeline, decoded, options);
+        }
+    }
+    if (pipeline.graph) {
+        pipeline.graph->drain(std::chrono::seconds(10));
+        const StageGraphStats stats = pipeline.graph->getStats();
+        for (std::size_t i = 0; i < stats.stages.size(); ++i) {
+            pipeline.latency[pipeline.graph_stages[i]] = stats.stages[i].time;
+        }
+    } else if (pipeline.decoder) {
+        while (pipeline.decoder->getStats().in_flight > 0 &&
+               pipeline.decoder->waitNext(decoded, std::chrono::milliseconds(1000)) == 0) {
+            processFrame(pipeline, decoded, options);
+        }
+        pipeline.latency[Decode] = pipeline.decoder->getStats().decode_time;
+    }
+    pipeline.camera->deactivate();
+    pipeline.done.store(true);
+}
+
+double peakRssMiB() {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters{};
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+        return counters.PeakWorkingSetSize / (1024.0 * 1024.0);
+    }
+    return 0;
+#else
+    struct rusage usage {};
+    getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+    return usage.ru_maxrss / (1024.0 * 1024.0); // Bytes
+#else
+    return usage.ru_maxrss / 1024.0; // KiB
+#endif
+#endif
+}
+
+std::string narrow(const std::wstring& text) {
+    std::string result;
+    for (wchar_t c : text) {
+        result.push_back(c >= 0x20 && c < 0x7F && c != '"' && c != '\\'
+                             ? static_cast<char>(c)
+                             : '?');
+    }
+    return result;
+}
+
+void writeJson(const std::string& path, const std::vector<std::unique_ptr<Pipeline>>& pipelines,
+               const std::array<LatencyHistogram, STAGE_COUNT>& latency,
+               const LatencyHistogram& total, uint64_t frames, double seconds,
+               double rss) {
+    std::ofstream out(path, std::ios::out | std::ios::trunc);
+    auto histogram = [&](const LatencyHistogram& h) {
+        out << "{\"count\":" << h.count() << ",\"p50_us\":" << h.percentile(50)
+            << ",\"p90_us\":" << h.percentile(90) << ",\"p99_us\":" << h.percentile(99)
+            << ",\"max_us\":" << h.max() << "}";
+    };
+    out << "{\"frames\":" << frames << ",\"seconds\":" << seconds
+        << ",\"fps\":" << (seconds > 0 ? frames / seconds : 0.0)
+        << ",\"peak_rss_mib\":" << rss << ",\"sources\":[";
+    for (std::size_t i = 0; i < pipelines.size(); ++i) {
+        const Pipeline& pipeline = *pipelines[i];
+        out << (i ? "," : "") << "{\"name\":\"" << narrow(pipeline.name)
+            << "\",\"frames\":" << pipeline.processed
+            << ",\"result\":" << pipeline.result;
+        if (pipeline.shedder) {
+            const LoadShedStats stats = pipeline.shedder->getStats();
+            out << ",\"load_shedding\":{\"level\":" << stats.level
+                << ",\"analyzed\":" << stats.analyzed
+                << ",\"skipped\":" << stats.skipped
+                << ",\"overloaded\":" << stats.overloaded
+                << ",\"escalations\":" << stats.escalations
+                << ",\"recoveries\":" << stats.recoveries
+                << ",\"failed_recoveries\":" << stats.failed_recoveries
+                << ",\"latency_ms\":" << stats.latency_ms
+                << ",\"queue_depth\":" << stats.queue_depth
+                << ",\"processing_ms\":" << stats.processing_ms
+                << ",\"frames_at_level\":[";
+            for (std::size_t level = 0; level < stats.frames_at_level.size(); ++level) {
+                out << (level ? "," : "") << stats.frames_at_level[level];
+            }
+            out << "],\"decisions\":[";
+            for (std::size_t d = 0; d < pipeline.decisions.size(); ++d) {
+                const LoadDecision& decision = pipeline.decisions[d];
+                out << (d ? "," : "") << "{\"frame\":" << decision.frame
+                    << ",\"from\":" << decision.from << ",\"to\":" << decision.to
+                    << ",\"reason\":\"" << loadReasonName(decision.reason)
+                    << "\",\"latency_ms\":" << decision.latency_ms
+                    << ",\"queue_depth\":" << decision.queue_depth
+                    << ",\"processing_ms\":" << decision.processing_ms
+                    << ",\"busiest_stage\":\""
+                    << (decision.busiest_stage < STAGE_COUNT
+                            ? STAGE_NAMES[decision.busiest_stage]
+                            : "")
+                    << "\"}";
+            }
+            out << "]}";
+        }
+        out << "}";
+    }
+    out << "],\"stages\":{";
+    const char* separator = "";
+    for (std::size_t stage = 0; stage < STAGE_COUNT; ++stage) {
+        if (latency[stage].count() > 0) {
+            out << separator << "\"" << STAGE_NAMES[stage] << "\":";
+            histogram(latency[stage]);
+            separator = ",";
+        }
+    }
+    out << "},\"frame\":";
+    histogram(total);
+    out << "}\n";
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    RunOptions options;
+    if (!parseArguments(argc, argv, options)) {
+        usage();
+        return 1;
+    }
+
+    auto workers   = std::make_shared<ThreadPool>(options.threads);
+    auto scheduler = options.graph ? std::make_shared<StageScheduler>(
+                                         StageSchedulerOptions{}, workers)
+                                   : nullptr;
+#ifdef _WIN32
+    std::unique_ptr<WebcamManager> manager;
+#endif
+    std::vector<std::unique_ptr<Pipeline>> pipelines;
+    for (const SourceSpec& spec : options.sources) {
+        auto pipeline = std::make_unique<Pipeline>(workers);
+        if (spec.kind == SourceSpec::Kind::Camera) {
+#ifdef _WIN32
+            if (!manager) {
+                manager = std::make_unique<WebcamManager>();
+                manager->waitForDevices(std::chrono::seconds(10));
+            }
+            if (spec.camera >= manager->getDeviceCount()) {
+                std::fwprintf(stderr, L"no camera %zu\n", spec.camera);
+                return 1;
+            }
+            pipeline->camera = &(*manager)[spec.camera];
+#else
+            std::fwprintf(stderr, L"cameras are only supported on Windows\n");
+            return 1;
+#endif
+        } else {
+            pipeline->owned  = std::make_unique<Webcam>(createSource(spec, options));
+            pipeline->camera = pipeline->owned.get();
+            // Every frame is processed, the source waits for the pipeline
+            pipeline->camera->setCaptureOptions({8, RingPolicy::Block});
+        }
+        if (options.shed_ms > 0) {
+            // A live camera: frames keep coming and the oldest are dropped
+            pipeline->camera->setCaptureOptions({8, RingPolicy::OverwriteOldest});
+
+            const MediaCatalog& catalog = pipeline->camera->getMediaCatalog();
+            pipeline->selected          = pipeline->camera->getMediaTypeIndex();
+            LoadShedOptions shed;
+            shed.target_latency_ms = options.shed_ms;
+            if (pipeline->selected < catalog.size() && catalog.fps(pipeline->selected) > 0) {
+                shed.frame_budget_ms = 1000.0 / catalog.fps(pipeline->selected);
+            }
+            shed.optional_stages = (1u << Flow) | (1u << Blobs);
+            pipeline->shedder    = std::make_unique<LoadShedder>(shed);
+        }
+        if (scheduler) {
+            pipeline->graph = std::make_unique<StageGraph>(StageGraphOptions{}, scheduler);
+        }
+        pipeline->name = pipeline->camera->getName();
+        pipeline->camera->setRegionOfInterest(options.roi);
+
+        int16_t result = pipeline->camera->activate();
+        if (result != 0) {
+            std::fwprintf(stderr, L"cannot open %ls: %d\n", pipeline->name.c_str(), result);
+            return 1;
+        }
+        pipelines.push_back(std::move(pipeline));
+    }
+
+    if (!options.trace_path.empty()) {
+        startFrameTrace();
+    }
+    TraceReport       report;
+    std::atomic<bool> stop{false};
+    const auto        start = std::chrono::steady_clock::now();
+
+    std::vector<std::thread> threads;
+    for (auto& pipeline : pipelines) {
+        threads.emplace_back(runPipeline, std::ref(*pipeline), std::cref(options),
+                             std::cref(stop));
+    }
+    // Deadline and, when tracing, regular collection so no buffer overflows
+    auto running = [&] {
+        return std::any_of(pipelines.begin(), pipelines.end(),
+                           [](const auto& p) { return !p->done.load(); });
+    };
+    while (running()) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        const double elapsed = std::chrono::duration<double>(
+                                   std::chrono::steady_clock::now() - start)
+                                   .count();
+        if (options.seconds > 0 && elapsed >= options.seconds) {
+            stop.store(true);
+        }
+        if (isFrameTraceRecording()) {
+            report.collect();
+        }
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    const double seconds =
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    stopFrameTrace();
+
+    std::array<LatencyHistogram, STAGE_COUNT> latency{};
+    LatencyHistogram                          total;
+    uint64_t                                  frames = 0;
+    bool                                      failed = false;
+    for (const auto& pipeline : pipelines) {
+        for (std::size_t stage = 0; stage < STAGE_COUNT; ++stage) {
+            latency[stage].merge(pipeline->latency[stage]);
+        }
+        total.merge(pipeline->total);
+        frames += pipeline->processed;
+        failed = failed || pipeline->result != 0 || pipeline->processed == 0;
+        std::wprintf(L"%-32ls %8llu frames  %8.1f fps  result %d\n",
+                     pipeline->name.c_str(),
+                     static_cast<unsigned long long>(pipeline->processed),
+                     pipeline->processed / seconds, pipeline->result);
+        if (pipeline->shedder) {
+            const LoadShedStats stats = pipeline->shedder->getStats();
+            std::wprintf(L"  load level %u of %zu, %llu analyzed, %llu skipped, "
+                         L"%llu escalations, %llu recoveries (%llu failed)\n",
+                         stats.level, pipeline->shedder->getLevelCount() - 1,
+                         static_cast<unsigned long long>(stats.analyzed),
+                         static_cast<unsigned long long>(stats.skipped),
+                         static_cast<unsigned long long>(stats.escalations),
+                         static_cast<unsigned long long>(stats.recoveries),
+                         static_cast<unsigned long long>(stats.failed_recoveries));
+            for (const LoadDecision& decision : pipeline->decisions) {
+                std::wprintf(L"  frame %6llu: level %u -> %u (%s), latency %.1f ms, "
+                             L"queue %.1f, processing %.1f ms, busiest %s\n",
+                             static_cast<unsigned long long>(decision.frame),
+                             decision.from, decision.to, loadReasonName(decision.reason),
+                             decision.latency_ms, decision.queue_depth,
+                             decision.processing_ms,
+                             decision.busiest_stage < STAGE_COUNT
+                                 ? STAGE_NAMES[decision.busiest_stage]
+                                 : "-");
+            }
+        }
+    }
+    const double rss = peakRssMiB();
+    std::wprintf(L"total %llu frames in %.3f s, %.1f fps, %zu worker threads, "
+                 L"peak RSS %.1f MiB\n",
+                 static_cast<unsigned long long>(frames), seconds, frames / seconds,
+                 workers->size(), rss);
+    if (scheduler) {
+        const StageSchedulerStats stats = scheduler->getStats();
+        std::wprintf(L"graph: %llu stage tasks, at most %zu running and %zu waiting\n",
+                     static_cast<unsigned long long>(stats.tasks), stats.max_running,
+                     stats.max_ready);
+    }
+    std::wprintf(L"%-10ls %8ls %9ls %9ls %9ls %9ls\n", L"stage", L"count", L"p50 us",
+                 L"p90 us", L"p99 us", L"max us");
+    auto row = [](const wchar_t* name, const LatencyHistogram& h) {
+        std::wprintf(L"%-10ls %8llu %9llu %9llu %9llu %9llu\n", name,
+                     static_cast<unsigned long long>(h.count()),
+                     static_cast<unsigned long long>(h.percentile(50)),
+                     static_cast<unsigned long long>(h.percentile(90)),
+                     static_cast<unsigned long long>(h.percentile(99)),
+                     static_cast<unsigned long long>(h.max()));
+    };
+    for (std::size_t stage = 0; stage < STAGE_COUNT; ++stage) {
+        if (latency[stage].count() > 0) {
+            const std::string name = STAGE_NAMES[stage];
+            row(std::wstring(name.begin(), name.end()).c_str(), latency[stage]);
+        }
+    }
+    row(L"frame", total);
+
+    if (!options.json_path.empty()) {
+        writeJson(options.json_path, pipelines, latency, total, frames, seconds, rss);
+    }
+    if (!options.trace_path.empty()) {
+        report.collect();
+        if (!FRAME_TRACE_ENABLED) {
+            std::fwprintf(stderr, L"built without WEBCAM_ENABLE_TRACE, the trace is empty\n");
+        }
+        row(L"traced", report.getEndToEnd());
+        if (report.writeChromeTrace(options.trace_path) != 0) {
+            std::fwprintf(stderr, L"cannot write %s\n", options.trace_path.c_str());
+            failed = true;
+        }
+    }
+    return failed ? 1 : 0;
+}